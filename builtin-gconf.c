@@ -31,6 +31,7 @@
 
 #include "mce-log.h"
 #include "mce-io.h"
+#include "mce-conf.h"
 
 /* ========================================================================= *
  *
@@ -50,6 +51,15 @@
 /** Path to persistent storage file */
 #define VALUES_PATH G_STRINGIFY(MCE_VAR_DIR)"/builtin-gconf.values"
 
+/** Configuration group for builtin-gconf settings in mce.ini */
+#define MCE_CONF_BUILTIN_GCONF_GROUP "BuiltinGConf"
+
+/** Delay for coalescing persistent storage writes; 0 = write through */
+#define MCE_CONF_SAVE_DELAY "SaveDelay"
+
+/** Default persistent storage write delay [ms] */
+#define DEFAULT_SAVE_DELAY 1000
+
 /* ========================================================================= *
  *
  * MACROS
@@ -146,8 +156,18 @@ typedef struct GConfClient
 
   GSList  *entries;
 
+  GHashTable *entry_lut; // key -> GConfEntry
+
   GSList  *notify_list;
 
+  GHashTable *notify_lut; // key -> GSList of GConfClientNotify
+
+  gint     save_delay;    // write-behind delay [ms], 0 = write through
+
+  guint    save_id;       // pending write-behind timer
+
+  guint    save_coalesced; // number of file writes avoided
+
 } GConfClient;
 
 typedef enum
@@ -257,15 +277,15 @@ gconf_error_quark (void)
 
 /** Error logging function */
 #if GCONF_ENABLE_ERROR_LOGGING
-# define gconf_log_error(FMT, ARG...) mce_log_file(LL_WARN, __FILE__, __FUNCTION__, FMT , ##ARG)
+# define gconf_log_error(FMT, ARG...) mce_log(LL_WARN, FMT , ##ARG)
 #else
 # define gconf_log_error(FMT, ARG...) do{}while(0)
 #endif
 
 /** Debug logging function */
 #if GCONF_ENABLE_DEBUG_LOGGING
-# define gconf_log_debug_p()          mce_log_p(LL_DEBUG)
-# define gconf_log_debug(FMT, ARG...) mce_log_file(LL_DEBUG, __FILE__, __FUNCTION__, FMT , ##ARG)
+# define gconf_log_debug_p()          mce_log_enabled_p(LL_DEBUG)
+# define gconf_log_debug(FMT, ARG...) mce_log(LL_DEBUG, FMT , ##ARG)
 #else
 # define gconf_log_debug_p()          0
 # define gconf_log_debug(FMT, ARG...) do{}while(0)
@@ -1496,6 +1516,53 @@ cleanup:
   return;
 }
 
+/** Write-behind timer callback */
+static gboolean gconf_client_save_cb(gpointer aptr)
+{
+  GConfClient *self = aptr;
+
+  self->save_id = 0;
+
+  gconf_client_save_values(self, VALUES_PATH);
+
+  return FALSE;
+}
+
+/** Schedule saving of values after changing them
+ *
+ * Changes made within the write-behind delay are written to the
+ * persistent storage file in one go.
+ */
+static void gconf_client_schedule_save(GConfClient *self)
+{
+  if( self->save_delay <= 0 )
+  {
+    gconf_client_save_values(self, VALUES_PATH);
+  }
+  else if( self->save_id )
+  {
+    self->save_coalesced += 1;
+  }
+  else
+  {
+    self->save_id = g_timeout_add(self->save_delay,
+                                  gconf_client_save_cb, self);
+  }
+}
+
+/** Save pending changes immediately */
+static void gconf_client_flush_values(GConfClient *self)
+{
+  if( self->save_id )
+  {
+    g_source_remove(self->save_id), self->save_id = 0;
+    gconf_client_save_values(self, VALUES_PATH);
+  }
+
+  mce_log(LL_NOTICE, "%u value file writes avoided by write-behind",
+          self->save_coalesced);
+}
+
 /** Load values from persistent storage file */
 static void gconf_client_load_values(GConfClient *self, const char *path)
 {
@@ -1650,6 +1717,23 @@ gconf_client_get_default(void)
     }
     self->entries = g_slist_reverse(self->entries);
 
+    // index entries by key; the key strings are owned by the entries
+    self->entry_lut = g_hash_table_new(g_str_hash, g_str_equal);
+    for( GSList *e_iter = self->entries; e_iter; e_iter = e_iter->next )
+    {
+      GConfEntry *entry = e_iter->data;
+      g_hash_table_insert(self->entry_lut, entry->key, entry);
+    }
+
+    // notifications bucketed by key; lists are managed explicitly
+    self->notify_lut = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                             g_free, 0);
+
+    // persistent storage write-behind delay
+    self->save_delay = mce_conf_get_int(MCE_CONF_BUILTIN_GCONF_GROUP,
+                                        MCE_CONF_SAVE_DELAY,
+                                        DEFAULT_SAVE_DELAY);
+
     // let gconf_client_is_valid() know about this
     default_client = self;
 
@@ -1700,15 +1784,7 @@ gconf_client_find_entry(GConfClient *self, const gchar *key, GError **err)
     goto cleanup;
   }
 
-  for( GSList *e_iter = self->entries; e_iter; e_iter = e_iter->next )
-  {
-    GConfEntry *entry = e_iter->data;
-    if( !strcmp(entry->key, key) )
-    {
-      res = entry;
-      break;
-    }
-  }
+  res = g_hash_table_lookup(self->entry_lut, key);
 
   if( !res )
   {
@@ -1788,6 +1864,7 @@ gconf_client_set_bool(GConfClient *client,
     }
 #endif
 
+    gconf_client_schedule_save(client);
     gconf_client_notify_change(client, key);
   }
 
@@ -1818,6 +1895,7 @@ gconf_client_set_int(GConfClient *client,
     }
 #endif
 
+    gconf_client_schedule_save(client);
     gconf_client_notify_change(client, key);
   }
   return res;
@@ -1847,6 +1925,7 @@ gconf_client_set_float(GConfClient *client,
     }
 #endif
 
+    gconf_client_schedule_save(client);
     gconf_client_notify_change(client, key);
   }
   return res;
@@ -1876,6 +1955,7 @@ gconf_client_set_string(GConfClient *client,
     }
 #endif
 
+    gconf_client_schedule_save(client);
     gconf_client_notify_change(client, key);
   }
   return res;
@@ -1907,6 +1987,7 @@ gconf_client_set_list(GConfClient *client,
     }
 #endif
 
+    gconf_client_schedule_save(client);
     gconf_client_notify_change(client, key);
   }
   return res;
@@ -1917,8 +1998,7 @@ void
 gconf_client_suggest_sync(GConfClient *client, GError **err)
 {
   if( gconf_client_is_valid(client, err) ) {
-    // FIXME: do we need delayed save?
-    gconf_client_save_values(client, VALUES_PATH);
+    gconf_client_flush_values(client);
   }
 }
 
@@ -2012,6 +2092,25 @@ EXIT:
 }
 
 
+/** Locate still registered notify by key and id */
+static
+GConfClientNotify *
+gconf_client_notify_find(GConfClient *client, const char *key, guint id)
+{
+  for( GSList *item = g_hash_table_lookup(client->notify_lut, key);
+       item; item = item->next )
+  {
+    GConfClientNotify *notify = item->data;
+
+    if( notify->id == id )
+    {
+      return notify;
+    }
+  }
+
+  return 0;
+}
+
 /** Dispatch change notifications via installed  callbacks */
 static
 void
@@ -2023,23 +2122,39 @@ gconf_client_notify_change(GConfClient           *client,
 
   if( entry )
   {
-    /* handle internal notifications */
-    for( GSList *item = client->notify_list; item; item = item->next )
+    /* handle internal notifications
+     *
+     * Callbacks may add / remove notifies, which modifies the
+     * bucket we are iterating over -> take a snapshot of the ids
+     * and re-validate each one before making the callback.
+     */
+    GSList *ids = 0;
+
+    for( GSList *item = g_hash_table_lookup(client->notify_lut, entry->key);
+         item; item = item->next )
     {
       GConfClientNotify *notify = item->data;
+      ids = g_slist_prepend(ids, GUINT_TO_POINTER(notify->id));
+    }
+    ids = g_slist_reverse(ids);
 
-      if( notify->func == 0 )
+    for( GSList *item = ids; item; item = item->next )
+    {
+      GConfClientNotify *notify =
+        gconf_client_notify_find(client, entry->key,
+                                 GPOINTER_TO_UINT(item->data));
+
+      if( notify == 0 || notify->func == 0 )
       {
         continue;
       }
 
-      if( !strcmp(notify->namespace_section, namespace_section) )
-      {
-	gconf_log_debug("id=%u, namespace=%s", notify->id, notify->namespace_section);
-        notify->func(client, notify->id, entry, notify->user_data);
-      }
+      gconf_log_debug("id=%u, namespace=%s", notify->id, notify->namespace_section);
+      notify->func(client, notify->id, entry, notify->user_data);
     }
 
+    g_slist_free(ids);
+
     /* broadcast change also on dbus */
     gconf_signal_value_change(entry);
   }
@@ -2070,6 +2185,12 @@ gconf_client_notify_add(GConfClient *client,
                                      destroy_notify);
 
     client->notify_list = g_slist_prepend(client->notify_list, notify);
+
+    GSList *bucket = g_hash_table_lookup(client->notify_lut,
+                                         namespace_section);
+    bucket = g_slist_prepend(bucket, notify);
+    g_hash_table_insert(client->notify_lut,
+                        g_strdup(namespace_section), bucket);
   }
 
 cleanup:
@@ -2092,8 +2213,18 @@ gconf_client_notify_remove(GConfClient *client, guint cnxn)
 
     if( notify->id == cnxn )
     {
-      gconf_client_notify_free(notify);
+      GSList *bucket = g_hash_table_lookup(client->notify_lut,
+                                           notify->namespace_section);
+      bucket = g_slist_remove(bucket, notify);
+      if( bucket )
+        g_hash_table_insert(client->notify_lut,
+                            g_strdup(notify->namespace_section), bucket);
+      else
+        g_hash_table_remove(client->notify_lut, notify->namespace_section);
+
+      /* Unlink before freeing: destroy_notify may call back to us */
       client->notify_list = g_slist_delete_link(client->notify_list, item);
+      gconf_client_notify_free(notify);
       break;
     }
   }
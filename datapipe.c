@@ -21,10 +21,475 @@
  */
 #include <glib.h>
 
+#include <string.h>			/* memcpy(), memset(), strrchr() */
+#include <dlfcn.h>			/* dladdr() */
+
 #include "datapipe.h"
 
 #include "mce-log.h"			/* mce_log(), LL_* */
 
+/**
+ * Get a reference to a callback array
+ *
+ * @param hooks The callback array, or NULL
+ * @return hooks
+ */
+static datapipe_hooks_t *datapipe_hooks_ref(datapipe_hooks_t *const hooks)
+{
+	if (hooks != NULL)
+		hooks->refcount++;
+
+	return hooks;
+}
+
+/**
+ * Release a reference to a callback array
+ *
+ * @param hooks The callback array, or NULL
+ */
+static void datapipe_hooks_unref(datapipe_hooks_t *const hooks)
+{
+	if ((hooks != NULL) && (--hooks->refcount == 0))
+		g_free(hooks);
+}
+
+/**
+ * Replace a callback array with a copy that has one callback appended
+ *
+ * @param phooks Pointer to the callback array to modify
+ * @param hook The callback to append
+ */
+static void datapipe_hooks_append(datapipe_hooks_t **const phooks,
+				  gpointer const hook)
+{
+	datapipe_hooks_t *const hooks = *phooks;
+	const guint count = datapipe_hooks_count(hooks);
+	datapipe_hooks_t *res;
+
+	res = g_malloc(sizeof *res + (count + 1) * sizeof res->hook[0]);
+	res->refcount = 1;
+	res->count = count + 1;
+
+	if (count > 0)
+		memcpy(res->hook, hooks->hook, count * sizeof res->hook[0]);
+
+	res->hook[count] = hook;
+
+	*phooks = res;
+	datapipe_hooks_unref(hooks);
+}
+
+/**
+ * Replace a callback array with a copy that has the first
+ * occurrence of a callback removed
+ *
+ * @param phooks Pointer to the callback array to modify
+ * @param hook The callback to remove
+ * @return TRUE if the callback was removed,
+ *         FALSE if it was not in the array
+ */
+static gboolean datapipe_hooks_remove(datapipe_hooks_t **const phooks,
+				      gconstpointer const hook)
+{
+	datapipe_hooks_t *const hooks = *phooks;
+	const guint count = datapipe_hooks_count(hooks);
+	datapipe_hooks_t *res = NULL;
+	gboolean removed = FALSE;
+	guint i;
+
+	for (i = 0; i < count; i++) {
+		if (hooks->hook[i] == hook)
+			break;
+	}
+
+	if (i == count)
+		goto EXIT;
+
+	if (count > 1) {
+		res = g_malloc(sizeof *res +
+			       (count - 1) * sizeof res->hook[0]);
+		res->refcount = 1;
+		res->count = count - 1;
+		memcpy(res->hook, hooks->hook, i * sizeof res->hook[0]);
+		memcpy(res->hook + i, hooks->hook + i + 1,
+		       (count - 1 - i) * sizeof res->hook[0]);
+	}
+
+	*phooks = res;
+	datapipe_hooks_unref(hooks);
+	removed = TRUE;
+
+EXIT:
+	return removed;
+}
+
+/**
+ * Kinds of datapipe callbacks, as reported in statistics
+ */
+typedef enum {
+	DATAPIPE_HOOK_FILTER,		/**< Filter */
+	DATAPIPE_HOOK_INPUT_TRIGGER,	/**< Input trigger */
+	DATAPIPE_HOOK_OUTPUT_TRIGGER,	/**< Output trigger */
+	DATAPIPE_HOOK_REFCOUNT_TRIGGER,	/**< Reference count trigger */
+} datapipe_hook_kind_t;
+
+/** Names for datapipe_hook_kind_t values */
+static const char *const datapipe_hook_kind_name[] = {
+	[DATAPIPE_HOOK_FILTER]           = "filter",
+	[DATAPIPE_HOOK_INPUT_TRIGGER]    = "input",
+	[DATAPIPE_HOOK_OUTPUT_TRIGGER]   = "output",
+	[DATAPIPE_HOOK_REFCOUNT_TRIGGER] = "refcount",
+};
+
+/**
+ * Execution time statistics
+ */
+typedef struct {
+	guint64 count;			/**< Number of executions */
+	guint64 total_us;		/**< Cumulative execution time */
+	guint64 max_us;			/**< Longest execution time */
+	guint32 hist[DATAPIPE_STATS_BUCKETS];	/**< Execution counts;
+						 *   bucket N > 0 holds times
+						 *   from 2^(N-1) to 2^N-1 us,
+						 *   the last one everything
+						 *   longer than that */
+} datapipe_timing_t;
+
+/**
+ * Execution time statistics of a datapipe callback
+ */
+typedef struct {
+	gconstpointer hook;		/**< Callback function */
+	datapipe_hook_kind_t kind;	/**< How the callback is used */
+	datapipe_timing_t timing;	/**< Execution times */
+} datapipe_hook_stats_t;
+
+/**
+ * Execution statistics of a datapipe
+ */
+struct datapipe_stats_t {
+	datapipe_timing_t timing;	/**< Times of execute_datapipe(),
+					 *   including nested executions */
+	GPtrArray *hooks;		/**< datapipe_hook_stats_t entries */
+};
+
+/** Whether datapipe executions are timed */
+static gboolean datapipe_stats_enabled = FALSE;
+
+/** Datapipes that have been set up, for statistics reporting */
+static GSList *datapipe_list = NULL;
+
+/**
+ * Enable datapipe execution statistics
+ */
+void datapipe_stats_enable(void)
+{
+	datapipe_stats_enabled = TRUE;
+}
+
+/**
+ * Check if datapipe execution statistics are enabled
+ *
+ * @return TRUE if statistics are collected, FALSE otherwise
+ */
+gboolean datapipe_stats_enabled_p(void)
+{
+	return datapipe_stats_enabled;
+}
+
+/**
+ * Get start time for timing a datapipe execution step
+ *
+ * @return monotonic time in microseconds,
+ *         or 0 if statistics are not enabled
+ */
+static gint64 datapipe_stats_begin(void)
+{
+	return datapipe_stats_enabled ? g_get_monotonic_time() : 0;
+}
+
+/**
+ * Add execution time to statistics
+ *
+ * @param timing The statistics to update
+ * @param t0 Start time from datapipe_stats_begin()
+ */
+static void datapipe_timing_add(datapipe_timing_t *const timing,
+				const gint64 t0)
+{
+	const gint64 t1 = datapipe_stats_begin();
+	const guint64 us = (t1 > t0) ? (guint64)(t1 - t0) : 0;
+	guint64 v = us;
+	guint bucket = 0;
+
+	for (; v && bucket < DATAPIPE_STATS_BUCKETS - 1; v >>= 1)
+		bucket++;
+
+	timing->count++;
+	timing->total_us += us;
+	timing->hist[bucket]++;
+
+	if (timing->max_us < us)
+		timing->max_us = us;
+}
+
+/**
+ * Add datapipe callback execution time to statistics
+ *
+ * @param datapipe The datapipe the callback was executed for
+ * @param kind How the callback is used
+ * @param hook The callback
+ * @param t0 Start time from datapipe_stats_begin()
+ */
+static void datapipe_stats_end_hook(const datapipe_struct *const datapipe,
+				    const datapipe_hook_kind_t kind,
+				    gconstpointer const hook,
+				    const gint64 t0)
+{
+	datapipe_stats_t *const stats = datapipe->stats;
+	datapipe_hook_stats_t *entry = NULL;
+	guint i;
+
+	if (!datapipe_stats_enabled || stats == NULL)
+		goto EXIT;
+
+	/* Datapipes have only a handful of callbacks */
+	for (i = 0; i < stats->hooks->len; i++) {
+		entry = g_ptr_array_index(stats->hooks, i);
+
+		if ((entry->hook == hook) && (entry->kind == kind))
+			break;
+	}
+
+	if (i == stats->hooks->len) {
+		entry = g_malloc0(sizeof *entry);
+		entry->hook = hook;
+		entry->kind = kind;
+		g_ptr_array_add(stats->hooks, entry);
+	}
+
+	datapipe_timing_add(&entry->timing, t0);
+
+EXIT:
+	return;
+}
+
+/**
+ * Allocate statistics for a datapipe
+ *
+ * @return Empty statistics
+ */
+static datapipe_stats_t *datapipe_stats_create(void)
+{
+	datapipe_stats_t *stats = g_malloc0(sizeof *stats);
+
+	stats->hooks = g_ptr_array_new();
+
+	return stats;
+}
+
+/**
+ * Release statistics of a datapipe
+ *
+ * @param stats The statistics, or NULL
+ */
+static void datapipe_stats_delete(datapipe_stats_t *const stats)
+{
+	guint i;
+
+	if (stats == NULL)
+		goto EXIT;
+
+	for (i = 0; i < stats->hooks->len; i++)
+		g_free(g_ptr_array_index(stats->hooks, i));
+
+	g_ptr_array_free(stats->hooks, TRUE);
+	g_free(stats);
+
+EXIT:
+	return;
+}
+
+/**
+ * Sort callback statistics by cumulative execution time, longest first
+ */
+static gint datapipe_stats_hook_cmp(gconstpointer a, gconstpointer b)
+{
+	const datapipe_hook_stats_t *const *pa = a;
+	const datapipe_hook_stats_t *const *pb = b;
+	const guint64 ta = (*pa)->timing.total_us;
+	const guint64 tb = (*pb)->timing.total_us;
+
+	return (ta < tb) - (ta > tb);
+}
+
+/**
+ * Sort datapipes by cumulative execution time, longest first
+ */
+static gint datapipe_stats_pipe_cmp(gconstpointer a, gconstpointer b)
+{
+	const datapipe_struct *const *pa = a;
+	const datapipe_struct *const *pb = b;
+	const guint64 ta = (*pa)->stats->timing.total_us;
+	const guint64 tb = (*pb)->stats->timing.total_us;
+
+	return (ta < tb) - (ta > tb);
+}
+
+/**
+ * Get human readable name for a callback function
+ *
+ * Modules are loaded with local symbol binding and most callbacks
+ * are static functions, so unless an exact symbol match is found,
+ * the name is given as object file name plus offset that can be
+ * resolved with addr2line.
+ *
+ * @param hook The callback
+ * @return Callback name; release with g_free()
+ */
+static gchar *datapipe_stats_hook_name(gconstpointer const hook)
+{
+	const char *base;
+	Dl_info info;
+
+	memset(&info, 0, sizeof info);
+
+	if (!dladdr(hook, &info) || (info.dli_fname == NULL))
+		return g_strdup_printf("%p", hook);
+
+	if ((info.dli_sname != NULL) && (info.dli_saddr == hook))
+		return g_strdup(info.dli_sname);
+
+	base = strrchr(info.dli_fname, '/');
+	base = base ? base + 1 : info.dli_fname;
+
+	return g_strdup_printf("%s+0x%lx", base,
+			       (unsigned long)((const char *)hook -
+					       (const char *)info.dli_fbase));
+}
+
+/**
+ * Append a statistics line to a report
+ *
+ * @param report The report to append to
+ * @param name Name of the datapipe or callback
+ * @param timing Execution times
+ */
+static void datapipe_stats_append(GString *const report,
+				  const gchar *const name,
+				  const datapipe_timing_t *const timing)
+{
+	guint i;
+
+	g_string_append_printf(report, "%-44s %8"G_GUINT64_FORMAT
+			       " %10"G_GUINT64_FORMAT" %8"G_GUINT64_FORMAT
+			       " %8.1f", name, timing->count,
+			       timing->total_us,
+			       timing->max_us,
+			       timing->count ?
+			       (double)timing->total_us / timing->count : 0.0);
+
+	for (i = 0; i < DATAPIPE_STATS_BUCKETS; i++) {
+		if (timing->hist[i] == 0)
+			continue;
+
+		g_string_append_printf(report, " %u:%u",
+				       i ? 1u << (i - 1) : 0u,
+				       timing->hist[i]);
+	}
+
+	g_string_append_c(report, '\n');
+}
+
+/**
+ * Format datapipe execution statistics
+ *
+ * Datapipes and their callbacks are listed by cumulative execution
+ * time, longest first. Datapipe times include everything executed
+ * from within the datapipe, nested datapipe executions included.
+ *
+ * @return Statistics report; release with g_free()
+ */
+gchar *datapipe_stats_to_string(void)
+{
+	GString *report;
+	GPtrArray *pipes;
+	GSList *item;
+	guint i, k;
+
+	if (!datapipe_stats_enabled) {
+		return g_strdup("datapipe statistics not enabled; "
+				"start mce with --trace=datapipes\n");
+	}
+
+	report = g_string_new(NULL);
+	pipes = g_ptr_array_new();
+
+	for (item = datapipe_list; item; item = item->next) {
+		datapipe_struct *datapipe = item->data;
+
+		if ((datapipe->stats->timing.count > 0) ||
+		    (datapipe->stats->hooks->len > 0))
+			g_ptr_array_add(pipes, datapipe);
+	}
+
+	g_ptr_array_sort(pipes, datapipe_stats_pipe_cmp);
+
+	g_string_append_printf(report, "%-44s %8s %10s %8s %8s %s\n",
+			       "datapipe / callback", "count",
+			       "total_us", "max_us", "avg_us",
+			       "histogram <usec>:<count>");
+
+	for (i = 0; i < pipes->len; i++) {
+		datapipe_struct *datapipe = g_ptr_array_index(pipes, i);
+		datapipe_stats_t *stats = datapipe->stats;
+
+		datapipe_stats_append(report, datapipe->name, &stats->timing);
+
+		g_ptr_array_sort(stats->hooks, datapipe_stats_hook_cmp);
+
+		for (k = 0; k < stats->hooks->len; k++) {
+			datapipe_hook_stats_t *entry =
+				g_ptr_array_index(stats->hooks, k);
+			gchar *hook = datapipe_stats_hook_name(entry->hook);
+			const char *kind = datapipe_hook_kind_name[entry->kind];
+			gchar *name = g_strdup_printf("  %-8s %s", kind, hook);
+
+			datapipe_stats_append(report, name, &entry->timing);
+			g_free(name);
+			g_free(hook);
+		}
+	}
+
+	g_ptr_array_free(pipes, TRUE);
+
+	return g_string_free(report, FALSE);
+}
+
+/**
+ * Execute the reference count triggers of a datapipe
+ *
+ * @param datapipe The datapipe to execute
+ */
+static void execute_datapipe_refcount_triggers(datapipe_struct *const datapipe)
+{
+	datapipe_hooks_t *hooks = datapipe_hooks_ref(datapipe->refcount_triggers);
+	const guint count = datapipe_hooks_count(hooks);
+	void (*refcount_trigger)(void);
+	guint i;
+
+	for (i = 0; i < count; i++) {
+		const gint64 t0 = datapipe_stats_begin();
+
+		refcount_trigger = hooks->hook[i];
+		refcount_trigger();
+		datapipe_stats_end_hook(datapipe, DATAPIPE_HOOK_REFCOUNT_TRIGGER,
+					hooks->hook[i], t0);
+	}
+
+	datapipe_hooks_unref(hooks);
+}
+
 /**
  * Execute the input triggers of a datapipe
  *
@@ -41,8 +506,9 @@ void execute_datapipe_input_triggers(datapipe_struct *const datapipe,
 				     const caching_policy_t cache_indata)
 {
 	void (*trigger)(gconstpointer const input);
+	datapipe_hooks_t *hooks;
 	gpointer data;
-	gint i;
+	guint i;
 
 	if (datapipe == NULL) {
 		/* Potential memory leak! */
@@ -63,11 +529,19 @@ void execute_datapipe_input_triggers(datapipe_struct *const datapipe,
 		}
 	}
 
-	for (i = 0; (trigger = g_slist_nth_data(datapipe->input_triggers,
-						i)) != NULL; i++) {
+	hooks = datapipe_hooks_ref(datapipe->input_triggers);
+
+	for (i = 0; i < datapipe_hooks_count(hooks); i++) {
+		const gint64 t0 = datapipe_stats_begin();
+
+		trigger = hooks->hook[i];
 		trigger(data);
+		datapipe_stats_end_hook(datapipe, DATAPIPE_HOOK_INPUT_TRIGGER,
+					hooks->hook[i], t0);
 	}
 
+	datapipe_hooks_unref(hooks);
+
 EXIT:
 	return;
 }
@@ -86,9 +560,10 @@ gconstpointer execute_datapipe_filters(datapipe_struct *const datapipe,
 				       const data_source_t use_cache)
 {
 	gpointer (*filter)(gpointer input);
+	datapipe_hooks_t *hooks;
 	gpointer data;
 	gconstpointer retval = NULL;
-	gint i;
+	guint i;
 
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
@@ -99,9 +574,16 @@ gconstpointer execute_datapipe_filters(datapipe_struct *const datapipe,
 
 	data = (use_cache == USE_CACHE) ? datapipe->cached_data : indata;
 
-	for (i = 0; (filter = g_slist_nth_data(datapipe->filters,
-					       i)) != NULL; i++) {
-		gpointer tmp = filter(data);
+	hooks = datapipe_hooks_ref(datapipe->filters);
+
+	for (i = 0; i < datapipe_hooks_count(hooks); i++) {
+		const gint64 t0 = datapipe_stats_begin();
+		gpointer tmp;
+
+		filter = hooks->hook[i];
+		tmp = filter(data);
+		datapipe_stats_end_hook(datapipe, DATAPIPE_HOOK_FILTER,
+					hooks->hook[i], t0);
 
 		/* If the data needs to be freed, and this isn't the indata,
 		 * or if we're not using the cache, then free the data
@@ -113,6 +595,8 @@ gconstpointer execute_datapipe_filters(datapipe_struct *const datapipe,
 		data = tmp;
 	}
 
+	datapipe_hooks_unref(hooks);
+
 	retval = data;
 
 EXIT:
@@ -132,8 +616,9 @@ void execute_datapipe_output_triggers(const datapipe_struct *const datapipe,
 				      const data_source_t use_cache)
 {
 	void (*trigger)(gconstpointer input);
+	datapipe_hooks_t *hooks;
 	gconstpointer data;
-	gint i;
+	guint i;
 
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
@@ -144,11 +629,19 @@ void execute_datapipe_output_triggers(const datapipe_struct *const datapipe,
 
 	data = (use_cache == USE_CACHE) ? datapipe->cached_data : indata;
 
-	for (i = 0; (trigger = g_slist_nth_data(datapipe->output_triggers,
-						i)) != NULL; i++) {
+	hooks = datapipe_hooks_ref(datapipe->output_triggers);
+
+	for (i = 0; i < datapipe_hooks_count(hooks); i++) {
+		const gint64 t0 = datapipe_stats_begin();
+
+		trigger = hooks->hook[i];
 		trigger(data);
+		datapipe_stats_end_hook(datapipe, DATAPIPE_HOOK_OUTPUT_TRIGGER,
+					hooks->hook[i], t0);
 	}
 
+	datapipe_hooks_unref(hooks);
+
 EXIT:
 	return;
 }
@@ -170,6 +663,7 @@ gconstpointer execute_datapipe(datapipe_struct *const datapipe,
 			       const caching_policy_t cache_indata)
 {
 	gconstpointer data = NULL;
+	gint64 t0;
 
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
@@ -178,6 +672,8 @@ gconstpointer execute_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
+	t0 = datapipe_stats_begin();
+
 	execute_datapipe_input_triggers(datapipe, indata, use_cache,
 					cache_indata);
 
@@ -189,6 +685,9 @@ gconstpointer execute_datapipe(datapipe_struct *const datapipe,
 
 	execute_datapipe_output_triggers(datapipe, data, USE_INDATA);
 
+	if (datapipe_stats_enabled && (datapipe->stats != NULL))
+		datapipe_timing_add(&datapipe->stats->timing, t0);
+
 EXIT:
 	return data;
 }
@@ -202,9 +701,6 @@ EXIT:
 void append_filter_to_datapipe(datapipe_struct *const datapipe,
 			       gpointer (*filter)(gpointer data))
 {
-	void (*refcount_trigger)(void);
-	gint i;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"append_filter_to_datapipe() called "
@@ -226,11 +722,9 @@ void append_filter_to_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	datapipe->filters = g_slist_append(datapipe->filters, filter);
+	datapipe_hooks_append(&datapipe->filters, filter);
 
-	for (i = 0; (refcount_trigger = g_slist_nth_data(datapipe->refcount_triggers, i)) != NULL; i++) {
-		refcount_trigger();
-	}
+	execute_datapipe_refcount_triggers(datapipe);
 
 EXIT:
 	return;
@@ -246,10 +740,6 @@ EXIT:
 void remove_filter_from_datapipe(datapipe_struct *const datapipe,
 				 gpointer (*filter)(gpointer data))
 {
-	void (*refcount_trigger)(void);
-	guint oldlen;
-	gint i;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"remove_filter_from_datapipe() called "
@@ -271,20 +761,14 @@ void remove_filter_from_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	oldlen = g_slist_length(datapipe->filters);
-
-	datapipe->filters = g_slist_remove(datapipe->filters, filter);
-
 	/* Did we remove any entry? */
-	if (oldlen == g_slist_length(datapipe->filters)) {
+	if (!datapipe_hooks_remove(&datapipe->filters, filter)) {
 		mce_log(LL_DEBUG,
 			"Trying to remove non-existing filter");
 		goto EXIT;
 	}
 
-	for (i = 0; (refcount_trigger = g_slist_nth_data(datapipe->refcount_triggers, i)) != NULL; i++) {
-		refcount_trigger();
-	}
+	execute_datapipe_refcount_triggers(datapipe);
 
 EXIT:
 	return;
@@ -299,9 +783,6 @@ EXIT:
 void append_input_trigger_to_datapipe(datapipe_struct *const datapipe,
 				      void (*trigger)(gconstpointer data))
 {
-	void (*refcount_trigger)(void);
-	gint i;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"append_input_trigger_to_datapipe() called "
@@ -316,12 +797,9 @@ void append_input_trigger_to_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	datapipe->input_triggers = g_slist_append(datapipe->input_triggers,
-						  trigger);
+	datapipe_hooks_append(&datapipe->input_triggers, trigger);
 
-	for (i = 0; (refcount_trigger = g_slist_nth_data(datapipe->refcount_triggers, i)) != NULL; i++) {
-		refcount_trigger();
-	}
+	execute_datapipe_refcount_triggers(datapipe);
 
 EXIT:
 	return;
@@ -337,10 +815,6 @@ EXIT:
 void remove_input_trigger_from_datapipe(datapipe_struct *const datapipe,
 					void (*trigger)(gconstpointer data))
 {
-	void (*refcount_trigger)(void);
-	guint oldlen;
-	gint i;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"remove_input_trigger_from_datapipe() called "
@@ -355,21 +829,14 @@ void remove_input_trigger_from_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	oldlen = g_slist_length(datapipe->input_triggers);
-
-	datapipe->input_triggers = g_slist_remove(datapipe->input_triggers,
-						  trigger);
-
 	/* Did we remove any entry? */
-	if (oldlen == g_slist_length(datapipe->input_triggers)) {
+	if (!datapipe_hooks_remove(&datapipe->input_triggers, trigger)) {
 		mce_log(LL_DEBUG,
 			"Trying to remove non-existing input trigger");
 		goto EXIT;
 	}
 
-	for (i = 0; (refcount_trigger = g_slist_nth_data(datapipe->refcount_triggers, i)) != NULL; i++) {
-		refcount_trigger();
-	}
+	execute_datapipe_refcount_triggers(datapipe);
 
 EXIT:
 	return;
@@ -384,9 +851,6 @@ EXIT:
 void append_output_trigger_to_datapipe(datapipe_struct *const datapipe,
 				       void (*trigger)(gconstpointer data))
 {
-	void (*refcount_trigger)(void);
-	gint i;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"append_output_trigger_to_datapipe() called "
@@ -401,12 +865,9 @@ void append_output_trigger_to_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	datapipe->output_triggers = g_slist_append(datapipe->output_triggers,
-						   trigger);
+	datapipe_hooks_append(&datapipe->output_triggers, trigger);
 
-	for (i = 0; (refcount_trigger = g_slist_nth_data(datapipe->refcount_triggers, i)) != NULL; i++) {
-		refcount_trigger();
-	}
+	execute_datapipe_refcount_triggers(datapipe);
 
 EXIT:
 	return;
@@ -422,10 +883,6 @@ EXIT:
 void remove_output_trigger_from_datapipe(datapipe_struct *const datapipe,
 					 void (*trigger)(gconstpointer data))
 {
-	void (*refcount_trigger)(void);
-	guint oldlen;
-	gint i;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"remove_output_trigger_from_datapipe() called "
@@ -440,21 +897,14 @@ void remove_output_trigger_from_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	oldlen = g_slist_length(datapipe->output_triggers);
-
-	datapipe->output_triggers = g_slist_remove(datapipe->output_triggers,
-						   trigger);
-
 	/* Did we remove any entry? */
-	if (oldlen == g_slist_length(datapipe->output_triggers)) {
+	if (!datapipe_hooks_remove(&datapipe->output_triggers, trigger)) {
 		mce_log(LL_DEBUG,
 			"Trying to remove non-existing output trigger");
 		goto EXIT;
 	}
 
-	for (i = 0; (refcount_trigger = g_slist_nth_data(datapipe->refcount_triggers, i)) != NULL; i++) {
-		refcount_trigger();
-	}
+	execute_datapipe_refcount_triggers(datapipe);
 
 EXIT:
 	return;
@@ -483,7 +933,7 @@ void append_refcount_trigger_to_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	datapipe->refcount_triggers = g_slist_append(datapipe->refcount_triggers, trigger);
+	datapipe_hooks_append(&datapipe->refcount_triggers, trigger);
 
 EXIT:
 	return;
@@ -499,8 +949,6 @@ EXIT:
 void remove_refcount_trigger_from_datapipe(datapipe_struct *const datapipe,
 					   void (*trigger)(void))
 {
-	guint oldlen;
-
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
 			"remove_refcount_trigger_from_datapipe() called "
@@ -515,12 +963,8 @@ void remove_refcount_trigger_from_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
-	oldlen = g_slist_length(datapipe->refcount_triggers);
-
-	datapipe->refcount_triggers = g_slist_remove(datapipe->refcount_triggers, trigger);
-
 	/* Did we remove any entry? */
-	if (oldlen == g_slist_length(datapipe->refcount_triggers)) {
+	if (!datapipe_hooks_remove(&datapipe->refcount_triggers, trigger)) {
 		mce_log(LL_DEBUG,
 			"Trying to remove non-existing refcount trigger");
 		goto EXIT;
@@ -533,7 +977,10 @@ EXIT:
 /**
  * Initialise a datapipe
  *
+ * Use setup_datapipe() to name the datapipe after its variable.
+ *
  * @param datapipe The datapipe to manipulate
+ * @param name Name used in statistics; must point to static data
  * @param read_only READ_ONLY if the datapipe is read only,
  *                  READ_WRITE if it's read/write
  * @param free_cache FREE_CACHE if the cached data needs to be freed,
@@ -542,10 +989,11 @@ EXIT:
  *		   or 0 if only passing pointers or data as pointers
  * @param initial_data Initial cache content
  */
-void setup_datapipe(datapipe_struct *const datapipe,
-		    const read_only_policy_t read_only,
-		    const cache_free_policy_t free_cache,
-		    const gsize datasize, gpointer initial_data)
+void setup_named_datapipe(datapipe_struct *const datapipe,
+			  const gchar *const name,
+			  const read_only_policy_t read_only,
+			  const cache_free_policy_t free_cache,
+			  const gsize datasize, gpointer initial_data)
 {
 	if (datapipe == NULL) {
 		mce_log(LL_ERR,
@@ -554,6 +1002,11 @@ void setup_datapipe(datapipe_struct *const datapipe,
 		goto EXIT;
 	}
 
+	/* Skip the address-of operator setup_datapipe() passes along */
+	datapipe->name = (name && *name == '&') ? name + 1 : name;
+	datapipe->stats = datapipe_stats_create();
+	datapipe_list = g_slist_prepend(datapipe_list, datapipe);
+
 	datapipe->filters = NULL;
 	datapipe->input_triggers = NULL;
 	datapipe->output_triggers = NULL;
@@ -606,6 +1059,19 @@ void free_datapipe(datapipe_struct *const datapipe)
 			"still has registered refcount_trigger(s)");
 	}
 
+	datapipe_hooks_unref(datapipe->filters);
+	datapipe->filters = NULL;
+	datapipe_hooks_unref(datapipe->input_triggers);
+	datapipe->input_triggers = NULL;
+	datapipe_hooks_unref(datapipe->output_triggers);
+	datapipe->output_triggers = NULL;
+	datapipe_hooks_unref(datapipe->refcount_triggers);
+	datapipe->refcount_triggers = NULL;
+
+	datapipe_list = g_slist_remove(datapipe_list, datapipe);
+	datapipe_stats_delete(datapipe->stats);
+	datapipe->stats = NULL;
+
 	if (datapipe->free_cache == FREE_CACHE) {
 		g_free(datapipe->cached_data);
 	}
@@ -23,22 +23,44 @@
 
 #include <glib.h>
 
+/**
+ * Flat array of datapipe callbacks
+ *
+ * The array is never modified once it has been attached to a
+ * datapipe; adding or removing callbacks creates a new copy.
+ * Execution holds a reference to the array it is iterating over,
+ * so callbacks can be added or removed from within callbacks.
+ */
+typedef struct {
+	guint refcount;			/**< Number of users of the array */
+	guint count;			/**< Number of callbacks */
+	gpointer hook[];		/**< Callback function pointers */
+} datapipe_hooks_t;
+
+/** Number of callbacks in a (possibly NULL) callback array */
+#define datapipe_hooks_count(_hooks)	((_hooks) ? (_hooks)->count : 0)
+
+/** Execution statistics of a datapipe; see datapipe_stats_enable() */
+typedef struct datapipe_stats_t datapipe_stats_t;
+
 /**
  * Datapipe structure
  *
  * Only access this struct through the functions
  */
 typedef struct {
-	GSList *filters;		/**< The filters */
-	GSList *input_triggers;		/**< Triggers called on indata */
-	GSList *output_triggers;	/**< Triggers called on outdata */
-	GSList *refcount_triggers;	/**< Triggers called on
-					 *   reference count changes
-					 */
+	datapipe_hooks_t *filters;	/**< The filters */
+	datapipe_hooks_t *input_triggers;	/**< Triggers called on indata */
+	datapipe_hooks_t *output_triggers;	/**< Triggers called on outdata */
+	datapipe_hooks_t *refcount_triggers;	/**< Triggers called on
+						 *   reference count changes
+						 */
 	gpointer cached_data;		/**< Latest cached data */
 	gsize datasize;			/**< Size of data; NULL == automagic */
 	gboolean free_cache;		/**< Free the cache? */
 	gboolean read_only;		/**< Datapipe is read only */
+	const gchar *name;		/**< Name used in statistics */
+	datapipe_stats_t *stats;	/**< Execution statistics */
 } datapipe_struct;
 
 /**
@@ -89,11 +111,11 @@ typedef enum {
 /* Reference count */
 
 /** Retrieve the filter reference count from a datapipe */
-#define datapipe_get_filter_refcount(_datapipe)	(g_slist_length((_datapipe).filters))
+#define datapipe_get_filter_refcount(_datapipe)	(datapipe_hooks_count((_datapipe).filters))
 /** Retrieve the input trigger reference count from a datapipe */
-#define datapipe_get_input_trigger_refcount(_datapipe)	(g_slist_length((_datapipe).input_triggers))
+#define datapipe_get_input_trigger_refcount(_datapipe)	(datapipe_hooks_count((_datapipe).input_triggers))
 /** Retrieve the output trigger reference count from a datapipe */
-#define datapipe_get_output_trigger_refcount(_datapipe)	(g_slist_length((_datapipe).output_triggers))
+#define datapipe_get_output_trigger_refcount(_datapipe)	(datapipe_hooks_count((_datapipe).output_triggers))
 
 /* Datapipe execution */
 void execute_datapipe_input_triggers(datapipe_struct *const datapipe,
@@ -135,10 +157,26 @@ void append_refcount_trigger_to_datapipe(datapipe_struct *const datapipe,
 void remove_refcount_trigger_from_datapipe(datapipe_struct *const datapipe,
 					   void (*trigger)(void));
 
-void setup_datapipe(datapipe_struct *const datapipe,
-		    const read_only_policy_t read_only,
-		    const cache_free_policy_t free_cache,
-		    const gsize datasize, gpointer initial_data);
+void setup_named_datapipe(datapipe_struct *const datapipe,
+			  const gchar *const name,
+			  const read_only_policy_t read_only,
+			  const cache_free_policy_t free_cache,
+			  const gsize datasize, gpointer initial_data);
 void free_datapipe(datapipe_struct *const datapipe);
 
+/** Initialise a datapipe named after the datapipe variable */
+#define setup_datapipe(_datapipe, _read_only, _free_cache,\
+		       _datasize, _initial_data)\
+	setup_named_datapipe((_datapipe), #_datapipe, (_read_only),\
+			     (_free_cache), (_datasize), (_initial_data))
+
+/* Instrumentation */
+
+/** Number of log2 buckets in datapipe latency histograms */
+#define DATAPIPE_STATS_BUCKETS	16
+
+void datapipe_stats_enable(void);
+gboolean datapipe_stats_enabled_p(void);
+gchar *datapipe_stats_to_string(void);
+
 #endif /* _DATAPIPE_H_ */
@@ -70,6 +70,7 @@
 					 * mce_suspend_io_monitor(),
 					 * mce_resume_io_monitor(),
 					 * mce_register_io_monitor_chunk(),
+					 * mce_set_io_monitor_drain(),
 					 * mce_unregister_io_monitor(),
 					 * mce_get_io_monitor_name(),
 					 * mce_get_io_monitor_fd()
@@ -98,6 +99,15 @@ static guint keypress_repeat_timeout_cb_id = 0;
 /** ID for misc timeout source */
 static guint misc_io_monitor_timeout_cb_id = 0;
 
+/** ID for activity coalescing timeout source */
+static guint activity_coalesce_cb_id = 0;
+
+/** Activity has been seen since the last report */
+static gboolean activity_pending = FALSE;
+
+/** Minimum time between activity reports in milliseconds */
+static gint activity_coalesce_window = DEFAULT_ACTIVITY_COALESCE_WINDOW;
+
 /** List of touchscreen input devices */
 static GSList *touchscreen_dev_list = NULL;
 /** List of keyboard input devices */
@@ -374,6 +384,49 @@ static int evdevinfo_probe(evdevinfo_t *self, int fd)
 	return res;
 }
 
+/** Update FNV-1a hash with a block of data
+ *
+ * @param hash hash value so far
+ * @param data data to hash
+ * @param size number of bytes to hash
+ *
+ * @return updated hash value
+ */
+static guint32 evdev_hash_update(guint32 hash, const void *data, size_t size)
+{
+	const unsigned char *pos = data;
+
+	for( size_t i = 0; i < size; ++i ) {
+		hash ^= pos[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/** Initial value for evdev_hash_update() */
+#define EVDEV_HASH_INIT 2166136261u
+
+/** Calculate hash over all probed event code bitmaps
+ *
+ * @param self evdevinfo_t object
+ *
+ * @return hash value
+ */
+static guint32 evdevinfo_hash(const evdevinfo_t *self)
+{
+	guint32 hash = EVDEV_HASH_INIT;
+
+	for( int i = 0; i < EV_CNT; ++i ) {
+		const evdevbits_t *bits = self->mask[i];
+		if( !bits )
+			continue;
+		hash = evdev_hash_update(hash, &bits->type, sizeof bits->type);
+		hash = evdev_hash_update(hash, bits->bit,
+					 EVDEVBITS_LEN(bits->cnt) * sizeof *bits->bit);
+	}
+	return hash;
+}
+
 /** Types of use MCE can have for evdev input devices
  */
 typedef enum {
@@ -406,10 +459,11 @@ static const char * const evdev_class[] =
 /** Use heuristics to determine what mce should do with an evdev device node
  *
  * @param fd file descriptor to probe data from
+ * @param hash where to store hash of the probed event codes, or NULL
  *
  * @return one of EVDEV_TOUCH, EVDEV_INPUT, ...
  */
-static evdev_type_t get_evdev_type(int fd)
+static evdev_type_t get_evdev_type(int fd, guint32 *hash)
 {
 	int res = EVDEV_IGNORE;
 
@@ -417,6 +471,9 @@ static evdev_type_t get_evdev_type(int fd)
 
 	evdevinfo_probe(feat, fd);
 
+	if( hash )
+		*hash = evdevinfo_hash(feat);
+
 	/* Key events mce is interested in */
 	static const int keypad_lut[] = {
 		KEY_CAMERA,
@@ -553,6 +610,453 @@ cleanup:
 	return res;
 }
 
+/* ========================================================================= *
+ * EVDEV CLASSIFICATION CACHE
+ * ========================================================================= */
+
+/** Maximum number of devices remembered in the classification cache */
+#define EVDEV_CACHE_MAX 64
+
+/** Cached classification for one evdev device
+ */
+typedef struct
+{
+	/** Device fingerprint, see evdev_cache_get_key() */
+	gchar        *key;
+	/** Classification made by the full probe */
+	evdev_type_t  type;
+	/** Hash of event code bitmaps seen by the full probe */
+	guint32       hash;
+	/** Device has been seen during this mce session */
+	gboolean      seen;
+	/** Classification has been confirmed during this mce session */
+	gboolean      verified;
+} evdev_cache_entry_t;
+
+/** Names used for evdev classifications in the cache file */
+static const char * const evdev_cache_type_name[] =
+{
+	[EVDEV_REJECT]   = "reject",
+	[EVDEV_TOUCH]    = "touch",
+	[EVDEV_INPUT]    = "input",
+	[EVDEV_ACTIVITY] = "activity",
+	[EVDEV_IGNORE]   = "ignore",
+};
+
+/** Fingerprint -> evdev_cache_entry_t lookup table */
+static GHashTable *evdev_cache = NULL;
+
+/** Cache contents differ from what has been saved */
+static gboolean evdev_cache_dirty = FALSE;
+
+/** Device nodes registered from cache, waiting for full probe */
+static GQueue evdev_cache_verify_queue = G_QUEUE_INIT;
+
+/** ID for background verify / save idle callback */
+static guint evdev_cache_idle_id = 0;
+
+/** Delete cache entry
+ *
+ * @param self evdev_cache_entry_t object, or NULL
+ */
+static void evdev_cache_entry_delete(evdev_cache_entry_t *self)
+{
+	if( self ) {
+		g_free(self->key);
+		g_free(self);
+	}
+}
+
+/** Type agnostic callback for evdev_cache_entry_delete()
+ */
+static void evdev_cache_entry_delete_cb(gpointer self)
+{
+	evdev_cache_entry_delete(self);
+}
+
+/** Construct fingerprint for an evdev device node
+ *
+ * The fingerprint consists of the device id, physical path and name
+ * plus a hash of supported event types. These take fewer ioctls to
+ * get than the event code bitmaps needed for classification.
+ *
+ * @param fd file descriptor of the device node
+ * @param name device name, as returned by EVIOCGNAME
+ *
+ * @return fingerprint string, or NULL on failure; release with g_free()
+ */
+static gchar *evdev_cache_get_key(int fd, const char *name)
+{
+	gchar          *key = NULL;
+	struct input_id id;
+	char            phys[256];
+	unsigned long   types[EVDEVBITS_LEN(EV_CNT)];
+
+	memset(types, 0, sizeof types);
+	if( ioctl(fd, EVIOCGBIT(0, EV_CNT), types) == -1 )
+		goto EXIT;
+
+	if( ioctl(fd, EVIOCGID, &id) == -1 )
+		memset(&id, 0, sizeof id);
+
+	if( ioctl(fd, EVIOCGPHYS(sizeof phys), phys) < 0 )
+		*phys = 0;
+	phys[sizeof phys - 1] = 0;
+
+	key = g_strdup_printf("%04x:%04x:%04x:%04x:%08x:%s:%s",
+			      id.bustype, id.vendor, id.product, id.version,
+			      evdev_hash_update(EVDEV_HASH_INIT,
+						types, sizeof types),
+			      phys, name);
+
+	/* Keep the cache file line oriented */
+	g_strdelimit(key, "\n", '?');
+
+EXIT:
+	return key;
+}
+
+/** Look up cached classification
+ *
+ * @param key device fingerprint, or NULL
+ *
+ * @return cache entry, or NULL if the device is not known
+ */
+static evdev_cache_entry_t *evdev_cache_lookup(const char *key)
+{
+	evdev_cache_entry_t *entry = NULL;
+
+	if( evdev_cache && key ) {
+		if( (entry = g_hash_table_lookup(evdev_cache, key)) )
+			entry->seen = TRUE;
+	}
+	return entry;
+}
+
+/** Add or update cached classification
+ *
+ * @param key device fingerprint
+ * @param type classification from full probe
+ * @param hash event code hash from full probe
+ * @param verified TRUE if made during this mce session
+ *
+ * @return cache entry
+ */
+static evdev_cache_entry_t *evdev_cache_store(const char *key,
+					      evdev_type_t type,
+					      guint32 hash,
+					      gboolean verified)
+{
+	evdev_cache_entry_t *entry = g_hash_table_lookup(evdev_cache, key);
+
+	if( !entry ) {
+		entry = g_malloc0(sizeof *entry);
+		entry->key  = g_strdup(key);
+		entry->type = EVDEV_IGNORE;
+		g_hash_table_replace(evdev_cache, entry->key, entry);
+		evdev_cache_dirty = TRUE;
+	}
+
+	if( entry->type != type || entry->hash != hash ) {
+		entry->type = type;
+		entry->hash = hash;
+		evdev_cache_dirty = TRUE;
+	}
+
+	entry->seen     = verified;
+	entry->verified = verified;
+
+	return entry;
+}
+
+/** Parse cache file contents
+ *
+ * Each line holds classification name, event code hash in hex
+ * and the device fingerprint separated by single spaces.
+ * Malformed lines are skipped.
+ *
+ * @param data zero terminated file contents
+ *
+ * @return number of cached devices
+ */
+static guint evdev_cache_parse(char *data)
+{
+	char *line;
+
+	while( (line = strsep(&data, "\n")) ) {
+		char *name = strsep(&line, " ");
+		char *hash = strsep(&line, " ");
+		char *end  = NULL;
+		guint32 val;
+
+		if( !hash || !line || !*line )
+			continue;
+
+		val = (guint32)strtoul(hash, &end, 16);
+		if( end == hash || *end )
+			continue;
+
+		for( size_t i = 0; i < G_N_ELEMENTS(evdev_cache_type_name); ++i ) {
+			if( strcmp(evdev_cache_type_name[i], name) )
+				continue;
+			if( g_hash_table_size(evdev_cache) < EVDEV_CACHE_MAX )
+				evdev_cache_store(line, i, val, FALSE);
+			break;
+		}
+	}
+
+	return g_hash_table_size(evdev_cache);
+}
+
+/** Append cache entries to text buffer
+ *
+ * @param text buffer to append to
+ * @param seen TRUE to append entries seen during this session,
+ *             FALSE to append the rest
+ * @param cnt number of entries already in the buffer
+ *
+ * @return number of entries in the buffer, at most EVDEV_CACHE_MAX
+ */
+static guint evdev_cache_format(GString *text, gboolean seen, guint cnt)
+{
+	GHashTableIter iter;
+	gpointer       val;
+
+	g_hash_table_iter_init(&iter, evdev_cache);
+	while( cnt < EVDEV_CACHE_MAX &&
+	       g_hash_table_iter_next(&iter, NULL, &val) ) {
+		const evdev_cache_entry_t *entry = val;
+
+		if( entry->seen != seen )
+			continue;
+
+		g_string_append_printf(text, "%s %08x %s\n",
+				       evdev_cache_type_name[entry->type],
+				       entry->hash, entry->key);
+		++cnt;
+	}
+
+	return cnt;
+}
+
+/** Load cached classifications from persistent storage
+ */
+static void evdev_cache_load(void)
+{
+	char *data = NULL;
+
+	evdev_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+					    NULL, evdev_cache_entry_delete_cb);
+
+	if( (data = mce_io_load_file(MCE_EVDEV_CACHE_PATH, NULL)) ) {
+		mce_log(LL_DEBUG, "%u evdev classifications cached",
+			evdev_cache_parse(data));
+	}
+
+	/* Nothing new to save yet */
+	evdev_cache_dirty = FALSE;
+
+	g_free(data);
+}
+
+/** Save cached classifications to persistent storage
+ *
+ * Devices seen during this session take precedence over the ones
+ * remembered from earlier sessions.
+ */
+static void evdev_cache_save(void)
+{
+	GString *text = NULL;
+	guint    cnt  = 0;
+
+	if( !evdev_cache || !evdev_cache_dirty )
+		goto EXIT;
+
+	text = g_string_new("");
+	cnt = evdev_cache_format(text, TRUE, cnt);
+	cnt = evdev_cache_format(text, FALSE, cnt);
+
+	mce_log(LL_DEBUG, "updating %s", MCE_EVDEV_CACHE_PATH);
+	mce_io_update_file_atomic(MCE_EVDEV_CACHE_PATH,
+				  text->str, text->len, 0644, FALSE);
+
+	evdev_cache_dirty = FALSE;
+
+EXIT:
+	if( text )
+		g_string_free(text, TRUE);
+}
+
+/** Run full probe on a device node that was registered from cache
+ *
+ * If the probe disagrees with the cached classification, the cache is
+ * updated and the device node is registered again.
+ *
+ * @param filename path to the device node
+ */
+static void evdev_cache_verify(const char *filename)
+{
+	int                  fd    = -1;
+	gchar               *key   = NULL;
+	evdev_cache_entry_t *entry = NULL;
+	evdev_type_t         type;
+	guint32              hash  = 0;
+	char                 name[256];
+
+	/* Device node might have been removed already */
+	if( (fd = open(filename, O_NONBLOCK | O_RDONLY)) == -1 )
+		goto EXIT;
+
+	if( ioctl(fd, EVIOCGNAME(sizeof name), name) < 0 )
+		goto EXIT;
+	name[sizeof name - 1] = 0;
+
+	if( !(key = evdev_cache_get_key(fd, name)) )
+		goto EXIT;
+
+	/* Skip device nodes that have been taken over by other devices */
+	if( !(entry = evdev_cache_lookup(key)) || entry->verified )
+		goto EXIT;
+
+	type = get_evdev_type(fd, &hash);
+
+	if( type == entry->type ) {
+		evdev_cache_store(key, type, hash, TRUE);
+		goto EXIT;
+	}
+
+	mce_log(LL_NOTICE, "%s: \"%s\", cached: %s, probe: %s", filename,
+		name, evdev_class[entry->type], evdev_class[type]);
+
+	evdev_cache_store(key, type, hash, TRUE);
+	update_inputdevices(filename, TRUE);
+
+EXIT:
+	g_free(key);
+
+	if( fd != -1 )
+		close(fd);
+}
+
+/** Idle callback for verifying cached classifications in the background
+ *
+ * One device node is probed per call. The cache is saved once there
+ * is nothing left to verify.
+ *
+ * @param data Unused
+ *
+ * @return TRUE to get called again, FALSE when done
+ */
+static gboolean evdev_cache_idle_cb(gpointer data)
+{
+	gchar *filename;
+
+	(void)data;
+
+	if( (filename = g_queue_pop_head(&evdev_cache_verify_queue)) ) {
+		evdev_cache_verify(filename);
+		g_free(filename);
+		return TRUE;
+	}
+
+	evdev_cache_idle_id = 0;
+	evdev_cache_save();
+
+	return FALSE;
+}
+
+/** Schedule background verify / save
+ */
+static void evdev_cache_schedule(void)
+{
+	if( !evdev_cache_idle_id ) {
+		evdev_cache_idle_id = g_idle_add_full(G_PRIORITY_LOW,
+						      evdev_cache_idle_cb,
+						      NULL, NULL);
+	}
+}
+
+/** Queue device node registered from cache for full probe
+ *
+ * @param filename path to the device node
+ */
+static void evdev_cache_schedule_verify(const char *filename)
+{
+	if( !g_queue_find_custom(&evdev_cache_verify_queue, filename,
+				 (GCompareFunc)strcmp) ) {
+		g_queue_push_tail(&evdev_cache_verify_queue,
+				  g_strdup(filename));
+	}
+	evdev_cache_schedule();
+}
+
+/** Save pending changes and release the classification cache
+ */
+static void evdev_cache_quit(void)
+{
+	gchar *filename;
+
+	if( evdev_cache_idle_id ) {
+		g_source_remove(evdev_cache_idle_id);
+		evdev_cache_idle_id = 0;
+	}
+
+	while( (filename = g_queue_pop_head(&evdev_cache_verify_queue)) )
+		g_free(filename);
+
+	evdev_cache_save();
+
+	if( evdev_cache ) {
+		g_hash_table_unref(evdev_cache);
+		evdev_cache = NULL;
+	}
+}
+
+/** Classify evdev device node, using cached data when possible
+ *
+ * Device nodes matching a fingerprint in the cache are classified
+ * without full probe, which is then done in the background.
+ *
+ * @param filename path to the device node
+ * @param fd file descriptor of the device node
+ * @param name device name, as returned by EVIOCGNAME
+ *
+ * @return one of EVDEV_TOUCH, EVDEV_INPUT, ...
+ */
+static evdev_type_t evdev_cache_get_type(const char *filename, int fd,
+					 const char *name)
+{
+	evdev_type_t         type;
+	guint32              hash  = 0;
+	gchar               *key   = NULL;
+	evdev_cache_entry_t *entry = NULL;
+
+	key = evdev_cache_get_key(fd, name);
+
+	if( (entry = evdev_cache_lookup(key)) ) {
+		type = entry->type;
+		mce_log(LL_NOTICE, "%s: \"%s\", cached: %s",
+			filename, name, evdev_class[type]);
+		if( !entry->verified )
+			evdev_cache_schedule_verify(filename);
+		goto EXIT;
+	}
+
+	type = get_evdev_type(fd, &hash);
+	mce_log(LL_NOTICE, "%s: \"%s\", probe: %s",
+		filename, name, evdev_class[type]);
+
+	if( key && evdev_cache ) {
+		evdev_cache_store(key, type, hash, TRUE);
+		evdev_cache_schedule();
+	}
+
+EXIT:
+	g_free(key);
+
+	return type;
+}
+
 /**
  * Enable the specified GPIO key
  * non-existing or already enabled keys are silently ignored
@@ -689,6 +1193,83 @@ static void unregister_io_monitor(gpointer io_monitor, gpointer user_data)
 	}
 }
 
+/**
+ * Feed device activity to the device_inactive_pipe
+ */
+static void report_activity(void)
+{
+	activity_pending = FALSE;
+
+	(void)execute_datapipe(&device_inactive_pipe, GINT_TO_POINTER(FALSE),
+			       USE_INDATA, CACHE_INDATA);
+}
+
+/**
+ * Timeout function for activity coalescing
+ *
+ * @param data Unused
+ * @return TRUE to keep coalescing if activity was reported,
+ *         FALSE to disable the timeout
+ */
+static gboolean activity_coalesce_cb(gpointer data)
+{
+	(void)data;
+
+	if (activity_pending == FALSE) {
+		activity_coalesce_cb_id = 0;
+		return FALSE;
+	}
+
+	report_activity();
+
+	return TRUE;
+}
+
+/**
+ * Cancel timeout for activity coalescing
+ */
+static void cancel_activity_coalesce_timeout(void)
+{
+	if (activity_coalesce_cb_id != 0) {
+		g_source_remove(activity_coalesce_cb_id);
+		activity_coalesce_cb_id = 0;
+	}
+
+	activity_pending = FALSE;
+}
+
+/**
+ * Generate device activity
+ *
+ * Activity is reported at most once per coalescing window; events
+ * arriving within the window are reported when the window ends.
+ * Transition from inactive to active is always reported immediately.
+ */
+static void generate_activity(void)
+{
+	/* Leave the device inactive -> active transition unaffected */
+	if ((activity_coalesce_window <= 0) ||
+	    (datapipe_get_gbool(device_inactive_pipe) == TRUE)) {
+		report_activity();
+		goto EXIT;
+	}
+
+	/* Within coalescing window -> report when the window ends */
+	if (activity_coalesce_cb_id != 0) {
+		activity_pending = TRUE;
+		goto EXIT;
+	}
+
+	report_activity();
+
+	activity_coalesce_cb_id =
+		g_timeout_add(activity_coalesce_window,
+			      activity_coalesce_cb, NULL);
+
+EXIT:
+	return;
+}
+
 /**
  * Timeout function for touchscreen I/O monitor reprogramming
  *
@@ -987,8 +1568,7 @@ static gboolean touchscreen_iomon_cb(gpointer data, gsize bytes_read)
 	}
 
 	/* Generate activity */
-	(void)execute_datapipe(&device_inactive_pipe, GINT_TO_POINTER(FALSE),
-			       USE_INDATA, CACHE_INDATA);
+	generate_activity();
 
 	/* If the display is on/dim and visual tklock is active
 	 * or autorelock isn't active, suspend I/O monitors
@@ -1289,8 +1869,7 @@ static gboolean misc_iomon_cb(gpointer data, gsize bytes_read)
 	mce_log(LL_DEBUG, "ev->type: %d", ev->type);
 
 	/* Generate activity */
-	(void)execute_datapipe(&device_inactive_pipe, GINT_TO_POINTER(FALSE),
-			       USE_INDATA, CACHE_INDATA);
+	generate_activity();
 
 	/* Suspend I/O monitors */
 	if (misc_dev_list != NULL) {
@@ -1439,10 +2018,10 @@ static void match_and_register_io_monitor(const gchar *filename)
 			filename);
 		goto EXIT;
 	}
+	name[sizeof name - 1] = 0;
 
 	/* Probe how mce could use the evdev node */
-	type = get_evdev_type(fd);
-	mce_log(LL_NOTICE, "%s: \"%s\", probe: %s", filename, name, evdev_class[type]);
+	type = evdev_cache_get_type(filename, fd, name);
 
 	/* Check if the device is blacklisted by name in the config files */
 	if( (black = mce_conf_get_blacklisted_event_drivers()) ) {
@@ -1464,16 +2043,20 @@ static void match_and_register_io_monitor(const gchar *filename)
 		iomon = mce_register_io_monitor_chunk(fd, filename, MCE_IO_ERROR_POLICY_WARN,
 						      G_IO_IN | G_IO_ERR, FALSE, touchscreen_iomon_cb,
 						      sizeof (struct input_event));
-		if( iomon )
+		if( iomon ) {
+			mce_set_io_monitor_drain(iomon, TRUE);
 			touchscreen_dev_list = g_slist_prepend(touchscreen_dev_list, (gpointer)iomon);
+		}
 		break;
 
 	case EVDEV_INPUT:
 		iomon = mce_register_io_monitor_chunk(fd, filename, MCE_IO_ERROR_POLICY_WARN,
 						      G_IO_IN | G_IO_ERR, FALSE, keypress_iomon_cb,
 						      sizeof (struct input_event));
-		if( iomon )
+		if( iomon ) {
+			mce_set_io_monitor_drain(iomon, TRUE);
 			keyboard_dev_list = g_slist_prepend(keyboard_dev_list, (gpointer)iomon);
+		}
 		break;
 
 	case EVDEV_ACTIVITY:
@@ -1482,6 +2065,7 @@ static void match_and_register_io_monitor(const gchar *filename)
 						      sizeof (struct input_event));
 		if( iomon ) {
 			mce_set_io_monitor_err_cb(iomon, misc_err_cb);
+			mce_set_io_monitor_drain(iomon, TRUE);
 			misc_dev_list = g_slist_prepend(misc_dev_list, (gpointer)iomon);
 		}
 		break;
@@ -1762,6 +2346,7 @@ gboolean mce_input_init(void)
 	 *      and any workarounds are likely to be cumbersome
 	 */
 	/* Find the initial set of input devices */
+	evdev_cache_load();
 	if ((status = scan_inputdevices()) == FALSE) {
 		g_file_monitor_cancel(dev_input_gfmp);
 		dev_input_gfmp = NULL;
@@ -1778,6 +2363,11 @@ gboolean mce_input_init(void)
 				     MCE_CONF_HOMEKEY_LONG_DELAY,
 				     DEFAULT_HOME_LONG_DELAY);
 
+	activity_coalesce_window =
+		mce_conf_get_int(MCE_CONF_EVENT_INPUT_GROUP,
+				 MCE_CONF_ACTIVITY_COALESCE_WINDOW,
+				 DEFAULT_ACTIVITY_COALESCE_WINDOW);
+
 	update_switch_states();
 
 	gpio_key_disable_exists = (g_access(GPIO_KEY_DISABLE_PATH, W_OK) == 0);
@@ -1814,11 +2404,13 @@ void mce_input_exit(void)
 	}
 
 	unregister_inputdevices();
+	evdev_cache_quit();
 
 	/* Remove all timer sources */
 	cancel_touchscreen_io_monitor_timeout();
 	cancel_keypress_repeat_timeout();
 	cancel_misc_io_monitor_timeout();
+	cancel_activity_coalesce_timeout();
 
 	return;
 }
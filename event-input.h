@@ -31,6 +31,8 @@
 #define EVENT_FILE_PREFIX		"event"
 /** Path to the GPIO key disable interface */
 #define GPIO_KEY_DISABLE_PATH		"/sys/devices/platform/gpio-keys/disabled_keys"
+/** Path to the persistent evdev classification cache */
+#define MCE_EVDEV_CACHE_PATH		G_STRINGIFY(MCE_VAR_DIR) "/evdev-classes"
 
 /** Path to the GConf settings for the event input */
 #define MCE_GCONF_EVENT_INPUT_PATH	"/system/osso/dsm/event_input"
@@ -60,6 +62,15 @@
 /** Long delay for the [home] button in milliseconds */
 #define DEFAULT_HOME_LONG_DELAY		800		/* 0.8 seconds */
 
+/** Name of event input configuration group */
+#define MCE_CONF_EVENT_INPUT_GROUP	"EventInput"
+
+/** Name of configuration key for activity coalescing window */
+#define MCE_CONF_ACTIVITY_COALESCE_WINDOW	"ActivityCoalesceWindow"
+
+/** Minimum time between activity reports in milliseconds */
+#define DEFAULT_ACTIVITY_COALESCE_WINDOW	200		/* 0.2 seconds */
+
 /* When MCE is made modular, this will be handled differently */
 gboolean mce_input_init(void);
 void mce_input_exit(void);
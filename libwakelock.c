@@ -16,6 +16,8 @@
 #include <unistd.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <signal.h>
+#include <time.h>
 
 /** Whether to write debug logging to stderr
  *
@@ -127,17 +129,120 @@ static void lwl_debug_(const char *m, ...)
 # define lwl_debug(MSG, MORE...) do { } while( 0 )
 #endif
 
-/** Flag that gets set once the process is about to exit */
-static int        lwl_shutting_down = 0;
+/** Flag that gets set once the process is about to exit
+ *
+ * Also set on the signal handler exit path, after which the
+ * wakelock state cache is bypassed.
+ */
+static volatile sig_atomic_t lwl_shutting_down = 0;
+
+/** Directory containing the power management sysfs entries */
+#ifndef LWL_SYSFS_DIR
+# define LWL_SYSFS_DIR "/sys/power"
+#endif
 
 /** Sysfs entry for acquiring wakelocks */
-static const char lwl_lock_path[]   = "/sys/power/wake_lock";
+static const char lwl_lock_path[]   = LWL_SYSFS_DIR "/wake_lock";
 
 /** Sysfs entry for releasing wakelocks */
-static const char lwl_unlock_path[] = "/sys/power/wake_unlock";
+static const char lwl_unlock_path[] = LWL_SYSFS_DIR "/wake_unlock";
 
 /** Sysfs entry for allow/block suspend */
-static const char lwl_state_path[] = "/sys/power/state";
+static const char lwl_state_path[] = LWL_SYSFS_DIR "/state";
+
+/** Persistent file descriptor for lwl_lock_path */
+static int        lwl_lock_fd   = -1;
+
+/** Persistent file descriptor for lwl_unlock_path */
+static int        lwl_unlock_fd = -1;
+
+/** Write / skip statistics; see wakelock_get_stats() */
+static lwl_stats_t lwl_stats;
+
+/** Maximum number of wakelocks whose state is tracked */
+#define LWL_CACHE_SIZE 16
+
+/** Maximum length of tracked wakelock names, including terminator */
+#define LWL_NAME_MAX 48
+
+/** Known states of wakelocks */
+typedef enum {
+	/** Not known, sysfs must be written */
+	LWL_STATE_UNKNOWN,
+	/** Released via sysfs */
+	LWL_STATE_UNLOCKED,
+	/** Acquired without timeout */
+	LWL_STATE_LOCKED,
+	/** Acquired with timeout */
+	LWL_STATE_TIMED,
+} lwl_state_t;
+
+/** Cached wakelock state */
+typedef struct {
+	/** Wakelock name, or empty string for unused slot */
+	char        name[LWL_NAME_MAX];
+
+	/** State as last written to sysfs */
+	lwl_state_t state;
+
+	/** Expiry time of LWL_STATE_TIMED lock; CLOCK_MONOTONIC ns */
+	long long   expires;
+} lwl_lock_t;
+
+/** Wakelock state cache
+ *
+ * Updating the cache is not atomic, so it must not be used from
+ * signal handlers. Once lwl_shutting_down is set, all requests are
+ * written to sysfs without consulting the cache.
+ */
+static lwl_lock_t lwl_cache[LWL_CACHE_SIZE];
+
+/** Get monotonic time stamp
+ *
+ * @return CLOCK_MONOTONIC time in nanoseconds
+ */
+static long long lwl_get_time(void)
+{
+	struct timespec ts = { 0, 0 };
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/** Find / allocate cache entry for named wakelock
+ *
+ * @param name wakelock name
+ *
+ * @return cache entry, or NULL if the name is too long or the
+ *         cache is full
+ */
+static lwl_lock_t *lwl_cache_lookup(const char *name)
+{
+	lwl_lock_t *unused = 0;
+
+	if( strlen(name) >= LWL_NAME_MAX )
+		return 0;
+
+	for( int i = 0; i < LWL_CACHE_SIZE; ++i ) {
+		lwl_lock_t *lock = lwl_cache + i;
+
+		if( !*lock->name ) {
+			if( !unused )
+				unused = lock;
+		}
+		else if( !strcmp(lock->name, name) ) {
+			return lock;
+		}
+	}
+
+	if( unused ) {
+		strcpy(unused->name, name);
+		unused->state = LWL_STATE_UNKNOWN;
+		unused->expires = 0;
+	}
+
+	return unused;
+}
 
 /** Helper for writing to sysfs files
  */
@@ -160,6 +265,50 @@ static void lwl_write_file(const char *path, const char *data)
 	}
 }
 
+/** Helper for writing to sysfs files kept open
+ *
+ * The file is opened on first use and kept open for subsequent
+ * writes. On write failure the file is closed and then reopened
+ * on the next write.
+ *
+ * @param fd   pointer to persistent file descriptor
+ * @param path file to write to
+ * @param data string to write
+ *
+ * @return 0 on success, or -1 on failure
+ */
+static int lwl_write_persistent(int *fd, const char *path, const char *data)
+{
+	int res = -1;
+	int size = strlen(data);
+
+	lwl_debug(path, " << ", data, NULL);
+
+	if( *fd == -1 ) {
+		*fd = TEMP_FAILURE_RETRY(open(path, O_WRONLY | O_CLOEXEC));
+		if( *fd == -1 ) {
+			lwl_debug(path, ": open: ", strerror(errno),
+				  "\n", NULL);
+			goto EXIT;
+		}
+	}
+
+	errno = 0;
+	if( TEMP_FAILURE_RETRY(write(*fd, data, size)) != size ) {
+		lwl_debug(path, ": write: ", strerror(errno), "\n", NULL);
+		TEMP_FAILURE_RETRY(close(*fd)), *fd = -1;
+		goto EXIT;
+	}
+
+	res = 0;
+
+EXIT:
+	if( res < 0 )
+		++lwl_stats.write_errors;
+
+	return res;
+}
+
 /** Helper for checking if wakelock interface is supported
  */
 static int lwl_enabled(void)
@@ -175,6 +324,11 @@ static int lwl_enabled(void)
 }
 
 /** Use sysfs interface to create and enable a wakelock.
+ *
+ * The write is skipped if the wakelock is already known to be
+ * held without timeout and no timeout is requested, or if it is
+ * held with timeout that expires after the requested one. A lock
+ * with timeout does not need a matching wakelock_unlock() call.
  *
  * @param name The name of the wakelock to obtain
  * @param ns   Time in nanoseconds before the wakelock gets released
@@ -185,18 +339,47 @@ void wakelock_lock(const char *name, long long ns)
 	if( lwl_enabled() && !lwl_shutting_down ) {
 		char tmp[64];
 		char num[64];
+		lwl_lock_t *lock = lwl_cache_lookup(name);
+		long long   expires = (ns < 0) ? 0 : lwl_get_time() + ns;
+
+		/* Skip if held without timeout and no timeout is
+		 * requested, or if held with long enough timeout */
+		if( lock && ((lock->state == LWL_STATE_LOCKED && ns < 0) ||
+			     (lock->state == LWL_STATE_TIMED &&
+			      ns >= 0 && lock->expires >= expires)) ) {
+			lwl_debug(name, ": already locked\n", NULL);
+			++lwl_stats.lock_skips;
+			return;
+		}
+
 		if( ns < 0 ) {
 			lwl_concat(tmp, sizeof tmp, name, "\n", NULL);
 		} else {
-			lwl_concat(tmp, sizeof tmp, name,
+			lwl_concat(tmp, sizeof tmp, name, " ",
 				   lwl_number(num, sizeof num, ns),
 				   "\n", NULL);
 		}
-		lwl_write_file(lwl_lock_path, tmp);
+
+		if( lwl_write_persistent(&lwl_lock_fd, lwl_lock_path,
+					 tmp) < 0 ) {
+			if( lock )
+				lock->state = LWL_STATE_UNKNOWN;
+		}
+		else if( lock ) {
+			lock->state = (ns < 0) ? LWL_STATE_LOCKED
+					       : LWL_STATE_TIMED;
+			lock->expires = expires;
+		}
+		++lwl_stats.lock_writes;
 	}
 }
 
 /** Use sysfs interface to disable a wakelock.
+ *
+ * The write is skipped if the wakelock is already known to be
+ * released, or its timeout has passed. On the exit path the
+ * unlock is always written and the state cache is left alone, so
+ * that this can be called from signal handlers.
  *
  * @param name The name of the wakelock to release
  *
@@ -204,11 +387,44 @@ void wakelock_lock(const char *name, long long ns)
  */
 void wakelock_unlock(const char *name)
 {
-	if( lwl_enabled() ) {
+	if( lwl_enabled() && lwl_shutting_down ) {
 		char tmp[64];
+
 		lwl_concat(tmp, sizeof tmp, name, "\n", NULL);
 		lwl_write_file(lwl_unlock_path, tmp);
 	}
+	else if( lwl_enabled() ) {
+		char tmp[64];
+		lwl_lock_t *lock = lwl_cache_lookup(name);
+
+		if( lock && (lock->state == LWL_STATE_UNLOCKED ||
+			     (lock->state == LWL_STATE_TIMED &&
+			      lock->expires <= lwl_get_time())) ) {
+			lwl_debug(name, ": already unlocked\n", NULL);
+			++lwl_stats.unlock_skips;
+			return;
+		}
+
+		lwl_concat(tmp, sizeof tmp, name, "\n", NULL);
+		if( lwl_write_persistent(&lwl_unlock_fd, lwl_unlock_path,
+					 tmp) < 0 ) {
+			if( lock )
+				lock->state = LWL_STATE_UNKNOWN;
+		}
+		else if( lock ) {
+			lock->state = LWL_STATE_UNLOCKED;
+		}
+		++lwl_stats.unlock_writes;
+	}
+}
+
+/** Get wakelock write / skip statistics
+ *
+ * @param stats where to store the counters
+ */
+void wakelock_get_stats(lwl_stats_t *stats)
+{
+	*stats = lwl_stats;
 }
 
 /** Use sysfs interface to allow automatic entry to suspend
@@ -13,8 +13,28 @@ extern "C" {
 };
 # endif
 
+/** Wakelock sysfs write statistics */
+typedef struct
+{
+	/** Writes to /sys/power/wake_lock */
+	unsigned long lock_writes;
+
+	/** Lock requests skipped because the lock was already held */
+	unsigned long lock_skips;
+
+	/** Writes to /sys/power/wake_unlock */
+	unsigned long unlock_writes;
+
+	/** Unlock requests skipped because the lock was not held */
+	unsigned long unlock_skips;
+
+	/** Failed open / write attempts */
+	unsigned long write_errors;
+} lwl_stats_t;
+
 void wakelock_lock  (const char *name, long long ns);
 void wakelock_unlock(const char *name);
+void wakelock_get_stats(lwl_stats_t *stats);
 
 void wakelock_allow_suspend(void);
 void wakelock_block_suspend(void);
@@ -21,24 +21,1103 @@
 #include <glib.h>
 #include <glob.h>
 #include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "mce.h"
 #include "mce-conf.h"
+#include "mce-io.h"			/* mce_io_update_file_atomic() */
 #include "mce-log.h"			/* mce_log(), LL_* */
 #include "modules/led.h"
 
 /** Pointer to the keyfile structure where config values are read from */
 static gpointer keyfile = NULL;
 
+/* ========================================================================= *
+ * COMPILED CONFIGURATION CACHE
+ * ========================================================================= */
+
+/** Magic bytes at the start of a compiled configuration cache file */
+#define MCE_CONF_CACHE_MAGIC	"MCECONF\x02"
+
+/** Slot value for unused perfect hash slots */
+#define MCE_CONF_CACHE_EMPTY	0xffffffffu
+
+/** Maximum number of displacements tried per perfect hash bucket */
+#define MCE_CONF_CACHE_MAX_DISP	(1u << 16)
+
+/** Ini file the cache was compiled from */
+typedef struct {
+	guint32 path;			/**< Offset of path string */
+	guint32 reserved;		/**< Padding, zero */
+	guint64 mtime;			/**< Modification time, seconds */
+	guint64 mtime_ns;		/**< Modification time, nanoseconds */
+	guint64 size;			/**< File size */
+} mce_conf_cache_source_t;
+
+/** Configuration group; keys of a group are stored consecutively */
+typedef struct {
+	guint32 name;			/**< Offset of group name string */
+	guint32 first;			/**< Index of the first key */
+	guint32 count;			/**< Number of keys */
+} mce_conf_cache_group_t;
+
+/** Value types a key could be parsed as, see mce_conf_cache_key_t */
+enum {
+	MCE_CONF_CACHE_BOOLEAN      = 1 << 0,
+	MCE_CONF_CACHE_INTEGER      = 1 << 1,
+	MCE_CONF_CACHE_STRING       = 1 << 2,
+	MCE_CONF_CACHE_STRING_LIST  = 1 << 3,
+	MCE_CONF_CACHE_INTEGER_LIST = 1 << 4,
+};
+
+/** Configuration key
+ *
+ * Values are stored as GKeyFile parsed them when the cache was
+ * compiled; the getters just copy them out
+ */
+typedef struct {
+	guint32 group;			/**< Index of the group */
+	guint32 name;			/**< Offset of key name string */
+	guint32 value;			/**< Offset of raw value string */
+	guint32 valid;			/**< MCE_CONF_CACHE_xxx types that parsed */
+	gint32  boolean;		/**< Value as boolean */
+	gint32  integer;		/**< Value as integer */
+	guint32 string;			/**< Offset of value as string */
+	guint32 count;			/**< Number of list items */
+	guint32 list;			/**< Offset of list item string offsets */
+	guint32 ints;			/**< Offset of list items as integers */
+} mce_conf_cache_key_t;
+
+/** Perfect hash table mapping names to group/key indices
+ *
+ * Names hash first to a bucket; the bucket displacement then
+ * selects a hash function that maps every name in the bucket to
+ * an unique slot holding the index of the group/key
+ */
+typedef struct {
+	guint32 buckets;		/**< Number of buckets */
+	guint32 slots;			/**< Number of slots */
+	guint32 disp;			/**< Offset of displacement array */
+	guint32 slot;			/**< Offset of slot array */
+} mce_conf_cache_phf_t;
+
+/** Header of a compiled configuration cache file */
+typedef struct {
+	gchar   magic[8];		/**< MCE_CONF_CACHE_MAGIC */
+	guint32 size;			/**< Size of the whole file */
+	guint32 parse_us;		/**< Time spent parsing the sources */
+	guint32 sources;		/**< Number of source files */
+	guint32 groups;			/**< Number of groups */
+	guint32 keys;			/**< Number of keys */
+	guint32 source_off;		/**< Offset of source array */
+	guint32 group_off;		/**< Offset of group array */
+	guint32 key_off;		/**< Offset of key array */
+	mce_conf_cache_phf_t group_phf;	/**< Group name lookup */
+	mce_conf_cache_phf_t key_phf;	/**< Group and key name lookup */
+} mce_conf_cache_header_t;
+
+/** Stamp of a configuration source file */
+typedef struct {
+	gchar  *path;			/**< Path to the ini file */
+	guint64 mtime;			/**< Modification time, seconds */
+	guint64 mtime_ns;		/**< Modification time, nanoseconds */
+	guint64 size;			/**< File size */
+} mce_conf_source_t;
+
+/** Compiled configuration in use, or NULL when using the keyfile */
+static const mce_conf_cache_header_t *cache = NULL;
+
+/** Size of the compiled configuration mapping */
+static size_t cache_size = 0;
+
+/** Hash group and optional key name
+ *
+ * @param grp  group name
+ * @param key  key name, or NULL for hashing just the group name
+ *
+ * @return FNV-1a hash value
+ */
+static guint32 mce_conf_cache_hash(const gchar *grp, const gchar *key)
+{
+	guint32 h = 2166136261u;
+
+	for( const guchar *s = (const guchar *)grp; *s; ++s )
+		h = (h ^ *s) * 16777619u;
+
+	if( key ) {
+		h = (h ^ 0xff) * 16777619u;
+		for( const guchar *s = (const guchar *)key; *s; ++s )
+			h = (h ^ *s) * 16777619u;
+	}
+
+	return h;
+}
+
+/** Derive seeded hash value from name hash
+ *
+ * The names are hashed only once per lookup; the murmur3 finalizer
+ * makes different seeds act as independent hash functions
+ *
+ * @param h    hash from mce_conf_cache_hash()
+ * @param seed hash function selector
+ *
+ * @return hash value
+ */
+static guint32 mce_conf_cache_mix(guint32 h, guint32 seed)
+{
+	h ^= seed * 0x9e3779b9u;
+	h ^= h >> 16, h *= 0x85ebca6bu;
+	h ^= h >> 13, h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/** Get pointer to data within compiled configuration
+ *
+ * @param hdr start of the compiled configuration
+ * @param off offset from the start
+ *
+ * @return pointer to cache data
+ */
+static const void *mce_conf_cache_at(const mce_conf_cache_header_t *hdr,
+				     guint32 off)
+{
+	return (const gchar *)hdr + off;
+}
+
+/** Get string within the compiled configuration in use
+ *
+ * @param off offset from the start of the cache
+ *
+ * @return NUL terminated string
+ */
+static const gchar *mce_conf_cache_str(guint32 off)
+{
+	return mce_conf_cache_at(cache, off);
+}
+
+/** Look up a perfect hash slot
+ *
+ * @param phf  perfect hash table
+ * @param grp  group name
+ * @param key  key name, or NULL
+ *
+ * @return group/key index, or MCE_CONF_CACHE_EMPTY
+ */
+static guint32 mce_conf_cache_phf_lookup(const mce_conf_cache_phf_t *phf,
+					 const gchar *grp, const gchar *key)
+{
+	const guint32 *disp = mce_conf_cache_at(cache, phf->disp);
+	const guint32 *slot = mce_conf_cache_at(cache, phf->slot);
+	guint32 h;
+	guint32 b;
+
+	if( !phf->buckets || !phf->slots )
+		return MCE_CONF_CACHE_EMPTY;
+
+	h = mce_conf_cache_hash(grp, key);
+	b = mce_conf_cache_mix(h, 0) % phf->buckets;
+
+	return slot[mce_conf_cache_mix(h, disp[b]) % phf->slots];
+}
+
+/** Find group from the compiled configuration
+ *
+ * @param grp group name
+ *
+ * @return group entry, or NULL if not found
+ */
+static const mce_conf_cache_group_t *
+mce_conf_cache_find_group(const gchar *grp)
+{
+	const mce_conf_cache_group_t *group;
+	guint32 i = mce_conf_cache_phf_lookup(&cache->group_phf, grp, NULL);
+
+	if( i == MCE_CONF_CACHE_EMPTY )
+		return NULL;
+
+	group = mce_conf_cache_at(cache, cache->group_off);
+
+	/* Names that are not in the table hash to arbitrary slots */
+	if( strcmp(mce_conf_cache_str(group[i].name), grp) )
+		return NULL;
+
+	return group + i;
+}
+
+/** Find key from the compiled configuration
+ *
+ * @param grp group name
+ * @param key key name
+ *
+ * @return key entry, or NULL if not found
+ */
+static const mce_conf_cache_key_t *mce_conf_cache_find_key(const gchar *grp,
+							   const gchar *key)
+{
+	const mce_conf_cache_group_t *group;
+	const mce_conf_cache_key_t   *entry;
+	guint32 i = mce_conf_cache_phf_lookup(&cache->key_phf, grp, key);
+
+	if( i == MCE_CONF_CACHE_EMPTY )
+		return NULL;
+
+	group = mce_conf_cache_at(cache, cache->group_off);
+	entry = mce_conf_cache_at(cache, cache->key_off);
+	entry += i;
+
+	if( strcmp(mce_conf_cache_str(entry->name), key) ||
+	    strcmp(mce_conf_cache_str(group[entry->group].name), grp) )
+		return NULL;
+
+	return entry;
+}
+
+/** Build perfect hash table slots
+ *
+ * @param grp      group name of each item
+ * @param key      key name of each item, or NULL for group tables
+ * @param count    number of items
+ * @param buckets  number of buckets
+ * @param slots    number of slots
+ * @param disp     displacement array to fill, buckets entries
+ * @param slot     slot array to fill, slots entries
+ *
+ * @return TRUE on success, FALSE if no displacement works for some bucket
+ */
+static gboolean mce_conf_cache_phf_build(const gchar **grp,
+					 const gchar **key,
+					 guint32 count, guint32 buckets,
+					 guint32 slots, guint32 *disp,
+					 guint32 *slot)
+{
+	gboolean   ack    = FALSE;
+	guint32   *hash   = g_new(guint32, count);
+	guint32   *pos    = g_new(guint32, count);
+	guint32   *order  = g_new(guint32, buckets);
+	guint32   *size   = g_new0(guint32, buckets);
+	guint32   *first  = g_new0(guint32, buckets + 1);
+	guint32   *item   = g_new(guint32, count);
+
+	for( guint32 s = 0; s < slots; ++s )
+		slot[s] = MCE_CONF_CACHE_EMPTY;
+
+	/* Distribute items to buckets */
+	for( guint32 i = 0; i < count; ++i ) {
+		hash[i] = mce_conf_cache_hash(grp[i], key ? key[i] : NULL);
+		pos[i]  = mce_conf_cache_mix(hash[i], 0) % buckets;
+		size[pos[i]]++;
+	}
+	for( guint32 b = 0; b < buckets; ++b ) {
+		first[b + 1] = first[b] + size[b];
+		size[b] = 0;
+		order[b] = b;
+	}
+	for( guint32 i = 0; i < count; ++i )
+		item[first[pos[i]] + size[pos[i]]++] = i;
+
+	/* Place the largest buckets first while there is room */
+	for( guint32 i = 1; i < buckets; ++i ) {
+		guint32 b = order[i], j = i;
+		for( ; j > 0 && size[order[j - 1]] < size[b]; --j )
+			order[j] = order[j - 1];
+		order[j] = b;
+	}
+
+	for( guint32 i = 0; i < buckets; ++i ) {
+		guint32 b = order[i];
+		guint32 d;
+
+		disp[b] = 0;
+		if( !size[b] )
+			continue;
+
+		for( d = 1; d < MCE_CONF_CACHE_MAX_DISP; ++d ) {
+			guint32 n;
+
+			for( n = 0; n < size[b]; ++n ) {
+				guint32 k = item[first[b] + n];
+				guint32 s = mce_conf_cache_mix(hash[k], d) % slots;
+				if( slot[s] != MCE_CONF_CACHE_EMPTY )
+					break;
+				/* Reserve now, undone below on collision */
+				slot[s] = k;
+			}
+			if( n == size[b] )
+				break;
+
+			while( n-- > 0 ) {
+				guint32 k = item[first[b] + n];
+				slot[mce_conf_cache_mix(hash[k], d) % slots] =
+					MCE_CONF_CACHE_EMPTY;
+			}
+		}
+
+		if( d == MCE_CONF_CACHE_MAX_DISP ) {
+			mce_log(LL_WARN, "no perfect hash for %u items",
+				count);
+			goto EXIT;
+		}
+		disp[b] = d;
+	}
+
+	ack = TRUE;
+
+EXIT:
+	g_free(item);
+	g_free(first);
+	g_free(size);
+	g_free(order);
+	g_free(pos);
+	g_free(hash);
+
+	return ack;
+}
+
+/** Round cache section offset up to 8 byte alignment */
+#define MCE_CONF_CACHE_ALIGN(off) (((off) + 7u) & ~(gsize)7u)
+
+/** Number of perfect hash buckets for given number of items */
+#define MCE_CONF_CACHE_BUCKETS(n) ((n) / 2 + 1)
+
+/** Number of perfect hash slots for given number of items */
+#define MCE_CONF_CACHE_SLOTS(n)   ((n) + (n) / 8 + 1)
+
+/** Add string to compiled configuration string pool
+ *
+ * @param pool string pool
+ * @param str  string to add
+ *
+ * @return offset of the string within the pool
+ */
+static guint32 mce_conf_cache_add_str(GString *pool, const gchar *str)
+{
+	guint32 off = (guint32)pool->len;
+
+	g_string_append_len(pool, str, (gssize)strlen(str) + 1);
+
+	return off;
+}
+
+/** Parse key the way GKeyFile getters do and store the results
+ *
+ * @param ini   merged configuration
+ * @param grp   group name
+ * @param key   key name
+ * @param pool  string pool; offsets are stored relative to the pool
+ * @param words list data; offsets are stored as word indices
+ * @param entry key entry to fill
+ */
+static void mce_conf_cache_compile_key(GKeyFile *ini, const gchar *grp,
+				       const gchar *key, GString *pool,
+				       GArray *words,
+				       mce_conf_cache_key_t *entry)
+{
+	GError  *err = NULL;
+	gchar   *raw = g_key_file_get_value(ini, grp, key, 0);
+	gchar   *str = NULL;
+	gchar  **vec = NULL;
+	gint    *arr = NULL;
+	gsize    len = 0;
+
+	memset(entry, 0, sizeof *entry);
+	entry->value = mce_conf_cache_add_str(pool, raw ?: "");
+
+	entry->boolean = g_key_file_get_boolean(ini, grp, key, &err);
+	if( !err )
+		entry->valid |= MCE_CONF_CACHE_BOOLEAN;
+	g_clear_error(&err);
+
+	entry->integer = g_key_file_get_integer(ini, grp, key, &err);
+	if( !err )
+		entry->valid |= MCE_CONF_CACHE_INTEGER;
+	g_clear_error(&err);
+
+	/* Values returned together with an error are not used */
+	str = g_key_file_get_string(ini, grp, key, &err);
+	if( !err && str ) {
+		entry->valid |= MCE_CONF_CACHE_STRING;
+		entry->string = mce_conf_cache_add_str(pool, str);
+	}
+	g_clear_error(&err);
+
+	vec = g_key_file_get_string_list(ini, grp, key, &len, &err);
+	if( !err && vec ) {
+		entry->valid |= MCE_CONF_CACHE_STRING_LIST;
+		entry->count = (guint32)len;
+		entry->list  = words->len;
+		for( gsize i = 0; i < len; ++i ) {
+			guint32 off = mce_conf_cache_add_str(pool, vec[i]);
+			g_array_append_val(words, off);
+		}
+	}
+	g_clear_error(&err);
+
+	/* Empty list is returned as NULL without error */
+	len = 0;
+	arr = g_key_file_get_integer_list(ini, grp, key, &len, &err);
+	if( !err && len == entry->count ) {
+		entry->valid |= MCE_CONF_CACHE_INTEGER_LIST;
+		entry->ints = words->len;
+		for( gsize i = 0; i < len; ++i ) {
+			guint32 val = (guint32)arr[i];
+			g_array_append_val(words, val);
+		}
+	}
+	g_clear_error(&err);
+
+	g_free(arr);
+	g_strfreev(vec);
+	g_free(str);
+	g_free(raw);
+}
+
+/** Compile merged configuration into a cache image
+ *
+ * @param ini      merged configuration
+ * @param sources  ini files the configuration was merged from
+ * @param parse_us time it took to read and merge the sources
+ * @param psize    where to store size of the image
+ *
+ * @return cache image; release with g_free(), or NULL on failure
+ */
+static void *mce_conf_cache_compile(GKeyFile *ini, const GPtrArray *sources,
+				    guint32 parse_us, gsize *psize)
+{
+	gchar                   *data    = NULL;
+	gsize                    ngrp    = 0;
+	gchar                  **grp     = g_key_file_get_groups(ini, &ngrp);
+	GPtrArray               *kgrp    = g_ptr_array_new();
+	GPtrArray               *kname   = g_ptr_array_new();
+	GArray                  *kentry  = g_array_new(FALSE, FALSE,
+					sizeof(mce_conf_cache_key_t));
+	GArray                  *words   = g_array_new(FALSE, FALSE,
+							  sizeof(guint32));
+	GString                 *pool    = g_string_new("");
+	mce_conf_cache_header_t  hdr;
+	mce_conf_cache_group_t  *group;
+	mce_conf_cache_key_t    *key;
+	mce_conf_cache_source_t *source;
+	guint32                 *word;
+	gsize                    size;
+	guint32                  word_off;
+	guint32                  str_off;
+
+	memset(&hdr, 0, sizeof hdr);
+
+	/* Pool starts with an empty string so that the image always
+	 * ends in NUL, even when there is no configuration at all */
+	mce_conf_cache_add_str(pool, "");
+
+	/* Collect keys in file order, keys of each group together */
+	for( gsize g = 0; grp && g < ngrp; ++g ) {
+		gchar **keys = g_key_file_get_keys(ini, grp[g], 0, 0);
+
+		for( gsize k = 0; keys && keys[k]; ++k ) {
+			mce_conf_cache_key_t entry;
+
+			mce_conf_cache_compile_key(ini, grp[g], keys[k],
+						   pool, words, &entry);
+			entry.group = (guint32)g;
+			entry.name  = mce_conf_cache_add_str(pool, keys[k]);
+
+			g_ptr_array_add(kgrp, grp[g]);
+			g_ptr_array_add(kname, g_strdup(keys[k]));
+			g_array_append_val(kentry, entry);
+		}
+		g_strfreev(keys);
+	}
+
+	memcpy(hdr.magic, MCE_CONF_CACHE_MAGIC, sizeof hdr.magic);
+	hdr.parse_us = parse_us;
+	hdr.sources  = sources->len;
+	hdr.groups   = (guint32)ngrp;
+	hdr.keys     = kentry->len;
+
+	hdr.group_phf.buckets = MCE_CONF_CACHE_BUCKETS(hdr.groups);
+	hdr.group_phf.slots   = MCE_CONF_CACHE_SLOTS(hdr.groups);
+	hdr.key_phf.buckets   = MCE_CONF_CACHE_BUCKETS(hdr.keys);
+	hdr.key_phf.slots     = MCE_CONF_CACHE_SLOTS(hdr.keys);
+
+	/* Layout: header, fixed size tables, list data, string pool */
+	size = MCE_CONF_CACHE_ALIGN(sizeof hdr);
+	hdr.source_off = (guint32)size;
+	size = MCE_CONF_CACHE_ALIGN(size + hdr.sources * sizeof *source);
+	hdr.group_off = (guint32)size;
+	size = MCE_CONF_CACHE_ALIGN(size + hdr.groups * sizeof *group);
+	hdr.key_off = (guint32)size;
+	size = MCE_CONF_CACHE_ALIGN(size + hdr.keys * sizeof *key);
+	hdr.group_phf.disp = (guint32)size;
+	size += hdr.group_phf.buckets * sizeof(guint32);
+	hdr.group_phf.slot = (guint32)size;
+	size += hdr.group_phf.slots * sizeof(guint32);
+	hdr.key_phf.disp = (guint32)size;
+	size += hdr.key_phf.buckets * sizeof(guint32);
+	hdr.key_phf.slot = (guint32)size;
+	size += hdr.key_phf.slots * sizeof(guint32);
+	word_off = (guint32)size;
+	size += words->len * sizeof(guint32);
+	str_off = (guint32)size;
+
+	data = g_malloc0(size);
+	source = (void *)(data + hdr.source_off);
+	group  = (void *)(data + hdr.group_off);
+	key    = (void *)(data + hdr.key_off);
+	word   = (void *)(data + word_off);
+
+	if( words->len )
+		memcpy(word, words->data, words->len * sizeof(guint32));
+
+	for( guint i = 0; i < sources->len; ++i ) {
+		const mce_conf_source_t *src = g_ptr_array_index(sources, i);
+
+		source[i].path     = str_off + mce_conf_cache_add_str(pool,
+								  src->path);
+		source[i].mtime    = src->mtime;
+		source[i].mtime_ns = src->mtime_ns;
+		source[i].size     = src->size;
+	}
+
+	for( guint32 g = 0; g < hdr.groups; ++g )
+		group[g].name = str_off + mce_conf_cache_add_str(pool, grp[g]);
+
+	/* Turn pool relative offsets and word indices into image offsets */
+	for( guint32 k = 0; k < hdr.keys; ++k ) {
+		guint32 g = g_array_index(kentry, mce_conf_cache_key_t, k).group;
+
+		if( group[g].count++ == 0 )
+			group[g].first = k;
+
+		key[k] = g_array_index(kentry, mce_conf_cache_key_t, k);
+		key[k].name   += str_off;
+		key[k].value  += str_off;
+		key[k].string += str_off;
+
+		if( key[k].valid & MCE_CONF_CACHE_STRING_LIST ) {
+			for( guint32 i = 0; i < key[k].count; ++i )
+				word[key[k].list + i] += str_off;
+		}
+		key[k].list = word_off + key[k].list * sizeof(guint32);
+		key[k].ints = word_off + key[k].ints * sizeof(guint32);
+	}
+
+	if( !mce_conf_cache_phf_build((const gchar **)grp, NULL, hdr.groups,
+				      hdr.group_phf.buckets,
+				      hdr.group_phf.slots,
+				      (void *)(data + hdr.group_phf.disp),
+				      (void *)(data + hdr.group_phf.slot)) ||
+	    !mce_conf_cache_phf_build((const gchar **)kgrp->pdata,
+				      (const gchar **)kname->pdata,
+				      hdr.keys,
+				      hdr.key_phf.buckets,
+				      hdr.key_phf.slots,
+				      (void *)(data + hdr.key_phf.disp),
+				      (void *)(data + hdr.key_phf.slot)) ) {
+		g_free(data), data = NULL;
+		goto EXIT;
+	}
+
+	/* Append the string pool; it ends in NUL by construction */
+	hdr.size = (guint32)(size + pool->len);
+	data = g_realloc(data, hdr.size);
+	memcpy(data, &hdr, sizeof hdr);
+	memcpy(data + str_off, pool->str, pool->len);
+	*psize = hdr.size;
+
+EXIT:
+	for( guint i = 0; i < kname->len; ++i )
+		g_free(g_ptr_array_index(kname, i));
+	g_ptr_array_free(kname, TRUE);
+	g_ptr_array_free(kgrp, TRUE);
+	g_array_free(kentry, TRUE);
+	g_array_free(words, TRUE);
+	g_string_free(pool, TRUE);
+	g_strfreev(grp);
+
+	return data;
+}
+
+/** Check that a table fits within compiled configuration
+ *
+ * @param size  size of the compiled configuration
+ * @param off   offset of the table
+ * @param count number of table entries
+ * @param esize size of a table entry
+ *
+ * @return TRUE if the table is within bounds, FALSE otherwise
+ */
+static gboolean mce_conf_cache_fits(gsize size, guint32 off,
+				    guint32 count, gsize esize)
+{
+	return (off % 4 == 0) && (off <= size) &&
+		((guint64)count * esize <= size - off);
+}
+
+/** Check perfect hash table of compiled configuration
+ *
+ * @param hdr   compiled configuration
+ * @param size  size of the compiled configuration
+ * @param phf   perfect hash table to check
+ * @param count number of items the table indexes
+ *
+ * @return TRUE if the table is valid, FALSE otherwise
+ */
+static gboolean mce_conf_cache_phf_valid(const mce_conf_cache_header_t *hdr,
+					 gsize size,
+					 const mce_conf_cache_phf_t *phf,
+					 guint32 count)
+{
+	const guint32 *slot;
+
+	if( !mce_conf_cache_fits(size, phf->disp, phf->buckets,
+				 sizeof(guint32)) ||
+	    !mce_conf_cache_fits(size, phf->slot, phf->slots,
+				 sizeof(guint32)) )
+		return FALSE;
+
+	slot = mce_conf_cache_at(hdr, phf->slot);
+	for( guint32 s = 0; s < phf->slots; ++s ) {
+		if( slot[s] != MCE_CONF_CACHE_EMPTY && slot[s] >= count )
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/** Check key of compiled configuration
+ *
+ * @param hdr   compiled configuration
+ * @param size  size of the compiled configuration
+ * @param key   key to check
+ *
+ * @return TRUE if the key is valid, FALSE otherwise
+ */
+static gboolean mce_conf_cache_key_valid(const mce_conf_cache_header_t *hdr,
+					 gsize size,
+					 const mce_conf_cache_key_t *key)
+{
+	if( key->group >= hdr->groups || key->name >= size ||
+	    key->value >= size || key->string >= size )
+		return FALSE;
+
+	if( key->valid & MCE_CONF_CACHE_STRING_LIST ) {
+		const guint32 *list = mce_conf_cache_at(hdr, key->list);
+
+		if( !mce_conf_cache_fits(size, key->list, key->count,
+					 sizeof(guint32)) )
+			return FALSE;
+
+		for( guint32 i = 0; i < key->count; ++i ) {
+			if( list[i] >= size )
+				return FALSE;
+		}
+	}
+
+	if( (key->valid & MCE_CONF_CACHE_INTEGER_LIST) &&
+	    !mce_conf_cache_fits(size, key->ints, key->count,
+				 sizeof(gint32)) )
+		return FALSE;
+
+	return TRUE;
+}
+
+/** Check that compiled configuration is intact and up to date
+ *
+ * Everything that lookups dereference is bounds checked so that
+ * a corrupted cache file can not crash mce
+ *
+ * @param hdr     compiled configuration
+ * @param size    size of the compiled configuration
+ * @param sources current ini files
+ *
+ * @return TRUE if the cache can be used, FALSE otherwise
+ */
+static gboolean mce_conf_cache_valid(const mce_conf_cache_header_t *hdr,
+				     gsize size, const GPtrArray *sources)
+{
+	const mce_conf_cache_source_t *source;
+	const mce_conf_cache_group_t  *group;
+	const mce_conf_cache_key_t    *key;
+
+	if( size < sizeof *hdr || hdr->size != size ||
+	    hdr->source_off % 8 ||
+	    memcmp(hdr->magic, MCE_CONF_CACHE_MAGIC, sizeof hdr->magic) ||
+	    ((const gchar *)hdr)[size - 1] != 0 ) {
+		mce_log(LL_DEBUG, "config cache: invalid header");
+		return FALSE;
+	}
+
+	if( !mce_conf_cache_fits(size, hdr->source_off, hdr->sources,
+				 sizeof *source) ||
+	    !mce_conf_cache_fits(size, hdr->group_off, hdr->groups,
+				 sizeof *group) ||
+	    !mce_conf_cache_fits(size, hdr->key_off, hdr->keys,
+				 sizeof *key) ||
+	    !mce_conf_cache_phf_valid(hdr, size, &hdr->group_phf,
+				      hdr->groups) ||
+	    !mce_conf_cache_phf_valid(hdr, size, &hdr->key_phf,
+				      hdr->keys) ) {
+		mce_log(LL_DEBUG, "config cache: invalid tables");
+		return FALSE;
+	}
+
+	/* The cache is stale if any ini file was added, removed or
+	 * modified after the cache was written */
+	if( hdr->sources != sources->len ) {
+		mce_log(LL_DEBUG, "config cache: ini files added/removed");
+		return FALSE;
+	}
+
+	source = mce_conf_cache_at(hdr, hdr->source_off);
+	for( guint32 i = 0; i < hdr->sources; ++i ) {
+		const mce_conf_source_t *src = g_ptr_array_index(sources, i);
+
+		if( source[i].path >= size ||
+		    strcmp(mce_conf_cache_at(hdr, source[i].path),
+			   src->path) ||
+		    source[i].mtime != src->mtime ||
+		    source[i].mtime_ns != src->mtime_ns ||
+		    source[i].size != src->size ) {
+			mce_log(LL_DEBUG, "config cache: %s changed",
+				src->path);
+			return FALSE;
+		}
+	}
+
+	group = mce_conf_cache_at(hdr, hdr->group_off);
+	for( guint32 g = 0; g < hdr->groups; ++g ) {
+		if( group[g].name >= size || group[g].first > hdr->keys ||
+		    group[g].count > hdr->keys - group[g].first ) {
+			mce_log(LL_DEBUG, "config cache: invalid group");
+			return FALSE;
+		}
+	}
+
+	key = mce_conf_cache_at(hdr, hdr->key_off);
+	for( guint32 k = 0; k < hdr->keys; ++k ) {
+		if( !mce_conf_cache_key_valid(hdr, size, key + k) ) {
+			mce_log(LL_DEBUG, "config cache: invalid key");
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/** Map compiled configuration from the cache file
+ *
+ * @param sources current ini files
+ *
+ * @return TRUE if up to date configuration cache is now in use,
+ *         FALSE otherwise
+ */
+static gboolean mce_conf_cache_load(const GPtrArray *sources)
+{
+	void        *data = MAP_FAILED;
+	int          fd   = -1;
+	struct stat  st;
+
+	if( (fd = open(MCE_CONF_CACHE_PATH, O_RDONLY | O_CLOEXEC)) == -1 ) {
+		if( errno != ENOENT )
+			mce_log(LL_WARN, "%s: can't open: %m",
+				MCE_CONF_CACHE_PATH);
+		goto EXIT;
+	}
+
+	if( fstat(fd, &st) == -1 || st.st_size <= 0 ||
+	    (guint64)st.st_size > G_MAXUINT32 )
+		goto EXIT;
+
+	data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if( data == MAP_FAILED ) {
+		mce_log(LL_WARN, "%s: can't map: %m", MCE_CONF_CACHE_PATH);
+		goto EXIT;
+	}
+
+	if( !mce_conf_cache_valid(data, (gsize)st.st_size, sources) ) {
+		munmap(data, (size_t)st.st_size), data = MAP_FAILED;
+		goto EXIT;
+	}
+
+	cache = data;
+	cache_size = (size_t)st.st_size;
+
+EXIT:
+	if( fd != -1 )
+		close(fd);
+
+	return cache != NULL;
+}
+
+/** Write merged configuration to the cache file
+ *
+ * @param ini      merged configuration
+ * @param sources  ini files the configuration was merged from
+ * @param parse_us time it took to read and merge the sources
+ */
+static void mce_conf_cache_save(GKeyFile *ini, const GPtrArray *sources,
+				guint32 parse_us)
+{
+	gsize  size = 0;
+	void  *data = mce_conf_cache_compile(ini, sources, parse_us, &size);
+
+	if( !data )
+		goto EXIT;
+
+	if( !mce_io_update_file_atomic(MCE_CONF_CACHE_PATH, data, size,
+				       0644, FALSE) ) {
+		mce_log(LL_WARN, "%s: can't update", MCE_CONF_CACHE_PATH);
+		goto EXIT;
+	}
+
+	mce_log(LL_NOTICE, "config cache saved; ini files were parsed in %u us",
+		(unsigned)parse_us);
+
+EXIT:
+	g_free(data);
+}
+
+/** Stop using compiled configuration
+ */
+static void mce_conf_cache_unload(void)
+{
+	if( cache ) {
+		munmap((void *)cache, cache_size);
+		cache = NULL;
+		cache_size = 0;
+	}
+}
+
+/** Find key parsed as given type, set key file style error on failure
+ *
+ * @param grp   group name
+ * @param key   key name
+ * @param type  MCE_CONF_CACHE_xxx value type
+ * @param what  value type name for error messages
+ * @param error where to store the error
+ *
+ * @return key entry, or NULL with error set on failure
+ */
+static const mce_conf_cache_key_t *mce_conf_cache_lookup(const gchar *grp,
+							 const gchar *key,
+							 guint32 type,
+							 const gchar *what,
+							 GError **error)
+{
+	const mce_conf_cache_key_t *entry = mce_conf_cache_find_key(grp, key);
+
+	if( !entry ) {
+		if( !mce_conf_cache_find_group(grp) )
+			g_set_error(error, G_KEY_FILE_ERROR,
+				    G_KEY_FILE_ERROR_GROUP_NOT_FOUND,
+				    "Key file does not have group '%s'", grp);
+		else
+			g_set_error(error, G_KEY_FILE_ERROR,
+				    G_KEY_FILE_ERROR_KEY_NOT_FOUND,
+				    "Key file does not have key '%s' "
+				    "in group '%s'", key, grp);
+		goto EXIT;
+	}
+
+	if( !(entry->valid & type) ) {
+		g_set_error(error, G_KEY_FILE_ERROR,
+			    G_KEY_FILE_ERROR_INVALID_VALUE,
+			    "Value '%s' cannot be interpreted as %s",
+			    mce_conf_cache_str(entry->value), what);
+		entry = NULL;
+	}
+
+EXIT:
+	return entry;
+}
+
+/** Get boolean value from compiled configuration
+ *
+ * @param grp   group name
+ * @param key   key name
+ * @param error where to store errors
+ *
+ * @return value, or FALSE with error set on failure
+ */
+static gboolean mce_conf_cache_get_boolean(const gchar *grp, const gchar *key,
+					   GError **error)
+{
+	const mce_conf_cache_key_t *entry =
+		mce_conf_cache_lookup(grp, key, MCE_CONF_CACHE_BOOLEAN,
+				      "a boolean", error);
+
+	return entry ? entry->boolean : FALSE;
+}
+
+/** Get integer value from compiled configuration
+ *
+ * @param grp   group name
+ * @param key   key name
+ * @param error where to store errors
+ *
+ * @return value, or 0 with error set on failure
+ */
+static gint mce_conf_cache_get_integer(const gchar *grp, const gchar *key,
+				       GError **error)
+{
+	const mce_conf_cache_key_t *entry =
+		mce_conf_cache_lookup(grp, key, MCE_CONF_CACHE_INTEGER,
+				      "a number", error);
+
+	return entry ? entry->integer : 0;
+}
+
+/** Get string value from compiled configuration
+ *
+ * @param grp   group name
+ * @param key   key name
+ * @param error where to store errors
+ *
+ * @return value; release with g_free(), or NULL with error set on failure
+ */
+static gchar *mce_conf_cache_get_string(const gchar *grp, const gchar *key,
+					GError **error)
+{
+	const mce_conf_cache_key_t *entry =
+		mce_conf_cache_lookup(grp, key, MCE_CONF_CACHE_STRING,
+				      "a string", error);
+
+	return entry ? g_strdup(mce_conf_cache_str(entry->string)) : NULL;
+}
+
+/** Get string list value from compiled configuration
+ *
+ * @param grp    group name
+ * @param key    key name
+ * @param length where to store list length, or NULL
+ * @param error  where to store errors
+ *
+ * @return value; release with g_strfreev(), or NULL with error set
+ *         on failure
+ */
+static gchar **mce_conf_cache_get_string_list(const gchar *grp,
+					      const gchar *key,
+					      gsize *length, GError **error)
+{
+	const mce_conf_cache_key_t *entry =
+		mce_conf_cache_lookup(grp, key, MCE_CONF_CACHE_STRING_LIST,
+				      "a string list", error);
+	const guint32 *list;
+	gchar        **value = NULL;
+	gsize          count = 0;
+
+	if( !entry )
+		goto EXIT;
+
+	list  = mce_conf_cache_at(cache, entry->list);
+	count = entry->count;
+	value = g_new0(gchar *, count + 1);
+
+	for( gsize i = 0; i < count; ++i )
+		value[i] = g_strdup(mce_conf_cache_str(list[i]));
+
+EXIT:
+	if( length )
+		*length = count;
+
+	return value;
+}
+
+/** Get integer list value from compiled configuration
+ *
+ * @param grp    group name
+ * @param key    key name
+ * @param length where to store list length, or NULL
+ * @param error  where to store errors
+ *
+ * @return value; release with g_free(), or NULL on failure and
+ *         for empty lists
+ */
+static gint *mce_conf_cache_get_integer_list(const gchar *grp,
+					     const gchar *key,
+					     gsize *length, GError **error)
+{
+	const mce_conf_cache_key_t *entry =
+		mce_conf_cache_lookup(grp, key, MCE_CONF_CACHE_INTEGER_LIST,
+				      "an integer list", error);
+	const gint32  *ints;
+	gint          *value = NULL;
+	gsize          count = 0;
+
+	if( !entry )
+		goto EXIT;
+
+	ints  = mce_conf_cache_at(cache, entry->ints);
+	count = entry->count;
+	value = g_new(gint, count);
+
+	for( gsize i = 0; i < count; ++i )
+		value[i] = ints[i];
+
+EXIT:
+	if( length )
+		*length = count;
+
+	return value;
+}
+
+/** Get key names of a group from compiled configuration
+ *
+ * @param grp    group name
+ * @param length where to store number of keys, or NULL
+ * @param error  where to store errors
+ *
+ * @return key names; release with g_strfreev(), or NULL with error set
+ *         on failure
+ */
+static gchar **mce_conf_cache_get_keys(const gchar *grp, gsize *length,
+				       GError **error)
+{
+	const mce_conf_cache_group_t *group = mce_conf_cache_find_group(grp);
+	const mce_conf_cache_key_t   *key;
+	gchar                       **keys  = NULL;
+
+	if( length )
+		*length = 0;
+
+	if( !group ) {
+		g_set_error(error, G_KEY_FILE_ERROR,
+			    G_KEY_FILE_ERROR_GROUP_NOT_FOUND,
+			    "Key file does not have group '%s'", grp);
+		goto EXIT;
+	}
+
+	key = mce_conf_cache_at(cache, cache->key_off);
+	key += group->first;
+	keys = g_new0(gchar *, group->count + 1);
+
+	for( guint32 k = 0; k < group->count; ++k )
+		keys[k] = g_strdup(mce_conf_cache_str(key[k].name));
+
+	if( length )
+		*length = group->count;
+
+EXIT:
+	return keys;
+}
+
 /** Internal helper for insuring valid keyfile pointer is available
  *
  * @param keyfilepointer custom key file, or NULL to use the default one
  *
- * @returns non-null keyfile pointer, or aborts
+ * @returns keyfile pointer, NULL if compiled configuration is
+ *          used instead, or aborts
  */
 static gpointer mce_conf_get_keyfile(void)
 {
-	if( !keyfile ) {
+	if( !keyfile && !cache ) {
 		/* Earlier it was possible to have mce running with NULL
 		 * keyfile. Now the only reasons that might happen are:
 		 *   1) mce_conf_init() was not called yet
@@ -61,6 +1140,10 @@ static gpointer mce_conf_get_keyfile(void)
 gboolean mce_conf_has_group(const gchar *group)
 {
 	gpointer keyfileptr = mce_conf_get_keyfile();
+
+	if( cache )
+		return mce_conf_cache_find_group(group) != NULL;
+
 	return g_key_file_has_group(keyfileptr, group);
 }
 
@@ -75,7 +1158,12 @@ gboolean mce_conf_has_key(const gchar *group, const gchar *key)
 {
 	gpointer keyfileptr = mce_conf_get_keyfile();
 	GError *error = NULL;
-	gboolean res = g_key_file_has_key(keyfileptr, group, key, &error);
+	gboolean res;
+
+	if( cache )
+		return mce_conf_cache_find_key(group, key) != NULL;
+
+	res = g_key_file_has_key(keyfileptr, group, key, &error);
 	g_clear_error(&error);
 	return res;
 }
@@ -97,7 +1185,10 @@ gboolean mce_conf_get_bool(const gchar *group, const gchar *key,
 
 	gpointer keyfileptr = mce_conf_get_keyfile();
 
-	tmp = g_key_file_get_boolean(keyfileptr, group, key, &error);
+	if( cache )
+		tmp = mce_conf_cache_get_boolean(group, key, &error);
+	else
+		tmp = g_key_file_get_boolean(keyfileptr, group, key, &error);
 
 	if (error != NULL) {
 		mce_log(LL_DEBUG,
@@ -129,7 +1220,10 @@ gint mce_conf_get_int(const gchar *group, const gchar *key,
 
 	gpointer keyfileptr = mce_conf_get_keyfile();
 
-	tmp = g_key_file_get_integer(keyfileptr, group, key, &error);
+	if( cache )
+		tmp = mce_conf_cache_get_integer(group, key, &error);
+	else
+		tmp = g_key_file_get_integer(keyfileptr, group, key, &error);
 
 	if (error != NULL) {
 		mce_log(LL_DEBUG,
@@ -161,8 +1255,12 @@ gint *mce_conf_get_int_list(const gchar *group, const gchar *key,
 
 	gpointer keyfileptr = mce_conf_get_keyfile();
 
-	tmp = g_key_file_get_integer_list(keyfileptr, group, key,
-					  length, &error);
+	if( cache )
+		tmp = mce_conf_cache_get_integer_list(group, key,
+						      length, &error);
+	else
+		tmp = g_key_file_get_integer_list(keyfileptr, group, key,
+						  length, &error);
 
 	if (error != NULL) {
 		mce_log(LL_DEBUG,
@@ -194,7 +1292,10 @@ gchar *mce_conf_get_string(const gchar *group, const gchar *key,
 
 	gpointer keyfileptr = mce_conf_get_keyfile();
 
-	tmp = g_key_file_get_string(keyfileptr, group, key, &error);
+	if( cache )
+		tmp = mce_conf_cache_get_string(group, key, &error);
+	else
+		tmp = g_key_file_get_string(keyfileptr, group, key, &error);
 
 	if (error != NULL) {
 		mce_log(LL_DEBUG,
@@ -204,8 +1305,9 @@ gchar *mce_conf_get_string(const gchar *group, const gchar *key,
 			defaultval ? defaultval : "",
 			defaultval ? "'" : "");
 
-		if (defaultval != NULL)
-			tmp = g_strdup(defaultval);
+		/* GKeyFile can return a value together with an error */
+		g_free(tmp);
+		tmp = defaultval ? g_strdup(defaultval) : NULL;
 	}
 
 	g_clear_error(&error);
@@ -230,8 +1332,12 @@ gchar **mce_conf_get_string_list(const gchar *group, const gchar *key,
 
 	gpointer keyfileptr = mce_conf_get_keyfile();
 
-	tmp = g_key_file_get_string_list(keyfileptr, group, key,
-					 length, &error);
+	if( cache )
+		tmp = mce_conf_cache_get_string_list(group, key,
+						     length, &error);
+	else
+		tmp = g_key_file_get_string_list(keyfileptr, group, key,
+						 length, &error);
 
 	if (error != NULL) {
 		mce_log(LL_DEBUG,
@@ -253,7 +1359,10 @@ gchar **mce_conf_get_keys(const gchar *group, gsize *length)
 
 	gpointer keyfileptr = mce_conf_get_keyfile();
 
-	tmp = g_key_file_get_keys(keyfileptr, group, length, &error);
+	if( cache )
+		tmp = mce_conf_cache_get_keys(group, length, &error);
+	else
+		tmp = g_key_file_get_keys(keyfileptr, group, length, &error);
 
 	if (error != NULL) {
 		mce_log(LL_WARN,
@@ -412,14 +1521,38 @@ static int mce_conf_glob_error_cb(const char *path, int err)
   return 0;
 }
 
-/** Process config data from /etc/mce/mce.d/xxx.ini files
+/** Release configuration source stamps
+ *
+ * @param sources array of mce_conf_source_t, or NULL
  */
-static GKeyFile *mce_conf_read_ini_files(void)
+static void mce_conf_free_sources(GPtrArray *sources)
+{
+	if( !sources )
+		goto EXIT;
+
+	for( guint i = 0; i < sources->len; ++i ) {
+		mce_conf_source_t *source = g_ptr_array_index(sources, i);
+
+		g_free(source->path);
+		g_free(source);
+	}
+	g_ptr_array_free(sources, TRUE);
+
+EXIT:
+	return;
+}
+
+/** Get stamps of the ini files the configuration is merged from
+ *
+ * @return array of mce_conf_source_t; release with
+ *         mce_conf_free_sources()
+ */
+static GPtrArray *mce_conf_get_sources(void)
 {
 	static const char pattern[] = MCE_CONF_DIR"/[0-9][0-9]*.ini";
 
-	GKeyFile *ini = g_key_file_new();
-	glob_t    gb;
+	GPtrArray *sources = g_ptr_array_new();
+	glob_t     gb;
 
 	memset(&gb, 0, sizeof gb);
 
@@ -429,7 +1562,40 @@ static GKeyFile *mce_conf_read_ini_files(void)
 	}
 
 	for( size_t i = 0; i < gb.gl_pathc; ++i ) {
-		const char *path = gb.gl_pathv[i];
+		mce_conf_source_t *source;
+		struct stat        st;
+
+		if( stat(gb.gl_pathv[i], &st) == -1 ) {
+			mce_log(LL_WARN, "%s: can't stat: %m",
+				gb.gl_pathv[i]);
+			continue;
+		}
+
+		source = g_malloc0(sizeof *source);
+		source->path     = g_strdup(gb.gl_pathv[i]);
+		source->mtime    = (guint64)st.st_mtim.tv_sec;
+		source->mtime_ns = (guint64)st.st_mtim.tv_nsec;
+		source->size     = (guint64)st.st_size;
+		g_ptr_array_add(sources, source);
+	}
+
+EXIT:
+	globfree(&gb);
+
+	return sources;
+}
+
+/** Process config data from /etc/mce/mce.d/xxx.ini files
+ *
+ * @param sources ini files to merge, from mce_conf_get_sources()
+ */
+static GKeyFile *mce_conf_read_ini_files(const GPtrArray *sources)
+{
+	GKeyFile *ini = g_key_file_new();
+
+	for( guint i = 0; i < sources->len; ++i ) {
+		const mce_conf_source_t *source = g_ptr_array_index(sources, i);
+		const char *path = source->path;
 		GError     *err  = 0;
 		GKeyFile   *tmp  = g_key_file_new();
 
@@ -445,9 +1611,6 @@ static GKeyFile *mce_conf_read_ini_files(void)
 		g_key_file_free(tmp);
 	}
 
-EXIT:
-	globfree(&gb);
-
 	return ini;
 }
 
@@ -603,6 +1766,71 @@ static gchar **keybd_cached = NULL;
 /** List of blacklisted event devices obtained from ini files */
 static gchar **black_cached = NULL;
 
+/** Idle callback id for delayed cache file update */
+static guint mce_conf_cache_save_id = 0;
+
+/** Ini files the configuration to save was merged from */
+static GPtrArray *mce_conf_cache_save_sources = NULL;
+
+/** Time it took to read and merge the configuration to save */
+static guint32 mce_conf_cache_save_parse_us = 0;
+
+/** Idle callback for writing the cache file after startup
+ *
+ * @param aptr unused
+ *
+ * @return FALSE to stop the idle callback from repeating
+ */
+static gboolean mce_conf_cache_save_cb(gpointer aptr)
+{
+	(void)aptr;
+
+	if( !mce_conf_cache_save_id )
+		goto EXIT;
+
+	mce_conf_cache_save_id = 0;
+
+	if( keyfile )
+		mce_conf_cache_save(keyfile, mce_conf_cache_save_sources,
+				    mce_conf_cache_save_parse_us);
+
+	mce_conf_free_sources(mce_conf_cache_save_sources),
+		mce_conf_cache_save_sources = NULL;
+
+EXIT:
+	return FALSE;
+}
+
+/** Cancel pending cache file update
+ */
+static void mce_conf_cache_cancel_save(void)
+{
+	if( mce_conf_cache_save_id )
+		g_source_remove(mce_conf_cache_save_id),
+			mce_conf_cache_save_id = 0;
+
+	mce_conf_free_sources(mce_conf_cache_save_sources),
+		mce_conf_cache_save_sources = NULL;
+}
+
+/** Schedule cache file update to happen when mce is idle
+ *
+ * Compiling and writing the cache is left out of the startup path
+ *
+ * @param sources  ini files the configuration was merged from;
+ *                 ownership is transferred
+ * @param parse_us time it took to read and merge the sources
+ */
+static void mce_conf_cache_schedule_save(GPtrArray *sources,
+					 guint32 parse_us)
+{
+	mce_conf_cache_cancel_save();
+
+	mce_conf_cache_save_sources  = sources;
+	mce_conf_cache_save_parse_us = parse_us;
+	mce_conf_cache_save_id = g_idle_add(mce_conf_cache_save_cb, 0);
+}
+
 /**
  * Init function for the mce-conf component
  *
@@ -610,28 +1838,40 @@ static gchar **black_cached = NULL;
  */
 gboolean mce_conf_init(void)
 {
-	gboolean status = FALSE;
+	gboolean   status  = FALSE;
+	GPtrArray *sources = mce_conf_get_sources();
+	gint64     t0      = g_get_monotonic_time();
+	gint64     dt;
+
+	/* Use compiled configuration if it is up to date */
+	if( mce_conf_cache_load(sources) ) {
+		dt = g_get_monotonic_time() - t0;
+		mce_log(LL_NOTICE, "config cache loaded in %"G_GINT64_FORMAT
+			" us; parsing ini files took %u us when the cache"
+			" was compiled", dt, (unsigned)cache->parse_us);
+		status = TRUE;
+		goto EVDEV;
+	}
 
-	if( !(keyfile = mce_conf_read_ini_files()) )
+	if( !(keyfile = mce_conf_read_ini_files(sources)) )
 		goto EXIT;
 
-	touch_cached = g_key_file_get_string_list(keyfile,
-						  "evdev",
-						  "touch",
-						  0, 0);
+	dt = g_get_monotonic_time() - t0;
+	mce_log(LL_NOTICE, "ini files parsed in %"G_GINT64_FORMAT" us", dt);
 
-	keybd_cached = g_key_file_get_string_list(keyfile,
-						  "evdev",
-						  "keybd",
-						  0, 0);
-
-	black_cached = g_key_file_get_string_list(keyfile,
-						  "evdev",
-						  "black",
-						  0, 0);
+	mce_conf_cache_schedule_save(sources,
+				     (guint32)CLAMP(dt, 0, G_MAXUINT32));
+	sources = NULL;
 	status = TRUE;
 
+EVDEV:
+	touch_cached = mce_conf_get_string_list("evdev", "touch", 0);
+	keybd_cached = mce_conf_get_string_list("evdev", "keybd", 0);
+	black_cached = mce_conf_get_string_list("evdev", "black", 0);
+
 EXIT:
+	mce_conf_free_sources(sources);
+
 	return status;
 }
 
@@ -644,8 +1884,12 @@ void mce_conf_exit(void)
 	g_strfreev(keybd_cached), keybd_cached = 0;
 	g_strfreev(black_cached), black_cached = 0;
 
+	mce_conf_cache_cancel_save();
+
 	if( keyfile ) g_key_file_free(keyfile), keyfile = 0;
 
+	mce_conf_cache_unload();
+
 	return;
 }
 
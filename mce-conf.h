@@ -23,6 +23,9 @@
 
 #include <glib.h>
 
+/** Path to the compiled configuration cache */
+#define MCE_CONF_CACHE_PATH	G_STRINGIFY(MCE_VAR_DIR) "/config.cache"
+
 gboolean mce_conf_has_group(const gchar *group);
 gboolean mce_conf_has_key(const gchar *group, const gchar *key);
 
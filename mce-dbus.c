@@ -31,15 +31,42 @@
 #include "mce.h"
 #include "mce-dbus.h"
 
-#include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-log.h"			/* mce_log(), LL_*,
+					 * mce_log_recorder_p(),
+					 * mce_log_recorder_to_string() */
 
 #include "mce-gconf.h"
 
+#include "datapipe.h"			/* datapipe_stats_to_string() */
+
 /** List of all D-Bus handlers */
 static GSList *dbus_handlers = NULL;
 /** List iterator for msg_handler */
 static GSList *msg_handler_iter = NULL;
 
+/** Lookup table for D-Bus handlers; handler_key_t -> handler_bucket_t */
+static GHashTable *dbus_handler_lut = NULL;
+
+/** Pre-parsed D-Bus handler matching rule */
+typedef struct {
+	gint arg;			/**< Argument index, or -1 for path */
+	gchar *value;			/**< Expected value */
+} handler_rule_t;
+
+/** D-Bus handler lookup key */
+typedef struct {
+	guint type;			/**< DBUS_MESSAGE_TYPE */
+	const gchar *interface;		/**< Interface, NULL for errors and
+					 *   member-only lookups */
+	const gchar *name;		/**< Member or error name */
+} handler_key_t;
+
+/** D-Bus handlers sharing the same lookup key */
+typedef struct {
+	handler_key_t key;		/**< Lookup key; strings are owned */
+	GSList *handlers;		/**< Handlers in dispatch order */
+} handler_bucket_t;
+
 /** D-Bus handler structure */
 typedef struct {
 	gboolean (*callback)(DBusMessage *const msg);	/**< Handler callback */
@@ -47,6 +74,9 @@ typedef struct {
 	gchar *rules;			/**< Additional matching rules */
 	gchar *name;			/**< Method call or signal name */
 	guint type;			/**< DBUS_MESSAGE_TYPE */
+	handler_rule_t *rule_tab;	/**< Rules compiled from rules string */
+	guint rule_cnt;			/**< Number of compiled rules */
+	gboolean rule_err;		/**< Rules could not be compiled */
 } handler_struct;
 
 /** Pointer to the DBusConnection */
@@ -442,6 +472,94 @@ EXIT:
 	return status;
 }
 
+/**
+ * D-Bus callback for the flight recorder dump method call
+ *
+ * @param msg The D-Bus message to reply to
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean trace_dump_dbus_cb(DBusMessage *const msg)
+{
+	DBusMessage *reply = NULL;
+	gboolean status = FALSE;
+	gchar *trace = NULL;
+	const gchar *text = "";
+
+	mce_log(LL_DEBUG, "Received trace dump request");
+
+	if( mce_log_recorder_p() ) {
+		if( (trace = mce_log_recorder_to_string()) )
+			text = trace;
+	}
+	else {
+		text = "flight recorder not enabled; "
+			"start mce with --trace=recorder\n";
+	}
+
+	/* Create a reply */
+	reply = dbus_new_method_reply(msg);
+
+	/* Append the formatted trace */
+	if (dbus_message_append_args(reply,
+				     DBUS_TYPE_STRING, &text,
+				     DBUS_TYPE_INVALID) == FALSE) {
+		mce_log(LL_CRIT,
+			"Failed to append reply argument to D-Bus message "
+			"for %s.%s",
+			MCE_REQUEST_IF, MCE_TRACE_DUMP_REQ);
+		dbus_message_unref(reply);
+		goto EXIT;
+	}
+
+	/* Send the message */
+	status = dbus_send_message(reply);
+
+EXIT:
+	g_free(trace);
+	return status;
+}
+
+/**
+ * D-Bus callback for the datapipe statistics method call
+ *
+ * @param msg The D-Bus message to reply to
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean datapipe_stats_get_dbus_cb(DBusMessage *const msg)
+{
+	DBusMessage *reply = NULL;
+	gboolean status = FALSE;
+	gchar *stats = NULL;
+	const gchar *text = "";
+
+	mce_log(LL_DEBUG, "Received datapipe statistics get request");
+
+	if( (stats = datapipe_stats_to_string()) )
+		text = stats;
+
+	/* Create a reply */
+	reply = dbus_new_method_reply(msg);
+
+	/* Append the formatted statistics */
+	if (dbus_message_append_args(reply,
+				     DBUS_TYPE_STRING, &text,
+				     DBUS_TYPE_INVALID) == FALSE) {
+		mce_log(LL_CRIT,
+			"Failed to append reply argument to D-Bus message "
+			"for %s.%s",
+			MCE_REQUEST_IF, MCE_DATAPIPE_STATS_GET);
+		dbus_message_unref(reply);
+		goto EXIT;
+	}
+
+	/* Send the message */
+	status = dbus_send_message(reply);
+
+EXIT:
+	g_free(stats);
+	return status;
+}
+
 /** Helper for appending gconf string list to dbus message
  *
  * @param conf GConfValue of string list type
@@ -1153,11 +1271,13 @@ static gboolean config_set_dbus_cb(DBusMessage *const msg)
 		goto EXIT;
 	}
 
+#ifndef ENABLE_BUILTIN_GCONF
 	/* we changed something */
 	gconf_client_suggest_sync(client, &err);
 	if( err ) {
 		mce_log(LL_ERR, "gconf_client_suggest_sync: %s", err->message);
 	}
+#endif
 
 	if( !(reply = dbus_new_method_reply(msg)) )
 		goto EXIT;
@@ -1193,30 +1313,70 @@ EXIT:
 }
 
 /**
- * D-Bus rule checker
+ * Compare compiled D-Bus rules by argument index
  *
- * @param msg The D-Bus message being checked
- * @param rules The rule string to check against
- * @return TRUE if message matches the rules,
-	   FALSE if not
+ * @param a The first rule
+ * @param b The second rule
+ * @return Less than, equal to, or greater than zero depending on
+ *         whether a refers to an earlier, the same or a later argument
  */
-static gboolean check_rules(DBusMessage *const msg,
-			    const char *rules)
+static gint handler_rule_compare(gconstpointer a, gconstpointer b)
 {
+	const handler_rule_t *ra = a;
+	const handler_rule_t *rb = b;
+
+	return (ra->arg > rb->arg) - (ra->arg < rb->arg);
+}
+
+/**
+ * Release compiled D-Bus rules of a handler
+ *
+ * @param h The D-Bus handler
+ */
+static void handler_rules_free(handler_struct *const h)
+{
+	guint i;
+
+	for (i = 0; i < h->rule_cnt; i++)
+		g_free(h->rule_tab[i].value);
+
+	g_free(h->rule_tab);
+	h->rule_tab = NULL;
+	h->rule_cnt = 0;
+	h->rule_err = FALSE;
+}
+
+/**
+ * Compile the rule string of a D-Bus handler
+ *
+ * Parses "argN='value', path='value'" style rules once, so that
+ * incoming messages can be checked without string parsing
+ *
+ * @param h The D-Bus handler
+ */
+static void handler_rules_compile(handler_struct *const h)
+{
+	const char *rules = h->rules;
+	GArray *tab = g_array_new(FALSE, FALSE, sizeof (handler_rule_t));
+
+	h->rule_tab = NULL;
+	h->rule_cnt = 0;
+	h->rule_err = FALSE;
+
 	if (rules == NULL)
-		return TRUE;
-	rules += strspn(rules, " ");;
+		goto EXIT;
+
+	rules += strspn(rules, " ");
 
 	while (*rules != '\0') {
+		handler_rule_t rule;
 		const char *eq;
 		const char *value;
 		const char *value_end;
-		const char *val = NULL;
 		gboolean quot = FALSE;
 
 		if ((eq = strchr(rules, '=')) == NULL)
-			return FALSE;
-		eq += strspn(eq, " ");
+			goto ERROR;
 
 		if (eq[1] == '\'') {
 			value = eq + 2;
@@ -1228,50 +1388,247 @@ static gboolean check_rules(DBusMessage *const msg,
 		}
 
 		if (value_end == NULL)
-			return FALSE;
+			goto ERROR;
 
 		if (strncmp(rules, "arg", 3) == 0) {
-			int fld = atoi(rules + 3);
+			rule.arg = atoi(rules + 3);
+		} else if (strncmp(rules, "path", 4) == 0) {
+			rule.arg = -1;
+		} else {
+			goto ERROR;
+		}
 
-			DBusMessageIter iter;
+		rule.value = g_strndup(value, value_end - value);
+		g_array_append_val(tab, rule);
 
-			if (dbus_message_iter_init(msg, &iter) == FALSE)
-				return FALSE;
+		rules = value_end + (quot == TRUE ? 1 : 0);
+		rules += strspn(rules, " ");
+
+		if (*rules == ',')
+			rules++;
+		rules += strspn(rules, " ");
+	}
+
+	/* Arguments can then be checked with one forward iteration */
+	g_array_sort(tab, handler_rule_compare);
+	goto EXIT;
+
+ERROR:
+	mce_log(LL_ERR, "unsupported D-Bus matching rule '%s'", h->rules);
+	h->rule_err = TRUE;
+
+EXIT:
+	h->rule_cnt = tab->len;
+	h->rule_tab = (handler_rule_t *)g_array_free(tab, FALSE);
+}
+
+/**
+ * D-Bus rule checker
+ *
+ * @param msg The D-Bus message being checked
+ * @param h The D-Bus handler with compiled rules to check against
+ * @return TRUE if message matches the rules,
+	   FALSE if not
+ */
+static gboolean check_rules(DBusMessage *const msg,
+			    const handler_struct *const h)
+{
+	DBusMessageIter iter;
+	gint pos = -1;
+	guint i;
+
+	if (h->rule_err == TRUE)
+		return FALSE;
 
-			for (; fld; fld--) {
-				if (dbus_message_iter_has_next(&iter) == FALSE)
+	for (i = 0; i < h->rule_cnt; i++) {
+		const handler_rule_t *rule = &h->rule_tab[i];
+		const char *val = NULL;
+
+		if (rule->arg < 0) {
+			val = dbus_message_get_path(msg);
+		} else {
+			if (pos < 0) {
+				if (dbus_message_iter_init(msg, &iter) == FALSE)
+					return FALSE;
+				pos = 0;
+			}
+
+			for (; pos < rule->arg; pos++) {
+				if (dbus_message_iter_next(&iter) == FALSE)
 					return FALSE;
-				dbus_message_iter_next(&iter);
 			}
 
 			if (dbus_message_iter_get_arg_type(&iter) !=
 			    DBUS_TYPE_STRING)
 				return FALSE;
 			dbus_message_iter_get_basic(&iter, &val);
-
-		} else if (strncmp(rules, "path", 4) == 0) {
-			val = dbus_message_get_path(msg);
 		}
 
-		if (((value_end != NULL) &&
-		     ((strncmp(value, val, value_end - value) != 0) ||
-		      (val[value_end - value] != '\0'))) ||
-		    ((value_end == NULL) &&
-		     (strcmp(value, val) != 0)))
+		if ((val == NULL) || (strcmp(rule->value, val) != 0))
 			return FALSE;
+	}
 
-		if (value_end == NULL)
-			break;
+	return TRUE;
+}
 
-		rules = value_end + (quot == TRUE ? 1 : 0);
-		rules += strspn(rules, " ");;
+/**
+ * Hash function for D-Bus handler lookup keys
+ *
+ * @param data The handler_key_t to hash
+ * @return hash value
+ */
+static guint handler_key_hash(gconstpointer data)
+{
+	const handler_key_t *key = data;
+	guint hash = key->type;
 
-		if (*rules == ',')
-			rules++;
-		rules += strspn(rules, " ");;
+	if (key->interface != NULL)
+		hash = hash * 33 + g_str_hash(key->interface);
+
+	if (key->name != NULL)
+		hash = hash * 33 + g_str_hash(key->name);
+
+	return hash;
+}
+
+/**
+ * Equality function for D-Bus handler lookup keys
+ *
+ * @param a The first handler_key_t
+ * @param b The second handler_key_t
+ * @return TRUE if the keys are equal, FALSE otherwise
+ */
+static gboolean handler_key_equal(gconstpointer a, gconstpointer b)
+{
+	const handler_key_t *ka = a;
+	const handler_key_t *kb = b;
+
+	return ((ka->type == kb->type) &&
+		(g_strcmp0(ka->interface, kb->interface) == 0) &&
+		(g_strcmp0(ka->name, kb->name) == 0));
+}
+
+/**
+ * Release a D-Bus handler bucket; for use as GDestroyNotify
+ *
+ * @param data The handler_bucket_t to release
+ */
+static void handler_bucket_free(gpointer data)
+{
+	handler_bucket_t *bucket = data;
+
+	g_slist_free(bucket->handlers);
+	g_free((gchar *)bucket->key.interface);
+	g_free((gchar *)bucket->key.name);
+	g_free(bucket);
+}
+
+/**
+ * Add a D-Bus handler to a lookup table bucket
+ *
+ * @param key The lookup key of the bucket
+ * @param h The D-Bus handler
+ */
+static void handler_lut_insert(const handler_key_t *const key,
+			       handler_struct *const h)
+{
+	handler_bucket_t *bucket;
+
+	if (dbus_handler_lut == NULL) {
+		dbus_handler_lut = g_hash_table_new_full(handler_key_hash,
+							 handler_key_equal,
+							 NULL,
+							 handler_bucket_free);
 	}
 
-	return TRUE;
+	if ((bucket = g_hash_table_lookup(dbus_handler_lut, key)) == NULL) {
+		bucket = g_malloc0(sizeof (*bucket));
+		bucket->key.type = key->type;
+		bucket->key.interface = g_strdup(key->interface);
+		bucket->key.name = g_strdup(key->name);
+		g_hash_table_insert(dbus_handler_lut, &bucket->key, bucket);
+	}
+
+	bucket->handlers = g_slist_prepend(bucket->handlers, h);
+}
+
+/**
+ * Remove a D-Bus handler from a lookup table bucket
+ *
+ * @param key The lookup key of the bucket
+ * @param h The D-Bus handler
+ */
+static void handler_lut_delete(const handler_key_t *const key,
+			       handler_struct *const h)
+{
+	handler_bucket_t *bucket;
+	GSList *iter;
+
+	if (dbus_handler_lut == NULL)
+		goto EXIT;
+
+	if ((bucket = g_hash_table_lookup(dbus_handler_lut, key)) == NULL)
+		goto EXIT;
+
+	if ((iter = g_slist_find(bucket->handlers, h)) == NULL)
+		goto EXIT;
+
+	/* Keep msg_handler() iteration valid */
+	if (iter == msg_handler_iter)
+		msg_handler_iter = iter->next;
+
+	bucket->handlers = g_slist_delete_link(bucket->handlers, iter);
+
+	if (bucket->handlers == NULL)
+		g_hash_table_remove(dbus_handler_lut, &bucket->key);
+
+EXIT:
+	return;
+}
+
+/**
+ * Add a D-Bus handler to the lookup table
+ *
+ * Method call and signal handlers are indexed both by interface and
+ * member, and by member only; the latter is used for messages that
+ * do not specify an interface, as D-Bus treats that as a wildcard.
+ *
+ * @param h The D-Bus handler
+ */
+static void handler_lut_add(handler_struct *const h)
+{
+	handler_key_t key = { h->type, NULL, h->name };
+
+	if (h->type != DBUS_MESSAGE_TYPE_ERROR) {
+		/* Handlers without interface never match any messages */
+		if (h->interface == NULL)
+			goto EXIT;
+
+		handler_lut_insert(&key, h);
+		key.interface = h->interface;
+	}
+
+	handler_lut_insert(&key, h);
+
+EXIT:
+	return;
+}
+
+/**
+ * Remove a D-Bus handler from the lookup table
+ *
+ * @param h The D-Bus handler
+ */
+static void handler_lut_remove(handler_struct *const h)
+{
+	handler_key_t key = { h->type, NULL, h->name };
+
+	if (h->type != DBUS_MESSAGE_TYPE_ERROR) {
+		handler_lut_delete(&key, h);
+		key.interface = h->interface;
+	}
+
+	handler_lut_delete(&key, h);
 }
 
 /**
@@ -1288,40 +1645,63 @@ static DBusHandlerResult msg_handler(DBusConnection *const connection,
 				     gpointer const user_data)
 {
 	guint status = DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+	handler_bucket_t *bucket;
+	handler_key_t key;
 
 	(void)connection;
 	(void)user_data;
 
-	for (msg_handler_iter = dbus_handlers;
-	     msg_handler_iter != NULL;
-	     msg_handler_iter = g_slist_next(msg_handler_iter)) {
+	if (dbus_handler_lut == NULL)
+		goto EXIT;
+
+	key.type = dbus_message_get_type(msg);
+
+	switch (key.type) {
+	case DBUS_MESSAGE_TYPE_METHOD_CALL:
+	case DBUS_MESSAGE_TYPE_SIGNAL:
+		/* Without interface, the member-only bucket is used */
+		key.interface = dbus_message_get_interface(msg);
+		key.name = dbus_message_get_member(msg);
+
+		if (key.name == NULL)
+			goto EXIT;
+		break;
+
+	case DBUS_MESSAGE_TYPE_ERROR:
+		key.interface = NULL;
+		key.name = dbus_message_get_error_name(msg);
+
+		if (key.name == NULL)
+			goto EXIT;
+		break;
+
+	default:
+		goto EXIT;
+	}
+
+	if ((bucket = g_hash_table_lookup(dbus_handler_lut, &key)) == NULL)
+		goto EXIT;
+
+	for (msg_handler_iter = bucket->handlers;
+	     msg_handler_iter != NULL;) {
 		handler_struct *handler = msg_handler_iter->data;
 
+		/* Advance before the callback; it might remove
+		 * handlers, including itself */
+		msg_handler_iter = g_slist_next(msg_handler_iter);
+
 		switch (handler->type) {
 		case DBUS_MESSAGE_TYPE_METHOD_CALL:
-			if (dbus_message_is_method_call(msg,
-							handler->interface,
-							handler->name) == TRUE) {
-				handler->callback(msg);
-				status = DBUS_HANDLER_RESULT_HANDLED;
-				goto EXIT;
-			}
-
-			break;
+			handler->callback(msg);
+			status = DBUS_HANDLER_RESULT_HANDLED;
+			goto EXIT;
 
 		case DBUS_MESSAGE_TYPE_ERROR:
-			if (dbus_message_is_error(msg,
-						  handler->name) == TRUE) {
-				handler->callback(msg);
-			}
-
+			handler->callback(msg);
 			break;
 
 		case DBUS_MESSAGE_TYPE_SIGNAL:
-			if ((dbus_message_is_signal(msg,
-						   handler->interface,
-						   handler->name) == TRUE) &&
-			    (check_rules(msg, handler->rules) == TRUE)) {
+			if (check_rules(msg, handler) == TRUE) {
 				handler->callback(msg);
 			}
 
@@ -1336,6 +1716,8 @@ static DBusHandlerResult msg_handler(DBusConnection *const connection,
 	}
 
 EXIT:
+	msg_handler_iter = NULL;
+
 	return status;
 }
 
@@ -1420,6 +1802,8 @@ gconstpointer mce_dbus_handler_add(const gchar *const interface,
 	h->type = type;
 	h->callback = callback;
 
+	handler_rules_compile(h);
+
 	/* Only register D-Bus matches for signals */
 	if (match != NULL) {
 		dbus_bus_add_match(dbus_connection, match, &error);
@@ -1429,8 +1813,10 @@ gconstpointer mce_dbus_handler_add(const gchar *const interface,
 				"Failed to add D-Bus match '%s' for '%s'; %s",
 				match, h->interface, error.message);
 			dbus_error_free(&error);
+			handler_rules_free(h);
 			g_free(h->interface);
 			g_free(h->rules);
+			g_free(h->name);
 			g_free(h);
 			h = NULL;
 			goto EXIT;
@@ -1438,6 +1824,7 @@ gconstpointer mce_dbus_handler_add(const gchar *const interface,
 	}
 
 	dbus_handlers = g_slist_prepend(dbus_handlers, h);
+	handler_lut_add(h);
 
 EXIT:
 	g_free(match);
@@ -1494,12 +1881,12 @@ void mce_dbus_handler_remove(gconstpointer cookie)
 		/* Don't abort here, since we want to unregister it anyway */
 	}
 
-	if ((iter = g_slist_find(dbus_handlers, h))) {
-		if (iter == msg_handler_iter)
-			msg_handler_iter = iter->next;
-		dbus_handlers = g_slist_remove_link(dbus_handlers, iter);
-	}
+	handler_lut_remove(h);
+
+	if ((iter = g_slist_find(dbus_handlers, h)))
+		dbus_handlers = g_slist_delete_link(dbus_handlers, iter);
 
+	handler_rules_free(h);
 	g_free(h->interface);
 	g_free(h->rules);
 	g_free(h->name);
@@ -1844,6 +2231,22 @@ gboolean mce_dbus_init(const gboolean systembus)
 				 version_get_dbus_cb) == NULL)
 		goto EXIT;
 
+	/* dump_trace */
+	if (mce_dbus_handler_add(MCE_REQUEST_IF,
+				 MCE_TRACE_DUMP_REQ,
+				 NULL,
+				 DBUS_MESSAGE_TYPE_METHOD_CALL,
+				 trace_dump_dbus_cb) == NULL)
+		goto EXIT;
+
+	/* get_datapipe_stats */
+	if (mce_dbus_handler_add(MCE_REQUEST_IF,
+				 MCE_DATAPIPE_STATS_GET,
+				 NULL,
+				 DBUS_MESSAGE_TYPE_METHOD_CALL,
+				 datapipe_stats_get_dbus_cb) == NULL)
+		goto EXIT;
+
 	/* get_config */
 	if (mce_dbus_handler_add(MCE_REQUEST_IF,
 				 MCE_CONFIG_GET,
@@ -1879,6 +2282,11 @@ void mce_dbus_exit(void)
 		dbus_handlers = NULL;
 	}
 
+	if (dbus_handler_lut != NULL) {
+		g_hash_table_destroy(dbus_handler_lut);
+		dbus_handler_lut = NULL;
+	}
+
 	/* If there is an established D-Bus connection, unreference it */
 	if (dbus_connection != NULL) {
 		mce_log(LL_DEBUG, "Unreferencing D-Bus connection");
@@ -30,6 +30,12 @@
 # include <gconf/gconf-client.h>
 #endif
 
+/** Request for dumping the mce-log flight recorder contents */
+#define MCE_TRACE_DUMP_REQ		"dump_trace"
+
+/** Request for datapipe execution statistics */
+#define MCE_DATAPIPE_STATS_GET		"get_datapipe_stats"
+
 DBusConnection *dbus_connection_get(void);
 
 DBusMessage *dbus_new_signal(const gchar *const path,
@@ -58,8 +58,10 @@ gboolean mce_gconf_set_int(const gchar *const key, const gint value)
 		goto EXIT;
 	}
 
+#ifndef ENABLE_BUILTIN_GCONF
 	/* synchronise if possible, ignore errors */
 	gconf_client_suggest_sync(gconf_client, NULL);
+#endif
 
 	status = TRUE;
 
@@ -88,8 +90,10 @@ gboolean mce_gconf_set_string(const gchar *const key, const gchar *const value)
 		goto EXIT;
 	}
 
+#ifndef ENABLE_BUILTIN_GCONF
 	/* synchronise if possible, ignore errors */
 	gconf_client_suggest_sync(gconf_client, NULL);
+#endif
 
 	status = TRUE;
 
@@ -418,6 +422,9 @@ void mce_gconf_exit(void)
 			gconf_notifiers = NULL;
 		}
 #ifdef ENABLE_BUILTIN_GCONF
+		/* Write out changes still waiting for write-behind */
+		gconf_client_suggest_sync(gconf_client, NULL);
+
 		/* FIME: did not notice that gconf clients are GObjects ...
 		 *       now we can't g_object_unref() the client pointers
 		 *       from builtin-gconf
@@ -61,6 +61,12 @@ typedef struct
   float   value; // sensor data from android side
 } evepipe_t;
 
+/** Maximum number of sensor events handled per pipe read */
+#define EVEPIPE_READ_MAX 64
+
+/** PS distance at or below which the sensor is considered covered [cm] */
+#define EVEPIPE_PS_COVERED_DISTANCE 2.0f
+
 /** Initialize once flag for sensor data pipe */
 static bool evepipe_done = false;
 
@@ -70,6 +76,12 @@ static mce_hybris_ps_fn  evepipe_ps_cb  = 0;
 /** Callback for handling ambient light data */
 static mce_hybris_als_fn evepipe_als_cb = 0;
 
+/** Callback for handling batches of proximity data */
+static mce_sensor_batch_fn evepipe_ps_batch_cb  = 0;
+
+/** Callback for handling batches of ambient light data */
+static mce_sensor_batch_fn evepipe_als_batch_cb = 0;
+
 /** The sensor data pipe */
 static int               evepipe_fd[2]  = { -1, -1 };
 
@@ -93,7 +105,11 @@ static gboolean evepipe_recv_cb(GIOChannel *channel,
 
   gboolean keep_going = TRUE;
 
-  evepipe_t eve[64];
+  evepipe_t eve[EVEPIPE_READ_MAX];
+
+  mce_sensor_sample_t ps[EVEPIPE_READ_MAX];
+  mce_sensor_sample_t als[EVEPIPE_READ_MAX];
+  unsigned ps_cnt = 0, als_cnt = 0;
 
   int rc = read(evepipe_fd[0], eve, sizeof eve);
 
@@ -113,18 +129,27 @@ static gboolean evepipe_recv_cb(GIOChannel *channel,
 
   rc /= sizeof *eve;
 
+  /* Demux events in to per sensor batches; android time stamps
+   * are in nanoseconds, the sample stream uses microseconds */
   for( int i = 0; i < rc; ++i ) {
     switch( eve[i].type ) {
     case EVEPIPE_PS:
       if( evepipe_ps_cb ) {
         evepipe_ps_cb(eve[i].time, eve[i].value);
       }
+      ps[ps_cnt].timestamp = (uint64_t)eve[i].time / 1000;
+      ps[ps_cnt].value = eve[i].value <= EVEPIPE_PS_COVERED_DISTANCE;
+      ++ps_cnt;
       break;
 
     case EVEPIPE_ALS:
       if( evepipe_als_cb ) {
         evepipe_als_cb(eve[i].time, eve[i].value);
       }
+      als[als_cnt].timestamp = (uint64_t)eve[i].time / 1000;
+      als[als_cnt].value = (eve[i].value <= 0) ? 0 :
+        (unsigned)(eve[i].value + 0.5f);
+      ++als_cnt;
       break;
 
     default:
@@ -132,6 +157,14 @@ static gboolean evepipe_recv_cb(GIOChannel *channel,
     }
   }
 
+  if( ps_cnt && evepipe_ps_batch_cb ) {
+    evepipe_ps_batch_cb(ps, ps_cnt);
+  }
+
+  if( als_cnt && evepipe_als_batch_cb ) {
+    evepipe_als_batch_cb(als, als_cnt);
+  }
+
 cleanup:
 
   if( !keep_going )  {
@@ -544,6 +577,7 @@ void mce_hybris_ps_quit(void)
   static void (*real)(void) = 0;
   RESOLVE;
   evepipe_ps_cb = 0;
+  evepipe_ps_batch_cb = 0;
   if( real ) real();
 }
 
@@ -573,20 +607,15 @@ static void mce_hybris_ps_set_hook(mce_hybris_ps_fn cb)
   if( real ) real(cb);
 }
 
-/** Set proximity sensor event reporting callback
- *
- * Note: the callback will be called from the same context where
- *       glib mainloop is running
- *
- * @param cb callback plugin should use to send events to application code
+/** Install or remove the PS hook depending on reporting callbacks
  *
  * @return true on success, or false on failure
  */
-bool mce_hybris_ps_set_callback(mce_hybris_ps_fn cb)
+static bool mce_hybris_ps_update_hook(void)
 {
   bool res = true;
 
-  if( (evepipe_ps_cb = cb) ) {
+  if( evepipe_ps_cb || evepipe_ps_batch_cb ) {
     mce_hybris_ps_set_hook(evepipe_send_ps);
     res = evepipe_init();
   }
@@ -597,6 +626,39 @@ bool mce_hybris_ps_set_callback(mce_hybris_ps_fn cb)
   return res;
 }
 
+/** Set proximity sensor event reporting callback
+ *
+ * Note: the callback will be called from the same context where
+ *       glib mainloop is running
+ *
+ * @param cb callback plugin should use to send events to application code
+ *
+ * @return true on success, or false on failure
+ */
+bool mce_hybris_ps_set_callback(mce_hybris_ps_fn cb)
+{
+  evepipe_ps_cb = cb;
+  return mce_hybris_ps_update_hook();
+}
+
+/** Set proximity sensor sample batch reporting callback
+ *
+ * All PS events read from the sensor data pipe in one go are passed
+ * to the callback as a single batch, oldest first.
+ *
+ * Note: the callback will be called from the same context where
+ *       glib mainloop is running
+ *
+ * @param cb callback for receiving sample batches, or NULL to disable
+ *
+ * @return true on success, or false on failure
+ */
+bool mce_hybris_ps_set_batch_callback(mce_sensor_batch_fn cb)
+{
+  evepipe_ps_batch_cb = cb;
+  return mce_hybris_ps_update_hook();
+}
+
 /* ------------------------------------------------------------------------- *
  * ambient light sensor
  * ------------------------------------------------------------------------- */
@@ -619,6 +681,7 @@ void mce_hybris_als_quit(void)
   static void (*real)(void) = 0;
   RESOLVE;
   evepipe_als_cb = 0;
+  evepipe_als_batch_cb = 0;
   if( real ) real();
 }
 
@@ -648,20 +711,15 @@ static void mce_hybris_als_set_hook(mce_hybris_als_fn cb)
   if( real ) real(cb);
 }
 
-/** Set ambient light sensor event reporting callback
- *
- * Note: the callback will be called from the same context where
- *       glib mainloop is running
- *
- * @param cb callback plugin should use to send events to application code
+/** Install or remove the ALS hook depending on reporting callbacks
  *
  * @return true on success, or false on failure
  */
-bool mce_hybris_als_set_callback(mce_hybris_als_fn cb)
+static bool mce_hybris_als_update_hook(void)
 {
   bool res = true;
 
-  if( (evepipe_als_cb = cb) ) {
+  if( evepipe_als_cb || evepipe_als_batch_cb ) {
     mce_hybris_als_set_hook(evepipe_send_als);
     res = evepipe_init();
   }
@@ -671,3 +729,36 @@ bool mce_hybris_als_set_callback(mce_hybris_als_fn cb)
 
   return res;
 }
+
+/** Set ambient light sensor event reporting callback
+ *
+ * Note: the callback will be called from the same context where
+ *       glib mainloop is running
+ *
+ * @param cb callback plugin should use to send events to application code
+ *
+ * @return true on success, or false on failure
+ */
+bool mce_hybris_als_set_callback(mce_hybris_als_fn cb)
+{
+  evepipe_als_cb = cb;
+  return mce_hybris_als_update_hook();
+}
+
+/** Set ambient light sensor sample batch reporting callback
+ *
+ * All ALS events read from the sensor data pipe in one go are passed
+ * to the callback as a single batch, oldest first.
+ *
+ * Note: the callback will be called from the same context where
+ *       glib mainloop is running
+ *
+ * @param cb callback for receiving sample batches, or NULL to disable
+ *
+ * @return true on success, or false on failure
+ */
+bool mce_hybris_als_set_batch_callback(mce_sensor_batch_fn cb)
+{
+  evepipe_als_batch_cb = cb;
+  return mce_hybris_als_update_hook();
+}
@@ -19,6 +19,11 @@
 # include <stdbool.h>
 # include <stdint.h>
 
+/* The sample batch api is mce side only; the plugin does not need it */
+# if MCE_HYBRIS_INTERNAL < 2
+#  include "mce-sensor.h"
+# endif
+
 # ifdef __cplusplus
 extern "C" {
 # elif 0
@@ -67,6 +72,9 @@ bool mce_hybris_ps_init(void);
 void mce_hybris_ps_quit(void);
 bool mce_hybris_ps_set_active(bool active);
 bool mce_hybris_ps_set_callback(mce_hybris_ps_fn cb);
+# if MCE_HYBRIS_INTERNAL < 2
+bool mce_hybris_ps_set_batch_callback(mce_sensor_batch_fn cb);
+# endif
 
 /* - - - - - - - - - - - - - - - - - - - *
  * ambient light sensor
@@ -78,6 +86,9 @@ bool mce_hybris_als_init(void);
 void mce_hybris_als_quit(void);
 bool mce_hybris_als_set_active(bool active);
 bool mce_hybris_als_set_callback(mce_hybris_als_fn cb);
+# if MCE_HYBRIS_INTERNAL < 2
+bool mce_hybris_als_set_batch_callback(mce_sensor_batch_fn cb);
+# endif
 
 /* - - - - - - - - - - - - - - - - - - - *
  * generic
@@ -25,11 +25,12 @@
 #include <fcntl.h>			/* open(), O_RDONLY */
 #include <stdio.h>			/* fopen(), fscanf(), fseek(),
                                          * fclose(), fprintf(), fileno(),
-					 * fflush()
+					 * fputs(), fflush(), snprintf()
 					 */
 #include <stdlib.h>			/* exit(), strtoul(), EXIT_FAILURE */
-#include <string.h>			/* strlen() */
-#include <unistd.h>			/* close(), read(), ftruncate() */
+#include <string.h>			/* strlen(), strcmp() */
+#include <unistd.h>			/* close(), read(), pwrite(),
+					 * ftruncate() */
 
 #include "mce.h"
 #include "mce-io.h"
@@ -68,8 +69,22 @@ typedef struct {
 	gboolean suspended;			/**< Is the I/O monitor
 						 *   suspended? */
 	gboolean seekable;			/**< is the I/O channel seekable */
+	gchar *chunk_buffer;			/**< Read buffer for chunks */
+	gsize chunk_buffer_size;		/**< Size of chunk_buffer */
+	gboolean drain;				/**< Read until no more data
+						 *   is available */
+	gboolean dispatching;			/**< Chunk callbacks are
+						 *   being made */
+	gboolean unregistered;			/**< Unregistered while
+						 *   dispatching */
 } iomon_struct;
 
+/** Default read buffer size for chunk I/O monitors */
+#define IOMON_CHUNK_BUFFER_SIZE			4096
+
+/** Maximum number of reads done from a draining I/O monitor per wakeup */
+#define IOMON_DRAIN_READS_MAX			16
+
 /** Suffix used for temporary files */
 #define TMP_SUFFIX				".tmp"
 
@@ -425,10 +440,34 @@ EXIT:
 	return status;
 }
 
+/**
+ * Close file stream and/or descriptor associated with output
+ *
+ * @param output control structure for writing to a file
+ */
+static void mce_close_output_files(output_state_t *output)
+{
+	if( output->file ) {
+		if( fclose(output->file) == EOF ) {
+			mce_log(LL_WARN,"%s: can't close %s: %m", output->context, output->path);
+		}
+		output->file = 0;
+	}
+
+	if( output->fd_open ) {
+		if( close(output->fd) == -1 ) {
+			mce_log(LL_WARN,"%s: can't close %s: %m", output->context, output->path);
+		}
+		output->fd = -1;
+		output->fd_open = FALSE;
+	}
+}
+
 /**
  * Cleanup function for output file control structures
  *
- * Closes file stream associated with output if it is open
+ * Closes file stream and/or descriptor associated with output if
+ * they are open and forgets the last written value
  *
  * It is explicitly permitted to call this function:
  * 1) with NULL output parameter
@@ -440,28 +479,126 @@ EXIT:
 
 void mce_close_output(output_state_t *output)
 {
-	if( output && output->file ) {
-		if( fclose(output->file) == EOF ) {
-			mce_log(LL_WARN,"%s: can't close %s: %m", output->context, output->path);
+	if( !output )
+		goto EXIT;
+
+	mce_close_output_files(output);
+
+	g_free(output->cached_value);
+	output->cached_value = 0;
+	output->value_cached = FALSE;
+
+EXIT:
+	return;
+}
+
+/**
+ * Write a string via stdio stream
+ *
+ * @param output control structure for writing to a file
+ * @param string The string to write
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean mce_write_output_stdio(output_state_t *output,
+				       const gchar *string)
+{
+	gboolean status = FALSE; // assume failure
+
+	if( !output->file ) {
+		output->file = fopen(output->path, output->truncate_file ? "w" : "a");
+		if( !output->file ) {
+			mce_log(LL_ERR,"%s: can't open %s: %m", output->context, output->path);
+			goto EXIT;
+		}
+	}
+	else if( output->truncate_file )
+	{
+		rewind(output->file);
+		if( ftruncate(fileno(output->file), 0) == -1 ) {
+			mce_log(LL_WARN,"%s: can't truncate %s: %m", output->context, output->path);
 		}
-		output->file = 0;
 	}
+
+	// from now on assume success
+	status = TRUE;
+
+	if( fputs(string, output->file) == EOF ) {
+		mce_log(LL_WARN,"%s: can't write %s: %m", output->context, output->path);
+		status = FALSE;
+	}
+
+	if( fflush(output->file) == EOF ) {
+		mce_log(LL_WARN,"%s: can't flush %s: %m", output->context, output->path);
+		status = FALSE;
+	}
+
+EXIT:
+	return status;
 }
 
 /**
- * Write a string representation of a number to a file
+ * Write a string via raw file descriptor
+ *
+ * The string is written with one pwrite() to the start of the file.
+ * Sysfs attributes take each write as the whole new value, so nothing
+ * is done about possible left-overs from longer values.
+ *
+ * @param output control structure for writing to a file
+ * @param string The string to write
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean mce_write_output_pwrite(output_state_t *output,
+					const gchar *string)
+{
+	gboolean status = FALSE; // assume failure
+	size_t   size   = strlen(string);
+	ssize_t  done;
+
+	if( !output->fd_open ) {
+		int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+
+		if( output->truncate_file )
+			flags |= O_TRUNC;
+
+		output->fd = open(output->path, flags, 0666);
+		if( output->fd == -1 ) {
+			mce_log(LL_ERR,"%s: can't open %s: %m", output->context, output->path);
+			goto EXIT;
+		}
+		output->fd_open = TRUE;
+	}
+
+	if( (done = pwrite(output->fd, string, size, 0)) == -1 ) {
+		mce_log(LL_WARN,"%s: can't write %s: %m", output->context, output->path);
+		goto EXIT;
+	}
+
+	if( (size_t)done != size ) {
+		mce_log(LL_WARN,"%s: partial write to %s", output->context, output->path);
+		goto EXIT;
+	}
+
+	status = TRUE;
+
+EXIT:
+	return status;
+}
+
+/**
+ * Write a string to an output file
  *
  * Note: this variant uses in-place rewrites when truncating.
  * It should thus not be used in cases where atomicity is expected.
- * For atomic replace, use mce_write_number_string_to_file_atomic()
  *
  * @param output control structure for writing to a file
- * @param number The number to write
+ * @param string The string to write
  *
  * @return TRUE on success, FALSE on failure
  */
-
-gboolean mce_write_number_string_to_file(output_state_t *output, const gulong number)
+gboolean mce_write_string_to_output(output_state_t *output,
+				    const gchar *string)
 {
 	gboolean status = FALSE; // assume failure
 
@@ -483,41 +620,174 @@ gboolean mce_write_number_string_to_file(output_state_t *output, const gulong nu
 		goto EXIT;
 	}
 
-	if( !output->file ) {
-		output->file = fopen(output->path, output->truncate_file ? "w" : "a");
-		if( !output->file ) {
-			mce_log(LL_ERR,"%s: can't open %s: %m", output->context, output->path);
-			goto EXIT;
-		}
-	}
-	else if( output->truncate_file )
-	{
-		rewind(output->file);
-		if( ftruncate(fileno(output->file), 0) == -1 ) {
-			mce_log(LL_WARN,"%s: can't truncate %s: %m", output->context, output->path);
-		}
+	if( output->skip_unchanged && output->value_cached &&
+	    !strcmp(output->cached_value, string) ) {
+		status = TRUE;
+		goto EXIT;
 	}
 
-	// from now on assume success
-	status = TRUE;
+	if( output->use_pwrite )
+		status = mce_write_output_pwrite(output, string);
+	else
+		status = mce_write_output_stdio(output, string);
 
-	if( fprintf(output->file, "%lu", number) < 0 ) {
-		mce_log(LL_WARN,"%s: can't write %s: %m", output->context, output->path);
-		status = FALSE;
+	if( output->skip_unchanged ) {
+		g_free(output->cached_value);
+		output->cached_value = g_strdup(string);
+		output->value_cached = status;
 	}
 
-	if( fflush(output->file) == EOF ) {
-		mce_log(LL_WARN,"%s: can't flush %s: %m", output->context, output->path);
-		status = FALSE;
-	}
+	/* A failed write leaves the file in unknown state; reopen it
+	 * on the next write attempt */
+	if( !status )
+		mce_close_output(output);
 
 EXIT:
 
-	if( output->close_on_exit && output->file ) {
-		if( fclose(output->file) == EOF ) {
-			mce_log(LL_WARN,"%s: can't close %s: %m", output->context, output->path);
+	if( output->close_on_exit )
+		mce_close_output_files(output);
+
+	return status;
+}
+
+/**
+ * Write a string representation of a number to a file
+ *
+ * Note: this variant uses in-place rewrites when truncating.
+ * It should thus not be used in cases where atomicity is expected.
+ * For atomic replace, use mce_write_number_string_to_file_atomic()
+ *
+ * @param output control structure for writing to a file
+ * @param number The number to write
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+
+gboolean mce_write_number_string_to_file(output_state_t *output, const gulong number)
+{
+	char data[32];
+
+	snprintf(data, sizeof data, "%lu", number);
+
+	return mce_write_string_to_output(output, data);
+}
+
+/** Sequence of output writes to be made as one transaction */
+struct mce_output_batch_t
+{
+	/** output_state_t objects to write, in order */
+	GPtrArray *output;
+	/** Values to write, one per output entry */
+	GPtrArray *value;
+};
+
+/**
+ * Create an empty output write transaction
+ *
+ * @return transaction object; release with mce_output_batch_delete()
+ */
+mce_output_batch_t *mce_output_batch_create(void)
+{
+	mce_output_batch_t *self = g_malloc0(sizeof *self);
+
+	self->output = g_ptr_array_new();
+	self->value  = g_ptr_array_new();
+
+	return self;
+}
+
+/**
+ * Delete output write transaction
+ *
+ * @param self transaction object, or NULL
+ */
+void mce_output_batch_delete(mce_output_batch_t *self)
+{
+	guint i;
+
+	if( self ) {
+		for( i = 0; i < self->value->len; ++i )
+			g_free(g_ptr_array_index(self->value, i));
+		g_ptr_array_free(self->output, TRUE);
+		g_ptr_array_free(self->value, TRUE);
+		g_free(self);
+	}
+}
+
+/**
+ * Append output write to output write transaction
+ *
+ * Writes are made in the order they are added.  The same output
+ * can be written several times, e.g. to step through modes.
+ *
+ * @param self transaction object
+ * @param output control structure for writing to a file;
+ *               outputs without a path are ignored
+ * @param value The string to write
+ */
+void mce_output_batch_add(mce_output_batch_t *self,
+			  output_state_t *output, const gchar *value)
+{
+	if( !output->path || !value )
+		return;
+
+	g_ptr_array_add(self->output, output);
+	g_ptr_array_add(self->value, g_strdup(value));
+}
+
+/**
+ * Check if committing a transaction would leave outputs unchanged
+ *
+ * This is the case when every output in the transaction is known to
+ * hold the last value the transaction would write to it, which
+ * requires the outputs to be in skip_unchanged mode.
+ *
+ * @param self transaction object
+ *
+ * @return TRUE if the transaction can be skipped, FALSE otherwise
+ */
+gboolean mce_output_batch_is_current(const mce_output_batch_t *self)
+{
+	guint i, k;
+
+	for( i = 0; i < self->output->len; ++i ) {
+		const output_state_t *output = g_ptr_array_index(self->output, i);
+		const gchar *value = g_ptr_array_index(self->value, i);
+
+		/* Only the last write to each output matters */
+		for( k = i + 1; k < self->output->len; ++k ) {
+			if( g_ptr_array_index(self->output, k) == output )
+				break;
 		}
-		output->file = 0;
+		if( k < self->output->len )
+			continue;
+
+		if( !output->value_cached || strcmp(output->cached_value, value) )
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Make all output writes in a transaction
+ *
+ * All writes are attempted even if some of them fail. Writes to
+ * outputs in skip_unchanged mode are skipped as usual.
+ *
+ * @param self transaction object
+ *
+ * @return TRUE if all writes succeeded, FALSE otherwise
+ */
+gboolean mce_output_batch_commit(mce_output_batch_t *self)
+{
+	gboolean status = TRUE;
+	guint i;
+
+	for( i = 0; i < self->output->len; ++i ) {
+		if( !mce_write_string_to_output(g_ptr_array_index(self->output, i),
+						g_ptr_array_index(self->value, i)) )
+			status = FALSE;
 	}
 
 	return status;
@@ -730,6 +1000,58 @@ static const char *io_status_name(GIOStatus io_status)
 	return status_name;
 }
 
+/**
+ * Release I/O monitor resources
+ *
+ * @param iomon The I/O monitor; must already be unregistered
+ */
+static void mce_io_monitor_free(iomon_struct *iomon)
+{
+	g_io_channel_unref(iomon->iochan);
+	g_free(iomon->chunk_buffer);
+	g_free(iomon->file);
+	g_slice_free(iomon_struct, iomon);
+}
+
+#ifdef ENABLE_WAKELOCKS
+/** Idle callback id for releasing the input wakelock */
+static guint io_input_wakelock_id = 0;
+
+/**
+ * Release the input wakelock once the main loop goes idle
+ *
+ * @param aptr Unused
+ * @return FALSE to remove the idle callback
+ */
+static gboolean io_input_wakelock_release_cb(gpointer aptr)
+{
+	(void)aptr;
+
+	io_input_wakelock_id = 0;
+	wakelock_unlock("mce_input_handler");
+
+	return FALSE;
+}
+
+/**
+ * Block suspend until the main loop goes idle
+ *
+ * I/O watches have higher priority than idle callbacks, so the lock
+ * is held over a burst of input wakeups and released once the burst -
+ * including processing deferred to idle callbacks queued before the
+ * release - has been handled. Relocking an already held lock does not
+ * cause sysfs writes.
+ */
+static void io_input_wakelock_hold(void)
+{
+	wakelock_lock("mce_input_handler", -1);
+
+	if (!io_input_wakelock_id)
+		io_input_wakelock_id = g_idle_add(io_input_wakelock_release_cb,
+						  NULL);
+}
+#endif
+
 /**
  * Callback for successful chunk I/O
  *
@@ -745,13 +1067,15 @@ static gboolean io_chunk_cb(GIOChannel *source,
 {
 	iomon_struct *iomon = data;
 	gchar *buffer = NULL;
-	gsize bytes_want = 4096;
+	gsize bytes_want = 0;
 	gsize bytes_read = 0;
 	gsize chunks_read = 0;
 	gsize chunks_done = 0;
-	GIOStatus io_status;
+	GIOStatus io_status = G_IO_STATUS_NORMAL;
 	GError *error = NULL;
 	gboolean status = TRUE;
+	gboolean skipped = FALSE;
+	gint reads = 0;
 
 	/* Silence warnings */
 	(void)condition;
@@ -779,64 +1103,84 @@ static gboolean io_chunk_cb(GIOChannel *source,
 		g_clear_error(&error);
 	}
 
-	if( iomon->chunk_size < bytes_want ) {
-		bytes_want -= bytes_want % iomon->chunk_size;
-	} else {
-		bytes_want = iomon->chunk_size;
-	}
-
-	buffer = g_malloc(bytes_want);
+	buffer = iomon->chunk_buffer;
+	bytes_want = iomon->chunk_buffer_size;
 
 #ifdef ENABLE_WAKELOCKS
 	/* Since the locks on kernel side are released once all
 	 * events are read, we must obtain the userspace lock
 	 * before reading the available data */
-	wakelock_lock("mce_input_handler", -1);
+	io_input_wakelock_hold();
 #endif
 
-	io_status = g_io_channel_read_chars(source, buffer,
-					    bytes_want, &bytes_read, &error);
-
+	/* Callbacks might unregister the I/O monitor; freeing
+	 * it - and the buffer we are processing - is deferred
+	 * until we are done with it */
+	iomon->dispatching = TRUE;
 
-	/* If the read was interrupted, ignore */
-	if (io_status == G_IO_STATUS_AGAIN) {
-		g_clear_error(&error);
-	}
+	/* When draining, keep reading as long as the buffer gets filled
+	 * up - a short read means the kernel side queue is empty */
+	do {
+		bytes_read = chunks_read = chunks_done = 0;
 
-	if( bytes_read % iomon->chunk_size ) {
-		mce_log(LL_WARN, "Incomplete chunks read from: %s", iomon->file);
-	}
+		io_status = g_io_channel_read_chars(source, buffer,
+						    bytes_want, &bytes_read,
+						    &error);
+		++reads;
 
-	/* Process the data, and optionally ignore some of it */
-	if( (chunks_read = bytes_read / iomon->chunk_size) ) {
-		gchar *chunk = buffer;
-		for( ; chunks_done < chunks_read ; chunk += iomon->chunk_size ) {
-			++chunks_done;
-			if (iomon->callback(chunk, iomon->chunk_size) != TRUE) {
-				continue;
-			}
-			/* if possible, seek to the end of file */
-			if (iomon->seekable) {
-				g_io_channel_seek_position(iomon->iochan, 0,
-							   G_SEEK_END, &error);
-			}
-			/* in any case ignore rest of the data already read */
-			break;
+		/* If the read was interrupted, ignore */
+		if (io_status == G_IO_STATUS_AGAIN) {
+			g_clear_error(&error);
 		}
-	}
-
-	mce_log(LL_INFO, "%s: status=%s, data=%d/%d=%d+%d, skipped=%d",
-		iomon->file, io_status_name(io_status),
-		bytes_read, (int)iomon->chunk_size, chunks_read,
-		bytes_read % (int)iomon->chunk_size, chunks_read - chunks_done);
 
-#ifdef ENABLE_WAKELOCKS
-	/* Release the lock after we're done with processing it */
-	wakelock_unlock("mce_input_handler");
-#endif
+		if( bytes_read % iomon->chunk_size ) {
+			mce_log(LL_WARN, "Incomplete chunks read from: %s",
+				iomon->file);
+		}
 
+		/* Process the data, and optionally ignore some of it */
+		if( (chunks_read = bytes_read / iomon->chunk_size) ) {
+			gchar *chunk = buffer;
+			for( ; chunks_done < chunks_read ; chunk += iomon->chunk_size ) {
+				++chunks_done;
+				gboolean skip = iomon->callback(chunk,
+								iomon->chunk_size);
+				if (iomon->unregistered) {
+					skipped = TRUE;
+					break;
+				}
+				if (skip != TRUE) {
+					continue;
+				}
+				/* if possible, seek to the end of file */
+				if (iomon->seekable) {
+					g_io_channel_seek_position(iomon->iochan, 0,
+								   G_SEEK_END, &error);
+				}
+				/* in any case ignore rest of the data already read */
+				skipped = TRUE;
+				break;
+			}
+		}
 
-	g_free(buffer);
+		mce_log(LL_INFO, "%s: status=%s, data=%d/%d=%d+%d, skipped=%d",
+			iomon->file, io_status_name(io_status),
+			bytes_read, (int)iomon->chunk_size, chunks_read,
+			bytes_read % (int)iomon->chunk_size,
+			chunks_read - chunks_done);
+	} while( iomon->drain && !skipped && !error &&
+		 io_status == G_IO_STATUS_NORMAL &&
+		 bytes_read == bytes_want &&
+		 reads < IOMON_DRAIN_READS_MAX );
+
+	iomon->dispatching = FALSE;
+
+	/* Finish unregistering made from a callback */
+	if (iomon->unregistered) {
+		mce_io_monitor_free(iomon), iomon = NULL;
+		g_clear_error(&error);
+		goto EXIT;
+	}
 
 	/* Were there any errors? */
 	if (error != NULL) {
@@ -864,7 +1208,7 @@ static gboolean io_chunk_cb(GIOChannel *source,
 		 */
 		errno = 0;
 		g_clear_error(&error);
-	} else if ((bytes_read == 0) &&
+	} else if ((bytes_read == 0) && (reads == 1) &&
 		   (io_status != G_IO_STATUS_EOF) &&
 		   (io_status != G_IO_STATUS_AGAIN)) {
 		mce_log(LL_ERR,
@@ -1162,6 +1506,11 @@ static iomon_struct *mce_register_io_monitor(const gint fd,
 	iomon->rewind = FALSE;
 	iomon->chunk_size = 0;
 	iomon->err_callback = 0;
+	iomon->chunk_buffer = NULL;
+	iomon->chunk_buffer_size = 0;
+	iomon->drain = FALSE;
+	iomon->dispatching = FALSE;
+	iomon->unregistered = FALSE;
 
 	mce_determine_io_monitor_seekable(iomon);
 
@@ -1263,6 +1612,16 @@ gconstpointer mce_register_io_monitor_chunk(const gint fd,
 	/* Set the read chunk size */
 	iomon->chunk_size = chunk_size;
 
+	/* Allocate a read buffer holding as many whole chunks as fit
+	 * in the default size, or at least one chunk */
+	if (chunk_size < IOMON_CHUNK_BUFFER_SIZE) {
+		iomon->chunk_buffer_size = (IOMON_CHUNK_BUFFER_SIZE -
+					    IOMON_CHUNK_BUFFER_SIZE % chunk_size);
+	} else {
+		iomon->chunk_buffer_size = chunk_size;
+	}
+	iomon->chunk_buffer = g_malloc(iomon->chunk_buffer_size);
+
 	/* Verify that the rewind policy is sane */
 	if (iomon->seekable) {
 		/* Set the rewind policy */
@@ -1368,9 +1727,11 @@ void mce_unregister_io_monitor(gconstpointer io_monitor)
 		g_clear_error(&error);
 	}
 
-	g_io_channel_unref(iomon->iochan);
-	g_free(iomon->file);
-	g_slice_free(iomon_struct, iomon);
+	/* Defer freeing if called from io_chunk_cb() callback */
+	if (iomon->dispatching)
+		iomon->unregistered = TRUE;
+	else
+		mce_io_monitor_free(iomon);
 
 EXIT:
 	return;
@@ -1392,6 +1753,26 @@ void mce_set_io_monitor_err_cb(gconstpointer io_monitor, iomon_err_cb err_cb)
 	}
 }
 
+/**
+ * Set drain policy for chunk I/O monitor
+ *
+ * When enabled, the monitor keeps reading on each wakeup for as long
+ * as the read buffer gets filled up, so that a burst of input larger
+ * than the buffer is processed with one main loop dispatch.
+ *
+ * @param io_monitor A pointer to the I/O monitor
+ * @param drain TRUE to read until no more data is available,
+ *              FALSE to do one read per wakeup
+ */
+void mce_set_io_monitor_drain(gconstpointer io_monitor, gboolean drain)
+{
+	iomon_struct *iomon = (iomon_struct *)io_monitor;
+
+	if (iomon) {
+		iomon->drain = drain;
+	}
+}
+
 /**
  * Return the name of the monitored file
  *
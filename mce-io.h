@@ -55,6 +55,16 @@ typedef struct {
 	 *  FALSE to leave the file open */
 	gboolean close_on_exit;
 
+	/** TRUE to write via raw file descriptor with a single pwrite()
+	 *  to offset zero instead of stdio; meant for sysfs attributes,
+	 *  where each write replaces the whole value */
+	gboolean use_pwrite;
+
+	/** TRUE to skip writing the value that was written last; only
+	 *  for outputs that are not changed by anything else, and where
+	 *  rewriting the same value has no side effects */
+	gboolean skip_unchanged;
+
 	/* runtime configuration */
 
 	/** Path to the file, or NULL (in which case one misconfiguration
@@ -66,11 +76,28 @@ typedef struct {
 	/** Cached output stream, use mce_close_output() to close */
 	FILE *file;
 
+	/** Cached file descriptor for use_pwrite mode; valid if fd_open
+	 *  is set, use mce_close_output() to close */
+	int fd;
+
+	/** TRUE if fd is open */
+	gboolean fd_open;
+
+	/** Value last successfully written in skip_unchanged mode; valid
+	 *  if value_cached is set, released by mce_close_output() */
+	gchar *cached_value;
+
+	/** TRUE if cached_value holds the current file content */
+	gboolean value_cached;
+
 	/** TRUE if missing path configuration error has already been
 	 *  written for this file */
 	gboolean invalid_config_reported;
 } output_state_t;
 
+/** Sequence of output writes, see mce_output_batch_create() */
+typedef struct mce_output_batch_t mce_output_batch_t;
+
 /** Function pointer for I/O monitor callback */
 typedef gboolean (*iomon_cb)(gpointer data, gsize bytes_read);
 /** Function pointer for I/O monitor error callback */
@@ -87,7 +114,15 @@ gboolean mce_read_number_string_from_file(const gchar *const file,
 gboolean mce_write_string_to_file(const gchar *const file,
 				  const gchar *const string);
 void mce_close_output(output_state_t *output);
+gboolean mce_write_string_to_output(output_state_t *output,
+				    const gchar *string);
 gboolean mce_write_number_string_to_file(output_state_t *output, const gulong number);
+mce_output_batch_t *mce_output_batch_create(void);
+void mce_output_batch_delete(mce_output_batch_t *self);
+void mce_output_batch_add(mce_output_batch_t *self,
+			  output_state_t *output, const gchar *value);
+gboolean mce_output_batch_is_current(const mce_output_batch_t *self);
+gboolean mce_output_batch_commit(mce_output_batch_t *self);
 gboolean mce_write_number_string_to_file_atomic(const gchar *const file,
 						const gulong number);
 void mce_suspend_io_monitor(gconstpointer io_monitor);
@@ -106,6 +141,7 @@ gconstpointer mce_register_io_monitor_chunk(const gint fd,
 					    iomon_cb callback,
 					    gulong chunk_size);
 void mce_set_io_monitor_err_cb(gconstpointer io_monitor, iomon_err_cb err_cb);
+void mce_set_io_monitor_drain(gconstpointer io_monitor, gboolean drain);
 void mce_unregister_io_monitor(gconstpointer io_monitor);
 const gchar *mce_get_io_monitor_name(gconstpointer io_monitor);
 int mce_get_io_monitor_fd(gconstpointer io_monitor);
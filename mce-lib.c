@@ -23,6 +23,7 @@
 
 #include <stdio.h>			/* sscanf() */
 #include <string.h>			/* strcmp() */
+#include <time.h>			/* clock_gettime() */
 
 #include "mce.h"                        /* MCE_INVALID_TRANSLATION */
 #include "mce-lib.h"                    /* mce_translation_t */
@@ -359,3 +360,17 @@ gboolean strmemcmp(guint8 *mem, const gchar *str, gulong len)
 EXIT:
 	return result;
 }
+
+/**
+ * Get monotonic timestamp not affected by system time changes
+ *
+ * @return milliseconds since some reference point in time
+ */
+gint64 mce_lib_get_mono_tick(void)
+{
+	struct timespec ts = { 0, 0 };
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * (gint64)1000 + ts.tv_nsec / 1000000;
+}
@@ -55,5 +55,7 @@ gchar *strstr_delim(const gchar *const haystack, const char *needle,
 		    const char *const delimiter);
 gboolean strmemcmp(guint8 *mem, const gchar *str, gulong len);
 
+gint64 mce_lib_get_mono_tick(void);
+
 
 #endif /* _MCE_LIB_H_ */
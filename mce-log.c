@@ -24,9 +24,11 @@
 #ifdef OSSOLOG_COMPILE
 #include <stdio.h>			/* fprintf() */
 #include <stdarg.h>			/* va_start(), va_end(), vfprintf() */
-#include <string.h>			/* strdup() */
+#include <string.h>			/* strdup(), strspn() */
 #include <syslog.h>			/* openlog(), closelog(), vsyslog() */
 #include <sys/time.h>
+#include <sys/types.h>			/* ssize_t */
+#include <time.h>			/* clock_gettime() */
 #include "mce-log.h"
 
 static unsigned int logverbosity = LL_WARN;	/**< Log verbosity */
@@ -96,9 +98,51 @@ static const char *mce_log_level_tag(loglevel_t loglevel)
 	return res;
 }
 
+/** Size of the stack buffer used for formatting typical log messages */
+#define MCE_LOG_BUFFER_SIZE 256
+
+/** Write already formatted message to the current log output
+ *
+ * @param loglevel The level of severity for this message
+ * @param file Source file name, or NULL
+ * @param function Function name, or NULL
+ * @param msg The message to log
+ */
+static void mce_log_emit(loglevel_t loglevel, const char *file,
+			 const char *function, const char *msg)
+{
+	if (logtype == MCE_LOG_STDERR) {
+		struct timeval tv;
+		timestamp(&tv);
+		if( file && function ) {
+			fprintf(stderr, "%s: T+%ld.%03ld %s: %s: %s(): %s\n",
+				logname,
+				(long)tv.tv_sec, (long)(tv.tv_usec/1000),
+				mce_log_level_tag(loglevel),
+				file, function, msg);
+		} else {
+			fprintf(stderr, "%s: T+%ld.%03ld %s: %s\n",
+				logname,
+				(long)tv.tv_sec, (long)(tv.tv_usec/1000),
+				mce_log_level_tag(loglevel),
+				msg);
+		}
+	} else {
+		/* loglevels are subset of syslog priorities, so
+		 * we can use loglevel as is for syslog priority */
+		if( file && function )
+			syslog(loglevel, "%s: %s(): %s", file, function, msg);
+		else
+			syslog(loglevel, "%s", msg);
+	}
+}
+
 /**
  * Log debug message with optional filename and function name attached
  *
+ * Messages that fit in MCE_LOG_BUFFER_SIZE bytes are formatted on
+ * stack, only longer ones need dynamic memory allocation.
+ *
  * @param loglevel The level of severity for this message
  * @param fmt The format string for this message
  * @param ... Input to the format string
@@ -111,33 +155,28 @@ void mce_log_file(loglevel_t loglevel, const char *const file,
 	loglevel = mce_log_level_normalize(loglevel);
 
 	if (logverbosity >= loglevel) {
-		gchar *msg = 0;
+		char  buf[MCE_LOG_BUFFER_SIZE];
+		char *msg = buf;
+		char *tmp = 0;
+		int   len;
 
 		va_start(args, fmt);
-		g_vasprintf(&msg, fmt, args);
+		len = vsnprintf(buf, sizeof buf, fmt, args);
 		va_end(args);
 
-		if( file && function ) {
-			gchar *tmp = g_strconcat(file, ": ", function, "(): ",
-						 msg, NULL);
-			g_free(msg), msg = tmp;
+		if( len < 0 ) {
+			snprintf(buf, sizeof buf, "invalid format: %s", fmt);
 		}
-
-		if (logtype == MCE_LOG_STDERR) {
-			struct timeval tv;
-			timestamp(&tv);
-			fprintf(stderr, "%s: T+%ld.%03ld %s: %s\n",
-				logname,
-				(long)tv.tv_sec, (long)(tv.tv_usec/1000),
-				mce_log_level_tag(loglevel),
-				msg);
-		} else {
-			/* loglevels are subset of syslog priorities, so
-			 * we can use loglevel as is for syslog priority */
-			syslog(loglevel, "%s", msg);
+		else if( (size_t)len >= sizeof buf ) {
+			va_start(args, fmt);
+			if( g_vasprintf(&tmp, fmt, args) >= 0 )
+				msg = tmp;
+			va_end(args);
 		}
 
-		g_free(msg);
+		mce_log_emit(loglevel, file, function, msg);
+
+		g_free(tmp);
 	}
 }
 
@@ -195,4 +234,306 @@ int mce_log_p(const loglevel_t loglevel)
 	return logverbosity >= loglevel;
 }
 
+/* ========================================================================= *
+ * FLIGHT RECORDER
+ * ========================================================================= */
+
+/** Number of entries in the flight recorder ring; must be power of two */
+#define MCE_LOG_RECORDER_SIZE 4096
+
+/** Flight recorder entry */
+typedef struct {
+	/** Monotonic time stamp [ns] */
+	gint64                  tick;
+
+	/** Call site, NULL for unused entries */
+	const mce_trace_site_t *site;
+
+	/** Log level */
+	loglevel_t              loglevel;
+
+	/** Integer arguments for the site format string */
+	long                    arg[MCE_TRACE_ARGS_MAX];
+} mce_log_record_t;
+
+/** Flight recorder ring buffer, allocated when the recorder is enabled */
+static mce_log_record_t *recorder_ring = 0;
+
+/** Number of entries ever added to the flight recorder */
+static volatile guint recorder_head = 0;
+
+/** Start flight recorder mode
+ *
+ * After this mce_trace() stores messages in the flight recorder
+ * instead of formatting and writing them to the log.
+ */
+void mce_log_recorder_enable(void)
+{
+	if( !recorder_ring )
+		recorder_ring = g_malloc0(MCE_LOG_RECORDER_SIZE *
+					  sizeof *recorder_ring);
+}
+
+/** Flight recorder mode predicate
+ *
+ * @return 1 if mce_trace() messages go to flight recorder, 0 if not
+ */
+int mce_log_recorder_p(void)
+{
+	return recorder_ring != 0;
+}
+
+/** Store a message in the flight recorder
+ *
+ * Slots are claimed with an atomic increment, so adding does not
+ * need locking. The oldest entry is overwritten when the ring is full.
+ *
+ * @param site static call site information
+ * @param loglevel the level of severity for this message
+ * @param arg0 1st argument for the site format string
+ * @param arg1 2nd argument for the site format string
+ * @param arg2 3rd argument for the site format string
+ * @param arg3 4th argument for the site format string
+ */
+void mce_log_recorder_add(const mce_trace_site_t *site, loglevel_t loglevel,
+			  long arg0, long arg1, long arg2, long arg3)
+{
+	mce_log_record_t *rec;
+	struct timespec   ts;
+	guint             slot;
+
+	if( !recorder_ring )
+		goto EXIT;
+
+	slot = __sync_fetch_and_add(&recorder_head, 1);
+	rec  = recorder_ring + (slot & (MCE_LOG_RECORDER_SIZE - 1));
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	rec->tick     = ts.tv_sec * (gint64)1000000000 + ts.tv_nsec;
+	rec->site     = site;
+	rec->loglevel = loglevel;
+	rec->arg[0]   = arg0;
+	rec->arg[1]   = arg1;
+	rec->arg[2]   = arg2;
+	rec->arg[3]   = arg3;
+
+EXIT:
+	return;
+}
+
+/** Format one stored argument using a single conversion specification
+ *
+ * The call site format has been checked against the original argument
+ * types, so the conversion and its length modifier tell what type the
+ * stored long must be converted back to before formatting.
+ *
+ * @param spec conversion specification, e.g. "%-5lu"
+ * @param arg  stored argument value
+ * @param buf  buffer to format to
+ * @param size size of the buffer
+ *
+ * @return number of characters written, excluding the terminator
+ */
+static size_t mce_log_record_format_arg(const char *spec, long arg,
+					char *buf, size_t size)
+{
+	size_t      len  = strlen(spec);
+	char        conv = spec[len - 1];
+	const char *mod  = spec + strcspn(spec, "hlzjt");
+	int         res  = -1;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+	switch( conv ) {
+	case 'd': case 'i':
+		if( *mod == 'l' )
+			res = snprintf(buf, size, spec, arg);
+		else if( *mod == 'z' )
+			res = snprintf(buf, size, spec, (ssize_t)arg);
+		else
+			res = snprintf(buf, size, spec, (int)arg);
+		break;
+
+	case 'o': case 'u': case 'x': case 'X':
+		if( *mod == 'l' )
+			res = snprintf(buf, size, spec, (unsigned long)arg);
+		else if( *mod == 'z' )
+			res = snprintf(buf, size, spec, (size_t)arg);
+		else
+			res = snprintf(buf, size, spec, (unsigned)arg);
+		break;
+
+	case 'c':
+		res = snprintf(buf, size, spec, (int)arg);
+		break;
+
+	case 's':
+		res = snprintf(buf, size, spec, (const char *)arg);
+		break;
+
+	case 'p':
+		res = snprintf(buf, size, spec, (void *)arg);
+		break;
+
+	default:
+		/* Not storable in a long; rejected by mce_trace() */
+		res = snprintf(buf, size, "%s", "?");
+		break;
+	}
+#pragma GCC diagnostic pop
+
+	if( res < 0 )
+		res = 0;
+
+	return ((size_t)res < size) ? (size_t)res : size - 1;
+}
+
+/** Format flight recorder entry message
+ *
+ * @param rec flight recorder entry
+ * @param buf buffer to format to
+ * @param size size of the buffer
+ */
+static void mce_log_record_format(const mce_log_record_t *rec,
+				  char *buf, size_t size)
+{
+	const char *src = rec->site->fmt;
+	size_t      len = 0;
+	int         arg = 0;
+
+	while( *src && len < size - 1 ) {
+		char   spec[32];
+		size_t n;
+
+		if( *src != '%' || src[1] == '%' ) {
+			buf[len++] = *src;
+			src += (*src == '%') ? 2 : 1;
+			continue;
+		}
+
+		/* flags, width, precision, length modifier, conversion */
+		n = 1 + strspn(src + 1, "#0- +.123456789");
+		n += strspn(src + n, "hlzjt");
+		if( src[n] )
+			++n;
+
+		if( n >= sizeof spec || arg >= MCE_TRACE_ARGS_MAX )
+			break;
+
+		memcpy(spec, src, n), spec[n] = 0;
+		src += n;
+
+		len += mce_log_record_format_arg(spec, rec->arg[arg++],
+						 buf + len, size - len);
+	}
+
+	buf[len] = 0;
+}
+
+/** Iterate flight recorder entries from oldest to newest
+ *
+ * @param cb function to call for each entry
+ * @param aptr context pointer to pass to the callback
+ */
+static void mce_log_recorder_scan(void (*cb)(const mce_log_record_t *rec,
+					     void *aptr),
+				  void *aptr)
+{
+	guint head = recorder_head;
+	guint tail = 0;
+
+	if( !recorder_ring )
+		goto EXIT;
+
+	if( head > MCE_LOG_RECORDER_SIZE )
+		tail = head - MCE_LOG_RECORDER_SIZE;
+
+	for( ; tail != head; ++tail ) {
+		const mce_log_record_t *rec =
+			recorder_ring + (tail & (MCE_LOG_RECORDER_SIZE - 1));
+
+		if( rec->site )
+			cb(rec, aptr);
+	}
+
+EXIT:
+	return;
+}
+
+/** Callback for appending flight recorder entry to a string
+ *
+ * @param rec flight recorder entry
+ * @param aptr GString to append to
+ */
+static void mce_log_recorder_append_cb(const mce_log_record_t *rec,
+				       void *aptr)
+{
+	GString *text = aptr;
+	char     msg[MCE_LOG_BUFFER_SIZE];
+
+	mce_log_record_format(rec, msg, sizeof msg);
+	g_string_append_printf(text, "T+%" G_GINT64_FORMAT ".%06ld %s: "
+			       "%s: %s(): %s\n",
+			       rec->tick / 1000000000,
+			       (long)(rec->tick / 1000 % 1000000),
+			       mce_log_level_tag(rec->loglevel),
+			       rec->site->file, rec->site->function, msg);
+}
+
+/** Get flight recorder contents as text
+ *
+ * @return flight recorder entries formatted one per line, or NULL if
+ *         the recorder is not enabled; caller must release with g_free()
+ */
+char *mce_log_recorder_to_string(void)
+{
+	GString *text = 0;
+
+	if( !recorder_ring )
+		goto EXIT;
+
+	text = g_string_new(0);
+	mce_log_recorder_scan(mce_log_recorder_append_cb, text);
+
+EXIT:
+	return text ? g_string_free(text, FALSE) : 0;
+}
+
+/** Callback for writing flight recorder entry to the log
+ *
+ * @param rec flight recorder entry
+ * @param aptr unused
+ */
+static void mce_log_recorder_dump_cb(const mce_log_record_t *rec,
+				     void *aptr)
+{
+	char msg[MCE_LOG_BUFFER_SIZE];
+	char tmp[MCE_LOG_BUFFER_SIZE];
+
+	(void)aptr;
+
+	mce_log_record_format(rec, tmp, sizeof tmp);
+	snprintf(msg, sizeof msg, "T+%" G_GINT64_FORMAT ".%06ld %s",
+		 rec->tick / 1000000000,
+		 (long)(rec->tick / 1000 % 1000000), tmp);
+	mce_log_emit(mce_log_level_normalize(rec->loglevel),
+		     rec->site->file, rec->site->function, msg);
+}
+
+/** Write flight recorder contents to the log regardless of verbosity
+ */
+void mce_log_recorder_dump(void)
+{
+	if( !recorder_ring )
+		goto EXIT;
+
+	mce_log_emit(LL_NOTICE, NULL, NULL, "flight recorder dump begin");
+	mce_log_recorder_scan(mce_log_recorder_dump_cb, 0);
+	mce_log_emit(LL_NOTICE, NULL, NULL, "flight recorder dump end");
+
+EXIT:
+	return;
+}
+
 #endif /* OSSOLOG_COMPILE */
@@ -41,26 +41,117 @@ typedef enum {
 } loglevel_t;
 
 #ifdef OSSOLOG_COMPILE
+/** Highest log level compiled in
+ *
+ * Messages above this level are dropped at compile time. Can be set
+ * for the whole build via CPPFLAGS, for one file by defining it before
+ * including mce-log.h, or for a group of functions by redefining it
+ * in between them.
+ */
+#ifndef MCE_LOG_VERBOSITY_MAX
+# define MCE_LOG_VERBOSITY_MAX LL_DEBUG
+#endif
+
 void mce_log_file(loglevel_t loglevel, const char *const file,
 		  const char *const function, const char *const fmt, ...)
 	__attribute__((format(printf, 4, 5)));
-#define mce_log_raw(__loglevel, __fmt, __args...)	mce_log_file(__loglevel, NULL, NULL, __fmt , ## __args)
-#define mce_log(__loglevel, __fmt, __args...)		mce_log_file(__loglevel, __FILE__, __FUNCTION__, __fmt , ## __args)
 void mce_log_set_verbosity(const int verbosity);
 void mce_log_open(const char *const name, const int facility, const int type);
 void mce_log_close(void);
 int mce_log_p(const loglevel_t loglevel);
+
+/** Check whether logging at given level is both compiled in and enabled */
+#define mce_log_enabled_p(__loglevel)\
+	((__loglevel) <= MCE_LOG_VERBOSITY_MAX && mce_log_p(__loglevel))
+
+/* The level is checked before the arguments get evaluated */
+#define mce_log_raw(__loglevel, __fmt, __args...)\
+	(mce_log_enabled_p(__loglevel) ?\
+	 mce_log_file(__loglevel, NULL, NULL, __fmt , ## __args) : (void)0)
+#define mce_log(__loglevel, __fmt, __args...)\
+	(mce_log_enabled_p(__loglevel) ?\
+	 mce_log_file(__loglevel, __FILE__, __FUNCTION__, __fmt , ## __args) : (void)0)
+
+/** Maximum number of arguments stored per flight recorder entry */
+#define MCE_TRACE_ARGS_MAX 4
+
+/** Static information about a mce_trace() call site */
+typedef struct {
+	const char *file;		/**< Source file name */
+	const char *function;		/**< Function name */
+	const char *fmt;		/**< Format string for the arguments */
+} mce_trace_site_t;
+
+void mce_log_recorder_enable(void);
+int mce_log_recorder_p(void);
+void mce_log_recorder_add(const mce_trace_site_t *site, loglevel_t loglevel,
+			  long arg0, long arg1, long arg2, long arg3);
+char *mce_log_recorder_to_string(void);
+void mce_log_recorder_dump(void);
+
+/* Pad / truncate trace arguments to MCE_TRACE_ARGS_MAX longs; the
+ * conditional keeps -Wbad-function-cast quiet for function call args
+ * and the array size fails the build for floating point arguments and
+ * for arguments that do not fit in a long */
+#define mce_trace_arg_(__arg) ((long)(0 ? 0 : (__arg)) +\
+	(long)(0 * sizeof(char[(__builtin_classify_type(0 ? 0 : (__arg)) == 8 ||\
+				sizeof(0 ? 0 : (__arg)) > sizeof(long)) ? -1 : 1])))
+#define mce_trace_args_(__dummy, __a0, __a1, __a2, __a3, __rest...)\
+	mce_trace_arg_(__a0), mce_trace_arg_(__a1),\
+	mce_trace_arg_(__a2), mce_trace_arg_(__a3)
+
+/** Log via flight recorder when it is enabled, normally otherwise
+ *
+ * When the flight recorder is enabled, the message is stored in
+ * binary form regardless of verbosity and formatted only when the
+ * recorder is dumped. Up to MCE_TRACE_ARGS_MAX integer, character,
+ * pointer or string arguments are supported; each is formatted with
+ * its own conversion, and string arguments must point to static data.
+ */
+#define mce_trace(__loglevel, __fmt, __args...)\
+	do {\
+		if( (__loglevel) > MCE_LOG_VERBOSITY_MAX )\
+			break;\
+		if( mce_log_recorder_p() ) {\
+			static const mce_trace_site_t mce_trace_site = {\
+				__FILE__, __FUNCTION__, __fmt\
+			};\
+			mce_log_recorder_add(&mce_trace_site, __loglevel,\
+					     mce_trace_args_(0 , ## __args ,\
+							     0, 0, 0, 0));\
+		}\
+		else {\
+			mce_log(__loglevel, __fmt , ## __args);\
+		}\
+	} while( 0 )
 #else
+/* The dummy versions are expressions just like the real ones, so that
+ * code compiles the same way regardless of OSSOLOG_COMPILE */
+
 /** Dummy version used when logging is disabled at compile time */
-#define mce_log(_loglevel, _fmt, ...)			do {} while (0)
+#define mce_log_raw(_loglevel, _fmt, ...)		((void)0)
 /** Dummy version used when logging is disabled at compile time */
-#define mce_log_set_verbosity(_verbosity)		do {} while (0)
+#define mce_log(_loglevel, _fmt, ...)			((void)0)
 /** Dummy version used when logging is disabled at compile time */
-#define mce_log_open(_name, _facility, _type)		do {} while (0)
+#define mce_log_set_verbosity(_verbosity)		((void)0)
 /** Dummy version used when logging is disabled at compile time */
-#define mce_log_close()					do {} while (0)
+#define mce_log_open(_name, _facility, _type)		((void)0)
+/** Dummy version used when logging is disabled at compile time */
+#define mce_log_close()					((void)0)
 /** Dummy version used when logging is disabled at compile time */
 #define mce_log_p(_loglevel)				0
+/** Dummy version used when logging is disabled at compile time */
+#define mce_log_enabled_p(_loglevel)			0
+/** Dummy version used when logging is disabled at compile time */
+#define mce_trace(_loglevel, _fmt, ...)			do {} while (0)
+/** Dummy version used when logging is disabled at compile time */
+#define mce_log_recorder_enable()			((void)0)
+/** Dummy version used when logging is disabled at compile time */
+#define mce_log_recorder_p()				0
+/** Dummy version used when logging is disabled at compile time */
+#define mce_log_recorder_to_string()			NULL
+/** Dummy version used when logging is disabled at compile time */
+#define mce_log_recorder_dump()				((void)0)
 #endif /* OSSOLOG_COMPILE */
 
 #endif /* _MCE_LOG_H_ */
@@ -21,8 +21,10 @@
 #include <glib.h>
 #include <gmodule.h>
 
+#include <dlfcn.h>			/* dlopen(), dlsym(), dlclose() */
 #include <stdio.h>			/* fprintf(), stdout */
 #include <string.h>			/* strcmp() */
+#include <pthread.h>			/* pthread_create(), pthread_join() */
 
 #include "mce.h"			/* module_info_struct */
 #include "mce-modules.h"
@@ -35,6 +37,39 @@
 /** List of all loaded modules */
 static GSList *modules = NULL;
 
+/** Bookkeeping for one module listed in the configuration
+ */
+typedef struct
+{
+	/** Module name, as listed in the configuration */
+	gchar                    *name;
+	/** Path to the shared object */
+	gchar                    *path;
+	/** Handle from prefetch dlopen(), or NULL */
+	void                     *handle;
+	/** Module information from the prefetched shared object, or NULL */
+	const module_info_struct *info;
+	/** Time spent in prefetch dlopen(), in microseconds */
+	gint64                    load_us;
+	/** g_module_open() has been attempted */
+	gboolean                  done;
+} mce_module_load_t;
+
+/** Modules listed in the configuration, in configuration order */
+static mce_module_load_t *load_list = NULL;
+
+/** Number of entries in load_list */
+static guint load_count = 0;
+
+/** Thread running mce_modules_prefetch_thread() */
+static pthread_t load_thread;
+
+/** load_thread has been started and not joined yet */
+static gboolean load_thread_running = FALSE;
+
+/** When mce_modules_prefetch() started the load thread, in microseconds */
+static gint64 load_started = 0;
+
 /**
  * Dump information about mce modules to stdout
  */
@@ -155,17 +190,51 @@ static gchar * mce_modules_build_path(const gchar *directory,
 	return g_strdup_printf("%s/%s.so", directory, module_name);
 }
 
-/**
- * Init function for the mce-modules component
+/** Thread function for loading module shared objects
  *
- * @return TRUE on success, FALSE on failure
+ * Maps the modules and resolves their symbols so that the
+ * g_module_open() calls made from the main thread only need to run
+ * the module init functions.  GModule invokes g_module_check_init()
+ * only from g_module_open(), but dlopen() runs ELF constructors of
+ * the modules and of libraries they pull in within this thread, so
+ * such code must not touch main thread state.
+ *
+ * @param aptr Unused
+ *
+ * @return NULL
  */
-gboolean mce_modules_init(void)
+static void *mce_modules_prefetch_thread(void *aptr)
+{
+	(void)aptr;
+
+	for( guint i = 0; i < load_count; ++i ) {
+		mce_module_load_t *load = &load_list[i];
+		gint64 t = g_get_monotonic_time();
+
+		/* Use the same flags as g_module_open(path, 0) */
+		if( (load->handle = dlopen(load->path, RTLD_NOW | RTLD_GLOBAL)) )
+			load->info = dlsym(load->handle, "module_info");
+
+		load->load_us = g_get_monotonic_time() - t;
+	}
+
+	return NULL;
+}
+
+/** Start loading modules listed in the configuration
+ *
+ * Can be called as soon as the configuration is available, so that
+ * the modules get loaded while the rest of mce is initialized.
+ */
+void mce_modules_prefetch(void)
 {
 	gchar **modlist = NULL;
-	gsize length;
+	gsize length = 0;
 	gchar *path = NULL;
 
+	if( load_list )
+		goto EXIT;
+
 	/* Get the module path */
 	path = mce_conf_get_string(MCE_CONF_MODULES_GROUP,
 				   MCE_CONF_MODULES_PATH,
@@ -176,35 +245,196 @@ gboolean mce_modules_init(void)
 					   MCE_CONF_MODULES_MODULES,
 					   &length);
 
-	if (modlist != NULL) {
-		gint i;
-
-		for (i = 0; modlist[i]; i++) {
-			GModule *module;
-			gchar *tmp = mce_modules_build_path(path, modlist[i]);
-
-			mce_log(LL_INFO,
-				"Loading module: %s from %s",
-				modlist[i], path);
-
-			if ((module = g_module_open(tmp, 0)) != NULL) {
-				/* XXX: check dependencies, conflicts, et al */
-				modules = g_slist_prepend(modules, module);
-			} else {
-				const char *err = g_module_error();
-				mce_log(LL_ERR, "%s", err ?: "unknown error");
-				mce_log(LL_ERR,
-					"Failed to load module: %s; skipping",
-					modlist[i]);
-			}
-
-			g_free(tmp);
-		}
+	if( !modlist )
+		goto EXIT;
+
+	load_count = g_strv_length(modlist);
+	load_list = g_new0(mce_module_load_t, load_count + 1);
+
+	for( guint i = 0; i < load_count; ++i ) {
+		load_list[i].name = g_strdup(modlist[i]);
+		load_list[i].path = mce_modules_build_path(path, modlist[i]);
+	}
+
+	load_started = g_get_monotonic_time();
 
-		g_strfreev(modlist);
+	if( pthread_create(&load_thread, 0, mce_modules_prefetch_thread, 0) ) {
+		mce_log(LL_WARN, "failed to start module load thread");
+		goto EXIT;
 	}
 
+	load_thread_running = TRUE;
+
+EXIT:
+	g_strfreev(modlist);
 	g_free(path);
+}
+
+/** Wait for mce_modules_prefetch() to finish
+ *
+ * @return time spent waiting, in microseconds
+ */
+static gint64 mce_modules_prefetch_wait(void)
+{
+	gint64 t = g_get_monotonic_time();
+
+	if( load_thread_running ) {
+		pthread_join(load_thread, 0);
+		load_thread_running = FALSE;
+	}
+
+	return g_get_monotonic_time() - t;
+}
+
+/** Release prefetch handles and module bookkeeping
+ */
+static void mce_modules_prefetch_quit(void)
+{
+	mce_modules_prefetch_wait();
+
+	for( guint i = 0; i < load_count; ++i ) {
+		if( load_list[i].handle )
+			dlclose(load_list[i].handle);
+		g_free(load_list[i].name);
+		g_free(load_list[i].path);
+	}
+
+	g_free(load_list), load_list = NULL;
+	load_count = 0;
+}
+
+/** Find not yet initialized module that provides given functionality
+ *
+ * @param feature functionality name, as used in module depends
+ *
+ * @return module bookkeeping, or NULL if no pending module provides it
+ */
+static mce_module_load_t *mce_modules_find_pending(const gchar *feature)
+{
+	for( guint i = 0; i < load_count; ++i ) {
+		mce_module_load_t *load = &load_list[i];
+
+		if( load->done || !load->info || !load->info->provides )
+			continue;
+
+		for( gsize k = 0; load->info->provides[k]; ++k ) {
+			if( !strcmp(load->info->provides[k], feature) )
+				return load;
+		}
+	}
+
+	return NULL;
+}
+
+/** Check if all dependencies of a module have been initialized
+ *
+ * Dependencies not provided by any of the listed modules are
+ * assumed to be provided by mce core.
+ *
+ * @param load module bookkeeping
+ *
+ * @return TRUE if the module can be initialized, FALSE otherwise
+ */
+static gboolean mce_modules_is_ready(const mce_module_load_t *load)
+{
+	if( !load->info || !load->info->depends )
+		return TRUE;
+
+	for( gsize k = 0; load->info->depends[k]; ++k ) {
+		const mce_module_load_t *dep =
+			mce_modules_find_pending(load->info->depends[k]);
+
+		if( dep && dep != load )
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/** Pick next module to initialize
+ *
+ * Modules are initialized in configuration order, except that
+ * modules are held back until the modules they depend on have been
+ * initialized.
+ *
+ * @return module bookkeeping, or NULL when all modules are done
+ */
+static mce_module_load_t *mce_modules_next(void)
+{
+	mce_module_load_t *first = NULL;
+
+	for( guint i = 0; i < load_count; ++i ) {
+		mce_module_load_t *load = &load_list[i];
+
+		if( load->done )
+			continue;
+
+		if( mce_modules_is_ready(load) )
+			return load;
+
+		if( !first )
+			first = load;
+	}
+
+	if( first ) {
+		mce_log(LL_WARN, "module %s: circular dependencies",
+			first->name);
+	}
+
+	return first;
+}
+
+/**
+ * Init function for the mce-modules component
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean mce_modules_init(void)
+{
+	mce_module_load_t *load;
+	gint64 wait_us;
+	gint64 init_us = 0;
+
+	mce_modules_prefetch();
+	wait_us = mce_modules_prefetch_wait();
+
+	while( (load = mce_modules_next()) ) {
+		GModule *module;
+		gint64 t = g_get_monotonic_time();
+
+		load->done = TRUE;
+
+		mce_log(LL_INFO,
+			"Loading module: %s from %s",
+			load->name, load->path);
+
+		if ((module = g_module_open(load->path, 0)) != NULL) {
+			/* XXX: check conflicts, et al */
+			modules = g_slist_prepend(modules, module);
+		} else {
+			const char *err = g_module_error();
+			mce_log(LL_ERR, "%s", err ?: "unknown error");
+			mce_log(LL_ERR,
+				"Failed to load module: %s; skipping",
+				load->name);
+		}
+
+		t = g_get_monotonic_time() - t;
+		init_us += t;
+
+		mce_log(LL_NOTICE, "module %s: load %.1f ms, init %.1f ms",
+			load->name, load->load_us / 1000.0, t / 1000.0);
+	}
+
+	if( load_count ) {
+		mce_log(LL_NOTICE, "%u modules: load wait %.1f ms, "
+			"init %.1f ms, total %.1f ms", load_count,
+			wait_us / 1000.0, init_us / 1000.0,
+			(g_get_monotonic_time() - load_started) / 1000.0);
+	}
+
+	/* Loaded modules are now referenced via GModule */
+	mce_modules_prefetch_quit();
 
 	return TRUE;
 }
@@ -226,5 +456,8 @@ void mce_modules_exit(void)
 		modules = NULL;
 	}
 
+	/* In case startup failed before mce_modules_init() */
+	mce_modules_prefetch_quit();
+
 	return;
 }
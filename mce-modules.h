@@ -36,6 +36,7 @@
 #define DEFAULT_MCE_MODULE_PATH		"/usr/lib/mce/modules"
 
 void mce_modules_dump_info(void);
+void mce_modules_prefetch(void);
 gboolean mce_modules_init(void);
 void mce_modules_exit(void);
 
@@ -0,0 +1,44 @@
+/* ------------------------------------------------------------------------- *
+ * Copyright (C) 2013 Jolla Ltd.
+ * License: LGPLv2
+ * ------------------------------------------------------------------------- */
+
+/* Sensor sample stream types shared by the sensor backends (sensorfw,
+ * libhybris) and the modules consuming ALS / PS data.
+ *
+ * Backends deliver all samples that are available at the time of a
+ * wakeup as one batch, oldest first, so that the consumers can make
+ * decisions based on the whole time series instead of acting on each
+ * sample separately.
+ */
+
+#ifndef MCE_SENSOR_H_
+# define MCE_SENSOR_H_
+
+# include <stdint.h>
+
+# ifdef __cplusplus
+extern "C" {
+# elif 0
+} /* fool JED indentation ... */
+# endif
+
+/** Sensor sample with time stamp from the sensor backend */
+typedef struct {
+	uint64_t timestamp;	/**< Monotonic time stamp; microseconds */
+	unsigned value;		/**< ALS: lux, PS: 1 if covered, 0 if not */
+} mce_sensor_sample_t;
+
+/** Callback for receiving sensor samples in batches, oldest first
+ *
+ * @param samples array of samples, valid only during the call
+ * @param count   number of samples; always at least one
+ */
+typedef void (*mce_sensor_batch_fn)(const mce_sensor_sample_t *samples,
+				    unsigned count);
+
+# ifdef __cplusplus
+};
+#endif
+
+#endif /* MCE_SENSOR_H_ */
@@ -45,6 +45,45 @@ typedef struct ps_data {
 	uint8_t  withinProximity;
 } ps_data_t;
 
+/** Initial size of sensord data channel receive buffer */
+#define SFW_READER_BUFFER_SIZE 1024
+
+/** Maximum number of samples accepted in one sensord data block */
+#define SFW_READER_SAMPLES_MAX 4096
+
+/** Receive state for a sensord data channel
+ *
+ * Sensord sends blocks of samples, each prefixed with a 32-bit
+ * sample count. Whatever is available is read with one read() and
+ * incomplete blocks are carried over to the next input callback.
+ */
+typedef struct {
+	/** Sensor name, for diagnostic logging */
+	const char            *name;
+
+	/** Size of one sample as sensord sends it */
+	size_t                 sample_size;
+
+	/** Convert sample from sensord to mce format */
+	void                 (*convert)(const void *raw,
+					mce_sensor_sample_t *sample);
+
+	/** Receive buffer */
+	char                  *data;
+
+	/** Allocated size of the receive buffer */
+	size_t                 size;
+
+	/** Number of bytes in the receive buffer */
+	size_t                 used;
+
+	/** Samples decoded from the receive buffer */
+	mce_sensor_sample_t *samples;
+
+	/** Allocated number of samples */
+	size_t                 samples_size;
+} sfw_reader_t;
+
 /* ========================================================================= *
  * STATE DATA
  * ========================================================================= */
@@ -73,8 +112,14 @@ static bool       als_want    = false;
 /** Flag for ALS enabled at sensord */
 static bool       als_have    = false;
 
-/** Callback for sending ALS data to where it is needed */
-static void     (*als_notify)(unsigned lux) = 0;
+/** ALS sampling interval MCE wants [ms]; 0 = sensord default */
+static unsigned   als_interval_want = 0;
+
+/** ALS sampling interval set for the sensord session [ms] */
+static unsigned   als_interval_have = 0;
+
+/** Callback for sending ALS sample batches to where they are needed */
+static mce_sensor_batch_fn als_batch_notify = 0;
 
 /** Sensord name for PS */
 static const char ps_name[]  = "proximitysensor";
@@ -94,83 +139,271 @@ static bool       ps_want    = false;
 /** Flag for PS enabled at sensord */
 static bool       ps_have    = false;
 
-/** Callback for sending PS data to where it is needed */
-static void     (*ps_notify)(bool covered) = 0;
+/** Callback for sending PS sample batches to where they are needed */
+static mce_sensor_batch_fn ps_batch_notify = 0;
 
 /* ========================================================================= *
  * COMMON
  * ========================================================================= */
 
-/** Handle ALS input from sensord
+/** Convert ALS sample from sensord to mce format
  *
- * @param chn  io channel
- * @param cnd  (not used)
- * @param aptr (not used)
+ * @param raw    als_data_t, possibly unaligned
+ * @param sample where to store the converted sample
+ */
+static void
+als_convert_sample(const void *raw, mce_sensor_sample_t *sample)
+{
+	als_data_t data;
+
+	memcpy(&data, raw, sizeof data);
+	sample->timestamp = data.timestamp;
+	sample->value     = data.value;
+}
+
+/** Convert PS sample from sensord to mce format
  *
- * @return TRUE to keep io watch, or FALSE to remove it
+ * @param raw    ps_data_t, possibly unaligned
+ * @param sample where to store the converted sample
  */
-static gboolean
-als_input_cb(GIOChannel *chn, GIOCondition cnd, gpointer aptr)
+static void
+ps_convert_sample(const void *raw, mce_sensor_sample_t *sample)
 {
-	mce_log(LL_DEBUG, "@%s()", __FUNCTION__);
+	ps_data_t data;
 
-	(void)cnd; (void)aptr; // unused
+	memcpy(&data, raw, sizeof data);
+	sample->timestamp = data.timestamp;
+	sample->value     = (data.withinProximity != 0);
+}
 
-	gboolean keep_going = FALSE;
-	uint32_t count = 0;
+/** Receive state for ALS data channel */
+static sfw_reader_t als_reader = {
+	.name        = als_name,
+	.sample_size = sizeof(als_data_t),
+	.convert     = als_convert_sample,
+};
+
+/** Receive state for PS data channel */
+static sfw_reader_t ps_reader = {
+	.name        = ps_name,
+	.sample_size = sizeof(ps_data_t),
+	.convert     = ps_convert_sample,
+};
+
+/** Forget partially received data
+ *
+ * @param self receive state
+ */
+static void
+sfw_reader_reset(sfw_reader_t *self)
+{
+	self->used = 0;
+}
 
-	int fd;
-	int rc;
-	als_data_t data;
+/** Release dynamically allocated receive buffers
+ *
+ * @param self receive state
+ */
+static void
+sfw_reader_free(sfw_reader_t *self)
+{
+	g_free(self->data), self->data = 0, self->size = 0;
+	g_free(self->samples), self->samples = 0, self->samples_size = 0;
+	self->used = 0;
+}
+
+/** Make sure the receive buffer can hold given number of bytes
+ *
+ * @param self receive state
+ * @param size minimum buffer size
+ */
+static void
+sfw_reader_reserve(sfw_reader_t *self, size_t size)
+{
+	size_t have = self->size ?: SFW_READER_BUFFER_SIZE;
 
-	memset(&data, 0, sizeof data);
+	while( have < size )
+		have *= 2;
 
-	if( (fd = g_io_channel_unix_get_fd(chn)) < 0 ) {
-		mce_log(LL_ERR, "io channel has no fd");
-		goto EXIT;
+	if( have != self->size || !self->data ) {
+		self->data = g_realloc(self->data, have);
+		self->size = have;
 	}
+}
 
-	// FIXME: there should be only one read() ...
+/** Make sure the decoded sample array can hold given number of samples
+ *
+ * @param self  receive state
+ * @param count minimum number of samples
+ */
+static void
+sfw_reader_reserve_samples(sfw_reader_t *self, size_t count)
+{
+	size_t have = self->samples_size ?: 16;
+
+	while( have < count )
+		have *= 2;
+
+	if( have != self->samples_size || !self->samples ) {
+		self->samples = g_realloc(self->samples,
+					  have * sizeof *self->samples);
+		self->samples_size = have;
+	}
+}
+
+/** Read available data from sensord and decode complete sample blocks
+ *
+ * @param self    receive state
+ * @param fd      data channel file descriptor
+ * @param pcount  where to store number of decoded samples
+ *
+ * @return true if data channel should be kept open, false on errors
+ */
+static bool
+sfw_reader_input(sfw_reader_t *self, int fd, unsigned *pcount)
+{
+	bool     keep_going = false;
+	size_t   pos        = 0;
+	unsigned total      = 0;
+	ssize_t  rc;
+
+	/* Full buffer -> there might be more data available */
+	if( self->used == self->size || !self->data )
+		sfw_reader_reserve(self, self->used + 1);
 
-	rc = read(fd, &count, sizeof count);
+	rc = read(fd, self->data + self->used, self->size - self->used);
 	if( rc == -1 ) {
 		if( errno == EINTR || errno == EAGAIN )
-			keep_going = TRUE;
+			keep_going = true;
 		else
-			mce_log(LL_ERR, "read sample count: %m");
+			mce_log(LL_ERR, "%s: read: %m", self->name);
 		goto EXIT;
 	}
 	if( rc == 0 ) {
-		mce_log(LL_ERR, "read sample count: EOF");
-		goto EXIT;
-	}
-	if( rc != (int)sizeof count) {
-		mce_log(LL_ERR, "read sample count: got %d of %d bytes",
-			rc, (int)sizeof count);
+		mce_log(LL_ERR, "%s: read: EOF", self->name);
 		goto EXIT;
 	}
+	self->used += (size_t)rc;
 
-	mce_log(LL_DEBUG, "got %u ALS values", (unsigned)count);
-
-	if( count < 1 ) {
-		keep_going = TRUE;
-		goto EXIT;
-	}
+	/* Decode all complete blocks */
+	while( self->used - pos >= sizeof(uint32_t) ) {
+		uint32_t count;
+		size_t   block;
 
-	for( unsigned i = 0; i < count; ++i ) {
-		errno = 0, rc = read(fd, &data, sizeof data);
-		if( rc != sizeof data ) {
-			mce_log(LL_ERR, "failed to read sample: %m");
+		memcpy(&count, self->data + pos, sizeof count);
+		if( count > SFW_READER_SAMPLES_MAX ) {
+			mce_log(LL_ERR, "%s: got %u samples; out of sync?",
+				self->name, (unsigned)count);
 			goto EXIT;
 		}
+
+		block = sizeof count + count * self->sample_size;
+		if( self->used - pos < block ) {
+			/* Make room for the rest of the block */
+			if( block > self->size )
+				sfw_reader_reserve(self, block);
+			break;
+		}
+
+		sfw_reader_reserve_samples(self, total + count);
+		for( uint32_t i = 0; i < count; ++i ) {
+			const char *raw = (self->data + pos + sizeof count +
+					   i * self->sample_size);
+			self->convert(raw, self->samples + total + i);
+		}
+
+		total += count;
+		pos   += block;
+	}
+
+	/* Carry over partial block */
+	if( pos > 0 ) {
+		memmove(self->data, self->data + pos, self->used - pos);
+		self->used -= pos;
 	}
 
-	mce_log(LL_DEBUG, "last ALS value = %u", data.value);
-	if( als_notify )
-		als_notify(data.value);
+	keep_going = true;
+
+EXIT:
+	*pcount = keep_going ? total : 0;
+	return keep_going;
+}
+
+/** Send ALS samples to where they are needed
+ *
+ * @param samples array of samples, oldest first
+ * @param count   number of samples
+ */
+static void
+als_deliver(const mce_sensor_sample_t *samples, unsigned count)
+{
+	if( count < 1 )
+		goto EXIT;
+
+	mce_log(LL_DEBUG, "got %u ALS values, last = %u",
+		count, samples[count-1].value);
+
+	if( als_batch_notify )
+		als_batch_notify(samples, count);
 	else
 		mce_log(LL_WARN, "ALS enabled without notify cb");
 
+EXIT:
+	return;
+}
+
+/** Send PS samples to where they are needed
+ *
+ * @param samples array of samples, oldest first
+ * @param count   number of samples
+ */
+static void
+ps_deliver(const mce_sensor_sample_t *samples, unsigned count)
+{
+	if( count < 1 )
+		goto EXIT;
+
+	mce_log(LL_DEBUG, "got %u PS values, last = %u",
+		count, samples[count-1].value);
+
+	if( ps_batch_notify )
+		ps_batch_notify(samples, count);
+	else
+		mce_log(LL_WARN, "PS enabled without notify cb");
+
+EXIT:
+	return;
+}
+
+/** Handle ALS input from sensord
+ *
+ * @param chn  io channel
+ * @param cnd  (not used)
+ * @param aptr (not used)
+ *
+ * @return TRUE to keep io watch, or FALSE to remove it
+ */
+static gboolean
+als_input_cb(GIOChannel *chn, GIOCondition cnd, gpointer aptr)
+{
+	mce_log(LL_DEBUG, "@%s()", __FUNCTION__);
+
+	(void)cnd; (void)aptr; // unused
+
+	gboolean keep_going = FALSE;
+	unsigned count = 0;
+	int      fd;
+
+	if( (fd = g_io_channel_unix_get_fd(chn)) < 0 ) {
+		mce_log(LL_ERR, "io channel has no fd");
+		goto EXIT;
+	}
+
+	if( !sfw_reader_input(&als_reader, fd, &count) )
+		goto EXIT;
+
+	als_deliver(als_reader.samples, count);
+
 	keep_going = TRUE;
 
 EXIT:
@@ -197,61 +430,18 @@ ps_input_cb(GIOChannel *chn, GIOCondition cnd, gpointer aptr)
 	(void)cnd; (void)aptr; // unused
 
 	gboolean keep_going = FALSE;
-	uint32_t count = 0;
-
-	int fd;
-	int rc;
-	ps_data_t data;
-
-	memset(&data, 0, sizeof data);
+	unsigned count = 0;
+	int      fd;
 
 	if( (fd = g_io_channel_unix_get_fd(chn)) < 0 ) {
 		mce_log(LL_ERR, "io channel has no fd");
 		goto EXIT;
 	}
 
-	// FIXME: there should be only one read() ...
-
-	rc = read(fd, &count, sizeof count);
-	if( rc == -1 ) {
-		if( errno == EINTR || errno == EAGAIN )
-			keep_going = TRUE;
-		else
-			mce_log(LL_ERR, "read sample count: %m");
-		goto EXIT;
-	}
-	if( rc == 0 ) {
-		mce_log(LL_ERR, "read sample count: EOF");
+	if( !sfw_reader_input(&ps_reader, fd, &count) )
 		goto EXIT;
-	}
-	if( rc != (int)sizeof count) {
-		mce_log(LL_ERR, "read sample count: got %d of %d bytes",
-			rc, (int)sizeof count);
-		goto EXIT;
-	}
-
-	mce_log(LL_DEBUG, "Got %u PS values", (unsigned)count);
-
-	if( count < 1 ) {
-		keep_going = TRUE;
-		goto EXIT;
-	}
 
-	for( unsigned i = 0; i < count; ++i ) {
-		errno = 0, rc = read(fd, &data, sizeof data);
-		if( rc != sizeof data ) {
-			mce_log(LL_ERR, "failed to read sample: %m");
-			goto EXIT;
-		}
-	}
-
-	mce_log(LL_DEBUG, "last PS value = %u / %d", data.value,
-		data.withinProximity);
-
-	if( ps_notify )
-		ps_notify(data.withinProximity != 0);
-	else
-		mce_log(LL_WARN, "PS enabled without notify cb");
+	ps_deliver(ps_reader.samples, count);
 
 	keep_going = TRUE;
 
@@ -588,6 +778,49 @@ EXIT:
 	return res;
 }
 
+/** Issue set sampling interval IPC to sensord
+ *
+ * The interval applies to the session and can be changed while
+ * the sensor is running.
+ *
+ * @param id        sensor name
+ * @param iface     D-Bus interface for the sensor
+ * @param sessionid sensord session id from mce_sensorfw_request_sensor()
+ * @param interval  sampling interval in milliseconds, or 0 for default
+ *
+ * @return true on success, or false in case of errors
+ */
+static bool
+mce_sensorfw_set_interval(const char *id, const char *iface, int sessionid,
+			  unsigned interval)
+{
+	bool         res  = false;
+	char        *path = 0;
+	dbus_int32_t sid  = sessionid;
+	dbus_int32_t val  = (dbus_int32_t)interval;
+
+	mce_log(LL_DEBUG, "interval(%s, %d, %u)", id, sessionid, interval);
+
+	if( asprintf(&path, "%s/%s", SENSORFW_PATH, id) < 0 ) {
+		path = 0;
+		goto EXIT;
+	}
+
+	res = dbus_send(SENSORFW_SERVICE,
+			path,
+			iface,
+			"setInterval",
+			NULL,
+			DBUS_TYPE_INT32, &sid,
+			DBUS_TYPE_INT32, &val,
+			DBUS_TYPE_INVALID);
+
+EXIT:
+	free(path);
+
+	return res;
+}
+
 /* ========================================================================= *
  * ALS
  * ========================================================================= */
@@ -609,6 +842,7 @@ static void mce_sensorfw_als_read_cb(DBusPendingCall *pc, void *aptr)
 	dbus_uint64_t tck = 0;
 	dbus_uint32_t lux = 0;
 
+	mce_sensor_sample_t sample;
 	DBusMessageIter body, var, rec;
 
 	if( !(rsp = dbus_pending_call_steal_reply(pc)) )
@@ -646,10 +880,9 @@ static void mce_sensorfw_als_read_cb(DBusPendingCall *pc, void *aptr)
 
 	mce_log(LL_INFO, "initial ALS value = %u", lux);
 
-	if( als_notify )
-		als_notify(lux);
-	else
-		mce_log(LL_WARN, "ALS enabled without notify cb");
+	sample.timestamp = tck;
+	sample.value     = lux;
+	als_deliver(&sample, 1);
 
 	res = true;
 
@@ -710,6 +943,9 @@ static void mce_sensorfw_als_stop_session(void)
 	}
 
 	als_have = false;
+
+	/* New sessions start with sensord default interval */
+	als_interval_have = 0;
 }
 
 /** Have ALS session with sensord predicate
@@ -737,6 +973,7 @@ static bool mce_sensorfw_als_start_session(void)
 	if( als_sid < 0 )
 		goto EXIT;
 
+	sfw_reader_reset(&als_reader);
 	als_wid = mce_sensorfw_add_io_watch(als_sid, als_input_cb);
 	if( als_wid == 0 )
 		goto EXIT;
@@ -749,6 +986,29 @@ EXIT:
 	return als_wid != 0;
 }
 
+/** Rethink ALS sampling interval
+ *
+ * Changes are applied to running sensor only; the interval is
+ * re-applied after the sensor has been started.
+ */
+static void
+mce_sensorfw_als_rethink_interval(void)
+{
+	if( !sensord_running || !als_have )
+		goto EXIT;
+
+	if( als_interval_want == als_interval_have )
+		goto EXIT;
+
+	if( !mce_sensorfw_set_interval(als_name, als_iface, als_sid,
+				       als_interval_want) )
+		goto EXIT;
+
+	als_interval_have = als_interval_want;
+EXIT:
+	return;
+}
+
 /** Rethink ALS enabled state
  */
 static void
@@ -784,6 +1044,8 @@ mce_sensorfw_als_rethink(void)
 	}
 
 	als_have = als_want;
+
+	mce_sensorfw_als_rethink_interval();
 EXIT:
 	return;
 }
@@ -808,14 +1070,32 @@ mce_sensorfw_als_disable(void)
 	mce_sensorfw_als_rethink();
 }
 
-/** Set ALS notification callback
+/** Set ALS sampling interval
  *
- * @param cb function to call when ALS events are received
+ * The interval is changed on the fly, without restarting the
+ * sensord session.
+ *
+ * @param interval sampling interval in milliseconds, or 0 for default
  */
-void mce_sensorfw_als_set_notify(void (*cb)(unsigned lux))
+void
+mce_sensorfw_als_set_interval(unsigned interval)
+{
+	if( als_interval_want != interval ) {
+		mce_log(LL_DEBUG, "als interval: %u -> %u ms",
+			als_interval_want, interval);
+		als_interval_want = interval;
+	}
+	mce_sensorfw_als_rethink_interval();
+}
+
+/** Set ALS sample batch notification callback
+ *
+ * @param cb function to call with all ALS samples received at once
+ */
+void mce_sensorfw_als_set_batch_notify(mce_sensor_batch_fn cb)
 {
 	mce_log(LL_DEBUG, "@%s(%p)", __FUNCTION__, cb);
-	als_notify = cb;
+	als_batch_notify = cb;
 }
 
 /* ========================================================================= *
@@ -839,6 +1119,7 @@ static void mce_sensorfw_ps_read_cb(DBusPendingCall *pc, void *aptr)
 	dbus_uint64_t tck = 0;
 	dbus_uint32_t dst = 0;
 
+	mce_sensor_sample_t sample;
 	DBusMessageIter body, var, rec;
 
 	if( !(rsp = dbus_pending_call_steal_reply(pc)) )
@@ -876,10 +1157,9 @@ static void mce_sensorfw_ps_read_cb(DBusPendingCall *pc, void *aptr)
 
 	mce_log(LL_INFO, "initial PS value = %u", dst);
 
-	if( ps_notify )
-		ps_notify(dst > 0);
-	else
-		mce_log(LL_WARN, "PS enabled without notify cb");
+	sample.timestamp = tck;
+	sample.value     = (dst > 0);
+	ps_deliver(&sample, 1);
 
 	res = true;
 
@@ -970,6 +1250,7 @@ static bool mce_sensorfw_ps_start_session(void)
 	if( ps_sid < 0 )
 		goto EXIT;
 
+	sfw_reader_reset(&ps_reader);
 	ps_wid = mce_sensorfw_add_io_watch(ps_sid, ps_input_cb);
 	if( !ps_wid )
 		goto EXIT;
@@ -1041,14 +1322,14 @@ mce_sensorfw_ps_disable(void)
 	mce_sensorfw_ps_rethink();
 }
 
-/** Set PS notification callback
+/** Set PS sample batch notification callback
  *
- * @param cb function to call when PS events are received
+ * @param cb function to call with all PS samples received at once
  */
-void mce_sensorfw_ps_set_notify(void (*cb)(bool covered))
+void mce_sensorfw_ps_set_batch_notify(mce_sensor_batch_fn cb)
 {
 	mce_log(LL_DEBUG, "@%s(%p)", __FUNCTION__, cb);
-	ps_notify = cb;
+	ps_batch_notify = cb;
 }
 
 /* ========================================================================= *
@@ -1260,6 +1541,9 @@ mce_sensorfw_quit(void)
 	mce_sensorfw_ps_stop_session();
 	mce_sensorfw_als_stop_session();
 
+	sfw_reader_free(&ps_reader);
+	sfw_reader_free(&als_reader);
+
 	if( systembus ) {
 		dbus_connection_remove_filter(systembus,
 					      xsensord_dbus_filter_cb, 0);
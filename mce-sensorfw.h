@@ -1,6 +1,8 @@
 #ifndef MCE_SENSORFW_H_
 # define MCE_SENSORFW_H_
 
+# include "mce-sensor.h"
+
 # include <stdbool.h>
 
 # ifdef __cplusplus
@@ -12,11 +14,12 @@ extern "C" {
 bool mce_sensorfw_init(void);
 void mce_sensorfw_quit(void);
 
-void mce_sensorfw_als_set_notify(void (*cb)(unsigned lux));
+void mce_sensorfw_als_set_batch_notify(mce_sensor_batch_fn cb);
 void mce_sensorfw_als_enable(void);
 void mce_sensorfw_als_disable(void);
+void mce_sensorfw_als_set_interval(unsigned interval);
 
-void mce_sensorfw_ps_set_notify(void (*cb)(bool covered));
+void mce_sensorfw_ps_set_batch_notify(mce_sensor_batch_fn cb);
 void mce_sensorfw_ps_enable(void);
 void mce_sensorfw_ps_disable(void);
 
@@ -92,6 +92,8 @@
 
 #include "mce-log.h"			/* mce_log_open(), mce_log_close(),
 					 * mce_log_set_verbosity(), mce_log(),
+					 * mce_log_recorder_enable(),
+					 * mce_log_recorder_dump(),
 					 * LL_*
 					 */
 #include "mce-conf.h"			/* mce_conf_init(),
@@ -107,6 +109,7 @@
 					 * mce_gconf_exit()
 					 */
 #include "mce-modules.h"		/* mce_modules_dump_info(),
+					 * mce_modules_prefetch(),
 					 * mce_modules_init(),
 					 * mce_modules_exit()
 					 */
@@ -117,7 +120,8 @@
 					 * mce_switches_exit()
 					 */
 #include "datapipe.h"			/* setup_datapipe(),
-					 * free_datapipe()
+					 * free_datapipe(),
+					 * datapipe_stats_enable()
 					 */
 #include "modetransition.h"		/* mce_mode_init(),
 					 * mce_mode_exit()
@@ -186,7 +190,11 @@ static const char usage_fmt[] =
 "  -q, --quiet                decrease debug message verbosity\n"
 "  -v, --verbose              increase debug message verbosity\n"
 "  -t, --trace=<what>         enable domain specific debug logging;\n"
-"                               supported values: \"wakelocks\"\n"
+"                               supported values: \"wakelocks\",\n"
+"                               \"recorder\" (log to in-memory flight\n"
+"                               recorder, dumped on SIGUSR1),\n"
+"                               \"datapipes\" (collect datapipe\n"
+"                               execution time statistics)\n"
 "  -h, --help                 display this help and exit\n"
 "  -V, --version              output version information and exit\n"
 "\n"
@@ -339,7 +347,8 @@ static void signal_handler(const gint signr)
 {
 	switch (signr) {
 	case SIGUSR1:
-		/* We'll probably want some way to communicate with MCE */
+		/* Write flight recorder contents to log */
+		mce_log_recorder_dump();
 		break;
 
 	case SIGHUP:
@@ -693,6 +702,10 @@ static gboolean mce_enable_trace(const char *flags)
 #ifdef ENABLE_WAKELOCKS
 		{ "wakelocks", lwl_enable_logging },
 #endif
+#ifdef OSSOLOG_COMPILE
+		{ "recorder",  mce_log_recorder_enable },
+#endif
+		{ "datapipes", datapipe_stats_enable },
 		{ NULL, NULL }
 	};
 
@@ -889,6 +902,11 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	/* Start loading modules in the background
+	 * pre-requisite: mce_conf_init()
+	 */
+	mce_modules_prefetch();
+
 	/* Initialise D-Bus */
 	if (mce_dbus_init(systembus) == FALSE) {
 		mce_log(LL_CRIT,
@@ -1107,6 +1125,18 @@ EXIT:
 		mainloop = 0;
 	}
 
+#ifdef ENABLE_WAKELOCKS
+	{
+		lwl_stats_t stats;
+		wakelock_get_stats(&stats);
+		mce_log(LL_NOTICE, "wakelock writes: lock=%lu (%lu skipped)"
+			" unlock=%lu (%lu skipped) errors=%lu",
+			stats.lock_writes, stats.lock_skips,
+			stats.unlock_writes, stats.unlock_skips,
+			stats.write_errors);
+	}
+#endif
+
 	/* Log a farewell message and close the log */
 	mce_log(LL_INFO, "Exiting...");
 
@@ -23,13 +23,177 @@
 
 #include "median_filter.h"
 
+/**
+ * Set ring buffer slot at heap index
+ *
+ * @param filter The median filter
+ * @param lo TRUE for the lower half max-heap, FALSE for the upper half
+ * @param i Index in the heap
+ * @param slot Ring buffer slot to place at the index
+ */
+static void heap_set(median_filter_struct *filter, gboolean lo,
+		     gsize i, gsize slot)
+{
+	if (lo) {
+		filter->lo_heap[i] = slot;
+		filter->position[slot] = (gssize)i;
+	} else {
+		filter->hi_heap[i] = slot;
+		filter->position[slot] = -1 - (gssize)i;
+	}
+}
+
+/**
+ * Get value at heap index
+ *
+ * @param filter The median filter
+ * @param lo TRUE for the lower half max-heap, FALSE for the upper half
+ * @param i Index in the heap
+ * @return The value stored in the ring buffer slot at the index
+ */
+static gint heap_get(const median_filter_struct *filter, gboolean lo, gsize i)
+{
+	return filter->values[lo ? filter->lo_heap[i] : filter->hi_heap[i]];
+}
+
+/**
+ * Check heap ordering between two values
+ *
+ * @param lo TRUE for the lower half max-heap, FALSE for the upper half
+ * @param a Value closer to the heap root
+ * @param b Value further from the heap root
+ * @return TRUE if a must be above b in the heap
+ */
+static gboolean heap_before(gboolean lo, gint a, gint b)
+{
+	return lo ? (a > b) : (a < b);
+}
+
+/**
+ * Move heap entry towards the heap root until heap order is restored
+ *
+ * @param filter The median filter
+ * @param lo TRUE for the lower half max-heap, FALSE for the upper half
+ * @param i Index of the entry to move
+ * @return New index of the entry
+ */
+static gsize heap_sift_up(median_filter_struct *filter, gboolean lo, gsize i)
+{
+	gsize *heap = lo ? filter->lo_heap : filter->hi_heap;
+	gsize slot = heap[i];
+
+	while (i > 0) {
+		gsize parent = (i - 1) / 2;
+
+		if (!heap_before(lo, filter->values[slot],
+				 heap_get(filter, lo, parent)))
+			break;
+
+		heap_set(filter, lo, i, heap[parent]);
+		i = parent;
+	}
+
+	heap_set(filter, lo, i, slot);
+
+	return i;
+}
+
+/**
+ * Move heap entry away from the heap root until heap order is restored
+ *
+ * @param filter The median filter
+ * @param lo TRUE for the lower half max-heap, FALSE for the upper half
+ * @param i Index of the entry to move
+ */
+static void heap_sift_down(median_filter_struct *filter, gboolean lo, gsize i)
+{
+	gsize *heap = lo ? filter->lo_heap : filter->hi_heap;
+	gsize count = lo ? filter->lo_count : filter->hi_count;
+	gsize slot = heap[i];
+
+	for (;;) {
+		gsize child = 2 * i + 1;
+
+		if (child >= count)
+			break;
+
+		if (child + 1 < count &&
+		    heap_before(lo, heap_get(filter, lo, child + 1),
+				heap_get(filter, lo, child)))
+			child++;
+
+		if (!heap_before(lo, heap_get(filter, lo, child),
+				 filter->values[slot]))
+			break;
+
+		heap_set(filter, lo, i, heap[child]);
+		i = child;
+	}
+
+	heap_set(filter, lo, i, slot);
+}
+
+/**
+ * Add ring buffer slot to a heap
+ *
+ * @param filter The median filter
+ * @param lo TRUE for the lower half max-heap, FALSE for the upper half
+ * @param slot Ring buffer slot to add
+ */
+static void heap_push(median_filter_struct *filter, gboolean lo, gsize slot)
+{
+	gsize i = lo ? filter->lo_count++ : filter->hi_count++;
+
+	heap_set(filter, lo, i, slot);
+	heap_sift_up(filter, lo, i);
+}
+
+/**
+ * Remove the root entry of a heap
+ *
+ * @param filter The median filter
+ * @param lo TRUE for the lower half max-heap, FALSE for the upper half
+ * @return Ring buffer slot that was at the heap root
+ */
+static gsize heap_pop(median_filter_struct *filter, gboolean lo)
+{
+	gsize *heap = lo ? filter->lo_heap : filter->hi_heap;
+	gsize count = lo ? --filter->lo_count : --filter->hi_count;
+	gsize slot = heap[0];
+
+	if (count > 0) {
+		heap_set(filter, lo, 0, heap[count]);
+		heap_sift_down(filter, lo, 0);
+	}
+
+	return slot;
+}
+
+/**
+ * Allocate heaps for median filter
+ *
+ * @param filter The median filter to initialise
+ * @param window_size The window size to use
+ */
+static void median_filter_init_heap(median_filter_struct *filter,
+				    gsize window_size)
+{
+	filter->values = g_new0(gint, window_size);
+	filter->position = g_new0(gssize, window_size);
+	filter->lo_heap = g_new0(gsize, window_size / 2 + 1);
+	filter->hi_heap = g_new0(gsize, window_size / 2 + 1);
+}
+
 /**
  * Initialise median filter
 
+ * Filters with window_size larger than MEDIAN_FILTER_MAX_WINDOW_SIZE
+ * allocate memory that must be released with median_filter_free()
+ *
  * @param filter The median filter to initialise
  * @param window_size The window size to use
  *
- * @return FALSE if window_size is too big or filter is NULL,
+ * @return FALSE if window_size is zero or filter is NULL,
  *         TRUE on success
  */
 gboolean median_filter_init(median_filter_struct *filter, gsize window_size)
@@ -37,14 +201,25 @@ gboolean median_filter_init(median_filter_struct *filter, gsize window_size)
 	gboolean status = FALSE;
 	guint i;
 
-	if ((filter == NULL) || (window_size > MEDIAN_FILTER_MAX_WINDOW_SIZE))
+	if ((filter == NULL) || (window_size == 0))
 		goto EXIT;
 
 	filter->window_size = window_size;
 
-	for (i = 0; i < filter->window_size; i++) {
-		filter->window[i] = 0;
-		filter->ordered_window[i] = 0;
+	filter->values = NULL;
+	filter->position = NULL;
+	filter->lo_heap = NULL;
+	filter->hi_heap = NULL;
+	filter->lo_count = 0;
+	filter->hi_count = 0;
+
+	if (window_size > MEDIAN_FILTER_MAX_WINDOW_SIZE) {
+		median_filter_init_heap(filter, window_size);
+	} else {
+		for (i = 0; i < filter->window_size; i++) {
+			filter->window[i] = 0;
+			filter->ordered_window[i] = 0;
+		}
 	}
 
 	filter->samples = 0;
@@ -56,6 +231,30 @@ EXIT:
 	return status;
 }
 
+/**
+ * Release memory allocated for a median filter
+ *
+ * @param filter The median filter to release, or NULL
+ */
+void median_filter_free(median_filter_struct *filter)
+{
+	if (filter == NULL)
+		goto EXIT;
+
+	g_free(filter->values), filter->values = NULL;
+	g_free(filter->position), filter->position = NULL;
+	g_free(filter->lo_heap), filter->lo_heap = NULL;
+	g_free(filter->hi_heap), filter->hi_heap = NULL;
+
+	filter->lo_count = 0;
+	filter->hi_count = 0;
+	filter->samples = 0;
+	filter->oldest = 0;
+
+EXIT:
+	return;
+}
+
 /**
  * Insert a new sample into the median filter
  *
@@ -157,6 +356,73 @@ EXIT:
 		filter->ordered_window[filter->samples / 2]) / 2;
 }
 
+/**
+ * Insert a new sample into the heap based median filter
+ *
+ * The lower half of the samples is kept in a max-heap and the upper
+ * half in a min-heap; replacing the oldest sample takes O(log n) time
+ *
+ * @param filter The median filter to insert the value into
+ * @param value The value to insert
+ * @return The filtered value
+ */
+static gint insert_heap(median_filter_struct *filter, gint value)
+{
+	gsize slot = filter->oldest;
+	gssize pos;
+
+	filter->values[slot] = value;
+
+	if (filter->samples < filter->window_size) {
+		/* The filter window hasn't been filled yet; add the
+		 * value and keep the lower half equal or one larger */
+		if (filter->lo_count == 0 || value <= heap_get(filter, TRUE, 0))
+			heap_push(filter, TRUE, slot);
+		else
+			heap_push(filter, FALSE, slot);
+
+		if (filter->lo_count > filter->hi_count + 1)
+			heap_push(filter, FALSE, heap_pop(filter, TRUE));
+		else if (filter->hi_count > filter->lo_count)
+			heap_push(filter, TRUE, heap_pop(filter, FALSE));
+
+		filter->samples++;
+		goto EXIT;
+	}
+
+	/* The filter window is full; the new value replaces the oldest
+	 * one in place, then heap order is restored */
+	pos = filter->position[slot];
+
+	if (pos >= 0) {
+		heap_sift_down(filter, TRUE,
+			       heap_sift_up(filter, TRUE, (gsize)pos));
+	} else {
+		heap_sift_down(filter, FALSE,
+			       heap_sift_up(filter, FALSE, (gsize)(-1 - pos)));
+	}
+
+	/* A value that moved across the median ends up at the root
+	 * of its heap; swapping the roots restores the partitioning */
+	if (filter->hi_count > 0 &&
+	    heap_get(filter, TRUE, 0) > heap_get(filter, FALSE, 0)) {
+		gsize lo_slot = filter->lo_heap[0];
+
+		heap_set(filter, TRUE, 0, filter->hi_heap[0]);
+		heap_set(filter, FALSE, 0, lo_slot);
+		heap_sift_down(filter, TRUE, 0);
+		heap_sift_down(filter, FALSE, 0);
+	}
+
+EXIT:
+	/* For odd number of samples return the middle one
+	 * For even number of samples return the average
+	 * of the two middle ones
+	 */
+	return (heap_get(filter, TRUE, 0) +
+		heap_get(filter, filter->lo_count > filter->hi_count, 0)) / 2;
+}
+
 /**
  * Do a complete insertion of a sample into the median filter
  *
@@ -168,6 +434,12 @@ gint median_filter_map(median_filter_struct *filter, gint value)
 {
 	gint filtered_value;
 
+	if (filter->values != NULL) {
+		filtered_value = insert_heap(filter, value);
+		filter->oldest = (filter->oldest + 1) % filter->window_size;
+		goto EXIT;
+	}
+
 	/* Insert into the ordered array (deleting the oldest value) */
 	filtered_value = insert_ordered(filter, value,
 					filter->window[filter->oldest]);
@@ -176,5 +448,6 @@ gint median_filter_map(median_filter_struct *filter, gint value)
 	filter->window[filter->oldest] = value;
 	filter->oldest = (filter->oldest + 1) % filter->window_size;
 
+EXIT:
 	return filtered_value;
 }
@@ -24,7 +24,8 @@
 
 #include <glib.h>
 
-/** Maximum window size of the median filter */
+/** Maximum window size of the median filter using a sorted array;
+ *  filters with larger windows keep the samples in a pair of heaps */
 #define MEDIAN_FILTER_MAX_WINDOW_SIZE	11
 
 /** Median filter */
@@ -36,9 +37,27 @@ typedef struct {
 	gsize oldest;
 	gint window[MEDIAN_FILTER_MAX_WINDOW_SIZE];	/**< Ring buffer */
 	gint ordered_window[MEDIAN_FILTER_MAX_WINDOW_SIZE];	/**< Ordered buffer */
+
+	/* Large windows; unused when window_size is at most
+	 * MEDIAN_FILTER_MAX_WINDOW_SIZE */
+
+	/** Ring buffer for large windows */
+	gint *values;
+	/** Heap position of each ring buffer slot; n >= 0 for index n
+	 *  in lo_heap, -1 - n for index n in hi_heap */
+	gssize *position;
+	/** Max-heap of ring buffer slots holding the lower half */
+	gsize *lo_heap;
+	/** Min-heap of ring buffer slots holding the upper half */
+	gsize *hi_heap;
+	/** Number of slots in lo_heap */
+	gsize lo_count;
+	/** Number of slots in hi_heap */
+	gsize hi_count;
 } median_filter_struct;
 
 gboolean median_filter_init(median_filter_struct *filter, gsize window_size);
+void median_filter_free(median_filter_struct *filter);
 gint median_filter_map(median_filter_struct *filter, gint value);
 
 #endif /* _MEDIAN_FILTER_H_ */
@@ -58,15 +58,26 @@ static DBusConnection *systembus = 0;
 /** Clients we are tracking over D-Bus */
 static GHashTable *clients = 0;
 
-/** Timestamp of wakeup from dsme */
-static time_t wakeup_started  = 0;
+/** Clients with active cpu-keepalive period, min-heap ordered by timeout */
+static GPtrArray *client_heap = 0;
 
-/** Timeout for "clients should have issued keep alive requests" */
-static time_t wakeup_timeout  = 0;
+/** Timestamp of wakeup from dsme [ms] */
+static gint64 wakeup_started  = 0;
 
-/** Timer for releasing cpu-keepalive wakelock */
+/** Timeout for "clients should have issued keep alive requests" [ms] */
+static gint64 wakeup_timeout  = 0;
+
+/** Timer for the earliest cpu-keepalive deadline */
 static guint timer_id = 0;
 
+/** Monotonic time the timer_id is programmed to trigger at [ms] */
+static gint64 timer_when = 0;
+
+#ifdef ENABLE_WAKELOCKS
+/** Whether mce is currently holding the cpu-keepalive wakelock */
+static gboolean cpu_wakelock_held = FALSE;
+#endif
+
 /** Maximum delay between MCE_CPU_KEEPALIVE_START_REQ method calls */
 #ifdef ENABLE_WAKELOCKS
 # define MCE_CPU_KEEPALIVE_PERIOD_SECONDS 60         // 1 minute
@@ -74,6 +85,9 @@ static guint timer_id = 0;
 # define MCE_CPU_KEEPALIVE_PERIOD_SECONDS (60*60*24) // 1 day
 #endif
 
+/** Length of the minor keep-alive period started on period query */
+#define MCE_CPU_KEEPALIVE_MINOR_PERIOD_SECONDS 2
+
 /** Maximum delay between rtc wakeup and the 1st keep alive request */
 #define MCE_RTC_WAKEUP_1ST_TIMEOUT_SECONDS   2
 
@@ -88,15 +102,15 @@ static guint timer_id = 0;
 
 /** Get monotonic timestamp not affected by system time / timezone changes
  *
- * @return seconds since some reference point in time
+ * @return milliseconds since some reference point in time
  */
 static
-time_t
+gint64
 cpu_keepalive_get_time(void)
 {
   struct timespec ts;
   clock_gettime(CLOCK_MONOTONIC, &ts);
-  return ts.tv_sec;
+  return ts.tv_sec * (gint64)1000 + ts.tv_nsec / 1000000;
 }
 
 /* ========================================================================= *
@@ -260,10 +274,148 @@ struct client_t
   /** NameOwnerChanged signal match used for tracking death of client */
   char   *match_rule;
 
-  /** Upper bound for reneval of cpu keepalive for this client */
-  time_t  timeout;
+  /** Upper bound for reneval of cpu keepalive for this client [ms] */
+  gint64  timeout;
+
+  /** Position in client_heap, or CLIENT_HEAP_NONE */
+  guint   heap_pos;
 };
 
+/** Placeholder heap position for clients without active timeout */
+#define CLIENT_HEAP_NONE G_MAXUINT
+
+/** Get client from client_heap position
+ *
+ * @param pos heap position
+ *
+ * @return pointer to client_t structure
+ */
+static
+client_t *
+client_heap_get(guint pos)
+{
+  return g_ptr_array_index(client_heap, pos);
+}
+
+/** Store client to client_heap position
+ *
+ * @param pos  heap position
+ * @param self pointer to client_t structure
+ */
+static
+void
+client_heap_set(guint pos, client_t *self)
+{
+  g_ptr_array_index(client_heap, pos) = self;
+  self->heap_pos = pos;
+}
+
+/** Move client towards the root of client_heap until the order is restored
+ *
+ * @param pos heap position of the client
+ */
+static
+void
+client_heap_sift_up(guint pos)
+{
+  client_t *self = client_heap_get(pos);
+
+  while( pos > 0 )
+  {
+    guint     parent = (pos - 1) / 2;
+    client_t *other  = client_heap_get(parent);
+
+    if( other->timeout <= self->timeout )
+    {
+      break;
+    }
+    client_heap_set(pos, other);
+    pos = parent;
+  }
+  client_heap_set(pos, self);
+}
+
+/** Move client away from the root of client_heap until the order is restored
+ *
+ * @param pos heap position of the client
+ */
+static
+void
+client_heap_sift_down(guint pos)
+{
+  client_t *self  = client_heap_get(pos);
+  guint     count = client_heap->len;
+
+  for( ;; )
+  {
+    guint     child = 2 * pos + 1;
+    client_t *other = 0;
+
+    if( child >= count )
+    {
+      break;
+    }
+    other = client_heap_get(child);
+
+    if( child + 1 < count &&
+	client_heap_get(child + 1)->timeout < other->timeout )
+    {
+      other = client_heap_get(++child);
+    }
+
+    if( self->timeout <= other->timeout )
+    {
+      break;
+    }
+    client_heap_set(pos, other);
+    pos = child;
+  }
+  client_heap_set(pos, self);
+}
+
+/** Remove client from client_heap, if it is there
+ *
+ * @param self pointer to client_t structure
+ */
+static
+void
+client_heap_remove(client_t *self)
+{
+  guint     pos  = self->heap_pos;
+  client_t *last = 0;
+
+  if( pos == CLIENT_HEAP_NONE )
+  {
+    goto EXIT;
+  }
+
+  self->heap_pos = CLIENT_HEAP_NONE;
+
+  last = g_ptr_array_remove_index(client_heap, client_heap->len - 1);
+
+  if( last != self )
+  {
+    client_heap_set(pos, last);
+    client_heap_sift_up(pos);
+    client_heap_sift_down(last->heap_pos);
+  }
+
+EXIT:
+  return;
+}
+
+/** Get client with the earliest cpu-keepalive timeout
+ *
+ * @return pointer to client_t structure, or NULL if there are no
+ *         clients with active timeout
+ */
+static
+client_t *
+client_heap_peek(void)
+{
+  return client_heap->len ? client_heap_get(0) : 0;
+}
+
 /** Clear client cpu-keepalive timeout
  *
  * @param self pointer to client_t structure
@@ -273,6 +425,7 @@ void
 client_clear_timeout(client_t *self)
 {
   self->timeout = 0;
+  client_heap_remove(self);
 }
 
 
@@ -283,11 +436,22 @@ client_clear_timeout(client_t *self)
  */
 static
 void
-client_update_timeout(client_t *self, time_t when)
+client_update_timeout(client_t *self, gint64 when)
 {
   if( self->timeout < when )
   {
     self->timeout = when;
+
+    if( self->heap_pos == CLIENT_HEAP_NONE )
+    {
+      g_ptr_array_add(client_heap, self);
+      client_heap_sift_up(client_heap->len - 1);
+    }
+    else
+    {
+      /* Timeout can only grow -> move away from the root */
+      client_heap_sift_down(self->heap_pos);
+    }
   }
 }
 
@@ -310,6 +474,7 @@ client_create(const char *dbus_name)
   self->dbus_name  = g_strdup(dbus_name);
   self->match_rule = g_strdup_printf(client_match_fmt, self->dbus_name);
   self->timeout    = 0;
+  self->heap_pos   = CLIENT_HEAP_NONE;
 
   mce_log(LL_NOTICE, "added cpu-keepalive client %s", self->dbus_name);
 
@@ -335,6 +500,8 @@ client_delete(client_t *self)
   {
     mce_log(LL_NOTICE, "removed cpu-keepalive client %s", self->dbus_name);
 
+    client_heap_remove(self);
+
     /* NULL error -> match will be removed asynchronously */
     dbus_bus_remove_match(systembus, self->match_rule, 0);
 
@@ -361,10 +528,46 @@ client_delete_cb(void *self)
  *
  * ========================================================================= */
 
+/** Acquire / release cpu-keepalive wakelock
+ *
+ * The sysfs write is made only when the state actually changes, so
+ * clients renewing their keepalive periods do not cause wakelock
+ * traffic.
+ *
+ * @param hold TRUE to acquire, or FALSE to release the wakelock
+ */
+static
+void
+cpu_keepalive_set_wakelock(gboolean hold)
+{
+#ifdef ENABLE_WAKELOCKS
+  if( cpu_wakelock_held != hold )
+  {
+    cpu_wakelock_held = hold;
+
+    if( hold )
+    {
+      mce_log(LL_NOTICE, "cpu-keepalive started");
+      wakelock_lock(cpu_wakelock, -1);
+    }
+    else
+    {
+      mce_log(LL_NOTICE, "cpu-keepalive ended");
+      wakelock_unlock(cpu_wakelock);
+    }
+  }
+#else
+  (void)hold;
+#endif
+}
+
+static void cpu_keepalive_rethink(void);
+
 /** Handle triggering of cpu-keepalive timer
  *
- * Releases cpu keepalive wakelock and thus allows the system to
- * enter late suspend according to other policies.
+ * Expires client keepalive periods that have ended, and releases
+ * cpu keepalive wakelock if no active periods are left, which allows
+ * the system to enter late suspend according to other policies.
  *
  * @param data (not used)
  *
@@ -378,18 +581,14 @@ cpu_keepalive_timer_cb(gpointer data)
 
   if( timer_id != 0 )
   {
-    mce_log(LL_NOTICE, "cpu-keepalive ended");
     timer_id = 0;
-
-#ifdef ENABLE_WAKELOCKS
-    wakelock_unlock(cpu_wakelock);
-#endif
+    cpu_keepalive_rethink();
   }
 
   return FALSE;
 }
 
-/** Cancel end of cpu-keepalive timer
+/** Cancel cpu-keepalive timer
  */
 static
 void
@@ -401,61 +600,75 @@ cpu_keepalive_cancel_timer(void)
   }
 }
 
-/** Reset cpu-keepalive timer
+/** Program cpu-keepalive timer
+ *
+ * The timer is left as is if it already triggers at the given time.
  *
- * @param when monotonic time of the end of cpu-keepalive period
+ * @param when monotonic time of the next deadline [ms]
+ * @param now  current monotonic time [ms]
  */
 static
 void
-cpu_keepalive_set_timer(time_t when)
+cpu_keepalive_set_timer(gint64 when, gint64 now)
 {
-  cpu_keepalive_cancel_timer();
-
-  time_t now = cpu_keepalive_get_time();
+  if( timer_id != 0 && timer_when == when )
+  {
+    goto EXIT;
+  }
 
-  if( when < now ) when = now;
+  cpu_keepalive_cancel_timer();
 
-  mce_log(LL_NOTICE, "cpu-keepalive ends at T%+d", (int)(now - when));
+  mce_log(LL_DEBUG, "next cpu-keepalive deadline at T%+"G_GINT64_FORMAT" ms",
+	  now - when);
 
-  if( now < when )
-  {
-    timer_id = g_timeout_add_seconds(when - now,
-				     cpu_keepalive_timer_cb, 0);
-  }
-  else
-  {
-    timer_id = g_idle_add(cpu_keepalive_timer_cb, 0);
-  }
+  timer_when = when;
+  timer_id   = g_timeout_add((guint)MIN(when - now, G_MAXUINT),
+			     cpu_keepalive_timer_cb, 0);
+EXIT:
+  return;
 }
 
-/** Re-evaluate the end of cpu-keepalive period
+/** Re-evaluate the cpu-keepalive status
  *
- * Calculates maximum of wakeup period and per client renew periods
- * and uses it to reprogram the end of cpu-keepalive period
+ * Drops expired client periods and programs the timer for the
+ * earliest of the remaining client deadlines and the rtc wakeup
+ * timeout. The cpu-keepalive wakelock is held as long as there
+ * are pending deadlines.
  */
 static
 void
 cpu_keepalive_rethink(void)
 {
-  time_t maxtime = wakeup_timeout;
+  gint64    now    = cpu_keepalive_get_time();
+  gint64    next   = 0;
+  client_t *client = 0;
 
-  GHashTableIter iter;
-  gpointer key, val;
+  while( (client = client_heap_peek()) && client->timeout <= now )
+  {
+    mce_log(LL_INFO, "cpu-keepalive expired for %s", client->dbus_name);
+    client_clear_timeout(client);
+  }
 
-#ifdef ENABLE_WAKELOCKS
-  wakelock_lock(cpu_wakelock, -1);
-#endif
+  if( wakeup_timeout > now )
+  {
+    next = wakeup_timeout;
+  }
 
-  g_hash_table_iter_init(&iter, clients);
-  while( g_hash_table_iter_next (&iter, &key, &val) )
+  if( client && (!next || client->timeout < next) )
   {
-    client_t *client = val;
-    if( maxtime < client->timeout )
-    {
-      maxtime = client->timeout;
-    }
+    next = client->timeout;
+  }
+
+  if( next )
+  {
+    cpu_keepalive_set_wakelock(TRUE);
+    cpu_keepalive_set_timer(next, now);
+  }
+  else
+  {
+    cpu_keepalive_cancel_timer();
+    cpu_keepalive_set_wakelock(FALSE);
   }
-  cpu_keepalive_set_timer(maxtime);
 }
 
 /* ========================================================================= *
@@ -623,7 +836,8 @@ cpu_keepalive_register(const gchar *dbus_name)
 {
   client_t *client = cpu_keepalive_add_client(dbus_name);
 
-  time_t when = cpu_keepalive_get_time() + 2;
+  gint64 when = (cpu_keepalive_get_time() +
+		 MCE_CPU_KEEPALIVE_MINOR_PERIOD_SECONDS * 1000);
 
   client_update_timeout(client, when);
 
@@ -642,13 +856,14 @@ cpu_keepalive_start(const gchar *dbus_name)
 {
   client_t *client = cpu_keepalive_add_client(dbus_name);
 
-  time_t when = cpu_keepalive_get_time() + MCE_CPU_KEEPALIVE_PERIOD_SECONDS;
+  gint64 when = (cpu_keepalive_get_time() +
+		 MCE_CPU_KEEPALIVE_PERIOD_SECONDS * (gint64)1000);
 
   client_update_timeout(client, when);
 
   /* We got at least one keep alive request, extend the minimum
    * alive time a bit to give other clients time to get scheduled */
-  wakeup_timeout = wakeup_started + MCE_RTC_WAKEUP_2ND_TIMEOUT_SECONDS;
+  wakeup_timeout = wakeup_started + MCE_RTC_WAKEUP_2ND_TIMEOUT_SECONDS * 1000;
 
   cpu_keepalive_rethink();
 }
@@ -689,7 +904,7 @@ cpu_keepalive_wakeup(const gchar *dbus_name)
   wakeup_started = cpu_keepalive_get_time();
 
   /* Timeout for the 1st keepalive message to come through */
-  wakeup_timeout = wakeup_started + MCE_RTC_WAKEUP_1ST_TIMEOUT_SECONDS;
+  wakeup_timeout = wakeup_started + MCE_RTC_WAKEUP_1ST_TIMEOUT_SECONDS * 1000;
 
   cpu_keepalive_rethink();
 
@@ -962,6 +1177,8 @@ const gchar *g_module_check_init(GModule *module)
     goto EXIT;
   }
 
+  client_heap = g_ptr_array_new();
+
   clients = g_hash_table_new_full(g_str_hash, g_str_equal,
 				  g_free, client_delete_cb);
 
@@ -987,6 +1204,16 @@ void g_module_unload(GModule *module)
     g_hash_table_unref(clients), clients = 0;
   }
 
+  if( client_heap )
+  {
+    g_ptr_array_free(client_heap, TRUE), client_heap = 0;
+  }
+
+  cpu_keepalive_cancel_timer();
+
+  /* Without the timer nothing would release the wakelock */
+  cpu_keepalive_set_wakelock(FALSE);
+
   if( systembus )
   {
     cpu_keepalive_detach_from_dbus();
@@ -65,10 +65,11 @@
 					 * mce_write_number_string_to_file()
 					 */
 #include "mce-lib.h"			/* strstr_delim(),
+					 * mce_lib_get_mono_tick(),
 					 * mce_translate_string_to_int_with_default(),
 					 * mce_translation_t
 					 */
-#include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-log.h"			/* mce_log(), mce_trace(), LL_* */
 #include "mce-conf.h"			/* mce_conf_get_int(),
 					 * mce_conf_get_string()
 					 */
@@ -274,8 +275,25 @@ static const gchar *cabc_mode = DEFAULT_CABC_MODE;
  */
 static const gchar *psm_cabc_mode = NULL;
 
-/** Fadeout step length */
-static gint brightness_fade_steplength = 2;
+/** Software brightness fade state */
+static struct {
+	/** Brightness at the start of the fade */
+	gint   start_brightness;
+	/** Monotonic time at the start of the fade [ms] */
+	gint64 start_tick;
+	/** Length of the fade [ms] */
+	gint   duration;
+	/** Time between brightness writes [ms] */
+	gint   interval;
+} brightness_fade = {
+	.start_brightness = 0,
+	.start_tick = 0,
+	.duration = 0,
+	.interval = 0,
+};
+
+/** Maximum rate of brightness writes during software fade [Hz] */
+static gint brightness_fade_max_rate = DEFAULT_BRIGHTNESS_FADE_MAX_RATE;
 
 /** Brightness fade timeout callback ID */
 static guint brightness_fade_timeout_cb_id = 0;
@@ -300,6 +318,8 @@ static output_state_t brightness_output =
   .context = "brightness",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
 };
 
 /** File used to get maximum display brightness */
@@ -325,6 +345,8 @@ static output_state_t high_brightness_mode_output =
   .context = "high_brightness_mode",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
 };
 
 /** Is display high brightness mode supported */
@@ -1434,36 +1456,53 @@ static void write_brightness_value(int number)
 	//       and power it up at non-zero brightness???
 }
 
+static void setup_brightness_fade_timeout(gint delay);
+
 /**
  * Timeout callback for the brightness fade
  *
+ * The brightness is calculated from the time elapsed since the
+ * start of the fade, so late wakeups just skip the steps that
+ * should already have been taken.
+ *
  * @param data Unused
- * @return Returns TRUE to repeat, until the cached brightness has reached
- *         the destination value; when this happens, FALSE is returned
+ * @return Always returns FALSE; the timeout is re-armed until the
+ *         cached brightness has reached the destination value
  */
 static gboolean brightness_fade_timeout_cb(gpointer data)
 {
-	gboolean retval = TRUE;
+	gint64 elapsed = 0;
+	gint brightness = target_brightness;
 
 	(void)data;
 
-	if ((cached_brightness == -1) ||
-	    (ABS(cached_brightness -
-		 target_brightness) < brightness_fade_steplength)) {
-		cached_brightness = target_brightness;
-		retval = FALSE;
-	} else if (target_brightness > cached_brightness) {
-		cached_brightness += brightness_fade_steplength;
-	} else {
-		cached_brightness -= brightness_fade_steplength;
+	brightness_fade_timeout_cb_id = 0;
+
+	if (cached_brightness != -1) {
+		elapsed = (mce_lib_get_mono_tick() -
+			   brightness_fade.start_tick);
 	}
 
-	write_brightness_value(cached_brightness);
+	if ((cached_brightness != -1) &&
+	    (elapsed < brightness_fade.duration)) {
+		brightness = (brightness_fade.start_brightness +
+			      (gint)((target_brightness -
+				      brightness_fade.start_brightness) *
+				     elapsed / brightness_fade.duration));
 
-	if (retval == FALSE)
-		 brightness_fade_timeout_cb_id = 0;
+		/* Wake up on time for the end of the fade */
+		setup_brightness_fade_timeout(MIN(brightness_fade.interval,
+						  (gint)(brightness_fade.duration -
+							 elapsed)));
+	}
+
+	/* Skip writes that would not change anything */
+	if (brightness != cached_brightness) {
+		cached_brightness = brightness;
+		write_brightness_value(cached_brightness);
+	}
 
-	return retval;
+	return FALSE;
 }
 
 /**
@@ -1481,15 +1520,15 @@ static void cancel_brightness_fade_timeout(void)
 /**
  * Setup the brightness fade timeout
  *
- * @param step_time The time between each brightness step
+ * @param delay The time until the next brightness update
  */
-static void setup_brightness_fade_timeout(gint step_time)
+static void setup_brightness_fade_timeout(gint delay)
 {
 	cancel_brightness_fade_timeout();
 
 	/* Setup new timeout */
 	brightness_fade_timeout_cb_id =
-		g_timeout_add(step_time, brightness_fade_timeout_cb, NULL);
+		g_timeout_add(delay, brightness_fade_timeout_cb, NULL);
 }
 
 /**
@@ -1502,7 +1541,10 @@ static void setup_brightness_fade_timeout(gint step_time)
 static void update_brightness_fade(gint new_brightness)
 {
 	gboolean increase = (new_brightness >= cached_brightness);
-	gint step_time = 10;
+	gint steps = ABS(new_brightness - cached_brightness);
+	gint step_time = -1;
+	gint duration = 0;
+	gint interval = 0;
 
 	/* This should never happen, but just in case */
 	if (cached_brightness == new_brightness)
@@ -1534,28 +1576,40 @@ static void update_brightness_fade(gint new_brightness)
 	if (increase == TRUE) {
 		if (brightness_increase_policy == BRIGHTNESS_CHANGE_STEP_TIME)
 			step_time = brightness_increase_step_time;
-		else {
-			step_time = brightness_increase_constant_time /
-				    (new_brightness - cached_brightness);
-		}
+		else
+			duration = brightness_increase_constant_time;
 	} else {
 		if (brightness_decrease_policy == BRIGHTNESS_CHANGE_STEP_TIME)
 			step_time = brightness_decrease_step_time;
-		else {
-			step_time = brightness_decrease_constant_time /
-				    (cached_brightness - new_brightness);
-		}
+		else
+			duration = brightness_decrease_constant_time;
 	}
 
-	/* Special case */
-	if (step_time == 5) {
-		step_time = 2;
-		brightness_fade_steplength = 2;
-	} else {
-		brightness_fade_steplength = 1;
-	}
+	/* Special case: step time 5 has always meant 2 steps
+	 * every 2 ms, i.e. 1 ms per step */
+	if (step_time == 5)
+		duration = steps;
+	else if (step_time >= 0)
+		duration = step_time * steps;
+
+	/* One brightness step per write, unless that would
+	 * exceed the maximum write rate */
+	interval = duration / MAX(steps, 1);
+
+	if (brightness_fade_max_rate > 0)
+		interval = MAX(interval, 1000 / brightness_fade_max_rate);
+
+	brightness_fade.start_brightness = cached_brightness;
+	brightness_fade.start_tick = mce_lib_get_mono_tick();
+	brightness_fade.duration = MAX(duration, 1);
+	brightness_fade.interval = MAX(interval, 1);
+
+	mce_log(LL_DEBUG, "fade %d -> %d in %d ms, every %d ms",
+		cached_brightness, target_brightness,
+		brightness_fade.duration, brightness_fade.interval);
 
-	setup_brightness_fade_timeout(step_time);
+	setup_brightness_fade_timeout(MIN(brightness_fade.interval,
+					  brightness_fade.duration));
 
 EXIT:
 	return;
@@ -2584,6 +2638,12 @@ typedef struct
 	/** worker thread done flag */
 	bool finished;
 
+	/** errno value from failed worker thread operation */
+	int  error;
+
+	/** path of the file the failed worker thread operation was on */
+	const char *error_path;
+
 	/** path to fb wakeup event file */
 	const char *wake_path;
 
@@ -2601,13 +2661,91 @@ typedef struct
 
 	/** pipe reader io watch id */
 	guint     pipe_id;
+
+	/** path to fb state file supporting poll() notifications, or NULL */
+	gchar      *state_path;
+
+	/** state file descriptor */
+	int         state_fd;
+
+	/** state file io watch id */
+	guint       state_id;
 } waitfb_t;
 
+/** Cleanup handler for fb sleep/wakeup thread
+ *
+ * Marks the thread finished when it is cancelled or exits.
+ *
+ * @param aptr state data (as void pointer)
+ */
+static void waitfb_thread_cleanup(void *aptr)
+{
+	waitfb_t *self = aptr;
+
+	self->finished = true;
+}
+
+/** Cleanup handler for fb sleep/wakeup event file
+ *
+ * The file descriptor is invalidated before closing so that it
+ * can not get closed twice even if the thread gets cancelled
+ * within close().
+ *
+ * @param aptr file descriptor (as void pointer)
+ */
+static void waitfb_thread_close(void *aptr)
+{
+	int *fd  = aptr;
+	int  tmp = *fd;
+
+	if( tmp != -1 )
+		*fd = -1, close(tmp);
+}
+
+/** Block in read from fb sleep/wakeup event file
+ *
+ * The file is closed only by waitfb_thread_close(), both after
+ * the read and when the thread is cancelled while blocked in it.
+ *
+ * @param self state data
+ * @param path file to read
+ * @param fd   where to store the file descriptor while reading
+ *
+ * @return true once the read returns, or false on errors
+ */
+static bool waitfb_thread_wait(waitfb_t *self, const char *path, int *fd)
+{
+	char tmp[32];
+	int  err = 0;
+
+	if( (*fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY))) == -1 ) {
+		err = errno;
+	}
+	else {
+		pthread_cleanup_push(waitfb_thread_close, fd);
+		if( TEMP_FAILURE_RETRY(read(*fd, tmp, sizeof tmp)) == -1 )
+			err = errno;
+		pthread_cleanup_pop(1);
+	}
+
+	if( err ) {
+		/* Reported to mainloop via the pipe; stdio and mce_log()
+		 * are not to be used from this thread */
+		self->error = err;
+		self->error_path = path;
+	}
+
+	return err == 0;
+}
+
 /** Wait for fb sleep/wakeup thread
  *
  * Alternates between waiting for fb wakeup and sleep.
  * Signals mainloop about the changes via a pipe.
  *
+ * The thread uses deferred cancellation; it can be cancelled
+ * only while blocked in the open/read/write system calls.
+ *
  * @param aptr state data (as void pointer)
  *
  * @return 0
@@ -2616,56 +2754,48 @@ static void *waitfb_thread(void *aptr)
 {
 	waitfb_t *self = aptr;
 
-	/* allow quick and dirty cancellation */
 	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, 0);
-	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, 0);
+	pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, 0);
 
-	/* block in sysfs read */
-	char tmp[32];
-	int rc;
-	for( ;; ) {
-		// FIXME: check if mce_log() is thread safe
+	pthread_cleanup_push(waitfb_thread_cleanup, self);
 
+	for( ;; ) {
 		/* wait for fb wakeup */
-		self->wake_fd = TEMP_FAILURE_RETRY(open(self->wake_path,
-							O_RDONLY));
-		if( self->wake_fd == -1 ) {
-			fprintf(stderr, "%s: open: %m", self->wake_path);
-			break;
-		}
-		rc = TEMP_FAILURE_RETRY(read(self->wake_fd, tmp, sizeof tmp));
-		if( rc == -1 ) {
-			fprintf(stderr, "%s: %m", self->wake_path);
+		if( !waitfb_thread_wait(self, self->wake_path,
+					&self->wake_fd) )
 			break;
-		}
-		TEMP_FAILURE_RETRY(close(self->wake_fd)), self->wake_fd = -1;
 
 		/* send "woke up" to mainloop */
 		TEMP_FAILURE_RETRY(write(self->pipe_fd, "W", 1));
 
 		/* wait for fb sleep */
-		self->sleep_fd = TEMP_FAILURE_RETRY(open(self->sleep_path,
-							 O_RDONLY));
-		if( self->sleep_fd == -1 ) {
-			fprintf(stderr, "%s: open: %m", self->sleep_path);
-			break;
-		}
-		rc = TEMP_FAILURE_RETRY(read(self->sleep_fd, tmp, sizeof tmp));
-		if( rc == -1 ) {
-			fprintf(stderr, "%s: %m", self->sleep_path);
+		if( !waitfb_thread_wait(self, self->sleep_path,
+					&self->sleep_fd) )
 			break;
-		}
-		TEMP_FAILURE_RETRY(close(self->sleep_fd)), self->sleep_fd = -1;
 
 		/* send "sleeping" to mainloop */
 		TEMP_FAILURE_RETRY(write(self->pipe_fd, "S", 1));
 	}
 
+	/* send "exited" to mainloop */
+	TEMP_FAILURE_RETRY(write(self->pipe_fd, "X", 1));
+
 	/* mark thread done and exit */
-	self->finished = true;
+	pthread_cleanup_pop(1);
 	return 0;
 }
 
+/** Predicate for: fb sleep/wakeup is being tracked
+ *
+ * @param self state data
+ *
+ * @return true if fb state changes are tracked, false otherwise
+ */
+static bool waitfb_is_active(const waitfb_t *self)
+{
+	return self->thread || self->state_id;
+}
+
 /** Release all dynamic resources related to fb resume waiting
  *
  * @param self state data
@@ -2673,16 +2803,18 @@ static void *waitfb_thread(void *aptr)
 static void waitfb_cancel(waitfb_t *self)
 {
 	/* cancel worker thread */
-	if( self->thread && !self->finished ) {
-		mce_log(LL_DEBUG, "stopping waitfb thread");
-		if( pthread_cancel(self->thread) != 0 ) {
-			mce_log(LL_ERR, "failed to stop waitfb thread");
-		}
-		else {
-			void *status = 0;
-			pthread_join(self->thread, &status);
-			mce_log(LL_DEBUG, "thread stopped, status = %p", status);
+	if( self->thread ) {
+		if( !self->finished ) {
+			mce_log(LL_DEBUG, "stopping waitfb thread");
+			if( pthread_cancel(self->thread) != 0 )
+				mce_log(LL_ERR, "failed to stop waitfb thread");
 		}
+
+		/* the thread exits at the next cancellation point
+		 * or has already exited -> can be joined */
+		void *status = 0;
+		pthread_join(self->thread, &status);
+		mce_log(LL_DEBUG, "thread stopped, status = %p", status);
 	}
 	self->thread  = 0;
 
@@ -2698,14 +2830,16 @@ static void waitfb_cancel(waitfb_t *self)
 		close(self->pipe_fd), self->pipe_fd = -1;
 	}
 
-	/* close sysfs input fds */
-	if( self->sleep_fd != -1 ) {
-		mce_log(LL_DEBUG, "close %s", self->sleep_path);
-		close(self->sleep_fd), self->sleep_fd = -1;
+	/* remove state file io watch */
+	if( self->state_id ) {
+		mce_log(LL_DEBUG, "remove %s watch", self->state_path);
+		g_source_remove(self->state_id), self->state_id = 0;
 	}
-	if( self->wake_fd != -1 ) {
-		mce_log(LL_DEBUG, "close %s", self->wake_path);
-		close(self->wake_fd), self->wake_fd = -1;
+
+	/* close state file fd */
+	if( self->state_fd != -1 ) {
+		mce_log(LL_DEBUG, "close %s", self->state_path);
+		close(self->state_fd), self->state_fd = -1;
 	}
 }
 
@@ -2749,6 +2883,12 @@ static gboolean waitfb_event_cb(GIOChannel *chn,
 		goto EXIT;
 	}
 
+	if( tmp[rc-1] == 'X' ) {
+		mce_log(LL_ERR, "%s: %s", self->error_path ?: "waitfb",
+			g_strerror(self->error));
+		goto EXIT;
+	}
+
 	keep = TRUE;
 	self->suspended = (tmp[rc-1] == 'S');
 	mce_log(LL_NOTICE, "read:%d, suspended:%d", rc, self->suspended);
@@ -2763,7 +2903,148 @@ EXIT:
 	return keep;
 }
 
+/** Read frame buffer state from state file
+ *
+ * The file is expected to contain "awake" or "asleep".
+ *
+ * @param self      state data
+ * @param suspended where to store the frame buffer suspended state
+ *
+ * @return true on success, or false on failure
+ */
+static bool waitfb_read_state(waitfb_t *self, bool *suspended)
+{
+	bool res = false;
+	char tmp[32];
+	int  rc;
+
+	/* sysfs notifications are re-armed by reading from the start */
+	if( lseek(self->state_fd, 0, SEEK_SET) == -1 ) {
+		mce_log(LL_ERR, "%s: seek: %m", self->state_path);
+		goto EXIT;
+	}
+
+	rc = TEMP_FAILURE_RETRY(read(self->state_fd, tmp, sizeof tmp - 1));
+	if( rc == -1 ) {
+		mce_log(LL_ERR, "%s: read: %m", self->state_path);
+		goto EXIT;
+	}
+	tmp[rc] = 0;
+
+	if( !strncmp(tmp, "asleep", 6) )
+		*suspended = true;
+	else if( !strncmp(tmp, "awake", 5) )
+		*suspended = false;
+	else {
+		mce_log(LL_ERR, "%s: unknown state: %s", self->state_path,
+			tmp);
+		goto EXIT;
+	}
+
+	res = true;
+
+EXIT:
+	return res;
+}
+
+/** Priority input watch callback for frame buffer state file
+ *
+ * Gets triggered when the kernel notifies about state file change
+ *
+ * @param chn  (not used)
+ * @param cnd  (not used)
+ * @param aptr state data (as void pointer)
+ *
+ * @return TRUE to keep the watch, or FALSE to disable it
+ */
+static gboolean waitfb_state_cb(GIOChannel *chn,
+				GIOCondition cnd,
+				gpointer aptr)
+{
+	(void)chn; (void)cnd;
+
+	waitfb_t *self = aptr;
+	gboolean  keep = FALSE;
+	bool      suspended = self->suspended;
+
+	if( !self->state_id )
+		goto EXIT;
+
+	if( !waitfb_read_state(self, &suspended) )
+		goto EXIT;
+
+	keep = TRUE;
+
+	if( self->suspended != suspended ) {
+		self->suspended = suspended;
+		mce_log(LL_NOTICE, "suspended:%d", self->suspended);
+		stm_rethink_schedule();
+	}
+
+EXIT:
+	if( !keep && self->state_id ) {
+		self->state_id = 0;
+		mce_log(LL_CRIT, "stopping io watch");
+		waitfb_cancel(self);
+	}
+	return keep;
+}
+
+/** Start tracking frame buffer state via state file notifications
+ *
+ * Unlike the wait_for_fb_* files, the state file can be read without
+ * blocking and changes are signaled via POLLPRI, so no worker thread
+ * is needed.
+ *
+ * @param self state data
+ *
+ * @return TRUE if tracking was started, FALSE otherwise
+ */
+static gboolean waitfb_start_notify(waitfb_t *self)
+{
+	gboolean    res = FALSE;
+	GIOChannel *chn = 0;
+	bool        suspended = false;
+
+	if( !self->state_path || !*self->state_path )
+		goto EXIT;
+
+	self->state_fd = open(self->state_path, O_RDONLY | O_CLOEXEC);
+	if( self->state_fd == -1 ) {
+		mce_log(LL_WARN, "%s: open: %m", self->state_path);
+		goto EXIT;
+	}
+
+	/* initial state; also arms the notification */
+	if( !waitfb_read_state(self, &suspended) )
+		goto EXIT;
+
+	if( !(chn = g_io_channel_unix_new(self->state_fd)) )
+		goto EXIT;
+
+	self->state_id = g_io_add_watch(chn, G_IO_PRI | G_IO_ERR,
+					waitfb_state_cb, self);
+	if( !self->state_id )
+		goto EXIT;
+
+	self->suspended = suspended;
+	mce_log(LL_NOTICE, "tracking %s, suspended:%d", self->state_path,
+		self->suspended);
+	stm_rethink_schedule();
+
+	res = TRUE;
+
+EXIT:
+	if( chn != 0 ) g_io_channel_unref(chn);
+
+	return res;
+}
+
 /** Start delayed display state change broadcast
+ *
+ * Frame buffer state is tracked from the mainloop if a state file
+ * supporting poll() notifications is configured, otherwise with
+ * a worker thread blocking in wait_for_fb_* reads.
  *
  * @param self state data
  *
@@ -2778,6 +3059,12 @@ static gboolean waitfb_start(waitfb_t *self)
 	waitfb_cancel(self);
 
 #ifdef ENABLE_WAKELOCKS
+	if( waitfb_start_notify(self) ) {
+		res = TRUE;
+		goto EXIT;
+	}
+	waitfb_cancel(self);
+
 	if( access(self->wake_path, F_OK) == -1 ||
 	    access(self->sleep_path, F_OK) == -1 )
 		goto EXIT;
@@ -2800,9 +3087,12 @@ static gboolean waitfb_start(waitfb_t *self)
 
 
 	self->finished = false;
+	self->error = 0;
+	self->error_path = 0;
 
 	if( pthread_create(&self->thread, 0, waitfb_thread, self) ) {
 		mce_log(LL_ERR, "failed to create waitfb thread");
+		self->thread = 0;
 		goto EXIT;
 	}
 
@@ -2826,12 +3116,17 @@ static waitfb_t waitfb =
 	.suspended  = false,
 	.thread     = 0,
 	.finished   = false,
+	.error      = 0,
+	.error_path = 0,
 	.wake_path  = "/sys/power/wait_for_fb_wake",
 	.wake_fd    = -1,
 	.sleep_path = "/sys/power/wait_for_fb_sleep",
 	.sleep_fd   = -1,
 	.pipe_fd    = -1,
 	.pipe_id    = 0,
+	.state_path = 0,
+	.state_fd   = -1,
+	.state_id   = 0,
 };
 
 /**
@@ -4754,7 +5049,7 @@ static bool stm_suspend_allowed_early(void)
 {
 #ifdef ENABLE_WAKELOCKS
 	bool res = (suspend_allow_state() != 0);
-	mce_log(LL_INFO, "res=%s", res ? "true" : "false");
+	mce_trace(LL_INFO, "res=%s", res ? "true" : "false");
 	return res;
 #else
 	// "early suspend" in state machine transforms in to
@@ -4767,7 +5062,7 @@ static bool stm_suspend_allowed_late(void)
 {
 #ifdef ENABLE_WAKELOCKS
 	bool res = (suspend_allow_state() == 2);
-	mce_log(LL_INFO, "res=%s", res ? "true" : "false");
+	mce_trace(LL_INFO, "res=%s", res ? "true" : "false");
 	return res;
 #else
 	return false;
@@ -4777,39 +5072,39 @@ static bool stm_suspend_allowed_late(void)
 static void stm_suspend_start(void)
 {
 #ifdef ENABLE_WAKELOCKS
-	mce_log(LL_NOTICE, "suspending");
-	if( waitfb.thread )
+	mce_trace(LL_NOTICE, "suspending");
+	if( waitfb_is_active(&waitfb) )
 		wakelock_allow_suspend();
 	else
 		waitfb.suspended = true, backlight_ioctl(FB_BLANK_POWERDOWN);
 #else
-	mce_log(LL_NOTICE, "power off frame buffer");
+	mce_trace(LL_NOTICE, "power off frame buffer");
 	waitfb.suspended = true, backlight_ioctl(FB_BLANK_POWERDOWN);
 #endif
 }
 static void stm_resume_start(void)
 {
 #ifdef ENABLE_WAKELOCKS
-	mce_log(LL_NOTICE, "resuming");
-	if( waitfb.thread )
+	mce_trace(LL_NOTICE, "resuming");
+	if( waitfb_is_active(&waitfb) )
 		wakelock_block_suspend();
 	else
 		waitfb.suspended = false, backlight_ioctl(FB_BLANK_UNBLANK);
 #else
-	mce_log(LL_NOTICE, "power off frame buffer");
+	mce_trace(LL_NOTICE, "power off frame buffer");
 	waitfb.suspended = false, backlight_ioctl(FB_BLANK_UNBLANK);
 #endif
 }
 static bool stm_suspend_finished(void)
 {
 	bool res = waitfb.suspended;
-	mce_log(LL_INFO, "res=%s", res ? "true" : "false");
+	mce_trace(LL_INFO, "res=%s", res ? "true" : "false");
 	return res;
 }
 static bool stm_resume_finished(void)
 {
 	bool res = !waitfb.suspended;
-	mce_log(LL_INFO, "res=%s", res ? "true" : "false");
+	mce_trace(LL_INFO, "res=%s", res ? "true" : "false");
 	return res;
 }
 
@@ -4842,7 +5137,7 @@ static void stm_wakelock_release(void)
 	if( stm_wakelock_acquired ) {
 		stm_wakelock_acquired = false;
 #ifdef ENABLE_WAKELOCKS
-		mce_log(LL_INFO, "wakelock released");
+		mce_trace(LL_INFO, "wakelock released");
 		wakelock_unlock("mce_display_on");
 #endif
 	}
@@ -4854,7 +5149,7 @@ static void stm_wakelock_acquire(void)
 		stm_wakelock_acquired = true;
 #ifdef ENABLE_WAKELOCKS
 		wakelock_lock("mce_display_on", -1);
-		mce_log(LL_INFO, "wakelock acquired");
+		mce_trace(LL_INFO, "wakelock acquired");
 #endif
 	}
 }
@@ -4862,7 +5157,7 @@ static void stm_wakelock_acquire(void)
 static void stm_trans(stm_state_t state)
 {
 	if( dstate != state ) {
-		mce_log(LL_INFO, "STM: %s -> %s",
+		mce_trace(LL_INFO, "STM: %s -> %s",
 			stm_state_name(dstate),
 			stm_state_name(state));
 		dstate = state;
@@ -5147,12 +5442,12 @@ static void stm_rethink_step(void)
 static void stm_rethink(void)
 {
 	stm_state_t prev;
-	mce_log(LL_INFO, "ENTER @ %s", stm_state_name(dstate));
+	mce_trace(LL_INFO, "ENTER @ %s", stm_state_name(dstate));
 	do {
 		prev = dstate;
 		stm_rethink_step();
 	} while( dstate != prev );
-	mce_log(LL_INFO, "LEAVE @ %s", stm_state_name(dstate));
+	mce_trace(LL_INFO, "LEAVE @ %s", stm_state_name(dstate));
 }
 
 static gboolean stm_rethink_cb(gpointer aptr)
@@ -5177,7 +5472,7 @@ static void stm_rethink_cancel(void)
 {
 	if( stm_rethink_id ) {
 		g_source_remove(stm_rethink_id), stm_rethink_id = 0;
-		mce_log(LL_INFO, "cancelled");
+		mce_trace(LL_INFO, "cancelled");
 		wakelock_unlock("mce_display_stm");
 	}
 }
@@ -5186,7 +5481,7 @@ static void stm_rethink_schedule(void)
 {
 	if( !stm_rethink_id ) {
 		wakelock_lock("mce_display_stm", -1);
-		mce_log(LL_INFO, "scheduled");
+		mce_trace(LL_INFO, "scheduled");
 		stm_rethink_id = g_idle_add(stm_rethink_cb, 0);
 	}
 }
@@ -5787,6 +6082,11 @@ const gchar *g_module_check_init(GModule *module)
 				 MCE_CONF_CONSTANT_TIME_DECREASE,
 				 DEFAULT_BRIGHTNESS_DECREASE_CONSTANT_TIME);
 
+	brightness_fade_max_rate =
+		mce_conf_get_int(MCE_CONF_DISPLAY_GROUP,
+				 MCE_CONF_BRIGHTNESS_FADE_MAX_RATE,
+				 DEFAULT_BRIGHTNESS_FADE_MAX_RATE);
+
 	/* Note: Transition to MCE_DISPLAY_OFF can be made already
 	 * here, but the MCE_DISPLAY_ON state is blocked until mCE
 	 * gets notification from DSME */
@@ -5799,6 +6099,9 @@ const gchar *g_module_check_init(GModule *module)
 			       USE_INDATA, CACHE_INDATA);
 
 
+	waitfb.state_path = mce_conf_get_string(MCE_CONF_DISPLAY_GROUP,
+						MCE_CONF_FB_STATE_PATH,
+						0);
 	waitfb_start(&waitfb);
 
 	/* Re-evaluate the power on LED state from idle callback
@@ -5825,6 +6128,7 @@ void g_module_unload(GModule *module)
 
 	/* Kill the framebuffer sleep/wakeup thread */
 	waitfb_cancel(&waitfb);
+	g_free(waitfb.state_path), waitfb.state_path = 0;
 
 	/* Stop waiting for init_done state */
 	init_done_stop_tracking();
@@ -42,6 +42,12 @@
 /** Name of the configuration key for the constant time brightness decrease */
 #define MCE_CONF_CONSTANT_TIME_DECREASE		"ConstantTimeDecrease"
 
+/** Name of the configuration key for the maximum brightness fade write rate */
+#define MCE_CONF_BRIGHTNESS_FADE_MAX_RATE	"BrightnessFadeMaxRate"
+
+/** Name of the configuration key for the frame buffer state file */
+#define MCE_CONF_FB_STATE_PATH			"FbStatePath"
+
 /** Default brightness increase step-time */
 #define DEFAULT_BRIGHTNESS_INCREASE_STEP_TIME		5
 
@@ -54,6 +60,9 @@
 /** Default brightness decrease constant time */
 #define DEFAULT_BRIGHTNESS_DECREASE_CONSTANT_TIME	3000
 
+/** Default maximum brightness fade write rate; in Hz */
+#define DEFAULT_BRIGHTNESS_FADE_MAX_RATE		60
+
 /** Default timeout for the high brightness mode; in seconds */
 #define DEFAULT_HBM_TIMEOUT				1800	/* 30 min */
 
@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include <glib.h>
 #include <gmodule.h>
@@ -65,15 +66,45 @@ enum
 	 * Enough to cover 5% to 95% in 5% steps.
 	 */
 	ALS_LUX_STEPS = 20, // allows 5% steps for [5 ... 100] range
+
+	/** Maximum number of steps in a compiled brightness curve
+	 *
+	 * One step per brightness percentage in [0 ... 100] range.
+	 */
+	ALS_CURVE_STEPS = 101,
+
+	/** Lux drop needed for dimming the display, in percent
+	 *
+	 * Relative to the lux value the current level was selected for.
+	 */
+	ALS_HYSTERESIS_PERCENT = 10,
+
+	/** Minimum lux drop needed for dimming the display */
+	ALS_HYSTERESIS_MIN_LUX = 1,
 };
 
-/** A step in ALS ramp */
+/** A step in compiled brightness curve */
 typedef struct
 {
-	int lux; /**< upper lux limit */
+	int lux; /**< lower lux limit */
 	int val; /**< brightness percentage to use */
 } als_limit_t;
 
+/** Brightness curve compiled from ALS ramp
+ *
+ * The configured ramp is interpolated in the log(lux) domain and
+ * stored as the lux values where each brightness percentage is
+ * reached, so lux -> brightness mapping is a binary search.
+ */
+typedef struct
+{
+	/** Number of steps in use; at least one */
+	int count;
+
+	/** Steps in ascending lux and brightness order; step[0].lux is 0 */
+	als_limit_t step[ALS_CURVE_STEPS];
+} als_curve_t;
+
 /** ALS filtering state */
 typedef struct
 {
@@ -95,8 +126,8 @@ typedef struct
 	/** Latest brightness percentage result */
 	int val;
 
-	/** Brightness percent from lux value look up table */
-	als_limit_t lut[ALS_PROFILE_COUNT][ALS_LUX_STEPS+1];
+	/** Brightness curves for ALS profiles */
+	als_curve_t curve[ALS_PROFILE_COUNT];
 } als_filter_t;
 
 /** Is there an ALS available? */
@@ -114,6 +145,33 @@ static display_state_t display_state = MCE_DISPLAY_UNDEF;
 /** Latest lux reading from the ALS */
 static gint als_lux_latest = -1;
 
+/** ALS smoothing time constant [ms]; 0 disables smoothing */
+static gint als_smoothing_time = DEFAULT_ALS_SMOOTHING_TIME;
+
+/** Smoothed lux value; valid when als_smooth_timestamp is nonzero */
+static double als_smooth_lux = 0;
+
+/** Time stamp of the newest sample included in als_smooth_lux [us] */
+static uint64_t als_smooth_timestamp = 0;
+
+/** ALS sampling interval while lux is stable [ms]; 0 = sensord default */
+static gint als_interval_stable = DEFAULT_ALS_SAMPLE_INTERVAL_STABLE;
+
+/** ALS sampling interval after lux has changed [ms] */
+static gint als_interval_burst = DEFAULT_ALS_SAMPLE_INTERVAL_BURST;
+
+/** Time to use burst sampling interval after lux has changed [ms] */
+static gint als_burst_hold_time = DEFAULT_ALS_BURST_HOLD_TIME;
+
+/** Sample time stamp until which burst interval is used [us] */
+static uint64_t als_burst_until = 0;
+
+/** Lux change that ends stable sampling [%] */
+static gint als_stable_threshold = DEFAULT_ALS_STABLE_THRESHOLD;
+
+/** Lux value the stable band is centered on, or -1 if not known */
+static gint als_stable_lux = -1;
+
 /** List of monitored external als enablers (legacy D-Bus API) */
 static GSList *ext_als_enablers = NULL;
 
@@ -160,6 +218,9 @@ static gboolean save_color_profile(const gchar *id);
 /** Integer minimum helper */
 static inline int imin(int a, int b) { return (a < b) ? a : b; }
 
+/** Integer maximum helper */
+static inline int imax(int a, int b) { return (a > b) ? a : b; }
+
 /** Check if color profile is supported
  *
  * @param id color profile name
@@ -219,20 +280,124 @@ static void als_filter_clear_threshold(als_filter_t *self)
 	self->lux_hi = 0;
 }
 
+/** Reset brightness curve to a state where any lux yields 100%
+ *
+ * @param self brightness curve
+ */
+static void als_curve_reset(als_curve_t *self)
+{
+	self->count = 1;
+	self->step[0].lux = 0;
+	self->step[0].val = 100;
+}
+
+/** Append step to brightness curve
+ *
+ * @param self brightness curve
+ * @param lux  lowest lux value yielding val
+ * @param val  brightness percentage
+ */
+static void als_curve_add(als_curve_t *self, int lux, int val)
+{
+	als_limit_t *last = &self->step[self->count - 1];
+
+	if( val <= last->val )
+		goto EXIT;
+
+	/* Steps that would not be reachable get overridden */
+	if( lux <= last->lux )
+		last->val = val;
+	else if( self->count < ALS_CURVE_STEPS ) {
+		last = &self->step[self->count++];
+		last->lux = lux;
+		last->val = val;
+	}
+EXIT:
+	return;
+}
+
+/** Compile brightness curve from ALS ramp
+ *
+ * Ramp slot k maps lux values in [lim[k-1], lim[k]) to lev[k] and
+ * anything above the last limit to 100%. The curve goes through
+ * lev[k] at the start of each slot and rises log-linearly towards
+ * the level of the next slot, so that brightness follows ambient
+ * light without visible steps. Non-monotonic ramps are flattened.
+ *
+ * @param self brightness curve
+ * @param lim  ramp upper lux limits
+ * @param lev  ramp brightness percentages
+ * @param cnt  number of ramp slots
+ */
+static void als_curve_compile(als_curve_t *self, const int *lim,
+			      const int *lev, int cnt)
+{
+	double x0 = 0, y0;
+
+	y0 = CLAMP(lev[0], 0, 100);
+	self->count = 1;
+	self->step[0].lux = 0;
+	self->step[0].val = (int)y0;
+
+	for( int k = 0; k < cnt; ++k ) {
+		double x1 = lim[k];
+		double y1 = (k + 1 < cnt) ? CLAMP(lev[k+1], 0, 100) : 100;
+
+		/* Skip unordered limits, flatten decreasing levels */
+		if( x1 <= x0 )
+			continue;
+		if( y1 < y0 )
+			y1 = y0;
+
+		double l0 = log(x0 + 1);
+		double l1 = log(x1 + 1);
+
+		for( int val = (int)y0 + 1; val <= (int)y1; ++val ) {
+			double t = (val - y0) / (y1 - y0);
+			double lux = ceil(exp(l0 + t * (l1 - l0)) - 1 - 1e-9);
+
+			als_curve_add(self, (int)MIN(lux, x1), val);
+		}
+
+		x0 = x1;
+		y0 = y1;
+	}
+}
+
+/** Find brightness curve step for lux value
+ *
+ * @param self brightness curve
+ * @param lux  ambient light value
+ *
+ * @return index of the step with largest lux limit not above lux
+ */
+static int als_curve_find(const als_curve_t *self, int lux)
+{
+	int lo = 0;
+	int hi = self->count;
+
+	while( hi - lo > 1 ) {
+		int mid = (lo + hi) / 2;
+
+		if( self->step[mid].lux <= lux )
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
 /** Initialize ALS filtering state
  *
  * @param self ALS filtering state data
  */
 static void als_filter_init(als_filter_t *self)
 {
-	/* Reset ramps to a state where any lux value will
+	/* Reset curves to a state where any lux value will
 	 * yield 100% brightness */
-	for( int i = 0; i < ALS_PROFILE_COUNT; ++i ) {
-		for( int k = 0; k <= ALS_LUX_STEPS; ++k ) {
-			self->lut[i][k].lux = INT_MAX;
-			self->lut[i][k].val = 100;
-		}
-	}
+	for( int i = 0; i < ALS_PROFILE_COUNT; ++i )
+		als_curve_reset(&self->curve[i]);
 
 	/* Default to 100% output */
 	self->val  = 100;
@@ -286,10 +451,10 @@ als_filter_load_profile(als_filter_t *self, const char *grp,
 			grp, lim_key);
 	}
 
-	for( gsize k = 0; k < lim_cnt; ++k ) {
-		self->lut[prof][k].lux = lim_val[k];
-		self->lut[prof][k].val = lev_val[k];
-	}
+	als_curve_compile(&self->curve[prof], lim_val, lev_val, (int)lim_cnt);
+
+	mce_log(LL_DEBUG, "[%s] %s: %d brightness steps", grp,
+		als_profile_name(prof), self->curve[prof].count);
 EXIT:
 	g_free(lim_val);
 	g_free(lev_val);
@@ -319,11 +484,11 @@ EXIT:
 	return;
 }
 
-/** Get lux value for given profile and step in ramp
+/** Get lux value for given profile and step in brightness curve
  *
  * @param self ALS filtering state data
  * @param prof ALS profile id
- * @param slot position in ramp
+ * @param slot position in curve
  *
  * @return lux value
  */
@@ -331,8 +496,8 @@ static int als_filter_get_lux(als_filter_t *self, als_profile_t prof, int slot)
 {
 	if( slot < 0 )
 		return 0;
-	if( slot < ALS_LUX_STEPS )
-		return self->lut[prof][slot].lux;
+	if( slot < self->curve[prof].count )
+		return self->curve[prof].step[slot].lux;
 	return INT_MAX;
 }
 
@@ -361,42 +526,34 @@ static int als_filter_run(als_filter_t *self, als_profile_t prof, int lux)
 		goto EXIT;
 	}
 
-	int slot;
-
-	for( slot = 0; slot < ALS_LUX_STEPS; ++slot ) {
-		if( lux < self->lut[prof][slot].lux )
-			break;
-	}
+	int slot = als_curve_find(&self->curve[prof], lux);
 
 	self->prof = prof;
-
-	if( slot < ALS_LUX_STEPS )
-		self->val = self->lut[prof][slot].val;
-	else
-		self->val = 100;
-
-	self->lux_lo = 0;
-	self->lux_hi = INT_MAX;
+	self->val  = self->curve[prof].step[slot].val;
 
 	/* Add hysteresis to transitions that make the display dimmer
 	 *
-         *                 lux from ALS
-	 *                  |
-         *                  |  configuration slot
-	 *                  |   |
-         *                  v   |
-         *    0----A------B-----C-----> [lux]
+	 * Curve steps are only 1% brightness apart, so the band is
+	 * proportional to the lux value instead of the step width;
+	 * otherwise sensor noise would make the brightness flap.
+	 *
+         *                      lux from ALS
+	 *                       |
+         *                       |  next curve step
+	 *                       |   |
+         *                       v   |
+         *    0--------------B---L---C-----> [lux]
 	 *
-         *              |-------|
-	 * threshold    lo      hi
+         *                  |----------|
+	 * threshold        lo         hi
 	 */
 
-	int a = als_filter_get_lux(self, prof, slot-2);
-	int b = als_filter_get_lux(self, prof, slot-1);
-	int c = als_filter_get_lux(self, prof, slot+0);
+	int c = als_filter_get_lux(self, prof, slot+1);
+	int band = imax((int)((gint64)lux * ALS_HYSTERESIS_PERCENT / 100),
+			ALS_HYSTERESIS_MIN_LUX);
 
-	self->lux_lo = b - imin(b-a, c-b) / 10;
-	self->lux_hi = c;
+	self->lux_lo = imax(lux - band, 0);
+	self->lux_hi = (c < INT_MAX) ? c - 1 : INT_MAX;
 
 	mce_log(LL_DEBUG, "prof=%d, slot=%d, range=%d...%d",
 		prof, slot, self->lux_lo, self->lux_hi);
@@ -416,16 +573,137 @@ static void run_datapipes(void)
 			 USE_CACHE, DONT_CACHE_INDATA);
 }
 
-/** Handle lux value changed event
+/** Forget smoothing history so that the next sample is used as is
+ */
+static void als_smooth_reset(void)
+{
+	als_smooth_lux = 0;
+	als_smooth_timestamp = 0;
+}
+
+/** Feed one ALS sample to the smoothing filter
+ *
+ * The weight of a sample depends on the time elapsed since the
+ * previous one, so the response time stays the same regardless
+ * of the rate at which the sensor reports data.
+ *
+ * @param sample ambient light sample
+ */
+static void als_smooth_feed(const mce_sensor_sample_t *sample)
+{
+	double dt, tau;
+
+	if( !als_smooth_timestamp || als_smoothing_time <= 0 ) {
+		als_smooth_lux = sample->value;
+		goto EXIT;
+	}
+
+	/* Samples that are not newer than the previous one get no weight */
+	if( sample->timestamp <= als_smooth_timestamp )
+		goto EXIT;
+
+	dt  = (double)(sample->timestamp - als_smooth_timestamp);
+	tau = als_smoothing_time * 1000.0;
+
+	als_smooth_lux += (sample->value - als_smooth_lux) * dt / (tau + dt);
+
+EXIT:
+	if( als_smooth_timestamp < sample->timestamp )
+		als_smooth_timestamp = sample->timestamp;
+}
+
+/** Select ALS sampling interval based on the latest samples
+ *
+ * A low rate is used while the samples stay within the stable band
+ * around the lux value seen at the start of the stable period. A
+ * sample outside the band moves the band and switches to burst rate,
+ * which is kept for a while after the last such sample so that the
+ * new level is found quickly.
+ *
+ * The band is independent of the brightness curve hysteresis, which
+ * is one sided and would keep the sensor in burst mode whenever the
+ * lux value wobbles upwards.
  *
- * @param lux ambient light value
+ * No timers are needed: the burst period is checked against sample
+ * time stamps, and sensord keeps reporting at burst rate until it
+ * is time to slow down.
+ *
+ * @param samples array of samples, oldest first
+ * @param count   number of samples
  */
-static void als_lux_changed(unsigned lux)
+static void als_rate_update(const mce_sensor_sample_t *samples, unsigned count)
 {
-	als_lux_latest = (int)lux;
+	const mce_sensor_sample_t *last = samples + count - 1;
+	unsigned interval;
+
+	if( als_interval_stable <= 0 ) {
+		interval = 0;
+		goto EXIT;
+	}
 
-	mce_log(LL_DEBUG, "lux=%d", als_lux_latest);
+	for( unsigned i = 0; i < count; ++i ) {
+		gint lux = (gint)MIN(samples[i].value, (unsigned)G_MAXINT);
+
+		if( als_stable_lux >= 0 ) {
+			gint band = (gint)((gint64)als_stable_lux *
+					   imax(als_stable_threshold, 0) / 100);
+
+			if( abs(lux - als_stable_lux) <= imax(band, 1) )
+				continue;
+		}
+
+		als_stable_lux = lux;
+		als_burst_until = samples[i].timestamp +
+			1000 * (uint64_t)imax(als_burst_hold_time, 0);
+	}
+
+	if( last->timestamp < als_burst_until )
+		interval = (unsigned)imax(als_interval_burst, 0);
+	else
+		interval = (unsigned)als_interval_stable;
+
+EXIT:
+	mce_sensorfw_als_set_interval(interval);
+}
+
+/** Stop adaptive ALS sampling rate; sensord default rate is used */
+static void als_rate_reset(void)
+{
+	als_burst_until = 0;
+	als_stable_lux = -1;
+	mce_sensorfw_als_set_interval(0);
+}
+
+/** Handle batch of ALS samples
+ *
+ * Brightness filtering is re-evaluated at most once per batch, and
+ * only if the smoothed lux value changes.
+ *
+ * @param samples ambient light samples, oldest first
+ * @param count   number of samples
+ */
+static void als_batch_cb(const mce_sensor_sample_t *samples, unsigned count)
+{
+	gint lux;
+
+	als_rate_update(samples, count);
+
+	for( unsigned i = 0; i < count; ++i )
+		als_smooth_feed(samples + i);
+
+	lux = (gint)(als_smooth_lux + 0.5);
+
+	mce_log(LL_DEBUG, "samples=%u last=%u lux=%d", count,
+		samples[count-1].value, lux);
+
+	if( als_lux_latest == lux )
+		goto EXIT;
+
+	als_lux_latest = lux;
 	run_datapipes();
+
+EXIT:
+	return;
 }
 
 /** Check if ALS sensor should be enabled or disabled
@@ -464,10 +742,13 @@ static void rethink_als_status(void)
 		use_als_flag, want_data, ext_als_enablers ? 1 : 0,
 		enable_new);
 
-	if( want_data )
-		mce_sensorfw_als_set_notify(als_lux_changed);
-	else
-		mce_sensorfw_als_set_notify(0);
+	if( want_data ) {
+		mce_sensorfw_als_set_batch_notify(als_batch_cb);
+	}
+	else {
+		mce_sensorfw_als_set_batch_notify(0);
+		als_rate_reset();
+	}
 
 	if( enable_old == enable_new )
 		goto EXIT;
@@ -485,6 +766,7 @@ static void rethink_als_status(void)
 		als_filter_clear_threshold(&lut_display);
 		als_filter_clear_threshold(&lut_led);
 		als_filter_clear_threshold(&lut_key);
+		als_smooth_reset();
 	}
 
 	run_datapipes();
@@ -1059,6 +1341,23 @@ const gchar *g_module_check_init(GModule *module)
 	als_filter_load_config(&lut_led);
 	als_filter_load_config(&lut_key);
 
+	als_smoothing_time = mce_conf_get_int(MCE_CONF_ALS_GROUP,
+					      MCE_CONF_ALS_SMOOTHING_TIME,
+					      DEFAULT_ALS_SMOOTHING_TIME);
+
+	als_interval_stable = mce_conf_get_int(MCE_CONF_ALS_GROUP,
+					       MCE_CONF_ALS_SAMPLE_INTERVAL_STABLE,
+					       DEFAULT_ALS_SAMPLE_INTERVAL_STABLE);
+	als_interval_burst = mce_conf_get_int(MCE_CONF_ALS_GROUP,
+					      MCE_CONF_ALS_SAMPLE_INTERVAL_BURST,
+					      DEFAULT_ALS_SAMPLE_INTERVAL_BURST);
+	als_burst_hold_time = mce_conf_get_int(MCE_CONF_ALS_GROUP,
+					       MCE_CONF_ALS_BURST_HOLD_TIME,
+					       DEFAULT_ALS_BURST_HOLD_TIME);
+	als_stable_threshold = mce_conf_get_int(MCE_CONF_ALS_GROUP,
+						MCE_CONF_ALS_STABLE_THRESHOLD,
+						DEFAULT_ALS_STABLE_THRESHOLD);
+
 	/* Get intial display state */
 	display_state = datapipe_get_gint(display_state_pipe);
 
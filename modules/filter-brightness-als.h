@@ -44,6 +44,38 @@
 /** Name of the configuration key for the brightness level step-down policy */
 #define MCE_CONF_STEP_DOWN_POLICY		"StepDownPolicy"
 
+/** Name of the configuration key for the ALS smoothing time constant */
+#define MCE_CONF_ALS_SMOOTHING_TIME		"SmoothingTime"
+
+/** Default ALS smoothing time constant; 0 = use samples as is */
+#define DEFAULT_ALS_SMOOTHING_TIME		0		/* Milliseconds */
+
+/** Name of the configuration key for the stable ALS sampling interval */
+#define MCE_CONF_ALS_SAMPLE_INTERVAL_STABLE	"SampleIntervalStable"
+
+/** Default ALS sampling interval while lux stays within stable band;
+ *  0 = leave sampling rate to sensord */
+#define DEFAULT_ALS_SAMPLE_INTERVAL_STABLE	1000		/* Milliseconds */
+
+/** Name of the configuration key for the burst ALS sampling interval */
+#define MCE_CONF_ALS_SAMPLE_INTERVAL_BURST	"SampleIntervalBurst"
+
+/** Default ALS sampling interval after lux has left stable band */
+#define DEFAULT_ALS_SAMPLE_INTERVAL_BURST	100		/* Milliseconds */
+
+/** Name of the configuration key for the ALS burst sampling hold time */
+#define MCE_CONF_ALS_BURST_HOLD_TIME		"BurstHoldTime"
+
+/** Default time to keep using burst sampling interval */
+#define DEFAULT_ALS_BURST_HOLD_TIME		2000		/* Milliseconds */
+
+/** Name of the configuration key for the ALS stable band width */
+#define MCE_CONF_ALS_STABLE_THRESHOLD		"StableThreshold"
+
+/** Default lux change that ends stable sampling, relative to the lux
+ *  value at the start of the stable period */
+#define DEFAULT_ALS_STABLE_THRESHOLD		10		/* Percent */
+
 /*  Paths for Avago APDS990x (QPDS-T900) ALS */
 
 /** Device path for Avago ALS */
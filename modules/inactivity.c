@@ -50,6 +50,7 @@
 					 * MCE_ADD_ACTIVITY_CALLBACK_REQ,
 					 * MCE_REMOVE_ACTIVITY_CALLBACK_REQ
 					 */
+#include "mce-lib.h"			/* mce_lib_get_mono_tick() */
 #include "datapipe.h"			/* datapipe_get_gbool(),
 					 * append_filter_to_datapipe(),
 					 * remove_filter_from_datapipe()
@@ -97,6 +98,9 @@ static GSList *activity_cb_monitor_list = NULL;
 /** ID for inactivity timeout source */
 static guint inactivity_timeout_cb_id = 0;
 
+/** Monotonic time in milliseconds when the device becomes inactive */
+static gint64 inactivity_deadline = 0;
+
 /** Device inactivity state */
 static gboolean device_inactive = FALSE;
 
@@ -428,13 +432,25 @@ static void call_activity_callbacks(void)
  */
 static gboolean inactivity_timeout_cb(gpointer data)
 {
+	gint64 now = mce_lib_get_mono_tick();
+
 	(void)data;
 
 	inactivity_timeout_cb_id = 0;
 
+	/* Activity seen after the timeout was set up moves
+	 * the deadline forward; wait for the remaining time */
+	if (now < inactivity_deadline) {
+		inactivity_timeout_cb_id =
+			g_timeout_add((guint)(inactivity_deadline - now),
+				      inactivity_timeout_cb, NULL);
+		goto EXIT;
+	}
+
 	(void)execute_datapipe(&device_inactive_pipe, GINT_TO_POINTER(TRUE),
 			       USE_INDATA, CACHE_INDATA);
 
+EXIT:
 	return FALSE;
 }
 
@@ -451,23 +467,58 @@ static void cancel_inactivity_timeout(void)
 }
 
 /**
- * Setup inactivity timeout
+ * Get inactivity timeout
+ *
+ * @return inactivity timeout in seconds
  */
-static void setup_inactivity_timeout(void)
+static gint get_inactivity_timeout(void)
 {
 	gint timeout = datapipe_get_gint(inactivity_timeout_pipe);
 
-	cancel_inactivity_timeout();
-
 	/* Sanitise timeout */
 	if (timeout <= 0)
 		timeout = 30;
 
+	return timeout;
+}
+
+/**
+ * Setup inactivity timeout
+ */
+static void setup_inactivity_timeout(void)
+{
+	gint timeout = get_inactivity_timeout();
+
+	cancel_inactivity_timeout();
+
+	inactivity_deadline = mce_lib_get_mono_tick() + timeout * 1000;
+
 	/* Setup new timeout */
 	inactivity_timeout_cb_id =
 		g_timeout_add_seconds(timeout, inactivity_timeout_cb, NULL);
 }
 
+/**
+ * Restart inactivity timeout due to activity
+ *
+ * Moves the inactivity deadline forward without touching
+ * an already active timeout source; the timeout callback
+ * re-arms itself if it fires before the deadline.
+ */
+static void restart_inactivity_timeout(void)
+{
+	if (inactivity_timeout_cb_id == 0) {
+		setup_inactivity_timeout();
+		goto EXIT;
+	}
+
+	inactivity_deadline = (mce_lib_get_mono_tick() +
+			       get_inactivity_timeout() * 1000);
+
+EXIT:
+	return;
+}
+
 /**
  * Datapipe filter for inactivity
  *
@@ -503,7 +554,7 @@ static gpointer device_inactive_filter(gpointer data)
 	/* We got activity; restart timeouts */
 	if (device_inactive == FALSE) {
 		call_activity_callbacks();
-		setup_inactivity_timeout();
+		restart_inactivity_timeout();
 	}
 
 	/* Only send the inactivity status if it changed */
@@ -103,6 +103,8 @@ static output_state_t led_current_kb0_output =
   .context = "led_current_kb0",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
 };
 /** Key backlight channel 1 LED current path */
 static output_state_t led_current_kb1_output =
@@ -110,6 +112,8 @@ static output_state_t led_current_kb1_output =
   .context = "led_current_kb1",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
 };
 /** Key backlight channel 2 LED current path */
 static output_state_t led_current_kb2_output =
@@ -117,6 +121,8 @@ static output_state_t led_current_kb2_output =
   .context = "led_current_kb2",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
 };
 /** Key backlight channel 3 LED current path */
 static output_state_t led_current_kb3_output =
@@ -124,6 +130,8 @@ static output_state_t led_current_kb3_output =
   .context = "led_current_kb3",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
 };
 /** Key backlight channel 4 LED current path */
 static output_state_t led_current_kb4_output =
@@ -131,6 +139,8 @@ static output_state_t led_current_kb4_output =
   .context = "led_current_kb4",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
 };
 /** Key backlight channel 5 LED current path */
 static output_state_t led_current_kb5_output =
@@ -138,6 +148,8 @@ static output_state_t led_current_kb5_output =
   .context = "led_current_kb5",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
 };
 
 /** Key backlight channel 0 backlight path */
@@ -146,6 +158,7 @@ static output_state_t led_brightness_kb0_output =
   .context = "led_brightness_kb0",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
 };
 /** Key backlight channel 1 backlight path */
 static output_state_t led_brightness_kb1_output =
@@ -153,6 +166,7 @@ static output_state_t led_brightness_kb1_output =
   .context = "led_brightness_kb1",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
 };
 /** Key backlight channel 2 backlight path */
 static output_state_t led_brightness_kb2_output =
@@ -160,6 +174,7 @@ static output_state_t led_brightness_kb2_output =
   .context = "led_brightness_kb2",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
 };
 /** Key backlight channel 3 backlight path */
 static output_state_t led_brightness_kb3_output =
@@ -167,6 +182,7 @@ static output_state_t led_brightness_kb3_output =
   .context = "led_brightness_kb3",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
 };
 /** Key backlight channel 4 backlight path */
 static output_state_t led_brightness_kb4_output =
@@ -174,6 +190,7 @@ static output_state_t led_brightness_kb4_output =
   .context = "led_brightness_kb4",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
 };
 /** Key backlight channel 5 backlight path */
 static output_state_t led_brightness_kb5_output =
@@ -181,6 +198,7 @@ static output_state_t led_brightness_kb5_output =
   .context = "led_brightness_kb5",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
 };
 
 /** Path to engine 3 mode */
@@ -198,6 +216,8 @@ static output_state_t n810_keypad_fadetime_output =
   .context = "n810_keypad_fadetime",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
   .path = MCE_KEYPAD_BACKLIGHT_FADETIME_SYS_PATH,
 };
 
@@ -207,6 +227,8 @@ static output_state_t n810_keyboard_fadetime_output =
   .context = "n810_keyboard_fadetime",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
   .path = MCE_KEYBOARD_BACKLIGHT_FADETIME_SYS_PATH,
 };
 
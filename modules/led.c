@@ -41,7 +41,9 @@
 
 #include "mce-io.h"			/* mce_close_file(),
 					 * mce_write_string_to_file(),
-					 * mce_write_number_string_to_file()
+					 * mce_write_number_string_to_file(),
+					 * mce_write_string_to_output(),
+					 * mce_output_batch_*()
 					 */
 #include "mce-hal.h"			/* get_product_id(),
 					 * product_id_t
@@ -91,6 +93,12 @@
 # include "../mce-hybris.h"
 #endif
 
+#ifdef ENABLE_WAKELOCKS
+# include "../libwakelock.h"		/* wakelock_lock(),
+					 * wakelock_unlock()
+					 */
+#endif
+
 #if 0 // DEBUG: make all logging from this module "critical"
 # undef mce_log
 # define mce_log(LEV, FMT, ARGS...) \
@@ -117,8 +125,6 @@ G_MODULE_EXPORT module_info_struct module_info = {
 static GQueue *pattern_stack = NULL;
 /** The pattern combination rule queue */
 static GQueue *combination_rule_list = NULL;
-/** The pattern combination rule queue */
-static GQueue *combination_rule_xref_list = NULL;
 /** The D-Bus controlled LED switch */
 static gboolean led_enabled = FALSE;
 
@@ -162,7 +168,13 @@ typedef enum {
 	 * NJoy-controlled RGB patterns,
 	 * and monochrome direct-controlled patterns
 	 */
-	NUMBER_OF_PATTERN_FIELDS = 6
+	NUMBER_OF_PATTERN_FIELDS = 6,
+	/** Ramp-up time field for software driven monochrome patterns */
+	PATTERN_RISE_TIME_FIELD = 6,
+	/** Ramp-down time field for software driven monochrome patterns */
+	PATTERN_FALL_TIME_FIELD = 7,
+	/** Number of fields used by software driven monochrome patterns */
+	NUMBER_OF_PATTERN_FIELDS_SW = 8
 } pattern_field;
 
 /**
@@ -172,6 +184,12 @@ typedef enum {
  */
 #define CHANNEL_SIZE		32 * 2
 
+/** Keyframe of a software driven pattern */
+typedef struct {
+	guint32 time;			/**< Offset in the cycle in ms */
+	guint16 level;			/**< Brightness level from time on */
+} sw_keyframe_t;
+
 /** Structure holding LED patterns */
 typedef struct {
 	gchar *name;			/**< Pattern name */
@@ -193,21 +211,63 @@ typedef struct {
 	gchar channel3[CHANNEL_SIZE + 1];
 	guint gconf_cb_id;		/**< Callback ID for GConf entry */
 	guint rgb_color;                /**< RGB24 data for libhybris use */
+	gint rise_time;			/**< Ramp-up time in ms */
+	gint fall_time;			/**< Ramp-down time in ms */
+	guint cycle;			/**< Software pattern cycle in ms */
+	guint levels;			/**< Software pattern levels above 0 */
+	guint frames;			/**< Number of keyframes */
+	/** Precomputed software pattern cycle, or NULL */
+	sw_keyframe_t *keyframes;
+	guint order;			/**< Position in the pattern stack */
+	gint heap_index;		/**< Index in active heap, or -1 */
+	/** Combination rules this pattern is a pre-requisite for */
+	GPtrArray *rules;
 } pattern_struct;
 
-/** Pattern combination rule struct; this is also used for cross-referencing */
+/** Pattern combination rule struct */
 typedef struct {
 	/** Name of the combined pattern */
 	gchar *rulename;
 	/** List of pre-requisite patterns */
 	GQueue *pre_requisites;
+	/** The combined pattern */
+	pattern_struct *pattern;
+	/** Number of inactive pre-requisites */
+	guint pending;
 } combination_rule_struct;
 
+/** Number of pattern visibility classes; policies 0-5 and the rest */
+#define PATTERN_POLICY_CLASSES	7
+
+/** Active and enabled patterns; min-heaps by stack order per visibility */
+static GPtrArray *pattern_heap[PATTERN_POLICY_CLASSES];
+
+/** Lookup table for patterns by name */
+static GHashTable *pattern_lut = NULL;
+
 /** Pointer to the top pattern */
 static pattern_struct *active_pattern = NULL;
 /** The active brightness */
 static gint active_brightness = -1;
 
+/** Software driven pattern that is running, or NULL */
+static const pattern_struct *sw_pattern = NULL;
+/** Start of the software driven pattern; monotonic time in ms */
+static gint64 sw_pattern_started = 0;
+/** Last level written by the software driven pattern, or -1 */
+static gint sw_pattern_level = -1;
+/** Timer for the next software driven pattern keyframe */
+static guint sw_pattern_timer_id = 0;
+/** Function for writing software driven pattern brightness levels */
+static void (*sw_pattern_write)(const pattern_struct *, guint) = NULL;
+
+#ifdef ENABLE_WAKELOCKS
+/** Wakelock that keeps suspend from freezing software driven ramps */
+static const char sw_pattern_wakelock[] = "mce_led_pattern";
+/** Whether mce is currently holding the sw_pattern_wakelock */
+static gboolean sw_pattern_wakelock_held = FALSE;
+#endif
+
 /** Currently driven leds */
 static guint current_lysti_led_pattern = 0;
 
@@ -269,6 +329,8 @@ static output_state_t led_current_rm_output =
   .context = "led_current_rm",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
 };
 
 /** Path to green channel LED current path */
@@ -277,6 +339,8 @@ static output_state_t led_current_g_output =
   .context = "led_current_g",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
 };
 
 /** Path to blue channel LED current path */
@@ -285,6 +349,8 @@ static output_state_t led_current_b_output =
   .context = "led_current_b",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
 };
 
 /** Path to monochrome/red channel LED brightness path  */
@@ -293,6 +359,7 @@ static output_state_t led_brightness_rm_output =
   .context = "led_brightness_rm",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
 };
 
 /** Path to red channel LED brightness path */
@@ -301,6 +368,7 @@ static output_state_t led_brightness_g_output =
   .context = "led_brightness_g",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
 };
 
 /** Path to blue channel LED brightness path */
@@ -309,28 +377,98 @@ static output_state_t led_brightness_b_output =
   .context = "led_brightness_b",
   .truncate_file = TRUE,
   .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
 };
 
 /** Path to engine 1 mode */
-static gchar *engine1_mode_path = NULL;
+static output_state_t engine1_mode_output =
+{
+  .context = "engine1_mode",
+  .truncate_file = TRUE,
+  .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
+};
+
 /** Path to engine 2 mode */
-static gchar *engine2_mode_path = NULL;
+static output_state_t engine2_mode_output =
+{
+  .context = "engine2_mode",
+  .truncate_file = TRUE,
+  .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
+};
+
 /** Path to engine 3 mode */
-static gchar *engine3_mode_path = NULL;
+static output_state_t engine3_mode_output =
+{
+  .context = "engine3_mode",
+  .truncate_file = TRUE,
+  .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
+};
 
 /** Path to engine 1 load */
-static gchar *engine1_load_path = NULL;
+static output_state_t engine1_load_output =
+{
+  .context = "engine1_load",
+  .truncate_file = TRUE,
+  .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
+};
+
 /** Path to engine 2 load */
-static gchar *engine2_load_path = NULL;
+static output_state_t engine2_load_output =
+{
+  .context = "engine2_load",
+  .truncate_file = TRUE,
+  .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
+};
+
 /** Path to engine 3 load */
-static gchar *engine3_load_path = NULL;
+static output_state_t engine3_load_output =
+{
+  .context = "engine3_load",
+  .truncate_file = TRUE,
+  .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
+};
 
 /** Path to engine 1 leds */
-static gchar *engine1_leds_path = NULL;
+static output_state_t engine1_leds_output =
+{
+  .context = "engine1_leds",
+  .truncate_file = TRUE,
+  .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
+};
+
 /** Path to engine 2 leds */
-static gchar *engine2_leds_path = NULL;
+static output_state_t engine2_leds_output =
+{
+  .context = "engine2_leds",
+  .truncate_file = TRUE,
+  .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
+};
+
 /** Path to engine 3 leds */
-static gchar *engine3_leds_path = NULL;
+static output_state_t engine3_leds_output =
+{
+  .context = "engine3_leds",
+  .truncate_file = TRUE,
+  .close_on_exit = FALSE,
+  .use_pwrite = TRUE,
+  .skip_unchanged = TRUE,
+};
 
 /** Maximum LED brightness
  *
@@ -342,6 +480,7 @@ static gchar *engine3_leds_path = NULL;
 static guint maximum_led_brightness = MAXIMUM_LYSTI_MONOCHROME_LED_CURRENT;
 
 static void cancel_pattern_timeout(void);
+static void sw_pattern_stop(void);
 static void led_update_active_pattern(void);
 
 /**
@@ -451,16 +590,16 @@ static led_type_t get_led_type(void)
 		led_current_rm_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_CURRENT_SUFFIX, NULL);
 		led_brightness_rm_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_BRIGHTNESS_SUFFIX, NULL);
 
-		engine1_mode_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_MODE_SUFFIX, NULL);
-		engine2_mode_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_MODE_SUFFIX, NULL);
-		engine3_mode_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE3, MCE_LED_MODE_SUFFIX, NULL);
+		engine1_mode_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_MODE_SUFFIX, NULL);
+		engine2_mode_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_MODE_SUFFIX, NULL);
+		engine3_mode_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE3, MCE_LED_MODE_SUFFIX, NULL);
 
 		/* We have 3 engines, but only 1 LED,
 		 * so while we need to be able to set the mode of all
 		 * engines (to disable the unused ones), we don't need
 		 * to program them
 		 */
-		engine1_load_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_LOAD_SUFFIX, NULL);
+		engine1_load_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_LOAD_SUFFIX, NULL);
 
 		disable_reno();
 		break;
@@ -476,14 +615,14 @@ static led_type_t get_led_type(void)
 		led_brightness_rm_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL8, MCE_LED_BRIGHTNESS_SUFFIX, NULL);
 
 		/* Engine 3 is used by keyboard backlight */
-		engine1_mode_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_MODE_SUFFIX, NULL);
-		engine2_mode_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_MODE_SUFFIX, NULL);
+		engine1_mode_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_MODE_SUFFIX, NULL);
+		engine2_mode_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_MODE_SUFFIX, NULL);
 
-		engine1_load_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_LOAD_SUFFIX, NULL);
-		engine2_load_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_LOAD_SUFFIX, NULL);
+		engine1_load_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_LOAD_SUFFIX, NULL);
+		engine2_load_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_LOAD_SUFFIX, NULL);
 
-		engine1_leds_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_LEDS_SUFFIX, NULL);
-		engine2_leds_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_LEDS_SUFFIX, NULL);
+		engine1_leds_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_LEDS_SUFFIX, NULL);
+		engine2_leds_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_LEDS_SUFFIX, NULL);
 
 		disable_reno();
 		break;
@@ -501,17 +640,17 @@ static led_type_t get_led_type(void)
 		led_brightness_g_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL1, MCE_LED_BRIGHTNESS_SUFFIX, NULL);
 		led_brightness_b_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL2, MCE_LED_BRIGHTNESS_SUFFIX, NULL);
 
-		engine1_mode_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_MODE_SUFFIX, NULL);
-		engine2_mode_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_MODE_SUFFIX, NULL);
-		engine3_mode_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE3, MCE_LED_MODE_SUFFIX, NULL);
+		engine1_mode_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_MODE_SUFFIX, NULL);
+		engine2_mode_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_MODE_SUFFIX, NULL);
+		engine3_mode_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE3, MCE_LED_MODE_SUFFIX, NULL);
 
-		engine1_load_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_LOAD_SUFFIX, NULL);
-		engine2_load_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_LOAD_SUFFIX, NULL);
-		engine3_load_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE3, MCE_LED_LOAD_SUFFIX, NULL);
+		engine1_load_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_LOAD_SUFFIX, NULL);
+		engine2_load_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_LOAD_SUFFIX, NULL);
+		engine3_load_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE3, MCE_LED_LOAD_SUFFIX, NULL);
 
-		engine1_leds_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_LEDS_SUFFIX, NULL);
-		engine2_leds_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_LEDS_SUFFIX, NULL);
-		engine3_leds_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE3, MCE_LED_LEDS_SUFFIX, NULL);
+		engine1_leds_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_LEDS_SUFFIX, NULL);
+		engine2_leds_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_LEDS_SUFFIX, NULL);
+		engine3_leds_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5523_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE3, MCE_LED_LEDS_SUFFIX, NULL);
 		break;
 
 	case PRODUCT_RX44:
@@ -528,13 +667,13 @@ static led_type_t get_led_type(void)
 		led_current_rm_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_CURRENT_SUFFIX, NULL);
 		led_brightness_rm_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_BRIGHTNESS_SUFFIX, NULL);
 
-		engine1_mode_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_MODE_SUFFIX, NULL);
-		engine2_mode_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL1, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_MODE_SUFFIX, NULL);
-		engine3_mode_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL2, MCE_LED_DEVICE, MCE_LED_ENGINE3, MCE_LED_MODE_SUFFIX, NULL);
+		engine1_mode_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_MODE_SUFFIX, NULL);
+		engine2_mode_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL1, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_MODE_SUFFIX, NULL);
+		engine3_mode_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL2, MCE_LED_DEVICE, MCE_LED_ENGINE3, MCE_LED_MODE_SUFFIX, NULL);
 
-		engine1_load_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_LOAD_SUFFIX, NULL);
-		engine2_load_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL1, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_LOAD_SUFFIX, NULL);
-		engine3_load_path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL2, MCE_LED_DEVICE, MCE_LED_ENGINE3, MCE_LED_LOAD_SUFFIX, NULL);
+		engine1_load_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL0, MCE_LED_DEVICE, MCE_LED_ENGINE1, MCE_LED_LOAD_SUFFIX, NULL);
+		engine2_load_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL1, MCE_LED_DEVICE, MCE_LED_ENGINE2, MCE_LED_LOAD_SUFFIX, NULL);
+		engine3_load_output.path = g_strconcat(MCE_LED_DIRECT_SYS_PATH, MCE_LED_LP5521_PREFIX, MCE_LED_CHANNEL2, MCE_LED_DEVICE, MCE_LED_ENGINE3, MCE_LED_LOAD_SUFFIX, NULL);
 		break;
 
 	case PRODUCT_RX34:
@@ -559,31 +698,6 @@ EXIT:
 	return led_type;
 }
 
-/**
- * Custom find function to get a particular entry in the pattern stack
- *
- * @param data The pattern_struct entry
- * @param userdata The pattern name
- * @return Less than, equal to, or greater than zero depending
- *         whether the name of the pattern struct pointed to by data
- *         is less than, equal to, or greater than entry2
- */
-static gint queue_find(gconstpointer data, gconstpointer userdata) G_GNUC_PURE;
-static gint queue_find(gconstpointer data, gconstpointer userdata)
-{
-	pattern_struct *psp;
-
-	if (data == NULL || userdata == NULL)
-		return -1;
-
-	psp = (pattern_struct *)data;
-
-	if (psp->name == NULL)
-		return -1;
-
-	return strcmp(psp->name, (gchar *)userdata);
-}
-
 /**
  * Custom compare function used for priority insertions
  *
@@ -609,6 +723,343 @@ static gint queue_prio_compare(gconstpointer entry1,
 	return psp1->priority - psp2->priority;
 }
 
+/**
+ * Get the visibility class of a pattern
+ *
+ * @param psp The pattern
+ * @return The screen display policy, or PATTERN_POLICY_CLASSES - 1
+ *         for policies that have no special meaning
+ */
+static guint pattern_policy_class(const pattern_struct *const psp)
+{
+	if ((psp->policy < 0) || (psp->policy >= PATTERN_POLICY_CLASSES - 1))
+		return PATTERN_POLICY_CLASSES - 1;
+
+	return (guint)psp->policy;
+}
+
+/**
+ * Swap two entries in an active pattern heap
+ *
+ * @param heap The heap
+ * @param i Index of the first entry
+ * @param j Index of the second entry
+ */
+static void pattern_heap_swap(GPtrArray *heap, guint i, guint j)
+{
+	pattern_struct *psp1 = g_ptr_array_index(heap, i);
+	pattern_struct *psp2 = g_ptr_array_index(heap, j);
+
+	g_ptr_array_index(heap, i) = psp2, psp2->heap_index = (gint)i;
+	g_ptr_array_index(heap, j) = psp1, psp1->heap_index = (gint)j;
+}
+
+/**
+ * Get the stack order of an entry in an active pattern heap
+ *
+ * @param heap The heap
+ * @param i Index of the entry
+ * @return The position of the pattern in the pattern stack
+ */
+static guint pattern_heap_order(GPtrArray *heap, guint i)
+{
+	return ((pattern_struct *)g_ptr_array_index(heap, i))->order;
+}
+
+/**
+ * Restore heap order after the entry at given index has changed
+ *
+ * @param heap The heap
+ * @param i Index of the changed entry
+ */
+static void pattern_heap_fix(GPtrArray *heap, guint i)
+{
+	guint child;
+
+	/* Move towards the top */
+	while (i > 0) {
+		guint parent = (i - 1) / 2;
+
+		if (pattern_heap_order(heap, parent) <
+		    pattern_heap_order(heap, i))
+			break;
+
+		pattern_heap_swap(heap, i, parent);
+		i = parent;
+	}
+
+	/* Move towards the bottom */
+	while ((child = 2 * i + 1) < heap->len) {
+		if ((child + 1 < heap->len) &&
+		    (pattern_heap_order(heap, child + 1) <
+		     pattern_heap_order(heap, child)))
+			child++;
+
+		if (pattern_heap_order(heap, i) <
+		    pattern_heap_order(heap, child))
+			break;
+
+		pattern_heap_swap(heap, i, child);
+		i = child;
+	}
+}
+
+/**
+ * Add or remove a pattern to/from the active pattern heaps
+ * depending on whether it is both active and enabled
+ *
+ * @param psp The pattern
+ */
+static void pattern_heap_update(pattern_struct *const psp)
+{
+	GPtrArray *heap = pattern_heap[pattern_policy_class(psp)];
+	gboolean show = (psp->active == TRUE) && (psp->enabled == TRUE);
+	guint i;
+
+	if (heap == NULL)
+		goto EXIT;
+
+	if (show == (psp->heap_index != -1))
+		goto EXIT;
+
+	if (show == TRUE) {
+		psp->heap_index = (gint)heap->len;
+		g_ptr_array_add(heap, psp);
+		pattern_heap_fix(heap, heap->len - 1);
+		goto EXIT;
+	}
+
+	/* Replace the removed entry with the last one */
+	i = (guint)psp->heap_index;
+	psp->heap_index = -1;
+	g_ptr_array_index(heap, i) = g_ptr_array_index(heap, heap->len - 1);
+	g_ptr_array_set_size(heap, heap->len - 1);
+
+	if (i < heap->len) {
+		((pattern_struct *)g_ptr_array_index(heap, i))->heap_index = (gint)i;
+		pattern_heap_fix(heap, i);
+	}
+
+EXIT:
+	return;
+}
+
+/**
+ * Get the topmost active and enabled pattern of a visibility class
+ *
+ * @param policy The visibility class
+ * @return The pattern, or NULL if there are no shown patterns in the class
+ */
+static pattern_struct *pattern_heap_top(guint policy)
+{
+	GPtrArray *heap = pattern_heap[policy];
+
+	if ((heap == NULL) || (heap->len == 0))
+		return NULL;
+
+	return g_ptr_array_index(heap, 0);
+}
+
+/**
+ * Set the active state of a pattern
+ *
+ * The pending pre-requisite counts of the combination rules
+ * the pattern takes part in are updated too, but the combined
+ * patterns themselves are left as is
+ *
+ * @param psp The pattern
+ * @param active TRUE to activate the pattern, FALSE to deactivate it
+ */
+static void pattern_set_active(pattern_struct *const psp, gboolean active)
+{
+	guint i;
+
+	active = (active != FALSE);
+
+	if (psp->active == active)
+		goto EXIT;
+
+	psp->active = active;
+
+	for (i = 0; (psp->rules != NULL) && (i < psp->rules->len); i++) {
+		combination_rule_struct *cr = g_ptr_array_index(psp->rules, i);
+
+		if (active == TRUE)
+			cr->pending--;
+		else
+			cr->pending++;
+	}
+
+	pattern_heap_update(psp);
+
+EXIT:
+	return;
+}
+
+/**
+ * Set the enabled state of a pattern
+ *
+ * @param psp The pattern
+ * @param enabled TRUE to enable the pattern, FALSE to disable it
+ */
+static void pattern_set_enabled(pattern_struct *const psp, gboolean enabled)
+{
+	psp->enabled = (enabled != FALSE);
+	pattern_heap_update(psp);
+}
+
+/**
+ * Find the pattern to show
+ *
+ * Only the topmost shown pattern of each visibility class
+ * needs to be considered, so the cost does not depend on the
+ * number of patterns
+ *
+ * @param system_state The current system state
+ * @param display_state The current display state
+ * @return The pattern to show, or NULL if no pattern should be shown
+ */
+static pattern_struct *led_select_pattern(system_state_t system_state,
+					  display_state_t display_state)
+{
+	pattern_struct *best = NULL;
+	guint classes = 0;
+	guint policy;
+
+	/* If the LED is disabled,
+	 * only patterns with visibility 5 are shown
+	 */
+	if (led_enabled == FALSE) {
+		classes = 1u << 5;
+		goto SELECT;
+	}
+
+	/* Always show pattern with visibility 3 or 5 */
+	classes = (1u << 3) | (1u << 5);
+
+	if (system_state == MCE_STATE_ACTDEAD) {
+		/* If we're in acting dead,
+		 * show patterns with visibility 4,
+		 * and if the display is off, visibility 2 too
+		 */
+		classes |= 1u << 4;
+
+		if (display_state == MCE_DISPLAY_OFF)
+			classes |= 1u << 2;
+	} else if ((display_state == MCE_DISPLAY_OFF) ||
+		   (display_state == MCE_DISPLAY_LPM_OFF) ||
+		   (display_state == MCE_DISPLAY_LPM_ON)) {
+		/* If the display is off or in low power mode,
+		 * we can use any active pattern
+		 */
+		classes = (1u << PATTERN_POLICY_CLASSES) - 1;
+	} else {
+		/* Patterns with visibility 1 are shown with screen on */
+		classes |= 1u << 1;
+	}
+
+SELECT:
+	for (policy = 0; policy < PATTERN_POLICY_CLASSES; policy++) {
+		pattern_struct *psp;
+
+		if ((classes & (1u << policy)) == 0)
+			continue;
+
+		if ((psp = pattern_heap_top(policy)) == NULL)
+			continue;
+
+		if ((best == NULL) || (psp->order < best->order))
+			best = psp;
+	}
+
+	return best;
+}
+
+/**
+ * Set up pattern lookup, active pattern heaps and combination rule
+ * cross-references once all patterns have been loaded
+ */
+static void init_pattern_index(void)
+{
+	guint order = 0;
+	guint i;
+	GList *glp;
+
+	pattern_lut = g_hash_table_new(g_str_hash, g_str_equal);
+
+	for (i = 0; i < PATTERN_POLICY_CLASSES; i++)
+		pattern_heap[i] = g_ptr_array_new();
+
+	/* The first pattern with any given name is the one that is used */
+	for (glp = pattern_stack->head; glp != NULL; glp = glp->next) {
+		pattern_struct *psp = glp->data;
+
+		psp->order = order++;
+		psp->heap_index = -1;
+
+		if (g_hash_table_lookup(pattern_lut, psp->name) == NULL)
+			g_hash_table_insert(pattern_lut, psp->name, psp);
+
+		pattern_heap_update(psp);
+	}
+
+	for (glp = combination_rule_list->head; glp != NULL; glp = glp->next) {
+		combination_rule_struct *cr = glp->data;
+		GList *req;
+
+		cr->pattern = g_hash_table_lookup(pattern_lut, cr->rulename);
+		cr->pending = 0;
+
+		for (req = cr->pre_requisites->head; req != NULL; req = req->next) {
+			pattern_struct *psp = g_hash_table_lookup(pattern_lut,
+								  req->data);
+
+			/* Missing patterns are never active */
+			if ((psp == NULL) || (psp->active == FALSE))
+				cr->pending++;
+
+			if (psp == NULL)
+				continue;
+
+			if (psp->rules == NULL)
+				psp->rules = g_ptr_array_new();
+
+			g_ptr_array_add(psp->rules, cr);
+		}
+	}
+}
+
+/**
+ * Release pattern lookup, active pattern heaps and combination rule
+ * cross-references
+ */
+static void quit_pattern_index(void)
+{
+	guint i;
+	GList *glp;
+
+	for (i = 0; i < PATTERN_POLICY_CLASSES; i++) {
+		if (pattern_heap[i] != NULL)
+			g_ptr_array_free(pattern_heap[i], TRUE);
+		pattern_heap[i] = NULL;
+	}
+
+	for (glp = pattern_stack ? pattern_stack->head : NULL;
+	     glp != NULL; glp = glp->next) {
+		pattern_struct *psp = glp->data;
+
+		if (psp->rules != NULL)
+			g_ptr_array_free(psp->rules, TRUE);
+		psp->rules = NULL;
+		psp->heap_index = -1;
+	}
+
+	if (pattern_lut != NULL) {
+		g_hash_table_destroy(pattern_lut);
+		pattern_lut = NULL;
+	}
+}
+
 /**
  * Set Lysti-LED brightness
  *
@@ -784,16 +1235,16 @@ static void hybris_set_brightness(gint brightness)
 static void lysti_disable_led(void)
 {
 	/* Disable engine 1 */
-	(void)mce_write_string_to_file(engine1_mode_path,
-				       MCE_LED_DISABLED_MODE);
+	(void)mce_write_string_to_output(&engine1_mode_output,
+					 MCE_LED_DISABLED_MODE);
 
 	if (get_led_type() == LED_TYPE_LYSTI_MONO) {
 		/* Turn off the led */
 		(void)mce_write_number_string_to_file(&led_brightness_rm_output, 0);
 	} else if (get_led_type() == LED_TYPE_LYSTI_RGB) {
 		/* Disable engine 2 */
-		(void)mce_write_string_to_file(engine2_mode_path,
-					       MCE_LED_DISABLED_MODE);
+		(void)mce_write_string_to_output(&engine2_mode_output,
+						 MCE_LED_DISABLED_MODE);
 
 		/* Turn off all three leds */
 		(void)mce_write_number_string_to_file(&led_brightness_rm_output, 0);
@@ -808,20 +1259,20 @@ static void lysti_disable_led(void)
 static void njoy_disable_led(void)
 {
 	/* Disable engine 1 */
-	(void)mce_write_string_to_file(engine1_mode_path,
-				       MCE_LED_DISABLED_MODE);
+	(void)mce_write_string_to_output(&engine1_mode_output,
+					 MCE_LED_DISABLED_MODE);
 
 	if (get_led_type() == LED_TYPE_NJOY_MONO) {
 		/* Turn off the led */
 		(void)mce_write_number_string_to_file(&led_brightness_rm_output, 0);
 	} else if (get_led_type() == LED_TYPE_NJOY_RGB) {
 		/* Disable engine 2 */
-		(void)mce_write_string_to_file(engine2_mode_path,
-					       MCE_LED_DISABLED_MODE);
+		(void)mce_write_string_to_output(&engine2_mode_output,
+						 MCE_LED_DISABLED_MODE);
 
 		/* Disable engine 3 */
-		(void)mce_write_string_to_file(engine3_mode_path,
-					       MCE_LED_DISABLED_MODE);
+		(void)mce_write_string_to_output(&engine3_mode_output,
+						 MCE_LED_DISABLED_MODE);
 
 		/* Turn off all three leds */
 		(void)mce_write_number_string_to_file(&led_brightness_rm_output, 0);
@@ -855,6 +1306,7 @@ static void hybris_disable_led(void)
 static void disable_led(void)
 {
 	cancel_pattern_timeout();
+	sw_pattern_stop();
 
 	switch (get_led_type()) {
 	case LED_TYPE_LYSTI_RGB:
@@ -894,7 +1346,7 @@ static gboolean led_pattern_timeout_cb(gpointer data)
 
 	led_pattern_timeout_cb_id = 0;
 
-	active_pattern->active = FALSE;
+	pattern_set_active(active_pattern, FALSE);
 	led_update_active_pattern();
 
 	return FALSE;
@@ -931,35 +1383,41 @@ static void setup_pattern_timeout(gint timeout)
  */
 static void lysti_program_led(const pattern_struct *const pattern)
 {
-	/* Disable old LED patterns */
-	lysti_disable_led();
+	mce_output_batch_t *batch = mce_output_batch_create();
 
 	/* Load new patterns, one engine at a time */
 
 	/* Engine 1 */
-	(void)mce_write_string_to_file(engine1_mode_path,
-				       MCE_LED_LOAD_MODE);
-	(void)mce_write_string_to_file(engine1_leds_path,
-				       bin_to_string(pattern->engine1_mux));
-	(void)mce_write_string_to_file(engine1_load_path,
-				       pattern->channel1);
+	mce_output_batch_add(batch, &engine1_mode_output, MCE_LED_LOAD_MODE);
+	mce_output_batch_add(batch, &engine1_leds_output,
+			     bin_to_string(pattern->engine1_mux));
+	mce_output_batch_add(batch, &engine1_load_output, pattern->channel1);
 
 	/* Engine 2; if needed */
 	if (get_led_type() == LED_TYPE_LYSTI_RGB) {
-		(void)mce_write_string_to_file(engine2_mode_path,
-					       MCE_LED_LOAD_MODE);
-		(void)mce_write_string_to_file(engine2_leds_path,
-					       bin_to_string(pattern->engine2_mux));
-		(void)mce_write_string_to_file(engine2_load_path,
-					       pattern->channel2);
+		mce_output_batch_add(batch, &engine2_mode_output,
+				     MCE_LED_LOAD_MODE);
+		mce_output_batch_add(batch, &engine2_leds_output,
+				     bin_to_string(pattern->engine2_mux));
+		mce_output_batch_add(batch, &engine2_load_output,
+				     pattern->channel2);
 
 		/* Run the new pattern; enable engines in reverse order */
-		(void)mce_write_string_to_file(engine2_mode_path,
-					       MCE_LED_RUN_MODE);
+		mce_output_batch_add(batch, &engine2_mode_output,
+				     MCE_LED_RUN_MODE);
+	}
+
+	mce_output_batch_add(batch, &engine1_mode_output, MCE_LED_RUN_MODE);
+
+	/* Reprogram unless the same pattern is already running */
+	if (!mce_output_batch_is_current(batch)) {
+		/* Disable old LED patterns */
+		lysti_disable_led();
+
+		(void)mce_output_batch_commit(batch);
 	}
 
-	(void)mce_write_string_to_file(engine1_mode_path,
-				       MCE_LED_RUN_MODE);
+	mce_output_batch_delete(batch);
 
         /* Save what colors we are driving */
         current_lysti_led_pattern = pattern->engine1_mux | pattern->engine2_mux;
@@ -977,44 +1435,324 @@ static void lysti_program_led(const pattern_struct *const pattern)
  */
 static void njoy_program_led(const pattern_struct *const pattern)
 {
-	/* Disable old LED patterns */
-	njoy_disable_led();
+	mce_output_batch_t *batch = mce_output_batch_create();
 
 	/* Load new patterns */
 
 	/* Engine 1 */
-	(void)mce_write_string_to_file(engine1_mode_path,
-				       MCE_LED_LOAD_MODE);
-	(void)mce_write_string_to_file(engine1_load_path,
-				       pattern->channel1);
+	mce_output_batch_add(batch, &engine1_mode_output, MCE_LED_LOAD_MODE);
+	mce_output_batch_add(batch, &engine1_load_output, pattern->channel1);
 
 	if (get_led_type() == LED_TYPE_NJOY_RGB) {
 		/* Engine 2 */
-		(void)mce_write_string_to_file(engine2_mode_path,
-					       MCE_LED_LOAD_MODE);
-		(void)mce_write_string_to_file(engine2_load_path,
-					       pattern->channel2);
+		mce_output_batch_add(batch, &engine2_mode_output,
+				     MCE_LED_LOAD_MODE);
+		mce_output_batch_add(batch, &engine2_load_output,
+				     pattern->channel2);
 
 		/* Engine 3 */
-		(void)mce_write_string_to_file(engine3_mode_path,
-					       MCE_LED_LOAD_MODE);
-		(void)mce_write_string_to_file(engine3_load_path,
-					       pattern->channel3);
+		mce_output_batch_add(batch, &engine3_mode_output,
+				     MCE_LED_LOAD_MODE);
+		mce_output_batch_add(batch, &engine3_load_output,
+				     pattern->channel3);
 
 		/* Run the new pattern; enable engines in reverse order */
-		(void)mce_write_string_to_file(engine3_mode_path,
-					       MCE_LED_RUN_MODE);
-		(void)mce_write_string_to_file(engine2_mode_path,
-					       MCE_LED_RUN_MODE);
+		mce_output_batch_add(batch, &engine3_mode_output,
+				     MCE_LED_RUN_MODE);
+		mce_output_batch_add(batch, &engine2_mode_output,
+				     MCE_LED_RUN_MODE);
 	}
 
-	(void)mce_write_string_to_file(engine1_mode_path,
-				       MCE_LED_RUN_MODE);
+	mce_output_batch_add(batch, &engine1_mode_output, MCE_LED_RUN_MODE);
+
+	/* Reprogram unless the same pattern is already running */
+	if (!mce_output_batch_is_current(batch)) {
+		/* Disable old LED patterns */
+		njoy_disable_led();
+
+		(void)mce_output_batch_commit(batch);
+	}
+
+	mce_output_batch_delete(batch);
 
 	/* Reset brightness */
         njoy_set_brightness(-1);
 }
 
+/**
+ * Brightness level of a software driven pattern at given time
+ *
+ * The pattern ramps up from zero to full level, stays there for the
+ * on-period, ramps back down and stays off for the off-period
+ *
+ * @param pattern The pattern
+ * @param levels Number of brightness levels above zero
+ * @param t Time from the start of the pattern cycle in milliseconds
+ * @return Brightness level, 0 - levels
+ */
+static guint sw_pattern_level_at(const pattern_struct *const pattern,
+				 guint levels, guint t)
+{
+	guint rise = (guint)pattern->rise_time;
+	guint on = (guint)pattern->on_period;
+	guint fall = (guint)pattern->fall_time;
+
+	if (t < rise)
+		return levels * t / rise;
+
+	if ((t -= rise) < on)
+		return levels;
+
+	if ((t -= on) < fall)
+		return levels - levels * t / fall;
+
+	return 0;
+}
+
+/**
+ * Precompute keyframes for a software driven pattern
+ *
+ * Only points where the quantized brightness changes are stored, and
+ * keyframes are never closer than SW_PATTERN_MIN_FRAME_MS to each other;
+ * the exception is the keyframe that turns the LED off at the end of
+ * the fall ramp, which is always stored
+ *
+ * @param pattern The pattern
+ * @param levels Number of brightness levels above zero
+ */
+static void sw_pattern_compile(pattern_struct *const pattern, guint levels)
+{
+	sw_keyframe_t frame = { .time = 0, .level = 0 };
+	guint t;
+
+	/* Patterns that do not ramp are left to the hardware */
+	if ((pattern->rise_time <= 0) && (pattern->fall_time <= 0))
+		goto EXIT;
+
+	if ((pattern->rise_time < 0) || (pattern->fall_time < 0) ||
+	    (pattern->on_period < 0) || (pattern->off_period < 0)) {
+		mce_log(LL_ERR, "pattern %s: invalid timing", pattern->name);
+		goto EXIT;
+	}
+
+	pattern->cycle = (guint)(pattern->rise_time + pattern->on_period +
+				 pattern->fall_time + pattern->off_period);
+	pattern->levels = levels;
+
+	/* Keyframes are at least SW_PATTERN_MIN_FRAME_MS apart,
+	 * apart from the terminating zero level keyframe */
+	pattern->keyframes = g_new(sw_keyframe_t,
+				   pattern->cycle / SW_PATTERN_MIN_FRAME_MS + 2);
+
+	frame.level = (guint16)sw_pattern_level_at(pattern, levels, 0);
+	pattern->keyframes[pattern->frames++] = frame;
+
+	for (t = 1; t < pattern->cycle; t++) {
+		guint level = sw_pattern_level_at(pattern, levels, t);
+
+		if (level == frame.level)
+			continue;
+
+		if ((t - frame.time < SW_PATTERN_MIN_FRAME_MS) && (level != 0))
+			continue;
+
+		frame.time = t;
+		frame.level = (guint16)level;
+		pattern->keyframes[pattern->frames++] = frame;
+	}
+
+	pattern->keyframes = g_renew(sw_keyframe_t, pattern->keyframes,
+				     pattern->frames);
+
+	mce_log(LL_DEBUG, "pattern %s: %u keyframes in %u ms",
+		pattern->name, pattern->frames, pattern->cycle);
+
+EXIT:
+	return;
+}
+
+/**
+ * Find the keyframe in effect at given time
+ *
+ * @param pattern The pattern
+ * @param t Time from the start of the pattern cycle in milliseconds
+ * @return Index of the last keyframe at or before t
+ */
+static guint sw_pattern_find_frame(const pattern_struct *const pattern,
+				   guint t)
+{
+	guint lo = 0;
+	guint hi = pattern->frames;
+
+	while (hi - lo > 1) {
+		guint mid = (lo + hi) / 2;
+
+		if (pattern->keyframes[mid].time <= t)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/**
+ * Acquire or release the software driven pattern wakelock
+ *
+ * The pattern timer does not run while the device is suspended, and
+ * the LED is left at whatever level was written last
+ *
+ * @param hold TRUE to acquire, or FALSE to release the wakelock
+ */
+static void sw_pattern_set_wakelock(gboolean hold)
+{
+#ifdef ENABLE_WAKELOCKS
+	if (sw_pattern_wakelock_held == hold)
+		goto EXIT;
+
+	sw_pattern_wakelock_held = hold;
+
+	if (hold)
+		wakelock_lock(sw_pattern_wakelock, -1);
+	else
+		wakelock_unlock(sw_pattern_wakelock);
+
+EXIT:
+	return;
+#else
+	(void)hold;
+#endif
+}
+
+/**
+ * Cancel software pattern timer
+ */
+static void sw_pattern_cancel_timer(void)
+{
+	if (sw_pattern_timer_id != 0) {
+		g_source_remove(sw_pattern_timer_id);
+		sw_pattern_timer_id = 0;
+	}
+}
+
+/**
+ * Write the current brightness level of the software driven pattern
+ *
+ * @return Milliseconds until the next keyframe,
+ *         or 0 if the brightness never changes
+ */
+static guint sw_pattern_step(void)
+{
+	const pattern_struct *pattern = sw_pattern;
+	guint t;
+	guint i;
+	guint next;
+
+	if ((pattern == NULL) || (pattern->frames == 0))
+		return 0;
+
+	/* Follow the clock rather than count timer wakeups so that
+	 * late wakeups do not make the pattern drift
+	 */
+	t = (guint)((mce_lib_get_mono_tick() - sw_pattern_started) %
+		    pattern->cycle);
+	i = sw_pattern_find_frame(pattern, t);
+
+	if (sw_pattern_level != (gint)pattern->keyframes[i].level) {
+		sw_pattern_level = pattern->keyframes[i].level;
+		sw_pattern_write(pattern, (guint)sw_pattern_level);
+	}
+
+	if (pattern->frames == 1)
+		return 0;
+
+	if (i + 1 < pattern->frames)
+		next = pattern->keyframes[i + 1].time;
+	else if (pattern->keyframes[i].level != pattern->keyframes[0].level)
+		next = pattern->cycle;
+	else
+		/* Starting the next cycle would not change anything */
+		next = pattern->cycle + pattern->keyframes[1].time;
+
+	return next - t;
+}
+
+/**
+ * Timeout callback for software driven patterns
+ *
+ * @param data Unused
+ * @return Always returns FALSE to disable timeout
+ */
+static gboolean sw_pattern_timeout_cb(gpointer data)
+{
+	guint delay;
+
+	(void)data;
+
+	sw_pattern_timer_id = 0;
+
+	if ((delay = sw_pattern_step()) != 0)
+		sw_pattern_timer_id = g_timeout_add(delay,
+						    sw_pattern_timeout_cb,
+						    NULL);
+
+	/* Block suspend only in the middle of a ramp; suspending while
+	 * the LED is fully off or fully on leaves it at that level */
+	sw_pattern_set_wakelock((sw_pattern_timer_id != 0) &&
+				(sw_pattern_level > 0) &&
+				(sw_pattern_level < (gint)sw_pattern->levels));
+
+	return FALSE;
+}
+
+/**
+ * Start running a software driven pattern
+ *
+ * Restarting the pattern that is already running rewrites the current
+ * level without resetting the pattern phase
+ *
+ * @param pattern The pattern
+ * @param write Function for writing brightness levels
+ */
+static void sw_pattern_start(const pattern_struct *const pattern,
+			     void (*write)(const pattern_struct *, guint))
+{
+	if (sw_pattern != pattern) {
+		sw_pattern = pattern;
+		sw_pattern_started = mce_lib_get_mono_tick();
+	}
+
+	sw_pattern_write = write;
+	sw_pattern_level = -1;
+
+	sw_pattern_cancel_timer();
+	sw_pattern_timeout_cb(NULL);
+}
+
+/**
+ * Stop running software driven pattern
+ */
+static void sw_pattern_stop(void)
+{
+	sw_pattern_cancel_timer();
+	sw_pattern_set_wakelock(FALSE);
+	sw_pattern = NULL;
+	sw_pattern_level = -1;
+}
+
+/**
+ * Write brightness level of a software driven monochrome LED pattern
+ *
+ * @param pattern The pattern
+ * @param level Brightness level, 0 - pattern->brightness
+ */
+static void mono_sw_write(const pattern_struct *const pattern, guint level)
+{
+	(void)pattern;
+
+	mono_set_brightness((gint)level);
+}
+
 /**
  * Setup and activate a new mono-LED pattern
  *
@@ -1038,6 +1776,14 @@ static void mono_program_led(const pattern_struct *const pattern)
 	};
 
 
+	/* Ramping patterns are driven by software */
+	if (pattern->keyframes != NULL) {
+		(void)mce_write_string_to_file(MCE_LED_TRIGGER_PATH,
+					       MCE_LED_TRIGGER_NONE);
+		sw_pattern_start(pattern, mono_sw_write);
+		goto EXIT;
+	}
+
 	/* This shouldn't happen; disable the LED instead */
 	if (pattern->on_period == 0) {
 		mono_disable_led();
@@ -1080,6 +1826,26 @@ static inline int hybris_tune_brightness(int value)
 	return (res < 0) ? 0 : (res > 255) ? 255 : res;
 }
 
+/**
+ * Write brightness level of a software driven libhybris-LED pattern
+ *
+ * @param pattern The pattern
+ * @param level Brightness level, 0 - pattern->levels
+ */
+static void hybris_sw_write(const pattern_struct *const pattern, guint level)
+{
+	int r = (pattern->rgb_color >> 16) & 0xff;
+	int g = (pattern->rgb_color >>  8) & 0xff;
+	int b = (pattern->rgb_color >>  0) & 0xff;
+	int top = (int)pattern->levels;
+
+	r = hybris_tune_brightness(r * (int)level / top);
+	g = hybris_tune_brightness(g * (int)level / top);
+	b = hybris_tune_brightness(b * (int)level / top);
+
+	mce_hybris_indicator_set_pattern(r, g, b, 0, 0);
+}
+
 /**
  * Setup and activate a new libhybris-LED pattern
  *
@@ -1091,6 +1857,12 @@ static void hybris_program_led(const pattern_struct *const pattern)
 	int g = (pattern->rgb_color >>  8) & 0xff;
 	int b = (pattern->rgb_color >>  0) & 0xff;
 
+	/* Ramping patterns are driven by software */
+	if( pattern->keyframes ) {
+		sw_pattern_start(pattern, hybris_sw_write);
+		return;
+	}
+
 	/* Do als based brightness scaling before use*/
 	r = hybris_tune_brightness(r);
 	g = hybris_tune_brightness(g);
@@ -1143,78 +1915,18 @@ static void led_update_active_pattern(void)
 	display_state_t display_state = datapipe_get_gint(display_state_pipe);
 	system_state_t system_state = datapipe_get_gint(system_state_pipe);
 	pattern_struct *new_active_pattern;
-	gint i = 0;
 
 	if (g_queue_is_empty(pattern_stack) == TRUE) {
 		disable_led();
 		goto EXIT;
 	}
 
-	while ((new_active_pattern = g_queue_peek_nth(pattern_stack,
-						      i++)) != NULL) {
-		mce_log(LL_DEBUG,
-			"pattern: %s, active: %d, enabled: %d",
-			new_active_pattern->name,
-			new_active_pattern->active,
-			new_active_pattern->enabled);
+	new_active_pattern = led_select_pattern(system_state, display_state);
 
-		/* If the pattern is deactivated, ignore */
-		if (new_active_pattern->active == FALSE)
-			continue;
+	mce_log(LL_DEBUG, "pattern: %s",
+		new_active_pattern ? new_active_pattern->name : "none");
 
-		/* If the pattern is disabled through GConf, ignore */
-		if (new_active_pattern->enabled == FALSE)
-			continue;
-
-		/* If the LED is disabled,
-		 * only patterns with visibility 5 are shown
-		 */
-		if ((led_enabled == FALSE) &&
-		    (new_active_pattern->policy != 5))
-			continue;
-
-		/* Always show pattern with visibility 3 or 5 */
-		if ((new_active_pattern->policy == 3) ||
-		    (new_active_pattern->policy == 5))
-			break;
-
-		/* Acting dead behaviour */
-		if (system_state == MCE_STATE_ACTDEAD) {
-			/* If we're in acting dead,
-			 * show patterns with visibility 4
-			 */
-			if (new_active_pattern->policy == 4)
-				break;
-
-			/* If we're in acting dead
-			 * and the display is off, show pattern
-			 */
-			if ((display_state == MCE_DISPLAY_OFF) &&
-			    (new_active_pattern->policy == 2))
-				break;
-
-			/* If the display is on and visibility is 2,
-			 * or if visibility is 1/0, ignore pattern
-			 */
-			continue;
-		}
-
-		/* If the display is off or in low power mode,
-		 * we can use any active pattern
-		 */
-		if ((display_state == MCE_DISPLAY_OFF) ||
-		    (display_state == MCE_DISPLAY_LPM_OFF) ||
-		    (display_state == MCE_DISPLAY_LPM_ON))
-			break;
-
-		/* If the pattern should be shown with screen on, use it */
-		if (new_active_pattern->policy == 1)
-			break;
-	}
-
-	if ((new_active_pattern == NULL) ||
-	    ((led_enabled == FALSE) &&
-	     (new_active_pattern->policy != 5))) {
+	if (new_active_pattern == NULL) {
 		active_pattern = NULL;
 		disable_led();
 		cancel_pattern_timeout();
@@ -1247,90 +1959,34 @@ EXIT:
 static pattern_struct *find_pattern_struct(const gchar *const name)
 {
 	pattern_struct *psp = NULL;
-	GList *glp;
 
-	if (name == NULL)
+	if ((name == NULL) || (pattern_lut == NULL))
 		goto EXIT;
 
-	if ((glp = g_queue_find_custom(pattern_stack,
-				       name, queue_find)) != NULL) {
-		psp = (pattern_struct *)glp->data;
-	}
+	psp = g_hash_table_lookup(pattern_lut, name);
 
 EXIT:
 	return psp;
 }
 
-/**
- * Update combination rule
- *
- * @param name The rule to process
- * @param data Unused
- */
-static void update_combination_rule(gpointer name, gpointer data)
-{
-	combination_rule_struct *cr;
-	gboolean enabled = TRUE;
-	pattern_struct *psp;
-	GList *glp;
-	gchar *tmp;
-	gint i;
-
-	(void)data;
-
-	if ((glp = g_queue_find_custom(combination_rule_list,
-				       name, queue_find)) == NULL)
-		goto EXIT;
-
-	cr = glp->data;
-
-	/* If all patterns in the pre_requisite list are enabled,
-	 * then enable this pattern, else disable it
-	 */
-	for (i = 0; (tmp = g_queue_peek_nth(cr->pre_requisites, i)) != NULL; i++) {
-		/* We've got a pattern name; check if that pattern is active */
-		if (((psp = find_pattern_struct(tmp)) == NULL) ||
-		    (psp->active == FALSE)) {
-			enabled = FALSE;
-			break;
-		}
-	}
-
-	if ((psp = find_pattern_struct(name)) == NULL)
-		goto EXIT;
-
-	psp->active = enabled;
-
-EXIT:
-	return;
-}
-
 /**
  * Update activate patterns based on combination rules
  *
- * @param name THe name of the pattern that changed state
+ * A combined pattern is active when none of its pre-requisites
+ * are pending, i.e. when all of them are active
+ *
+ * @param psp The pattern that changed state
  */
-static void update_combination_rules(const gchar *const name)
+static void update_combination_rules(const pattern_struct *const psp)
 {
-	GList *glp;
+	guint i;
 
-	if (name == NULL) {
-		mce_log(LL_CRIT,
-			"called with name == NULL");
-		goto EXIT;
-	}
+	for (i = 0; (psp->rules != NULL) && (i < psp->rules->len); i++) {
+		combination_rule_struct *cr = g_ptr_array_index(psp->rules, i);
 
-	if ((glp = g_queue_find_custom(combination_rule_xref_list, name,
-				       queue_find)) != NULL) {
-		combination_rule_struct *xrf = glp->data;
-
-		/* Update all combination rules that this pattern influences */
-		g_queue_foreach(xrf->pre_requisites,
-				update_combination_rule, NULL);
+		if (cr->pattern != NULL)
+			pattern_set_active(cr->pattern, cr->pending == 0);
 	}
-
-EXIT:
-	return;
 }
 
 /**
@@ -1349,8 +2005,8 @@ static void led_activate_pattern(const gchar *const name)
 	}
 
 	if ((psp = find_pattern_struct(name)) != NULL) {
-		psp->active = TRUE;
-		update_combination_rules(name);
+		pattern_set_active(psp, TRUE);
+		update_combination_rules(psp);
 		led_update_active_pattern();
 		mce_log(LL_DEBUG,
 			"LED pattern %s activated",
@@ -1375,8 +2031,8 @@ static void led_deactivate_pattern(const gchar *const name)
 	pattern_struct *psp;
 
 	if ((psp = find_pattern_struct(name)) != NULL) {
-		psp->active = FALSE;
-		update_combination_rules(name);
+		pattern_set_active(psp, FALSE);
+		update_combination_rules(psp);
 		led_update_active_pattern();
 		mce_log(LL_DEBUG,
 			"LED pattern %s deactivated",
@@ -1541,7 +2197,7 @@ static void led_gconf_cb(GConfClient *const gcc, const guint id,
 	if ((glp = g_queue_find_custom(pattern_stack,
 				       &id, gconf_cb_find)) != NULL) {
 		psp = (pattern_struct *)glp->data;
-		psp->enabled = gconf_value_get_bool(gcv);
+		pattern_set_enabled(psp, gconf_value_get_bool(gcv));
 		led_update_active_pattern();
 	} else {
 		mce_log(LL_WARN, "Spurious GConf value received; confused!");
@@ -1769,7 +2425,7 @@ static gboolean init_combination_rules(void)
 				goto EXIT2;
 			}
 
-			cr = g_slice_new(combination_rule_struct);
+			cr = g_slice_new0(combination_rule_struct);
 
 			if (cr == NULL) {
 				g_strfreev(tmp);
@@ -1779,32 +2435,12 @@ static gboolean init_combination_rules(void)
 			cr->rulename = strdup(tmp[0]);
 			cr->pre_requisites = g_queue_new();
 
-			for (j = 1; j < length; j++) {
-				gchar *str = strdup(tmp[j]);
-				GList *glp;
-				combination_rule_struct *xrf = NULL;
-
-				g_queue_push_head(cr->pre_requisites, str);
-
-				glp = g_queue_find_custom(combination_rule_xref_list, str, queue_find);
-
-				if ((glp == NULL) || (glp->data == NULL)) {
-					xrf = g_slice_new(combination_rule_struct);
-					xrf->rulename = str;
-					xrf->pre_requisites = g_queue_new();
-					g_queue_push_head(combination_rule_xref_list, xrf);
-				} else {
-					xrf = (combination_rule_struct *)glp->data;
-				}
-
-				/* If the cross reference isn't in the list
-				 * already, add it
-				 */
-				if (g_queue_find_custom(xrf->pre_requisites, cr->rulename, queue_find) == NULL) {
-					g_queue_push_head(xrf->pre_requisites,
-							  cr->rulename);
-				}
-			}
+			/* Cross-references from the pre-requisites
+			 * are set up in init_pattern_index()
+			 */
+			for (j = 1; j < length; j++)
+				g_queue_push_head(cr->pre_requisites,
+						  strdup(tmp[j]));
 
 			g_queue_push_head(combination_rule_list, cr);
 		}
@@ -1914,7 +2550,7 @@ static gboolean init_lysti_patterns(void)
 				continue;
 			}
 
-			psp = g_slice_new(pattern_struct);
+			psp = g_slice_new0(pattern_struct);
 
 			if (!psp) {
 				g_strfreev(tmp);
@@ -2049,7 +2685,7 @@ static gboolean init_njoy_patterns(void)
 				continue;
 			}
 
-			psp = g_slice_new(pattern_struct);
+			psp = g_slice_new0(pattern_struct);
 
 			if (!psp) {
 				g_strfreev(tmp);
@@ -2163,14 +2799,15 @@ static gboolean init_mono_patterns(void)
 		if (tmp != NULL) {
 			pattern_struct *psp;
 
-			if (length != NUMBER_OF_PATTERN_FIELDS) {
+			if ((length != NUMBER_OF_PATTERN_FIELDS) &&
+			    (length != NUMBER_OF_PATTERN_FIELDS_SW)) {
 				mce_log(LL_ERR,
 					"Skipping invalid LED-pattern");
 				g_free(tmp);
 				continue;
 			}
 
-			psp = g_slice_new(pattern_struct);
+			psp = g_slice_new0(pattern_struct);
 
 			if (!psp) {
 				g_free(tmp);
@@ -2186,6 +2823,12 @@ static gboolean init_mono_patterns(void)
 			psp->brightness = tmp[PATTERN_BRIGHTNESS_FIELD];
 			psp->active = FALSE;
 
+			if (length == NUMBER_OF_PATTERN_FIELDS_SW) {
+				psp->rise_time = tmp[PATTERN_RISE_TIME_FIELD];
+				psp->fall_time = tmp[PATTERN_FALL_TIME_FIELD];
+				sw_pattern_compile(psp, (guint)psp->brightness);
+			}
+
 			psp->enabled = pattern_get_enabled(patternlist[i],
 							   &(psp->gconf_cb_id));
 
@@ -2293,6 +2936,8 @@ static gboolean init_hybris_patterns(void)
                 IDX_ON_PERIOD,  /* On-period field */
                 IDX_OFF_PERIOD, /* Off-period field */
                 IDX_COLOR,      /* LED color field */
+                IDX_RISE_TIME,  /* Optional ramp-up time field */
+                IDX_FALL_TIME,  /* Optional ramp-down time field */
                 IDX_NUMOF
         };
 
@@ -2343,7 +2988,7 @@ static gboolean init_hybris_patterns(void)
 			mce_log(LL_WARN,"LED pattern '%s' not configured",
 				name);
 		}
-		else if( length != IDX_NUMOF ) {
+		else if( length != IDX_RISE_TIME && length != IDX_NUMOF ) {
 			mce_log(LL_ERR,"LED pattern '%s' is invalid",
 				name);
 		}
@@ -2351,7 +2996,7 @@ static gboolean init_hybris_patterns(void)
 			mce_log(LL_DEBUG,"Getting LED pattern for: %s",
 				name);
 
-			pattern_struct *psp = g_slice_new(pattern_struct);
+			pattern_struct *psp = g_slice_new0(pattern_struct);
 
 			memset(psp, 0, sizeof *psp);
 
@@ -2366,6 +3011,13 @@ static gboolean init_hybris_patterns(void)
 			psp->enabled    = pattern_get_enabled(name,
 							   &psp->gconf_cb_id);
 
+			if( length == IDX_NUMOF ) {
+				psp->rise_time = strtol(v[IDX_RISE_TIME], 0, 0);
+				psp->fall_time = strtol(v[IDX_FALL_TIME], 0, 0);
+				sw_pattern_compile(psp,
+						   SW_PATTERN_HYBRIS_LEVELS);
+			}
+
 			g_queue_insert_sorted(pattern_stack, psp,
 					      queue_prio_compare,
 					      NULL);
@@ -2455,17 +3107,17 @@ const gchar *g_module_check_init(GModule *module)
 	append_output_trigger_to_datapipe(&led_pattern_deactivate_pipe,
 					  led_pattern_deactivate_trigger);
 
-	/* Setup a pattern stack,
-	 * a combination rule stack and a cross-refernce for said stack
+	/* Setup a pattern stack and a combination rule stack
 	 * and initialise the patterns
 	 */
 	pattern_stack = g_queue_new();
 	combination_rule_list = g_queue_new();
-	combination_rule_xref_list = g_queue_new();
 
 	if (init_patterns() == FALSE)
 		goto EXIT;
 
+	init_pattern_index();
+
 	/* req_led_pattern_activate */
 	if (mce_dbus_handler_add(MCE_REQUEST_IF,
 				 MCE_ACTIVATE_LED_PATTERN,
@@ -2546,6 +3198,19 @@ void g_module_unload(GModule *module)
 		led_disable();
 	}
 
+	/* Close engine files; they were used by led_disable() */
+	mce_close_output(&engine1_mode_output);
+	mce_close_output(&engine2_mode_output);
+	mce_close_output(&engine3_mode_output);
+
+	mce_close_output(&engine1_load_output);
+	mce_close_output(&engine2_load_output);
+	mce_close_output(&engine3_load_output);
+
+	mce_close_output(&engine1_leds_output);
+	mce_close_output(&engine2_leds_output);
+	mce_close_output(&engine3_leds_output);
+
 	/* Free path strings; this has to be done after led_disable(),
 	 * since it uses these paths
 	 */
@@ -2557,17 +3222,23 @@ void g_module_unload(GModule *module)
 	g_free((void*)led_brightness_g_output.path);
 	g_free((void*)led_brightness_b_output.path);
 
-	g_free(engine1_mode_path);
-	g_free(engine2_mode_path);
-	g_free(engine3_mode_path);
+	g_free((void*)engine1_mode_output.path);
+	g_free((void*)engine2_mode_output.path);
+	g_free((void*)engine3_mode_output.path);
 
-	g_free(engine1_load_path);
-	g_free(engine2_load_path);
-	g_free(engine3_load_path);
+	g_free((void*)engine1_load_output.path);
+	g_free((void*)engine2_load_output.path);
+	g_free((void*)engine3_load_output.path);
 
-	g_free(engine1_leds_path);
-	g_free(engine2_leds_path);
-	g_free(engine3_leds_path);
+	g_free((void*)engine1_leds_output.path);
+	g_free((void*)engine2_leds_output.path);
+	g_free((void*)engine3_leds_output.path);
+
+	/* Stop software driven patterns before releasing them */
+	sw_pattern_stop();
+
+	/* Free the pattern lookup table and heaps */
+	quit_pattern_index();
 
 	/* Free the pattern stack */
 	if (pattern_stack != NULL) {
@@ -2577,6 +3248,7 @@ void g_module_unload(GModule *module)
 			mce_gconf_notifier_remove(GINT_TO_POINTER(psp->gconf_cb_id), NULL);
 			free(psp->name);
 			psp->name = NULL;
+			g_free(psp->keyframes);
 			g_slice_free(pattern_struct, psp);
 		}
 
@@ -2605,20 +3277,6 @@ void g_module_unload(GModule *module)
 		combination_rule_list = NULL;
 	}
 
-	/* Free the combination rule cross reference list */
-	if (combination_rule_xref_list != NULL) {
-		combination_rule_struct *xrf;
-
-		while ((xrf = g_queue_pop_head(combination_rule_xref_list)) != NULL) {
-			g_queue_free(xrf->pre_requisites);
-			xrf->pre_requisites = NULL;
-			g_slice_free(combination_rule_struct, xrf);
-		}
-
-		g_queue_free(combination_rule_xref_list);
-		combination_rule_xref_list = NULL;
-	}
-
 	/* Remove all timer sources */
 	cancel_pattern_timeout();
 
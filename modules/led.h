@@ -105,6 +105,12 @@
 /** Maximum libhybris led brightness */
 #define MAXIMUM_HYBRIS_LED_BRIGHTNESS		100	/* % */
 
+/** Number of brightness steps used for software driven libhybris patterns */
+#define SW_PATTERN_HYBRIS_LEVELS		32
+
+/** Shortest time between software driven pattern updates in milliseconds */
+#define SW_PATTERN_MIN_FRAME_MS			20
+
 /** Path to the mono LED /sys directory */
 #define MCE_MONO_LED_SYS_PATH			"/sys/class/leds/keypad"
 
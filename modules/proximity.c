@@ -454,58 +454,35 @@ EXIT:
 }
 
 /**
- * I/O monitor callback for the proximity sensor (sensorfw)
+ * Sample batch callback for the proximity sensor (sensorfw, libhybris)
  *
- * @param covered  proximity sensor covered
- */
-#ifdef ENABLE_SENSORFW
-static void ps_sensorfw_iomon_cb(bool covered)
-{
-	cover_state_t proximity_sensor_state = COVER_UNDEF;
-
-	if( covered )
-		proximity_sensor_state = COVER_CLOSED;
-	else
-		proximity_sensor_state = COVER_OPEN;
-
-	if (old_proximity_sensor_state == proximity_sensor_state)
-		goto EXIT;
-
-	mce_log(LL_DEBUG, "state:%d -> %d", old_proximity_sensor_state,
-		proximity_sensor_state);
-
-	old_proximity_sensor_state = proximity_sensor_state;
-
-	(void)execute_datapipe(&proximity_sensor_pipe,
-			       GINT_TO_POINTER(proximity_sensor_state),
-			       USE_INDATA, CACHE_INDATA);
-EXIT:
-	return;
-}
-#endif /* ENABLE_SENSORFW */
-
-/**
- * I/O monitor callback for the proximity sensor (libhybris)
+ * Only the newest sample decides the reported state; cover/uncover
+ * transitions that revert within the same batch were already over
+ * by the time mce got to see them and are not fed to the datapipe.
  *
- * @param timestamp event time
- * @param distance  distance from proximity sensor to object
+ * @param samples  proximity samples, oldest first
+ * @param count    number of samples
  */
-
-#ifdef ENABLE_HYBRIS
-static void ps_hybris_iomon_cb(int64_t timestamp, float distance)
+#if defined(ENABLE_SENSORFW) || defined(ENABLE_HYBRIS)
+static void ps_batch_cb(const mce_sensor_sample_t *samples, unsigned count)
 {
-	static const float minval = 2.0f; // [cm]
-
+	const mce_sensor_sample_t *last = &samples[count - 1];
 	cover_state_t proximity_sensor_state = COVER_UNDEF;
+	unsigned transitions = 0;
 
-	if( distance <= minval )
+	for (unsigned i = 1; i < count; i++) {
+		if (samples[i].value != samples[i - 1].value)
+			transitions++;
+	}
+
+	if( last->value )
 		proximity_sensor_state = COVER_CLOSED;
 	else
 		proximity_sensor_state = COVER_OPEN;
 
-	mce_log(LL_DEBUG, "time:%lld distance:%g state:%d -> %d",
-		timestamp, distance, old_proximity_sensor_state,
-		proximity_sensor_state);
+	mce_log(LL_DEBUG, "time:%llu samples:%u transitions:%u state:%d -> %d",
+		(unsigned long long)last->timestamp, count, transitions,
+		old_proximity_sensor_state, proximity_sensor_state);
 
 	if (old_proximity_sensor_state == proximity_sensor_state)
 		goto EXIT;
@@ -515,11 +492,10 @@ static void ps_hybris_iomon_cb(int64_t timestamp, float distance)
 	(void)execute_datapipe(&proximity_sensor_pipe,
 			       GINT_TO_POINTER(proximity_sensor_state),
 			       USE_INDATA, CACHE_INDATA);
-
 EXIT:
 	return;
 }
-#endif /* ENABLE_HYBRIS */
+#endif /* ENABLE_SENSORFW || ENABLE_HYBRIS */
 
 /**
  * Update the proximity state (Avago)
@@ -622,14 +598,14 @@ static void enable_proximity_monitor(void)
 	switch( get_ps_type() ) {
 #ifdef ENABLE_SENSORFW
 	case PS_TYPE_SENSORFW:
-		mce_sensorfw_ps_set_notify(ps_sensorfw_iomon_cb);
+		mce_sensorfw_ps_set_batch_notify(ps_batch_cb);
 		enable_proximity_sensor();
 		goto EXIT;
 #endif
 #ifdef ENABLE_HYBRIS
 	case PS_TYPE_HYBRIS:
 		/* hook first, then enable */
-		mce_hybris_ps_set_callback(ps_hybris_iomon_cb);
+		mce_hybris_ps_set_batch_callback(ps_batch_cb);
 		enable_proximity_sensor();
 
 		/* FIXME: Is there a way to get immediate reading
@@ -687,12 +663,12 @@ static void disable_proximity_monitor(void)
 	switch( get_ps_type() ) {
 #ifdef ENABLE_SENSORFW
 	case PS_TYPE_SENSORFW:
-		mce_sensorfw_ps_set_notify(0);
+		mce_sensorfw_ps_set_batch_notify(0);
 		break;
 #endif
 #ifdef ENABLE_HYBRIS
 	case PS_TYPE_HYBRIS:
-		mce_hybris_ps_set_callback(0);
+		mce_hybris_ps_set_batch_callback(0);
 		break;
 #endif
 
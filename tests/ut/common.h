@@ -6,6 +6,8 @@
 #include <sys/cdefs.h>
 #include <sys/mman.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
 #if CHECK_MAJOR_VERSION < 0 || CHECK_MINOR_VERSION < 9 || CHECK_MICRO_VERSION < 9
@@ -112,17 +114,32 @@
 		tcase_fn_start (""# __testname, __FILE__, __LINE__); \
 		printf("--- " # __testname " [%d]:\n", _i);
 
-/* Provide stub for mce_log_file so the log output is to stdout, instead of
- * syslog */
+/* Provide stubs for mce_log_file and mce_log_p so the log output is to
+ * stdout, instead of syslog; define UT_REAL_MCE_LOG to test the real
+ * logging code instead */
 
 #include "../../mce-log.h"
 
+#ifndef UT_REAL_MCE_LOG
+
+/* Tests may lower this to keep benchmarks free of log output */
+static loglevel_t stub__mce_log_verbosity = LL_DEBUG;
+
+EXTERN_STUB (
+int, mce_log_p, (const loglevel_t loglevel))
+{
+	return loglevel <= stub__mce_log_verbosity;
+}
+
 EXTERN_STUB (
 void, mce_log_file, (loglevel_t loglevel, const char *const file,
 		     const char *const function, const char *const fmt, ...))
 {
 	(void)file;
 
+	if( loglevel > stub__mce_log_verbosity )
+		return;
+
 	const char *tag(loglevel_t level)
 	{
 		const char *res = "?";
@@ -150,6 +167,32 @@ void, mce_log_file, (loglevel_t loglevel, const char *const file,
 	g_free(msg);
 }
 
+#endif /* UT_REAL_MCE_LOG */
+
+/* ------------------------------------------------------------------------- *
+ * BENCHMARKS
+ * ------------------------------------------------------------------------- */
+
+/* Benchmarks depend on wall clock time and are added to test suites
+ * only when UT_BENCHMARKS environment variable is set */
+
+G_GNUC_UNUSED
+static gboolean ut_benchmarks_enabled(void)
+{
+	return getenv("UT_BENCHMARKS") != NULL;
+}
+
+/** Get monotonic time in nanoseconds */
+G_GNUC_UNUSED
+static gint64 ut_get_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * (gint64)1000000000 + ts.tv_nsec;
+}
+
 /* ------------------------------------------------------------------------- *
  * OTHER
  * ------------------------------------------------------------------------- */
@@ -0,0 +1,330 @@
+#include <check.h>
+#include <glib.h>
+
+#include "common.h"
+
+#include "../../builtin-gconf.c"
+
+/* ------------------------------------------------------------------------- *
+ * STUBS
+ * ------------------------------------------------------------------------- */
+
+EXTERN_STUB (
+gint, mce_conf_get_int, (const gchar *group, const gchar *key,
+			 const gint defaultval))
+{
+	(void)group;
+	(void)key;
+
+	return defaultval;
+}
+
+/** Number of times the values file has been written */
+static guint stub__mce_io_update_file_atomic_calls = 0;
+
+EXTERN_STUB (
+gboolean, mce_io_update_file_atomic, (const char *path,
+				      const void *data, size_t size,
+				      mode_t mode, gboolean keep_backup))
+{
+	(void)path;
+	(void)data;
+	(void)size;
+	(void)mode;
+	(void)keep_backup;
+
+	stub__mce_io_update_file_atomic_calls++;
+
+	return TRUE;
+}
+
+EXTERN_STUB (
+void, mce_dbus_send_config_notification, (GConfEntry *entry))
+{
+	(void)entry;
+}
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+/** Number of notifications received per key */
+static GHashTable *ut_notified = NULL;
+
+static void ut_notify_cb(GConfClient *client, guint id,
+			 GConfEntry *entry, gpointer user_data)
+{
+	(void)client;
+	(void)id;
+	(void)user_data;
+
+	const char *key = gconf_entry_get_key(entry);
+	guint count = GPOINTER_TO_UINT(g_hash_table_lookup(ut_notified, key));
+
+	g_hash_table_insert(ut_notified, g_strdup(key),
+			    GUINT_TO_POINTER(count + 1));
+}
+
+static guint ut_notified_count(const char *key)
+{
+	return GPOINTER_TO_UINT(g_hash_table_lookup(ut_notified, key));
+}
+
+/** Count the notification and remove notify given as user_data */
+static void ut_notify_remove_cb(GConfClient *client, guint id,
+				GConfEntry *entry, gpointer user_data)
+{
+	ut_notify_cb(client, id, entry, user_data);
+	gconf_client_notify_remove(client, GPOINTER_TO_UINT(user_data));
+}
+
+/** Write the current value of a key back via the type specific setter */
+static gboolean ut_set_same_value(GConfClient *client, const char *key)
+{
+	gboolean res = FALSE;
+	GConfValue *value = gconf_client_get(client, key, NULL);
+	GSList *list = NULL;
+	gchar *str = NULL;
+
+	if (!value)
+		goto EXIT;
+
+	switch (value->type) {
+	case GCONF_VALUE_BOOL:
+		res = gconf_client_set_bool(client, key,
+					    gconf_value_get_bool(value), NULL);
+		break;
+	case GCONF_VALUE_INT:
+		res = gconf_client_set_int(client, key,
+					   gconf_value_get_int(value), NULL);
+		break;
+	case GCONF_VALUE_FLOAT:
+		res = gconf_client_set_float(client, key,
+					     gconf_value_get_float(value),
+					     NULL);
+		break;
+	case GCONF_VALUE_STRING:
+		/* The value is shared; setting it frees the old string */
+		str = g_strdup(gconf_value_get_string(value));
+		res = gconf_client_set_string(client, key, str, NULL);
+		break;
+	case GCONF_VALUE_LIST:
+		/* The value is shared; setting it frees the old list */
+		list = gconf_value_list_copy(gconf_value_get_list(value));
+		res = gconf_client_set_list(client, key,
+					    gconf_value_get_list_type(value),
+					    list, NULL);
+		break;
+	default:
+		break;
+	}
+
+EXIT:
+	gconf_value_list_free(list);
+	g_free(str);
+	if (value)
+		gconf_value_free(value);
+
+	return res;
+}
+
+static void ut_setup(void)
+{
+	ut_notified = g_hash_table_new_full(g_str_hash, g_str_equal,
+					    g_free, NULL);
+}
+
+static void ut_teardown(void)
+{
+	g_hash_table_unref(ut_notified), ut_notified = NULL;
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+START_TEST (ut_check_all_keys_found)
+{
+	GConfClient *client = gconf_client_get_default();
+	guint keys = 0;
+
+	for (const setting_t *elem = gconf_defaults; elem->key; ++elem) {
+		GConfValue *value = gconf_client_get(client, elem->key, NULL);
+
+		ck_assert_msg(value != NULL, "key %s not found", elem->key);
+		gconf_value_free(value);
+		keys++;
+	}
+
+	ck_assert_int_eq(g_hash_table_size(client->entry_lut), keys);
+	ck_assert(gconf_client_get(client, "/no/such/key", NULL) == NULL);
+}
+END_TEST
+
+START_TEST (ut_check_notify_by_key)
+{
+	GConfClient *client = gconf_client_get_default();
+	const char *key_a = gconf_defaults[0].key;
+	const char *key_b = gconf_defaults[1].key;
+	guint id_a1, id_a2, id_b;
+
+	id_a1 = gconf_client_notify_add(client, key_a, ut_notify_cb,
+					NULL, NULL, NULL);
+	id_a2 = gconf_client_notify_add(client, key_a, ut_notify_cb,
+					NULL, NULL, NULL);
+	id_b  = gconf_client_notify_add(client, key_b, ut_notify_cb,
+					NULL, NULL, NULL);
+
+	ck_assert(ut_set_same_value(client, key_a));
+	ck_assert_int_eq(ut_notified_count(key_a), 2);
+	ck_assert_int_eq(ut_notified_count(key_b), 0);
+
+	gconf_client_notify_remove(client, id_a1);
+	ck_assert(ut_set_same_value(client, key_a));
+	ck_assert(ut_set_same_value(client, key_b));
+	ck_assert_int_eq(ut_notified_count(key_a), 3);
+	ck_assert_int_eq(ut_notified_count(key_b), 1);
+
+	/* Removing the last notify of a key drops the bucket */
+	gconf_client_notify_remove(client, id_a2);
+	gconf_client_notify_remove(client, id_b);
+	ck_assert(g_hash_table_lookup(client->notify_lut, key_a) == NULL);
+	ck_assert_int_eq(g_hash_table_size(client->notify_lut), 0);
+	ck_assert(client->notify_list == NULL);
+
+	ck_assert(ut_set_same_value(client, key_a));
+	ck_assert_int_eq(ut_notified_count(key_a), 3);
+}
+END_TEST
+
+START_TEST (ut_check_notify_remove_from_cb)
+{
+	GConfClient *client = gconf_client_get_default();
+	const char *key = gconf_defaults[0].key;
+	guint id_victim, id_remover;
+
+	/* Buckets are in reverse registration order -> the remover
+	 * gets called first and drops the notify that would be next */
+	id_victim = gconf_client_notify_add(client, key, ut_notify_cb,
+					    NULL, NULL, NULL);
+	id_remover = gconf_client_notify_add(client, key, ut_notify_remove_cb,
+					     GUINT_TO_POINTER(id_victim),
+					     NULL, NULL);
+
+	ck_assert(ut_set_same_value(client, key));
+	ck_assert_int_eq(ut_notified_count(key), 1);
+
+	gconf_client_notify_remove(client, id_remover);
+	ck_assert(client->notify_list == NULL);
+	ck_assert_int_eq(g_hash_table_size(client->notify_lut), 0);
+}
+END_TEST
+
+START_TEST (ut_check_write_behind)
+{
+	GConfClient *client = gconf_client_get_default();
+	const char *key = gconf_defaults[0].key;
+	guint coalesced;
+
+	gconf_client_suggest_sync(client, NULL);
+	ck_assert_int_eq(client->save_id, 0);
+
+	stub__mce_io_update_file_atomic_calls = 0;
+	coalesced = client->save_coalesced;
+
+	/* Changes are written out only after the delay ... */
+	for (int i = 0; i < 10; i++)
+		ck_assert(ut_set_same_value(client, key));
+	ck_assert_int_eq(stub__mce_io_update_file_atomic_calls, 0);
+	ck_assert(client->save_id != 0);
+	ck_assert_int_eq(client->save_coalesced, coalesced + 9);
+
+	/* ... or when explicitly asked to, but only once */
+	gconf_client_suggest_sync(client, NULL);
+	ck_assert_int_eq(stub__mce_io_update_file_atomic_calls, 1);
+	ck_assert_int_eq(client->save_id, 0);
+
+	gconf_client_suggest_sync(client, NULL);
+	ck_assert_int_eq(stub__mce_io_update_file_atomic_calls, 1);
+
+	/* Zero delay writes through */
+	client->save_delay = 0;
+	ck_assert(ut_set_same_value(client, key));
+	ck_assert(ut_set_same_value(client, key));
+	ck_assert_int_eq(stub__mce_io_update_file_atomic_calls, 3);
+	ck_assert_int_eq(client->save_id, 0);
+	client->save_delay = DEFAULT_SAVE_DELAY;
+}
+END_TEST
+
+/* Bulk get and set of every known key with a notify installed for each
+ * of them; every set reaches exactly the notify of its own key */
+START_TEST (ut_check_bulk)
+{
+	GConfClient *client = gconf_client_get_default();
+	const guint rounds = 2;
+	GArray *ids = g_array_new(FALSE, FALSE, sizeof(guint));
+
+	for (const setting_t *elem = gconf_defaults; elem->key; ++elem) {
+		guint id = gconf_client_notify_add(client, elem->key,
+						   ut_notify_cb, NULL, NULL,
+						   NULL);
+		g_array_append_val(ids, id);
+	}
+
+	for (guint i = 0; i < rounds; i++) {
+		for (const setting_t *elem = gconf_defaults; elem->key; ++elem) {
+			GConfValue *value = gconf_client_get(client, elem->key,
+							     NULL);
+			ck_assert(value != NULL);
+			gconf_value_free(value);
+		}
+	}
+	for (guint i = 0; i < rounds; i++) {
+		for (const setting_t *elem = gconf_defaults; elem->key; ++elem)
+			ck_assert(ut_set_same_value(client, elem->key));
+	}
+
+	for (const setting_t *elem = gconf_defaults; elem->key; ++elem)
+		ck_assert_int_eq(ut_notified_count(elem->key), rounds);
+
+	for (guint i = 0; i < ids->len; i++)
+		gconf_client_notify_remove(client, g_array_index(ids, guint, i));
+	g_array_free(ids, TRUE);
+
+	ck_assert(client->notify_list == NULL);
+}
+END_TEST
+
+static Suite *ut_builtin_gconf_suite (void)
+{
+	Suite *s = suite_create ("ut_builtin_gconf");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_checked_fixture(tc_core, ut_setup, ut_teardown);
+	tcase_add_test (tc_core, ut_check_all_keys_found);
+	tcase_add_test (tc_core, ut_check_notify_by_key);
+	tcase_add_test (tc_core, ut_check_notify_remove_from_cb);
+	tcase_add_test (tc_core, ut_check_write_behind);
+	tcase_add_test (tc_core, ut_check_bulk);
+	suite_add_tcase (s, tc_core);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	/* Keep debug logging of the bulk test out of the output */
+	stub__mce_log_verbosity = LL_WARN;
+
+	int number_failed;
+	Suite *s = ut_builtin_gconf_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
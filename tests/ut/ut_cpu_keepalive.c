@@ -0,0 +1,280 @@
+#include <check.h>
+#include <glib.h>
+
+#include "common.h"
+
+/* Tested module */
+#include "../../modules/cpu-keepalive.c"
+
+/* ------------------------------------------------------------------------- *
+ * STUBS
+ * ------------------------------------------------------------------------- */
+
+EXTERN_STUB (
+void, dbus_bus_add_match, (DBusConnection *connection, const char *rule,
+			   DBusError *error))
+{
+	(void)connection;
+	(void)rule;
+	(void)error;
+}
+
+EXTERN_STUB (
+void, dbus_bus_remove_match, (DBusConnection *connection, const char *rule,
+			      DBusError *error))
+{
+	(void)connection;
+	(void)rule;
+	(void)error;
+}
+
+/* No message -> client verification is skipped */
+EXTERN_STUB (
+DBusMessage *, dbus_message_new_method_call, (const char *bus_name,
+					      const char *path,
+					      const char *iface,
+					      const char *method))
+{
+	(void)bus_name;
+	(void)path;
+	(void)iface;
+	(void)method;
+
+	return NULL;
+}
+
+EXTERN_STUB (
+dbus_bool_t, dbus_message_append_args, (DBusMessage *message,
+					int first_arg_type, ...))
+{
+	(void)message;
+	(void)first_arg_type;
+
+	return FALSE;
+}
+
+/** Number of cpu-keepalive wakelock_lock() calls, i.e. sysfs writes */
+static guint stub__lock_calls = 0;
+
+/** Number of cpu-keepalive wakelock_unlock() calls */
+static guint stub__unlock_calls = 0;
+
+EXTERN_STUB (
+void, wakelock_lock, (const char *name, long long ns))
+{
+	(void)ns;
+
+	if (!strcmp(name, cpu_wakelock))
+		stub__lock_calls++;
+}
+
+EXTERN_STUB (
+void, wakelock_unlock, (const char *name))
+{
+	if (!strcmp(name, cpu_wakelock))
+		stub__unlock_calls++;
+}
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+static void ut_setup(void)
+{
+	client_heap = g_ptr_array_new();
+	clients = g_hash_table_new_full(g_str_hash, g_str_equal,
+					g_free, client_delete_cb);
+
+	wakeup_started = 0;
+	wakeup_timeout = 0;
+	cpu_wakelock_held = FALSE;
+
+	stub__lock_calls = 0;
+	stub__unlock_calls = 0;
+}
+
+static void ut_teardown(void)
+{
+	cpu_keepalive_cancel_timer();
+
+	if (clients)
+		g_hash_table_unref(clients), clients = 0;
+	if (client_heap)
+		g_ptr_array_free(client_heap, TRUE), client_heap = 0;
+}
+
+/** Check that client_heap is ordered and positions are up to date */
+static void ut_assert_heap(void)
+{
+	for (guint i = 0; i < client_heap->len; i++) {
+		ck_assert_int_eq(client_heap_get(i)->heap_pos, i);
+
+		if (i > 0) {
+			ck_assert(client_heap_get((i - 1) / 2)->timeout <=
+				  client_heap_get(i)->timeout);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+/* Clients are kept in deadline order through updates and removals */
+START_TEST (ut_check_heap_order)
+{
+	const guint count = 200;
+	client_t *client[count];
+	gint64 prev = 0;
+
+	for (guint i = 0; i < count; i++) {
+		client[i] = client_create("ut");
+		client_update_timeout(client[i], g_random_int_range(1, 1000));
+		ut_assert_heap();
+	}
+
+	for (guint i = 0; i < count; i += 3) {
+		client_update_timeout(client[i], client[i]->timeout + 500);
+		ut_assert_heap();
+	}
+
+	for (guint i = 0; i < count; i += 4) {
+		client_clear_timeout(client[i]);
+		ck_assert_int_eq(client[i]->heap_pos, CLIENT_HEAP_NONE);
+		ut_assert_heap();
+	}
+
+	for (guint i = 1; i < count; i += 4) {
+		client_delete(client[i]), client[i] = 0;
+		ut_assert_heap();
+	}
+
+	while (client_heap_peek()) {
+		client_t *head = client_heap_peek();
+
+		ck_assert(prev <= head->timeout);
+		prev = head->timeout;
+		client_clear_timeout(head);
+		ut_assert_heap();
+	}
+
+	for (guint i = 0; i < count; i++)
+		client_delete(client[i]);
+}
+END_TEST
+
+/* Renewing keepalive periods does not cause wakelock writes */
+START_TEST (ut_check_renew_wakelock_edges)
+{
+	for (int i = 0; i < 100; i++) {
+		cpu_keepalive_start("client1");
+		cpu_keepalive_start("client2");
+		cpu_keepalive_register("client3");
+	}
+
+	ck_assert_int_eq(stub__lock_calls, 1);
+	ck_assert_int_eq(stub__unlock_calls, 0);
+	ck_assert(timer_id != 0);
+
+	/* Timer is programmed for the earliest deadline */
+	ck_assert(timer_when == cpu_keepalive_get_client("client3")->timeout);
+
+	cpu_keepalive_stop("client1");
+	cpu_keepalive_remove_client("client2");
+	ck_assert_int_eq(stub__unlock_calls, 0);
+
+	cpu_keepalive_stop("client3");
+	ck_assert_int_eq(stub__lock_calls, 1);
+	ck_assert_int_eq(stub__unlock_calls, 1);
+	ck_assert(timer_id == 0);
+}
+END_TEST
+
+/* Expired periods are dropped and the wakelock is released when the
+ * last one ends */
+START_TEST (ut_check_expiry)
+{
+	gint64 now = cpu_keepalive_get_time();
+	client_t *client1, *client2;
+
+	cpu_keepalive_start("client1");
+	cpu_keepalive_start("client2");
+	client1 = cpu_keepalive_get_client("client1");
+	client2 = cpu_keepalive_get_client("client2");
+
+	client_clear_timeout(client1);
+	client_update_timeout(client1, now - 1);
+	ck_assert(cpu_keepalive_timer_cb(0) == FALSE);
+	ck_assert(timer_id != 0);
+	ck_assert_int_eq(client1->heap_pos, CLIENT_HEAP_NONE);
+	ck_assert(timer_when == client2->timeout);
+	ck_assert_int_eq(stub__unlock_calls, 0);
+
+	client_clear_timeout(client2);
+	client_update_timeout(client2, now - 1);
+	cpu_keepalive_timer_cb(0);
+	ck_assert(timer_id == 0);
+	ck_assert_int_eq(stub__lock_calls, 1);
+	ck_assert_int_eq(stub__unlock_calls, 1);
+
+	/* Clients stay tracked after their periods end */
+	ck_assert(cpu_keepalive_get_client("client1") == client1);
+}
+END_TEST
+
+/* Rtc wakeup keeps cpu alive even without clients */
+START_TEST (ut_check_wakeup)
+{
+	cpu_keepalive_wakeup("dsme");
+	ck_assert_int_eq(stub__lock_calls, 1);
+	ck_assert(timer_when == wakeup_timeout);
+
+	wakeup_timeout = 0;
+	cpu_keepalive_timer_cb(0);
+	ck_assert_int_eq(stub__unlock_calls, 1);
+}
+END_TEST
+
+/* Unloading the module releases the wakelock of pending periods */
+START_TEST (ut_check_unload)
+{
+	cpu_keepalive_start("client1");
+	ck_assert_int_eq(stub__lock_calls, 1);
+	ck_assert(timer_id != 0);
+
+	g_module_unload(NULL);
+	ck_assert(timer_id == 0);
+	ck_assert_int_eq(stub__unlock_calls, 1);
+	ck_assert(!cpu_wakelock_held);
+}
+END_TEST
+
+static Suite *ut_cpu_keepalive_suite (void)
+{
+	Suite *s = suite_create ("ut_cpu_keepalive");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_checked_fixture(tc_core, ut_setup, ut_teardown);
+	tcase_add_test (tc_core, ut_check_heap_order);
+	tcase_add_test (tc_core, ut_check_renew_wakelock_edges);
+	tcase_add_test (tc_core, ut_check_expiry);
+	tcase_add_test (tc_core, ut_check_wakeup);
+	tcase_add_test (tc_core, ut_check_unload);
+	suite_add_tcase (s, tc_core);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_cpu_keepalive_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
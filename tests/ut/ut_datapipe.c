@@ -0,0 +1,346 @@
+#include <check.h>
+#include <glib.h>
+
+#include "common.h"
+
+#include "../../datapipe.h"
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+static datapipe_struct ut_pipe;
+
+/** Order in which the test triggers were called */
+static GString *ut_calls = NULL;
+
+static void ut_trigger_a(gconstpointer data)
+{
+	(void)data;
+	g_string_append_c(ut_calls, 'a');
+}
+
+static void ut_trigger_b(gconstpointer data)
+{
+	(void)data;
+	g_string_append_c(ut_calls, 'b');
+}
+
+static void ut_trigger_c(gconstpointer data)
+{
+	(void)data;
+	g_string_append_c(ut_calls, 'c');
+}
+
+/** Removes itself and ut_trigger_c while the datapipe is executing */
+static void ut_trigger_remove(gconstpointer data)
+{
+	(void)data;
+	g_string_append_c(ut_calls, 'r');
+	remove_output_trigger_from_datapipe(&ut_pipe, ut_trigger_remove);
+	remove_output_trigger_from_datapipe(&ut_pipe, ut_trigger_c);
+}
+
+/** Appends ut_trigger_b while the datapipe is executing */
+static void ut_trigger_append(gconstpointer data)
+{
+	(void)data;
+	g_string_append_c(ut_calls, 'p');
+	remove_output_trigger_from_datapipe(&ut_pipe, ut_trigger_append);
+	append_output_trigger_to_datapipe(&ut_pipe, ut_trigger_b);
+}
+
+static gpointer ut_filter_inc(gpointer data)
+{
+	return GINT_TO_POINTER(GPOINTER_TO_INT(data) + 1);
+}
+
+static gpointer ut_filter_dbl(gpointer data)
+{
+	return GINT_TO_POINTER(GPOINTER_TO_INT(data) * 2);
+}
+
+static guint ut_bench_calls = 0;
+
+static void ut_trigger_bench(gconstpointer data)
+{
+	(void)data;
+	ut_bench_calls++;
+}
+
+/** Output trigger that takes at least 2 ms */
+static void ut_trigger_slow(gconstpointer data)
+{
+	(void)data;
+	g_usleep(2000);
+}
+
+/** Find line from datapipe_stats_to_string() output
+ *
+ * @param stats statistics report
+ * @param prefix start of the line to look for
+ *
+ * @return copy of the line, or NULL if not found; release with g_free()
+ */
+static gchar *ut_stats_line(const gchar *stats, const gchar *prefix)
+{
+	gchar **lines = g_strsplit(stats, "\n", 0);
+	gchar *line = NULL;
+	guint i;
+
+	for (i = 0; lines[i] && !line; i++) {
+		if (g_str_has_prefix(lines[i], prefix))
+			line = g_strdup(lines[i]);
+	}
+
+	g_strfreev(lines);
+
+	return line;
+}
+
+static void ut_setup_checked(void)
+{
+	setup_datapipe(&ut_pipe, READ_WRITE, DONT_FREE_CACHE,
+		       0, GINT_TO_POINTER(0));
+	ut_calls = g_string_new("");
+}
+
+static void ut_teardown_checked(void)
+{
+	free_datapipe(&ut_pipe);
+	g_string_free(ut_calls, TRUE), ut_calls = NULL;
+}
+
+static void ut_setup_stats(void)
+{
+	datapipe_stats_enable();
+	ut_setup_checked();
+}
+
+/** Measure average cost of dispatching to one output trigger
+ *
+ * @param triggers number of triggers to register
+ * @param rounds number of datapipe executions to time
+ *
+ * @return nanoseconds per trigger invocation
+ */
+static double ut_bench_dispatch(guint triggers, guint rounds)
+{
+	gint64 t0, t1;
+	guint i;
+
+	for (i = 0; i < triggers; i++)
+		append_output_trigger_to_datapipe(&ut_pipe, ut_trigger_bench);
+
+	ut_bench_calls = 0;
+
+	t0 = ut_get_nsec();
+	for (i = 0; i < rounds; i++) {
+		execute_datapipe(&ut_pipe, GINT_TO_POINTER(i),
+				 USE_INDATA, CACHE_INDATA);
+	}
+	t1 = ut_get_nsec();
+
+	ck_assert_int_eq(ut_bench_calls, triggers * rounds);
+
+	for (i = 0; i < triggers; i++)
+		remove_output_trigger_from_datapipe(&ut_pipe, ut_trigger_bench);
+
+	ck_assert_int_eq(datapipe_get_output_trigger_refcount(ut_pipe), 0);
+
+	return (double)(t1 - t0) / ((double)triggers * rounds);
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+START_TEST (ut_check_trigger_order)
+{
+	append_output_trigger_to_datapipe(&ut_pipe, ut_trigger_a);
+	append_output_trigger_to_datapipe(&ut_pipe, ut_trigger_b);
+	append_output_trigger_to_datapipe(&ut_pipe, ut_trigger_c);
+	ck_assert_int_eq(datapipe_get_output_trigger_refcount(ut_pipe), 3);
+
+	execute_datapipe(&ut_pipe, NULL, USE_INDATA, CACHE_INDATA);
+	ck_assert_str_eq(ut_calls->str, "abc");
+
+	remove_output_trigger_from_datapipe(&ut_pipe, ut_trigger_b);
+	ck_assert_int_eq(datapipe_get_output_trigger_refcount(ut_pipe), 2);
+
+	execute_datapipe(&ut_pipe, NULL, USE_INDATA, CACHE_INDATA);
+	ck_assert_str_eq(ut_calls->str, "abcac");
+
+	remove_output_trigger_from_datapipe(&ut_pipe, ut_trigger_a);
+	remove_output_trigger_from_datapipe(&ut_pipe, ut_trigger_c);
+	ck_assert_int_eq(datapipe_get_output_trigger_refcount(ut_pipe), 0);
+}
+END_TEST
+
+START_TEST (ut_check_filter_chain)
+{
+	gconstpointer res;
+
+	append_filter_to_datapipe(&ut_pipe, ut_filter_inc);
+	append_filter_to_datapipe(&ut_pipe, ut_filter_dbl);
+	ck_assert_int_eq(datapipe_get_filter_refcount(ut_pipe), 2);
+
+	res = execute_datapipe(&ut_pipe, GINT_TO_POINTER(3),
+			       USE_INDATA, CACHE_INDATA);
+	ck_assert_int_eq(GPOINTER_TO_INT(res), 8);
+
+	remove_filter_from_datapipe(&ut_pipe, ut_filter_inc);
+	remove_filter_from_datapipe(&ut_pipe, ut_filter_dbl);
+	ck_assert_int_eq(datapipe_get_filter_refcount(ut_pipe), 0);
+}
+END_TEST
+
+START_TEST (ut_check_remove_while_running)
+{
+	append_output_trigger_to_datapipe(&ut_pipe, ut_trigger_a);
+	append_output_trigger_to_datapipe(&ut_pipe, ut_trigger_remove);
+	append_output_trigger_to_datapipe(&ut_pipe, ut_trigger_c);
+
+	/* Changes made during execution take effect on the next run */
+	execute_datapipe(&ut_pipe, NULL, USE_INDATA, CACHE_INDATA);
+	ck_assert_str_eq(ut_calls->str, "arc");
+	ck_assert_int_eq(datapipe_get_output_trigger_refcount(ut_pipe), 1);
+
+	execute_datapipe(&ut_pipe, NULL, USE_INDATA, CACHE_INDATA);
+	ck_assert_str_eq(ut_calls->str, "arca");
+
+	remove_output_trigger_from_datapipe(&ut_pipe, ut_trigger_a);
+}
+END_TEST
+
+START_TEST (ut_check_append_while_running)
+{
+	append_output_trigger_to_datapipe(&ut_pipe, ut_trigger_append);
+	append_output_trigger_to_datapipe(&ut_pipe, ut_trigger_a);
+
+	execute_datapipe(&ut_pipe, NULL, USE_INDATA, CACHE_INDATA);
+	ck_assert_str_eq(ut_calls->str, "pa");
+
+	execute_datapipe(&ut_pipe, NULL, USE_INDATA, CACHE_INDATA);
+	ck_assert_str_eq(ut_calls->str, "paab");
+
+	remove_output_trigger_from_datapipe(&ut_pipe, ut_trigger_a);
+	remove_output_trigger_from_datapipe(&ut_pipe, ut_trigger_b);
+	ck_assert_int_eq(datapipe_get_output_trigger_refcount(ut_pipe), 0);
+}
+END_TEST
+
+/* Dispatch cost per trigger must not grow with the number of triggers;
+ * with g_slist_nth_data() lookups 256 triggers cost ~32 times as much
+ * per call as 8 triggers do. */
+START_TEST (ut_check_dispatch_benchmark)
+{
+	static const guint sizes[] = { 8, 32, 128, 256 };
+	double cost[G_N_ELEMENTS(sizes)];
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(sizes); i++) {
+		cost[i] = ut_bench_dispatch(sizes[i], 262144 / sizes[i]);
+	}
+
+	ck_assert_msg(cost[G_N_ELEMENTS(sizes) - 1] < cost[0] * 4,
+		      "dispatch cost grows with number of triggers");
+}
+END_TEST
+
+START_TEST (ut_check_stats)
+{
+	unsigned count = 0, max_us = 0;
+	gchar *stats;
+	gchar *line;
+	guint i;
+
+	append_filter_to_datapipe(&ut_pipe, ut_filter_dbl);
+	append_input_trigger_to_datapipe(&ut_pipe, ut_trigger_a);
+	append_output_trigger_to_datapipe(&ut_pipe, ut_trigger_slow);
+
+	for (i = 0; i < 3; i++)
+		execute_datapipe(&ut_pipe, GINT_TO_POINTER(i),
+				 USE_INDATA, CACHE_INDATA);
+
+	remove_output_trigger_from_datapipe(&ut_pipe, ut_trigger_slow);
+	remove_input_trigger_from_datapipe(&ut_pipe, ut_trigger_a);
+	remove_filter_from_datapipe(&ut_pipe, ut_filter_dbl);
+
+	stats = datapipe_stats_to_string();
+
+	/* name count total_us max_us avg_us histogram... */
+	line = ut_stats_line(stats, "ut_pipe ");
+	ck_assert_msg(line != NULL, "no statistics for ut_pipe");
+	ck_assert_int_eq(sscanf(line, "%*s %u %*u %u", &count, &max_us), 2);
+	ck_assert_int_eq(count, 3);
+	ck_assert_msg(max_us >= 2000, "ut_pipe max %u us", max_us);
+	g_free(line);
+
+	line = ut_stats_line(stats, "  output ");
+	ck_assert_msg(line != NULL, "no statistics for output trigger");
+	ck_assert_int_eq(sscanf(line, "%*s %*s %u %*u %u", &count, &max_us), 2);
+	ck_assert_int_eq(count, 3);
+	ck_assert_msg(max_us >= 2000, "output trigger max %u us", max_us);
+	g_free(line);
+
+	line = ut_stats_line(stats, "  filter ");
+	ck_assert_msg(line != NULL, "no statistics for filter");
+	ck_assert_int_eq(sscanf(line, "%*s %*s %u", &count), 1);
+	ck_assert_int_eq(count, 3);
+	g_free(line);
+
+	line = ut_stats_line(stats, "  input ");
+	ck_assert_msg(line != NULL, "no statistics for input trigger");
+	ck_assert_int_eq(sscanf(line, "%*s %*s %u", &count), 1);
+	ck_assert_int_eq(count, 3);
+	g_free(line);
+
+	g_free(stats);
+}
+END_TEST
+
+static Suite *ut_datapipe_suite (void)
+{
+	Suite *s = suite_create ("ut_datapipe");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_checked_fixture(tc_core, ut_setup_checked,
+				  ut_teardown_checked);
+	tcase_add_test (tc_core, ut_check_trigger_order);
+	tcase_add_test (tc_core, ut_check_filter_chain);
+	tcase_add_test (tc_core, ut_check_remove_while_running);
+	tcase_add_test (tc_core, ut_check_append_while_running);
+	suite_add_tcase (s, tc_core);
+
+	if (ut_benchmarks_enabled()) {
+		TCase *tc_bench = tcase_create ("benchmark");
+		tcase_set_timeout(tc_bench, 60);
+		tcase_add_checked_fixture(tc_bench, ut_setup_checked,
+					  ut_teardown_checked);
+		tcase_add_test (tc_bench, ut_check_dispatch_benchmark);
+		suite_add_tcase (s, tc_bench);
+	}
+
+	TCase *tc_stats = tcase_create ("stats");
+	tcase_add_checked_fixture(tc_stats, ut_setup_stats,
+				  ut_teardown_checked);
+	tcase_add_test (tc_stats, ut_check_stats);
+	suite_add_tcase (s, tc_stats);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_datapipe_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
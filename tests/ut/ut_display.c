@@ -144,6 +144,10 @@ static void stub_mce_conf_setup_unchecked(void)
 			MCE_CONF_DISPLAY_GROUP,
 			MCE_CONF_CONSTANT_TIME_DECREASE,
 			5000,
+		}, {
+			MCE_CONF_DISPLAY_GROUP,
+			MCE_CONF_BRIGHTNESS_FADE_MAX_RATE,
+			INT_MAX,
 		}, {
 			NULL,
 			NULL,
@@ -161,6 +165,10 @@ static void stub_mce_conf_setup_unchecked(void)
 			MCE_CONF_DISPLAY_GROUP,
 			MCE_CONF_BRIGHTNESS_DECREASE_POLICY,
 			NULL,
+		}, {
+			MCE_CONF_DISPLAY_GROUP,
+			MCE_CONF_FB_STATE_PATH,
+			NULL,
 		}, {
 			NULL,
 			NULL,
@@ -1937,6 +1945,71 @@ START_TEST (ut_check_sw_fading)
 }
 END_TEST
 
+/* Fading faster than the maximum write rate skips brightness steps
+ * instead of stretching the fade */
+START_TEST (ut_check_sw_fading_rate)
+{
+	ut_run_to_user_state();
+
+	const gint start_brightness = 1;
+	execute_datapipe(&display_brightness_pipe,
+			 GINT_TO_POINTER(start_brightness),
+			 USE_INDATA, CACHE_INDATA);
+	ut_assert_transition(ut_is_sysfs_brightness_eq,
+			     GINT_TO_POINTER(start_brightness * 20));
+
+	/* 80 steps, 2 ms each */
+	hw_fading_supported = FALSE;
+	brightness_increase_policy = BRIGHTNESS_CHANGE_STEP_TIME;
+	brightness_increase_step_time = 2;
+
+	const gint steps = 80;
+	const gint max_writes = (brightness_increase_step_time * steps *
+				 brightness_fade_max_rate / 1000) + 3;
+	const gint start_brightness_write_count =
+		stub__mce_io_write_count(STUB__BRIGHTNESS_OUTPUT_PATH);
+
+	execute_datapipe(&display_brightness_pipe,
+			 GINT_TO_POINTER(start_brightness + steps / 20),
+			 USE_INDATA, CACHE_INDATA);
+	ut_assert_transition(ut_is_sysfs_brightness_eq,
+			     GINT_TO_POINTER(start_brightness * 20 + steps));
+
+	const gint brightness_write_count =
+		stub__mce_io_write_count(STUB__BRIGHTNESS_OUTPUT_PATH) -
+		start_brightness_write_count;
+
+	ck_assert(brightness_write_count > 0);
+	ck_assert_int_lt(brightness_write_count, max_writes);
+}
+END_TEST
+
+/* Step time 5 is a special case that fades at 1 ms per step */
+START_TEST (ut_check_sw_fading_step_time_5)
+{
+	ut_run_to_user_state();
+
+	const gint start_brightness = 1;
+	execute_datapipe(&display_brightness_pipe,
+			 GINT_TO_POINTER(start_brightness),
+			 USE_INDATA, CACHE_INDATA);
+	ut_assert_transition(ut_is_sysfs_brightness_eq,
+			     GINT_TO_POINTER(start_brightness * 20));
+
+	hw_fading_supported = FALSE;
+	brightness_increase_policy = BRIGHTNESS_CHANGE_STEP_TIME;
+	brightness_increase_step_time = 5;
+
+	execute_datapipe(&display_brightness_pipe,
+			 GINT_TO_POINTER(start_brightness + 1),
+			 USE_INDATA, CACHE_INDATA);
+	ck_assert_int_eq(brightness_fade.duration, 20);
+
+	ut_assert_transition(ut_is_sysfs_brightness_eq,
+			     GINT_TO_POINTER(start_brightness * 20 + 20));
+}
+END_TEST
+
 START_TEST (ut_check_set_use_lpm_while_off)
 {
 	ut_run_to_user_state();
@@ -1998,6 +2071,83 @@ START_TEST (ut_check_unset_use_lpm_while_lpm)
 }
 END_TEST
 
+/*
+ * Frame buffer state file tracking {{{1
+ */
+
+/* Replace fb state file content in place, keeping open fds valid */
+static void ut_write_fb_state(const char *path, const char *state)
+{
+	int fd = open(path, O_WRONLY | O_TRUNC);
+
+	ck_assert(fd != -1);
+	ck_assert_int_eq(write(fd, state, strlen(state)),
+			 (ssize_t)strlen(state));
+	close(fd);
+}
+
+START_TEST (ut_check_waitfb_state_file)
+{
+	char     path[] = "/tmp/ut_display_fb_state.XXXXXX";
+	int      fd     = mkstemp(path);
+	bool     suspended;
+	guint    id;
+	waitfb_t self   = {
+		.wake_fd    = -1,
+		.sleep_fd   = -1,
+		.pipe_fd    = -1,
+		.state_path = path,
+		.state_fd   = -1,
+	};
+
+	ck_assert(fd != -1);
+	close(fd);
+
+	/* State file content is parsed on every read */
+	ut_write_fb_state(path, "asleep\n");
+	self.state_fd = open(path, O_RDONLY);
+	ck_assert(self.state_fd != -1);
+
+	suspended = false;
+	ck_assert(waitfb_read_state(&self, &suspended));
+	ck_assert(suspended);
+
+	ut_write_fb_state(path, "awake\n");
+	ck_assert(waitfb_read_state(&self, &suspended));
+	ck_assert(!suspended);
+
+	ut_write_fb_state(path, "unknown\n");
+	suspended = true;
+	ck_assert(!waitfb_read_state(&self, &suspended));
+	ck_assert(suspended);
+
+	close(self.state_fd), self.state_fd = -1;
+
+	/* Tracking starts from the current state */
+	ut_write_fb_state(path, "asleep\n");
+	ck_assert(waitfb_start_notify(&self));
+	ck_assert(waitfb_is_active(&self));
+	ck_assert(self.suspended);
+
+	/* Change notifications update the state */
+	ut_write_fb_state(path, "awake\n");
+	ck_assert(waitfb_state_cb(NULL, G_IO_PRI, &self));
+	ck_assert(!self.suspended);
+	ck_assert(waitfb_is_active(&self));
+
+	/* Unknown state stops tracking; the io watch is removed here
+	 * as glib would do when the callback returns FALSE */
+	ut_write_fb_state(path, "unknown\n");
+	id = self.state_id;
+	ck_assert(!waitfb_state_cb(NULL, G_IO_PRI, &self));
+	g_source_remove(id);
+	ck_assert(!waitfb_is_active(&self));
+	ck_assert_int_eq(self.state_fd, -1);
+
+	unlink(path);
+}
+END_TEST
+
 static Suite *ut_display_suite (void)
 {
 	Suite *s = suite_create ("ut_display");
@@ -2033,9 +2183,12 @@ static Suite *ut_display_suite (void)
 			     0, ut_check_blanking_pause_data_count);
 	tcase_add_loop_test (tc_core, ut_check_sw_fading,
 			     0, ut_check_sw_fading_data_count);
+	tcase_add_test (tc_core, ut_check_sw_fading_rate);
+	tcase_add_test (tc_core, ut_check_sw_fading_step_time_5);
 	tcase_add_test (tc_core, ut_check_set_use_lpm_while_off);
 	tcase_add_loop_test (tc_core, ut_check_unset_use_lpm_while_lpm,
 			     0, ut_check_unset_use_lpm_while_lpm_data_count);
+	tcase_add_test (tc_core, ut_check_waitfb_state_file);
 
 	suite_add_tcase (s, tc_core);
 
@@ -0,0 +1,206 @@
+#include <check.h>
+#include <glib.h>
+
+#include "common.h"
+
+/* Tested module */
+#include "../../event-input.c"
+
+/* ------------------------------------------------------------------------- *
+ * STUBS
+ * ------------------------------------------------------------------------- */
+
+/** Contents returned by mce_io_load_file(), or NULL */
+static const char *stub__load_data = NULL;
+
+/** Contents passed to the latest mce_io_update_file_atomic() call */
+static gchar *stub__save_data = NULL;
+
+/** Number of mce_io_update_file_atomic() calls */
+static guint stub__save_calls = 0;
+
+EXTERN_STUB (
+void *, mce_io_load_file, (const char *path, size_t *psize))
+{
+	(void)path;
+
+	if( psize )
+		*psize = stub__load_data ? strlen(stub__load_data) : 0;
+
+	return g_strdup(stub__load_data);
+}
+
+EXTERN_STUB (
+gboolean, mce_io_update_file_atomic, (const char *path,
+				      const void *data, size_t size,
+				      mode_t mode, gboolean keep_backup))
+{
+	(void)path;
+	(void)mode;
+	(void)keep_backup;
+
+	g_free(stub__save_data);
+	stub__save_data = g_strndup(data, size);
+	stub__save_calls++;
+
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+static void ut_setup(void)
+{
+	stub__load_data = NULL;
+	stub__save_calls = 0;
+	g_free(stub__save_data), stub__save_data = NULL;
+}
+
+static void ut_teardown(void)
+{
+	evdev_cache_quit();
+	g_free(stub__save_data), stub__save_data = NULL;
+}
+
+/** Count lines in text */
+static guint ut_count_lines(const char *text)
+{
+	guint cnt = 0;
+
+	for( ; text && *text; ++text )
+		cnt += (*text == '\n');
+
+	return cnt;
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+/* Cache file is parsed, malformed lines skipped and nothing gets
+ * saved unless classifications change */
+START_TEST (ut_check_load)
+{
+	evdev_cache_entry_t *entry;
+
+	stub__load_data =
+		"touch 0000abcd 0018:0000:0000:0000:00000003:phys:name 1\n"
+		"input 00001234 0019:0000:0000:0000:00000003::gpio-keys\n"
+		"bogus 00001234 key\n"
+		"ignore xyz key\n"
+		"ignore 00001234\n"
+		"\n"
+		"reject 00000001 0000:0000:0000:0000:0000000b::als";
+
+	evdev_cache_load();
+	ck_assert_int_eq(g_hash_table_size(evdev_cache), 3);
+
+	entry = evdev_cache_lookup("0018:0000:0000:0000:00000003:phys:name 1");
+	ck_assert(entry != NULL);
+	ck_assert_int_eq(entry->type, EVDEV_TOUCH);
+	ck_assert(entry->hash == 0xabcd);
+	ck_assert(entry->seen);
+	ck_assert(!entry->verified);
+
+	entry = evdev_cache_lookup("0000:0000:0000:0000:0000000b::als");
+	ck_assert(entry != NULL);
+	ck_assert_int_eq(entry->type, EVDEV_REJECT);
+
+	ck_assert(evdev_cache_lookup("key") == NULL);
+	ck_assert(evdev_cache_lookup(NULL) == NULL);
+
+	evdev_cache_save();
+	ck_assert_int_eq(stub__save_calls, 0);
+
+	/* Confirming cached data does not make the cache dirty */
+	evdev_cache_store("0019:0000:0000:0000:00000003::gpio-keys",
+			  EVDEV_INPUT, 0x1234, TRUE);
+	evdev_cache_save();
+	ck_assert_int_eq(stub__save_calls, 0);
+}
+END_TEST
+
+/* Saved data can be loaded back */
+START_TEST (ut_check_save_load)
+{
+	gchar *data;
+
+	evdev_cache_load();
+	evdev_cache_store("a:b", EVDEV_TOUCH, 1, TRUE);
+	evdev_cache_store("c:d e", EVDEV_ACTIVITY, 0xffffffff, TRUE);
+	evdev_cache_save();
+	ck_assert_int_eq(stub__save_calls, 1);
+	ck_assert_int_eq(ut_count_lines(stub__save_data), 2);
+	evdev_cache_quit();
+
+	data = g_strdup(stub__save_data);
+	stub__load_data = data;
+	evdev_cache_load();
+	ck_assert_int_eq(g_hash_table_size(evdev_cache), 2);
+	ck_assert_int_eq(evdev_cache_lookup("a:b")->type, EVDEV_TOUCH);
+	ck_assert_int_eq(evdev_cache_lookup("c:d e")->type, EVDEV_ACTIVITY);
+	ck_assert(evdev_cache_lookup("c:d e")->hash == 0xffffffff);
+	evdev_cache_quit();
+	g_free(data);
+}
+END_TEST
+
+/* Cache size is limited and devices seen during the session are kept */
+START_TEST (ut_check_save_limit)
+{
+	GString *text = g_string_new("");
+	gchar   *key;
+
+	for( guint i = 0; i < EVDEV_CACHE_MAX; ++i )
+		g_string_append_printf(text, "ignore 00000000 old%u\n", i);
+	stub__load_data = text->str;
+
+	evdev_cache_load();
+	ck_assert_int_eq(g_hash_table_size(evdev_cache), EVDEV_CACHE_MAX);
+
+	for( guint i = 0; i < 4; ++i ) {
+		key = g_strdup_printf("new%u", i);
+		evdev_cache_store(key, EVDEV_INPUT, i, TRUE);
+		g_free(key);
+	}
+	evdev_cache_save();
+
+	ck_assert_int_eq(ut_count_lines(stub__save_data), EVDEV_CACHE_MAX);
+	for( guint i = 0; i < 4; ++i ) {
+		key = g_strdup_printf("input %08x new%u\n", i, i);
+		ck_assert(strstr(stub__save_data, key) != NULL);
+		g_free(key);
+	}
+
+	g_string_free(text, TRUE);
+}
+END_TEST
+
+static Suite *ut_event_input_suite (void)
+{
+	Suite *s = suite_create ("ut_event_input");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_checked_fixture(tc_core, ut_setup, ut_teardown);
+	tcase_add_test (tc_core, ut_check_load);
+	tcase_add_test (tc_core, ut_check_save_load);
+	tcase_add_test (tc_core, ut_check_save_limit);
+	suite_add_tcase (s, tc_core);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_event_input_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
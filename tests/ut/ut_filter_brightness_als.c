@@ -0,0 +1,294 @@
+#include <check.h>
+#include <glib.h>
+
+#include "common.h"
+
+/* Tested module */
+#include "../../modules/filter-brightness-als.c"
+
+/* ------------------------------------------------------------------------- *
+ * STUBS
+ * ------------------------------------------------------------------------- */
+
+/** Ramp returned for all Limits* keys */
+static const gint stub__limits[] = {
+	1, 2, 3, 6, 11, 20, 36, 66, 121, 220,
+	400, 489, 599, 732, 896, 1095, 1340, 1639, 2005, 2453,
+};
+
+/** Ramp returned for all Levels* keys */
+static const gint stub__levels[] = {
+	30, 33, 36, 39, 42, 45, 48, 51, 54, 57,
+	60, 64, 68, 72, 76, 80, 84, 88, 92, 96,
+};
+
+EXTERN_STUB (
+gboolean, mce_conf_has_group, (const gchar *group))
+{
+	(void)group;
+
+	return TRUE;
+}
+
+EXTERN_STUB (
+gint *, mce_conf_get_int_list, (const gchar *group, const gchar *key,
+				gsize *length))
+{
+	(void)group;
+
+	const gint *data = g_str_has_prefix(key, "Limits") ?
+		stub__limits : stub__levels;
+
+	*length = G_N_ELEMENTS(stub__limits);
+	return g_memdup(data, sizeof stub__limits);
+}
+
+/** Interval passed to the latest mce_sensorfw_als_set_interval() call */
+static unsigned stub__als_interval = ~0u;
+
+EXTERN_STUB (
+void, mce_sensorfw_als_set_interval, (unsigned interval))
+{
+	stub__als_interval = interval;
+}
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+/** Brightness from compiled curve, found by a linear scan */
+static int ut_curve_lookup_linear(const als_curve_t *curve, int lux)
+{
+	int i = 0;
+
+	while (i + 1 < curve->count && curve->step[i + 1].lux <= lux)
+		i++;
+
+	return curve->step[i].val;
+}
+
+/** Brightness from configured ramp, as a step function */
+static int ut_ramp_lookup(int lux)
+{
+	for (guint k = 0; k < G_N_ELEMENTS(stub__limits); k++) {
+		if (lux < stub__limits[k])
+			return stub__levels[k];
+	}
+
+	return 100;
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+/* Compiled curve is monotonic, goes through the configured levels and
+ * never gives less light than the configured step function */
+START_TEST (ut_check_curve_compile)
+{
+	als_filter_t filter = { .id = "Test", .mask = 1u << ALS_PROFILE_NORMAL };
+	const als_curve_t *curve = &filter.curve[ALS_PROFILE_NORMAL];
+
+	als_filter_load_config(&filter);
+
+	ck_assert_int_eq(curve->step[0].lux, 0);
+	ck_assert_int_eq(curve->step[0].val, stub__levels[0]);
+	ck_assert_int_eq(curve->step[curve->count - 1].val, 100);
+
+	for (int i = 1; i < curve->count; i++) {
+		ck_assert_int_lt(curve->step[i - 1].lux, curve->step[i].lux);
+		ck_assert_int_lt(curve->step[i - 1].val, curve->step[i].val);
+	}
+
+	for (guint k = 1; k < G_N_ELEMENTS(stub__limits); k++) {
+		int lux = stub__limits[k - 1];
+
+		ck_assert_int_eq(ut_curve_lookup_linear(curve, lux),
+				 stub__levels[k]);
+	}
+
+	for (int lux = 0; lux < 3000; lux++) {
+		int val = ut_curve_lookup_linear(curve, lux);
+
+		ck_assert(val >= ut_ramp_lookup(lux));
+		ck_assert(val <= ut_ramp_lookup(lux) + 4);
+	}
+
+	/* Profiles missing from the mask yield full brightness */
+	ck_assert_int_eq(filter.curve[ALS_PROFILE_MINIMUM].count, 1);
+	ck_assert_int_eq(filter.curve[ALS_PROFILE_MINIMUM].step[0].val, 100);
+}
+END_TEST
+
+/* Unordered limits and decreasing levels do not break the curve */
+START_TEST (ut_check_curve_sanitize)
+{
+	static const int lim[] = { 10, 5, 100, 1000 };
+	static const int lev[] = { 50, 40, 20, 150 };
+	als_curve_t curve;
+
+	als_curve_compile(&curve, lim, lev, G_N_ELEMENTS(lim));
+
+	ck_assert_int_eq(curve.step[0].val, 50);
+	ck_assert_int_eq(curve.step[curve.count - 1].val, 100);
+
+	for (int i = 1; i < curve.count; i++) {
+		ck_assert_int_lt(curve.step[i - 1].lux, curve.step[i].lux);
+		ck_assert_int_lt(curve.step[i - 1].val, curve.step[i].val);
+	}
+}
+END_TEST
+
+/* Binary search matches linear scan for every lux value */
+START_TEST (ut_check_curve_find)
+{
+	als_filter_t filter = { .id = "Test", .mask = 1u << ALS_PROFILE_NORMAL };
+	const als_curve_t *curve = &filter.curve[ALS_PROFILE_NORMAL];
+
+	als_filter_load_config(&filter);
+
+	for (int lux = 0; lux < 5000; lux++) {
+		ck_assert_int_eq(curve->step[als_curve_find(curve, lux)].val,
+				 ut_curve_lookup_linear(curve, lux));
+	}
+
+	ck_assert_int_eq(curve->step[als_curve_find(curve, INT_MAX)].val, 100);
+}
+END_TEST
+
+/* Brightness follows rising lux immediately, falling lux with a lag */
+START_TEST (ut_check_filter_hysteresis)
+{
+	als_filter_t filter = { .id = "Test", .mask = 1u << ALS_PROFILE_NORMAL };
+	int val;
+
+	als_filter_load_config(&filter);
+
+	val = als_filter_run(&filter, ALS_PROFILE_NORMAL, 1000);
+	ck_assert_int_eq(val, ut_curve_lookup_linear(
+				 &filter.curve[ALS_PROFILE_NORMAL], 1000));
+
+	/* Dimming needs a lux drop of 10%, not just one curve step */
+	ck_assert_int_eq(filter.lux_lo, 900);
+	ck_assert_int_eq(als_filter_run(&filter, ALS_PROFILE_NORMAL,
+					filter.lux_lo), val);
+	ck_assert_int_lt(als_filter_run(&filter, ALS_PROFILE_NORMAL,
+					filter.lux_lo - 1), val);
+
+	val = als_filter_run(&filter, ALS_PROFILE_NORMAL, 1000);
+	ck_assert_int_lt(val, als_filter_run(&filter, ALS_PROFILE_NORMAL,
+					     filter.lux_hi + 1));
+}
+END_TEST
+
+/* Sensor noise around a curve step does not make brightness flap */
+START_TEST (ut_check_filter_noise)
+{
+	static const int noise[] = { 0, 3, -4, 5, -2, -5, 4, 1, -3, 2 };
+	als_filter_t filter = { .id = "Test", .mask = 1u << ALS_PROFILE_NORMAL };
+	int changes = 0;
+	int val;
+
+	als_filter_load_config(&filter);
+
+	for (int lux = 50; lux < 3000; lux += lux / 4) {
+		val = als_filter_run(&filter, ALS_PROFILE_NORMAL, lux);
+		changes = 0;
+
+		for (int i = 0; i < 100; i++) {
+			int noisy = lux + lux * noise[i % G_N_ELEMENTS(noise)] / 100;
+			int res = als_filter_run(&filter, ALS_PROFILE_NORMAL,
+						 noisy);
+
+			if (res != val)
+				changes++, val = res;
+		}
+
+		/* Rising to the peak of the noise is allowed once */
+		ck_assert_msg(changes <= 1, "lux=%d: %d changes", lux, changes);
+	}
+}
+END_TEST
+
+/* Sampling rate is raised when lux leaves the stable band and
+ * lowered again after hold time without further changes */
+START_TEST (ut_check_rate_update)
+{
+	const uint64_t hold = 1000 * (uint64_t)als_burst_hold_time;
+	mce_sensor_sample_t sample = { .timestamp = 1000000, .value = 1000 };
+
+	/* The first sample starts with burst rate */
+	als_rate_reset();
+	als_rate_update(&sample, 1);
+	ck_assert_int_eq(stub__als_interval, als_interval_burst);
+
+	sample.timestamp += hold;
+	als_rate_update(&sample, 1);
+	ck_assert_int_eq(stub__als_interval, als_interval_stable);
+
+	/* Changes within the band, in both directions */
+	sample.value = 1100;
+	sample.timestamp += 1000;
+	als_rate_update(&sample, 1);
+	ck_assert_int_eq(stub__als_interval, als_interval_stable);
+
+	sample.value = 900;
+	sample.timestamp += 1000;
+	als_rate_update(&sample, 1);
+	ck_assert_int_eq(stub__als_interval, als_interval_stable);
+
+	/* Change outside the band, followed by stable samples */
+	mce_sensor_sample_t batch[2] = {
+		{ .timestamp = sample.timestamp + 1000, .value = 10 },
+		{ .timestamp = sample.timestamp + 2000, .value = 11 },
+	};
+	als_rate_update(batch, 2);
+	ck_assert_int_eq(stub__als_interval, als_interval_burst);
+
+	sample.value = 10;
+	sample.timestamp = batch[0].timestamp + hold - 1;
+	als_rate_update(&sample, 1);
+	ck_assert_int_eq(stub__als_interval, als_interval_burst);
+
+	sample.timestamp = batch[0].timestamp + hold;
+	als_rate_update(&sample, 1);
+	ck_assert_int_eq(stub__als_interval, als_interval_stable);
+
+	/* Adaptive rate can be disabled */
+	als_interval_stable = 0;
+	sample.value = 10;
+	als_rate_update(&sample, 1);
+	ck_assert_int_eq(stub__als_interval, 0);
+	als_interval_stable = DEFAULT_ALS_SAMPLE_INTERVAL_STABLE;
+}
+END_TEST
+
+static Suite *ut_filter_brightness_als_suite (void)
+{
+	Suite *s = suite_create ("ut_filter_brightness_als");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_test (tc_core, ut_check_curve_compile);
+	tcase_add_test (tc_core, ut_check_curve_sanitize);
+	tcase_add_test (tc_core, ut_check_curve_find);
+	tcase_add_test (tc_core, ut_check_filter_hysteresis);
+	tcase_add_test (tc_core, ut_check_filter_noise);
+	tcase_add_test (tc_core, ut_check_rate_update);
+	suite_add_tcase (s, tc_core);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_filter_brightness_als_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,503 @@
+#include <check.h>
+#include <glib.h>
+
+#include "common.h"
+
+/* Tested module */
+#include "../../modules/led.c"
+
+/* ------------------------------------------------------------------------- *
+ * STUBS
+ * ------------------------------------------------------------------------- */
+
+/** Fake monotonic clock in milliseconds */
+static gint64 stub__mono_tick = 0;
+
+EXTERN_STUB (
+gint64, mce_lib_get_mono_tick, (void))
+{
+	return stub__mono_tick;
+}
+
+/** Whether the software pattern wakelock is held */
+static gboolean stub__wakelock_held = FALSE;
+
+EXTERN_STUB (
+void, wakelock_lock, (const char *name, long long ns))
+{
+	ck_assert_str_eq(name, sw_pattern_wakelock);
+	ck_assert(ns < 0);
+	ck_assert(!stub__wakelock_held);
+	stub__wakelock_held = TRUE;
+}
+
+EXTERN_STUB (
+void, wakelock_unlock, (const char *name))
+{
+	ck_assert_str_eq(name, sw_pattern_wakelock);
+	ck_assert(stub__wakelock_held);
+	stub__wakelock_held = FALSE;
+}
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+/** Number of software pattern level writes */
+static guint ut_sw_writes = 0;
+
+/** Latest software pattern level written */
+static guint ut_sw_level = 0;
+
+/** Record software pattern level writes */
+static void ut_sw_write(const pattern_struct *pattern, guint level)
+{
+	(void)pattern;
+
+	ut_sw_writes++;
+	ut_sw_level = level;
+}
+
+/** Make a breathing pattern with precomputed keyframes */
+static pattern_struct *ut_sw_pattern(gint rise, gint on, gint fall, gint off,
+				     guint levels)
+{
+	pattern_struct *psp = g_slice_new0(pattern_struct);
+
+	psp->name = strdup("breathing");
+	psp->rise_time = rise;
+	psp->on_period = on;
+	psp->fall_time = fall;
+	psp->off_period = off;
+	sw_pattern_compile(psp, levels);
+
+	return psp;
+}
+
+static void ut_sw_pattern_free(pattern_struct *psp)
+{
+	sw_pattern_stop();
+	g_free(psp->keyframes);
+	free(psp->name);
+	g_slice_free(pattern_struct, psp);
+}
+
+static void ut_setup(void)
+{
+	pattern_stack = g_queue_new();
+	combination_rule_list = g_queue_new();
+	led_enabled = TRUE;
+}
+
+static void ut_teardown(void)
+{
+	pattern_struct *psp;
+	combination_rule_struct *cr;
+	gchar *tmp;
+
+	quit_pattern_index();
+
+	while ((psp = g_queue_pop_head(pattern_stack)) != NULL) {
+		free(psp->name);
+		g_slice_free(pattern_struct, psp);
+	}
+
+	while ((cr = g_queue_pop_head(combination_rule_list)) != NULL) {
+		while ((tmp = g_queue_pop_head(cr->pre_requisites)) != NULL)
+			g_free(tmp);
+		g_queue_free(cr->pre_requisites);
+		g_free(cr->rulename);
+		g_slice_free(combination_rule_struct, cr);
+	}
+
+	g_queue_free(pattern_stack), pattern_stack = NULL;
+	g_queue_free(combination_rule_list), combination_rule_list = NULL;
+}
+
+/** Add an enabled, inactive pattern to the pattern stack */
+static void ut_add_pattern(const gchar *name, gint priority, gint policy)
+{
+	pattern_struct *psp = g_slice_new0(pattern_struct);
+
+	psp->name = strdup(name);
+	psp->priority = priority;
+	psp->policy = policy;
+	psp->enabled = TRUE;
+
+	g_queue_insert_sorted(pattern_stack, psp, queue_prio_compare, NULL);
+}
+
+/** Add a combination rule; the pre-requisites are NULL terminated */
+static void ut_add_rule(const gchar *name, ...)
+{
+	combination_rule_struct *cr = g_slice_new0(combination_rule_struct);
+	const gchar *req;
+	va_list va;
+
+	cr->rulename = g_strdup(name);
+	cr->pre_requisites = g_queue_new();
+
+	va_start(va, name);
+	while ((req = va_arg(va, const gchar *)) != NULL)
+		g_queue_push_head(cr->pre_requisites, g_strdup(req));
+	va_end(va);
+
+	g_queue_push_head(combination_rule_list, cr);
+}
+
+/** Activate or deactivate a pattern the way D-Bus requests do */
+static void ut_set_active(const gchar *name, gboolean active)
+{
+	pattern_struct *psp = find_pattern_struct(name);
+
+	ck_assert(psp != NULL);
+	pattern_set_active(psp, active);
+	update_combination_rules(psp);
+}
+
+/** Name of the pattern to show, or "none" */
+static const gchar *ut_selected(system_state_t system_state,
+				display_state_t display_state)
+{
+	pattern_struct *psp = led_select_pattern(system_state, display_state);
+
+	return psp ? psp->name : "none";
+}
+
+/** Pattern selection by walking the whole pattern stack */
+static pattern_struct *ut_reference_select(system_state_t system_state,
+					   display_state_t display_state)
+{
+	pattern_struct *psp;
+	gint i = 0;
+
+	while ((psp = g_queue_peek_nth(pattern_stack, i++)) != NULL) {
+		if ((psp->active == FALSE) || (psp->enabled == FALSE))
+			continue;
+
+		if ((led_enabled == FALSE) && (psp->policy != 5))
+			continue;
+
+		if ((psp->policy == 3) || (psp->policy == 5))
+			break;
+
+		if (system_state == MCE_STATE_ACTDEAD) {
+			if (psp->policy == 4)
+				break;
+
+			if ((display_state == MCE_DISPLAY_OFF) &&
+			    (psp->policy == 2))
+				break;
+
+			continue;
+		}
+
+		if ((display_state == MCE_DISPLAY_OFF) ||
+		    (display_state == MCE_DISPLAY_LPM_OFF) ||
+		    (display_state == MCE_DISPLAY_LPM_ON))
+			break;
+
+		if (psp->policy == 1)
+			break;
+	}
+
+	return psp;
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+/* Visibility classes are honoured in all states */
+START_TEST (ut_check_select_policy)
+{
+	ut_add_pattern("screen_on", 10, 1);
+	ut_add_pattern("actdead", 20, 4);
+	ut_add_pattern("screen_off", 30, 0);
+	ut_add_pattern("always", 40, 3);
+	ut_add_pattern("forced", 50, 5);
+	init_pattern_index();
+
+	ck_assert_str_eq(ut_selected(MCE_STATE_USER, MCE_DISPLAY_ON), "none");
+
+	ut_set_active("screen_off", TRUE);
+	ut_set_active("forced", TRUE);
+	ck_assert_str_eq(ut_selected(MCE_STATE_USER, MCE_DISPLAY_ON),
+			 "forced");
+	ck_assert_str_eq(ut_selected(MCE_STATE_USER, MCE_DISPLAY_OFF),
+			 "screen_off");
+
+	ut_set_active("screen_on", TRUE);
+	ut_set_active("actdead", TRUE);
+	ck_assert_str_eq(ut_selected(MCE_STATE_USER, MCE_DISPLAY_ON),
+			 "screen_on");
+	ck_assert_str_eq(ut_selected(MCE_STATE_ACTDEAD, MCE_DISPLAY_ON),
+			 "actdead");
+
+	pattern_set_enabled(find_pattern_struct("actdead"), FALSE);
+	ck_assert_str_eq(ut_selected(MCE_STATE_ACTDEAD, MCE_DISPLAY_ON),
+			 "forced");
+
+	led_enabled = FALSE;
+	ck_assert_str_eq(ut_selected(MCE_STATE_USER, MCE_DISPLAY_OFF),
+			 "forced");
+	ut_set_active("forced", FALSE);
+	ck_assert_str_eq(ut_selected(MCE_STATE_USER, MCE_DISPLAY_OFF), "none");
+}
+END_TEST
+
+/* Selection matches walking the whole pattern stack */
+START_TEST (ut_check_select_random)
+{
+	static const system_state_t system_states[] = {
+		MCE_STATE_USER, MCE_STATE_ACTDEAD,
+	};
+	static const display_state_t display_states[] = {
+		MCE_DISPLAY_OFF, MCE_DISPLAY_LPM_OFF, MCE_DISPLAY_LPM_ON,
+		MCE_DISPLAY_DIM, MCE_DISPLAY_ON,
+	};
+	const guint count = 300;
+	guint seed = 1;
+	gchar name[32];
+
+	for (guint i = 0; i < count; i++) {
+		snprintf(name, sizeof name, "pattern%u", i);
+		ut_add_pattern(name, rand_r(&seed) % 50,
+			       rand_r(&seed) % 9 - 1);
+	}
+	init_pattern_index();
+
+	for (guint i = 0; i < 20000; i++) {
+		pattern_struct *psp;
+
+		psp = g_queue_peek_nth(pattern_stack, rand_r(&seed) % count);
+
+		if (rand_r(&seed) % 4)
+			pattern_set_active(psp, rand_r(&seed) % 2);
+		else
+			pattern_set_enabled(psp, rand_r(&seed) % 2);
+
+		led_enabled = (rand_r(&seed) % 8) != 0;
+
+		for (guint s = 0; s < G_N_ELEMENTS(system_states); s++) {
+			for (guint d = 0; d < G_N_ELEMENTS(display_states); d++) {
+				ck_assert(led_select_pattern(system_states[s],
+							     display_states[d]) ==
+					  ut_reference_select(system_states[s],
+							      display_states[d]));
+			}
+		}
+	}
+}
+END_TEST
+
+/* Combined patterns follow the state of their pre-requisites */
+START_TEST (ut_check_combination)
+{
+	ut_add_pattern("a", 10, 0);
+	ut_add_pattern("b", 20, 0);
+	ut_add_pattern("ab", 5, 0);
+	ut_add_pattern("ax", 6, 0);
+	ut_add_rule("ab", "a", "b", NULL);
+	ut_add_rule("ax", "a", "missing", NULL);
+	init_pattern_index();
+
+	ut_set_active("a", TRUE);
+	ck_assert(!find_pattern_struct("ab")->active);
+	ck_assert_str_eq(ut_selected(MCE_STATE_USER, MCE_DISPLAY_OFF), "a");
+
+	ut_set_active("b", TRUE);
+	ck_assert(find_pattern_struct("ab")->active);
+	ck_assert_str_eq(ut_selected(MCE_STATE_USER, MCE_DISPLAY_OFF), "ab");
+
+	/* Repeated requests do not confuse the bookkeeping */
+	ut_set_active("b", TRUE);
+	ut_set_active("a", FALSE);
+	ut_set_active("a", FALSE);
+	ck_assert(!find_pattern_struct("ab")->active);
+	ck_assert_str_eq(ut_selected(MCE_STATE_USER, MCE_DISPLAY_OFF), "b");
+
+	ut_set_active("a", TRUE);
+	ck_assert(find_pattern_struct("ab")->active);
+
+	/* Rules with missing pre-requisites never match */
+	ck_assert(!find_pattern_struct("ax")->active);
+}
+END_TEST
+
+/* Keyframes are stored only where the level changes and not too often */
+START_TEST (ut_check_sw_compile)
+{
+	pattern_struct *psp = ut_sw_pattern(1000, 500, 2000, 1500, 15);
+	guint peak = 0;
+
+	ck_assert_int_eq(psp->cycle, 5000);
+	ck_assert_int_eq(psp->keyframes[0].time, 0);
+	ck_assert_int_eq(psp->keyframes[0].level, 0);
+
+	/* One keyframe per level up and down, plus the start */
+	ck_assert_int_eq(psp->frames, 2 * 15 + 1);
+
+	for (guint i = 1; i < psp->frames; i++) {
+		ck_assert(psp->keyframes[i].time - psp->keyframes[i - 1].time >=
+			  SW_PATTERN_MIN_FRAME_MS);
+		ck_assert(psp->keyframes[i].level != psp->keyframes[i - 1].level);
+		peak = MAX(peak, psp->keyframes[i].level);
+	}
+	ck_assert_int_eq(peak, 15);
+	ck_assert_int_eq(psp->keyframes[15].time, 1000);
+	ck_assert_int_eq(psp->keyframes[15].level, 15);
+	ck_assert_int_eq(psp->keyframes[psp->frames - 1].level, 0);
+	ut_sw_pattern_free(psp);
+
+	/* Fast ramps are limited to the minimum frame interval */
+	psp = ut_sw_pattern(100, 0, 100, 800, 100);
+	ck_assert(psp->frames <= 200 / SW_PATTERN_MIN_FRAME_MS + 1);
+	ut_sw_pattern_free(psp);
+
+	/* The LED is turned off at the end of the fall ramp even if
+	 * the off period is shorter than the keyframe interval */
+	psp = ut_sw_pattern(0, 500, 30, 10, 15);
+	ck_assert_int_eq(psp->keyframes[0].level, 15);
+	ck_assert_int_eq(psp->keyframes[psp->frames - 1].time, 530);
+	ck_assert_int_eq(psp->keyframes[psp->frames - 1].level, 0);
+	ut_sw_pattern_free(psp);
+
+	/* Patterns that do not ramp are left to the hardware */
+	psp = ut_sw_pattern(0, 500, 0, 500, 15);
+	ck_assert(psp->keyframes == NULL);
+	ut_sw_pattern_free(psp);
+}
+END_TEST
+
+/* Levels are written only when they change and wakeups happen
+ * only at keyframes */
+START_TEST (ut_check_sw_step)
+{
+	pattern_struct *psp = ut_sw_pattern(1000, 500, 2000, 1500, 15);
+	guint wakeups = 0;
+	guint delay;
+
+	stub__mono_tick = 100000;
+	ut_sw_writes = 0;
+
+	sw_pattern_start(psp, ut_sw_write);
+	ck_assert(sw_pattern_timer_id != 0);
+	ck_assert(!stub__wakelock_held);
+	ck_assert_int_eq(ut_sw_writes, 1);
+	ck_assert_int_eq(ut_sw_level, 0);
+
+	/* Run three cycles by waking up exactly when requested */
+	sw_pattern_cancel_timer();
+	stub__mono_tick += psp->keyframes[1].time;
+	while (stub__mono_tick < 100000 + 3 * 5000) {
+		delay = sw_pattern_step();
+		ck_assert(delay > 0);
+		stub__mono_tick += delay;
+		wakeups++;
+	}
+	ck_assert_int_eq(wakeups, 3 * (psp->frames - 1));
+	ck_assert_int_eq(ut_sw_writes, 3 * (psp->frames - 1) + 1);
+
+	/* Late wakeups do not make the pattern drift */
+	stub__mono_tick = 100000 + 10 * 5000 + 1700;
+	sw_pattern_step();
+	ck_assert_int_eq(ut_sw_level, 15 - 15 * 200 / 2000);
+
+	/* Restarting the running pattern keeps the phase but rewrites
+	 * the level */
+	ut_sw_writes = 0;
+	sw_pattern_start(psp, ut_sw_write);
+	ck_assert_int_eq(ut_sw_writes, 1);
+	ck_assert_int_eq(ut_sw_level, 15 - 15 * 200 / 2000);
+
+	ck_assert(stub__wakelock_held);
+
+	sw_pattern_stop();
+	ck_assert(sw_pattern_timer_id == 0);
+	ck_assert(!stub__wakelock_held);
+	ck_assert(sw_pattern_step() == 0);
+
+	ut_sw_pattern_free(psp);
+}
+END_TEST
+
+/* Suspend is blocked only while a ramp is in progress */
+START_TEST (ut_check_sw_wakelock)
+{
+	pattern_struct *psp = ut_sw_pattern(1000, 500, 2000, 1500, 15);
+	guint releases = 0;
+	gboolean held = FALSE;
+	guint cycle;
+	guint i;
+
+	stub__mono_tick = 100000;
+	sw_pattern_start(psp, ut_sw_write);
+
+	/* Wake up at every keyframe for two cycles */
+	for (cycle = 0; cycle < 2; cycle++) {
+		for (i = 0; i < psp->frames; i++) {
+			stub__mono_tick = 100000 + cycle * psp->cycle +
+					  psp->keyframes[i].time;
+			sw_pattern_cancel_timer();
+			sw_pattern_timeout_cb(NULL);
+
+			ck_assert(sw_pattern_timer_id != 0);
+			ck_assert_int_eq(stub__wakelock_held,
+					 (ut_sw_level > 0) &&
+					 (ut_sw_level < 15));
+
+			if (held && !stub__wakelock_held)
+				releases++;
+			held = stub__wakelock_held;
+		}
+	}
+
+	/* Released at the top and at the bottom of every cycle */
+	ck_assert_int_eq(releases, 4);
+
+	/* The off period is spent at zero without the wakelock */
+	stub__mono_tick = 100000 + 2 * psp->cycle + 3500 + 100;
+	sw_pattern_cancel_timer();
+	sw_pattern_timeout_cb(NULL);
+	ck_assert_int_eq(ut_sw_level, 0);
+	ck_assert(!stub__wakelock_held);
+
+	ut_sw_pattern_free(psp);
+	ck_assert(!stub__wakelock_held);
+}
+END_TEST
+
+static Suite *ut_led_suite (void)
+{
+	Suite *s = suite_create ("ut_led");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_checked_fixture(tc_core, ut_setup, ut_teardown);
+	tcase_add_test (tc_core, ut_check_select_policy);
+	tcase_add_test (tc_core, ut_check_select_random);
+	tcase_add_test (tc_core, ut_check_combination);
+	suite_add_tcase (s, tc_core);
+
+	TCase *tc_sw = tcase_create ("sw_pattern");
+	tcase_add_test (tc_sw, ut_check_sw_compile);
+	tcase_add_test (tc_sw, ut_check_sw_step);
+	tcase_add_test (tc_sw, ut_check_sw_wakelock);
+	suite_add_tcase (s, tc_sw);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_led_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,227 @@
+#include <check.h>
+#include <glib.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "common.h"
+
+/* Use regular files instead of sysfs entries */
+#define LWL_SYSFS_DIR "/tmp/ut_libwakelock"
+
+#include "../../libwakelock.c"
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+/** Get data written to a file, as one string */
+static gchar *ut_read(const char *path)
+{
+	gchar *data = 0;
+
+	if (!g_file_get_contents(path, &data, 0, 0))
+		data = g_strdup("");
+
+	return data;
+}
+
+static void ut_assert_written(const char *path, const char *expected)
+{
+	gchar *data = ut_read(path);
+
+	ck_assert_str_eq(data, expected);
+	g_free(data);
+}
+
+static void ut_setup(void)
+{
+	mkdir(LWL_SYSFS_DIR, 0755);
+	g_file_set_contents(lwl_lock_path, "", 0, 0);
+	g_file_set_contents(lwl_unlock_path, "", 0, 0);
+
+	memset(lwl_cache, 0, sizeof lwl_cache);
+	memset(&lwl_stats, 0, sizeof lwl_stats);
+	lwl_shutting_down = 0;
+}
+
+static void ut_teardown(void)
+{
+	if (lwl_lock_fd != -1)
+		close(lwl_lock_fd), lwl_lock_fd = -1;
+	if (lwl_unlock_fd != -1)
+		close(lwl_unlock_fd), lwl_unlock_fd = -1;
+
+	unlink(lwl_lock_path);
+	unlink(lwl_unlock_path);
+	rmdir(LWL_SYSFS_DIR);
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+/* Redundant lock / unlock requests do not cause writes */
+START_TEST (ut_check_redundant_skipped)
+{
+	lwl_stats_t stats;
+
+	/* State is not known before the first write */
+	wakelock_unlock("ut_lock");
+
+	for (int i = 0; i < 10; i++) {
+		wakelock_lock("ut_lock", -1);
+		wakelock_lock("ut_lock", -1);
+		wakelock_unlock("ut_lock");
+		wakelock_unlock("ut_lock");
+	}
+
+	wakelock_get_stats(&stats);
+	ck_assert_int_eq(stats.lock_writes, 10);
+	ck_assert_int_eq(stats.lock_skips, 10);
+	ck_assert_int_eq(stats.unlock_writes, 11);
+	ck_assert_int_eq(stats.unlock_skips, 10);
+	ck_assert_int_eq(stats.write_errors, 0);
+
+	GString *expected = g_string_new(0);
+
+	for (int i = 0; i < 10; i++)
+		g_string_append(expected, "ut_lock\n");
+	ut_assert_written(lwl_lock_path, expected->str);
+
+	g_string_free(expected, TRUE);
+}
+END_TEST
+
+/* Timed locks are written with the timeout and need no unlock */
+START_TEST (ut_check_timed)
+{
+	const long long hour = 3600LL * 1000 * 1000 * 1000;
+	lwl_stats_t stats;
+
+	wakelock_lock("ut_timed", hour);
+	ut_assert_written(lwl_lock_path, "ut_timed 3600000000000\n");
+
+	/* Shorter timeout than what is already held */
+	wakelock_lock("ut_timed", 1000);
+	wakelock_get_stats(&stats);
+	ck_assert_int_eq(stats.lock_writes, 1);
+	ck_assert_int_eq(stats.lock_skips, 1);
+
+	/* Expired lock does not need unlocking */
+	wakelock_lock("ut_short", 1);
+	while (lwl_get_time() <= lwl_cache_lookup("ut_short")->expires)
+		;
+	wakelock_unlock("ut_short");
+	wakelock_get_stats(&stats);
+	ck_assert_int_eq(stats.lock_writes, 2);
+	ck_assert_int_eq(stats.unlock_writes, 0);
+	ck_assert_int_eq(stats.unlock_skips, 1);
+
+	/* Lock without timeout replaces the timed one */
+	wakelock_lock("ut_short", -1);
+	wakelock_unlock("ut_short");
+	wakelock_get_stats(&stats);
+	ck_assert_int_eq(stats.lock_writes, 3);
+	ck_assert_int_eq(stats.unlock_writes, 1);
+
+	/* Timeout is applied to a lock held without timeout */
+	wakelock_lock("ut_short", -1);
+	wakelock_lock("ut_short", hour);
+	wakelock_get_stats(&stats);
+	ck_assert_int_eq(stats.lock_writes, 5);
+	ck_assert_int_eq(lwl_cache_lookup("ut_short")->state, LWL_STATE_TIMED);
+	ut_assert_written(lwl_lock_path,
+			  "ut_timed 3600000000000\n"
+			  "ut_short 1\n"
+			  "ut_short\n"
+			  "ut_short\n"
+			  "ut_short 3600000000000\n");
+}
+END_TEST
+
+/* On the exit path unlocks are written regardless of the cache */
+START_TEST (ut_check_shutting_down)
+{
+	wakelock_lock("ut_exit", -1);
+	wakelock_unlock("ut_exit");
+	ut_assert_written(lwl_unlock_path, "ut_exit\n");
+
+	g_file_set_contents(lwl_unlock_path, "", 0, 0);
+	lwl_shutting_down = 1;
+	wakelock_unlock("ut_exit");
+	ut_assert_written(lwl_unlock_path, "ut_exit\n");
+	ck_assert_int_eq(lwl_cache_lookup("ut_exit")->state,
+			 LWL_STATE_UNLOCKED);
+}
+END_TEST
+
+/* Files are kept open between writes */
+START_TEST (ut_check_persistent_fd)
+{
+	int fd;
+
+	wakelock_lock("ut_fd", -1);
+	fd = lwl_lock_fd;
+	ck_assert(fd != -1);
+
+	wakelock_unlock("ut_fd");
+	wakelock_lock("ut_fd", -1);
+	ck_assert_int_eq(lwl_lock_fd, fd);
+
+	ut_assert_written(lwl_lock_path, "ut_fd\nut_fd\n");
+	ut_assert_written(lwl_unlock_path, "ut_fd\n");
+}
+END_TEST
+
+/* Names that do not fit in the cache are always written */
+START_TEST (ut_check_cache_full)
+{
+	char name[32];
+	lwl_stats_t stats;
+
+	for (int i = 0; i < LWL_CACHE_SIZE; i++) {
+		snprintf(name, sizeof name, "ut_lock%d", i);
+		wakelock_lock(name, -1);
+	}
+
+	wakelock_lock("ut_uncached", -1);
+	wakelock_lock("ut_uncached", -1);
+	wakelock_unlock("ut_uncached");
+	wakelock_unlock("ut_uncached");
+
+	wakelock_get_stats(&stats);
+	ck_assert_int_eq(stats.lock_writes, LWL_CACHE_SIZE + 2);
+	ck_assert_int_eq(stats.unlock_writes, 2);
+	ck_assert_int_eq(stats.lock_skips + stats.unlock_skips, 0);
+}
+END_TEST
+
+static Suite *ut_libwakelock_suite (void)
+{
+	Suite *s = suite_create ("ut_libwakelock");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_checked_fixture(tc_core, ut_setup, ut_teardown);
+	tcase_add_test (tc_core, ut_check_redundant_skipped);
+	tcase_add_test (tc_core, ut_check_timed);
+	tcase_add_test (tc_core, ut_check_persistent_fd);
+	tcase_add_test (tc_core, ut_check_cache_full);
+	tcase_add_test (tc_core, ut_check_shutting_down);
+	suite_add_tcase (s, tc_core);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_libwakelock_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
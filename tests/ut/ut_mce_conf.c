@@ -0,0 +1,519 @@
+#include <check.h>
+#include <glib.h>
+
+#include "common.h"
+
+/* Tested module */
+#include "../../mce-conf.c"
+
+/* ------------------------------------------------------------------------- *
+ * STUBS
+ * ------------------------------------------------------------------------- */
+
+EXTERN_DUMMY_STUB (
+void, mce_abort, (void));
+
+/** Copy of the last cache image written */
+static void *ut_saved_image = NULL;
+
+/** Size of ut_saved_image */
+static gsize ut_saved_size = 0;
+
+/** Number of cache file writes */
+static guint ut_saved_count = 0;
+
+EXTERN_STUB (
+gboolean, mce_io_update_file_atomic, (const char *path,
+				      const void *data, size_t size,
+				      mode_t mode, gboolean keep_backup))
+{
+	(void)path;
+	(void)mode;
+	(void)keep_backup;
+
+	g_free(ut_saved_image);
+	ut_saved_image = g_memdup(data, size);
+	ut_saved_size  = size;
+	ut_saved_count++;
+
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+/** Configuration with values that exercise the GKeyFile value parsing */
+static const char ut_ini_data[] =
+	"[bools]\n"
+	"t=true\n"
+	"f=false\n"
+	"one=1\n"
+	"zero=0\n"
+	"spaced=true  \n"
+	"bad=yes\n"
+	"\n"
+	"[ints]\n"
+	"pos=42\n"
+	"neg=-7\n"
+	"spaced=13 \n"
+	"bad=4x\n"
+	"empty=\n"
+	"huge=99999999999\n"
+	"list=1;2;3\n"
+	"list_bad=1;x;3\n"
+	"\n"
+	"[strings]\n"
+	"plain=hello world\n"
+	"escapes=a\\sb\\tc\\nd\\re\\\\f\n"
+	"invalid=a\\qb\n"
+	"trailing=a\\\n"
+	"latin1=\xe4\xe4\n"
+	"list=a;b;c\n"
+	"list_end=a;b;\n"
+	"list_esc=a\\;b;c\n"
+	"list_empty=\n"
+	"list_semi=;\n"
+	"list_blank=;;x\n"
+	"\n"
+	"# a comment\n"
+	"[empty]\n"
+	"\n"
+	"[evdev]\n"
+	"touch=Touch A;Touch B\n";
+
+/** Extra key names probed in every group, none of them exist */
+static const char *const ut_missing_keys[] = {
+	"missing", "", "tru", "trueX", NULL
+};
+
+/** Merged configuration used as the reference */
+static GKeyFile *ut_ini = NULL;
+
+/** Compiled configuration of ut_ini */
+static void *ut_image = NULL;
+
+/** Size of ut_image */
+static gsize ut_image_size = 0;
+
+/** Make array of fake source file stamps
+ *
+ * @param count number of sources
+ *
+ * @return array of mce_conf_source_t
+ */
+static GPtrArray *ut_make_sources(guint count)
+{
+	GPtrArray *sources = g_ptr_array_new();
+
+	for( guint i = 0; i < count; ++i ) {
+		mce_conf_source_t *source = g_malloc0(sizeof *source);
+
+		source->path     = g_strdup_printf("/etc/mce/%02u-test.ini", i);
+		source->mtime    = 1400000000 + i;
+		source->mtime_ns = 1000 * i;
+		source->size     = 100 + i;
+		g_ptr_array_add(sources, source);
+	}
+
+	return sources;
+}
+
+/** Load ini data and compile it
+ *
+ * @param data    ini file content
+ * @param sources source stamps to store in the image
+ */
+static void ut_compile(const char *data, const GPtrArray *sources)
+{
+	GError *err = NULL;
+
+	ut_ini = g_key_file_new();
+	ck_assert(g_key_file_load_from_data(ut_ini, data, strlen(data),
+					    0, &err));
+	g_clear_error(&err);
+
+	ut_image = mce_conf_cache_compile(ut_ini, sources, 1234,
+					  &ut_image_size);
+	ck_assert(ut_image != NULL);
+}
+
+/** Use keyfile or compiled configuration for the mce_conf_xxx() calls
+ *
+ * @param use_cache TRUE to use ut_image, FALSE to use ut_ini
+ */
+static void ut_select(gboolean use_cache)
+{
+	keyfile = use_cache ? NULL : ut_ini;
+	cache   = use_cache ? ut_image : NULL;
+}
+
+/** Describe everything mce_conf_xxx() calls return for a key
+ *
+ * @param group group name
+ * @param key   key name
+ *
+ * @return description; release with g_free()
+ */
+static gchar *ut_describe(const gchar *group, const gchar *key)
+{
+	GString *res = g_string_new("");
+	gchar   *str;
+	gchar  **vec;
+	gint    *arr;
+	gsize    len = 99;
+
+	g_string_append_printf(res, "has=%d/%d",
+			       mce_conf_has_group(group),
+			       mce_conf_has_key(group, key));
+	g_string_append_printf(res, " bool=%d",
+			       mce_conf_get_bool(group, key, 2));
+	g_string_append_printf(res, " int=%d",
+			       mce_conf_get_int(group, key, -99));
+
+	str = mce_conf_get_string(group, key, "<def>");
+	g_string_append_printf(res, " str=[%s]", str);
+	g_free(str);
+
+	vec = mce_conf_get_string_list(group, key, &len);
+	g_string_append_printf(res, " strv=%zu:", len);
+	for( gsize i = 0; vec && vec[i]; ++i )
+		g_string_append_printf(res, "[%s]", vec[i]);
+	g_strfreev(vec);
+
+	len = 99;
+	arr = mce_conf_get_int_list(group, key, &len);
+	g_string_append_printf(res, " intv=%zu:", len);
+	for( gsize i = 0; arr && i < len; ++i )
+		g_string_append_printf(res, "%d,", arr[i]);
+	g_free(arr);
+
+	return g_string_free(res, FALSE);
+}
+
+/** Describe keys mce_conf_get_keys() returns for a group
+ *
+ * @param group group name
+ *
+ * @return description; release with g_free()
+ */
+static gchar *ut_describe_keys(const gchar *group)
+{
+	gsize   len  = 99;
+	gchar **keys = mce_conf_get_keys(group, &len);
+	gchar  *res  = keys ? g_strjoinv(",", keys) : g_strdup("<null>");
+	gchar  *tmp  = g_strdup_printf("%zu:%s", len, res);
+
+	g_strfreev(keys);
+	g_free(res);
+
+	return tmp;
+}
+
+static void ut_teardown(void)
+{
+	ut_select(FALSE);
+	keyfile = NULL;
+
+	if( ut_ini )
+		g_key_file_free(ut_ini), ut_ini = NULL;
+	g_free(ut_image), ut_image = NULL;
+	ut_image_size = 0;
+
+	mce_conf_cache_cancel_save();
+	g_free(ut_saved_image), ut_saved_image = NULL;
+	ut_saved_size  = 0;
+	ut_saved_count = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+/* Every getter returns the same from compiled configuration as
+ * from the GKeyFile it was compiled from */
+START_TEST (ut_check_getters)
+{
+	GPtrArray *sources = ut_make_sources(2);
+	gchar    **groups;
+
+	ut_compile(ut_ini_data, sources);
+	ck_assert(mce_conf_cache_valid(ut_image, ut_image_size, sources));
+
+	groups = g_key_file_get_groups(ut_ini, NULL);
+	ck_assert(groups && groups[0]);
+
+	for( gsize g = 0; groups[g]; ++g ) {
+		gchar **keys = g_key_file_get_keys(ut_ini, groups[g], 0, 0);
+		gchar  *want;
+		gchar  *have;
+
+		ut_select(FALSE), want = ut_describe_keys(groups[g]);
+		ut_select(TRUE),  have = ut_describe_keys(groups[g]);
+		ck_assert_str_eq(have, want);
+		g_free(have), g_free(want);
+
+		for( gsize k = 0; keys && keys[k]; ++k ) {
+			ut_select(FALSE), want = ut_describe(groups[g], keys[k]);
+			ut_select(TRUE),  have = ut_describe(groups[g], keys[k]);
+			ck_assert_str_eq(have, want);
+			g_free(have), g_free(want);
+		}
+
+		for( gsize k = 0; ut_missing_keys[k]; ++k ) {
+			const gchar *key = ut_missing_keys[k];
+
+			ut_select(FALSE), want = ut_describe(groups[g], key);
+			ut_select(TRUE),  have = ut_describe(groups[g], key);
+			ck_assert_str_eq(have, want);
+			g_free(have), g_free(want);
+		}
+		g_strfreev(keys);
+	}
+	g_strfreev(groups);
+
+	/* Unknown groups */
+	ut_select(TRUE);
+	ck_assert(!mce_conf_has_group("nothere"));
+	ck_assert(!mce_conf_has_key("nothere", "t"));
+	ck_assert(!mce_conf_has_key("ints", "t"));
+	ck_assert(mce_conf_get_keys("nothere", NULL) == NULL);
+	ck_assert_int_eq(mce_conf_get_int("nothere", "pos", 5), 5);
+
+	mce_conf_free_sources(sources);
+}
+END_TEST
+
+/* Compiled configuration is not used after any ini file changes */
+START_TEST (ut_check_stale)
+{
+	GPtrArray         *sources = ut_make_sources(3);
+	GPtrArray         *other;
+	mce_conf_source_t *source  = g_ptr_array_index(sources, 1);
+
+	ut_compile(ut_ini_data, sources);
+	ck_assert(mce_conf_cache_valid(ut_image, ut_image_size, sources));
+
+	source->mtime++;
+	ck_assert(!mce_conf_cache_valid(ut_image, ut_image_size, sources));
+	source->mtime--;
+
+	source->mtime_ns++;
+	ck_assert(!mce_conf_cache_valid(ut_image, ut_image_size, sources));
+	source->mtime_ns--;
+
+	source->size--;
+	ck_assert(!mce_conf_cache_valid(ut_image, ut_image_size, sources));
+	source->size++;
+
+	source->path[9] = '9';
+	ck_assert(!mce_conf_cache_valid(ut_image, ut_image_size, sources));
+	source->path[9] = '0';
+
+	ck_assert(mce_conf_cache_valid(ut_image, ut_image_size, sources));
+
+	other = ut_make_sources(2);
+	ck_assert(!mce_conf_cache_valid(ut_image, ut_image_size, other));
+	mce_conf_free_sources(other);
+
+	other = ut_make_sources(4);
+	ck_assert(!mce_conf_cache_valid(ut_image, ut_image_size, other));
+	mce_conf_free_sources(other);
+
+	mce_conf_free_sources(sources);
+}
+END_TEST
+
+/* Truncated and corrupted images are rejected */
+START_TEST (ut_check_corrupt)
+{
+	GPtrArray               *sources = ut_make_sources(1);
+	mce_conf_cache_header_t *hdr;
+	gchar                   *data;
+	guint32                  save;
+
+	ut_compile(ut_ini_data, sources);
+	hdr  = ut_image;
+	data = ut_image;
+
+	for( gsize size = 0; size < ut_image_size; ++size ) {
+		hdr->size = (guint32)size;
+		ck_assert(!mce_conf_cache_valid(ut_image, size, sources));
+	}
+	hdr->size = (guint32)ut_image_size;
+	ck_assert(mce_conf_cache_valid(ut_image, ut_image_size, sources));
+
+	data[0] ^= 1;
+	ck_assert(!mce_conf_cache_valid(ut_image, ut_image_size, sources));
+	data[0] ^= 1;
+
+	data[ut_image_size - 1] = 'x';
+	ck_assert(!mce_conf_cache_valid(ut_image, ut_image_size, sources));
+	data[ut_image_size - 1] = 0;
+
+	save = hdr->key_off, hdr->key_off = hdr->size - 4;
+	ck_assert(!mce_conf_cache_valid(ut_image, ut_image_size, sources));
+	hdr->key_off = save;
+
+	save = hdr->keys, hdr->keys = 1;
+	ck_assert(!mce_conf_cache_valid(ut_image, ut_image_size, sources));
+	hdr->keys = save;
+
+	save = hdr->key_phf.slots, hdr->key_phf.slots = G_MAXUINT32;
+	ck_assert(!mce_conf_cache_valid(ut_image, ut_image_size, sources));
+	hdr->key_phf.slots = save;
+
+	ck_assert(mce_conf_cache_valid(ut_image, ut_image_size, sources));
+
+	mce_conf_free_sources(sources);
+}
+END_TEST
+
+/** Sum values of every group/key pair via mce_conf_get_int()
+ *
+ * @param grp    group names
+ * @param key    key names
+ * @param count  number of group/key pairs
+ *
+ * @return sum of the looked up values
+ */
+static gint ut_lookup_all(gchar **grp, gchar **key, guint count)
+{
+	gint sum = 0;
+
+	for( guint i = 0; i < count; ++i )
+		sum += mce_conf_get_int(grp[i], key[i], -1);
+
+	return sum;
+}
+
+/* Every key of a large configuration is found from the compiled
+ * configuration with the same value as from GKeyFile */
+START_TEST (ut_check_large)
+{
+	const guint  groups  = 64;
+	const guint  keys    = 32;
+	const guint  count   = groups * keys;
+	GPtrArray   *sources = ut_make_sources(1);
+	GString     *ini     = g_string_new("");
+	gchar      **grp     = g_new0(gchar *, count + 1);
+	gchar      **key     = g_new0(gchar *, count + 1);
+	gint         sum_ini;
+	gint         sum_cache;
+
+	for( guint i = 0; i < count; ++i ) {
+		grp[i] = g_strdup_printf("Group%u", i / keys);
+		key[i] = g_strdup_printf("Key%u", i % keys);
+		if( i % keys == 0 )
+			g_string_append_printf(ini, "[%s]\n", grp[i]);
+		g_string_append_printf(ini, "%s=%u\n", key[i], i);
+	}
+	ut_compile(ini->str, sources);
+
+	ck_assert_int_eq(((mce_conf_cache_header_t *)ut_image)->keys, count);
+	ck_assert(mce_conf_cache_valid(ut_image, ut_image_size, sources));
+
+	ut_select(TRUE);
+	for( guint i = 0; i < count; ++i )
+		ck_assert(mce_conf_cache_find_key(grp[i], key[i]));
+	ck_assert(!mce_conf_cache_find_key("Group0", "Key9999"));
+	ck_assert(!mce_conf_cache_find_key("Group9999", "Key0"));
+
+	ut_select(FALSE);
+	sum_ini = ut_lookup_all(grp, key, count);
+
+	ut_select(TRUE);
+	sum_cache = ut_lookup_all(grp, key, count);
+
+	ck_assert_int_eq(sum_cache, sum_ini);
+	ck_assert_int_eq(sum_cache, count * (count - 1) / 2);
+
+	g_string_free(ini, TRUE);
+	g_strfreev(key);
+	g_strfreev(grp);
+	mce_conf_free_sources(sources);
+}
+END_TEST
+
+/* Configuration without any ini files compiles to a valid image */
+START_TEST (ut_check_empty)
+{
+	GPtrArray *sources = ut_make_sources(0);
+
+	ut_compile("", sources);
+	ck_assert(mce_conf_cache_valid(ut_image, ut_image_size, sources));
+
+	ut_select(TRUE);
+	ck_assert(!mce_conf_has_group("evdev"));
+	ck_assert(mce_conf_get_string_list("evdev", "touch", NULL) == NULL);
+
+	mce_conf_free_sources(sources);
+}
+END_TEST
+
+/* Cache file is written from idle callback, not during init */
+START_TEST (ut_check_deferred_save)
+{
+	GPtrArray *sources = ut_make_sources(2);
+
+	ut_compile(ut_ini_data, sources);
+	ut_select(FALSE);
+
+	/* Nothing is written until the idle callback gets called */
+	mce_conf_cache_schedule_save(sources, 1234);
+	ck_assert(mce_conf_cache_save_id != 0);
+	ck_assert_int_eq(ut_saved_count, 0);
+
+	ck_assert(!mce_conf_cache_save_cb(NULL));
+	ck_assert_int_eq(mce_conf_cache_save_id, 0);
+	ck_assert_int_eq(ut_saved_count, 1);
+	ck_assert(mce_conf_cache_save_sources == NULL);
+
+	/* The written image matches the configuration */
+	sources = ut_make_sources(2);
+	ck_assert_int_eq(ut_saved_size, ut_image_size);
+	ck_assert(!memcmp(ut_saved_image, ut_image, ut_image_size));
+	ck_assert(mce_conf_cache_valid(ut_saved_image, ut_saved_size,
+				       sources));
+	ck_assert_int_eq(((mce_conf_cache_header_t *)ut_saved_image)->parse_us,
+			 1234);
+
+	/* Cancelled update is not written */
+	mce_conf_cache_schedule_save(sources, 1);
+	mce_conf_cache_cancel_save();
+	ck_assert_int_eq(mce_conf_cache_save_id, 0);
+	ck_assert(!mce_conf_cache_save_cb(NULL));
+	ck_assert_int_eq(ut_saved_count, 1);
+}
+END_TEST
+
+static Suite *ut_mce_conf_suite (void)
+{
+	Suite *s = suite_create ("ut_mce_conf");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_checked_fixture(tc_core, NULL, ut_teardown);
+	tcase_add_test (tc_core, ut_check_getters);
+	tcase_add_test (tc_core, ut_check_stale);
+	tcase_add_test (tc_core, ut_check_corrupt);
+	tcase_add_test (tc_core, ut_check_large);
+	tcase_add_test (tc_core, ut_check_empty);
+	tcase_add_test (tc_core, ut_check_deferred_save);
+	suite_add_tcase (s, tc_core);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_mce_conf_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,224 @@
+#include <check.h>
+#include <glib.h>
+
+#include "common.h"
+
+#include "../../mce-dbus.c"
+
+/* ------------------------------------------------------------------------- *
+ * STUBS
+ * ------------------------------------------------------------------------- */
+
+EXTERN_STUB (
+void, dbus_bus_add_match, (DBusConnection *connection, const char *rule,
+			   DBusError *error))
+{
+	(void)connection;
+	(void)rule;
+	(void)error;
+}
+
+EXTERN_STUB (
+void, dbus_bus_remove_match, (DBusConnection *connection, const char *rule,
+			      DBusError *error))
+{
+	(void)connection;
+	(void)rule;
+	(void)error;
+}
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+#define UT_IFACE_A "com.example.a"
+#define UT_IFACE_B "com.example.b"
+
+/** Number of calls made to ut_handler_a() and ut_handler_b() */
+static guint ut_calls[2] = { 0, 0 };
+
+static gboolean ut_handler_a(DBusMessage *const msg)
+{
+	(void)msg;
+
+	ut_calls[0]++;
+
+	return TRUE;
+}
+
+static gboolean ut_handler_b(DBusMessage *const msg)
+{
+	(void)msg;
+
+	ut_calls[1]++;
+
+	return TRUE;
+}
+
+/** Pass a message to msg_handler() and release it
+ *
+ * @return TRUE if the message was handled, FALSE otherwise
+ */
+static gboolean ut_dispatch(DBusMessage *msg)
+{
+	DBusHandlerResult res = msg_handler(NULL, msg, NULL);
+
+	dbus_message_unref(msg);
+
+	return res == DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static gboolean ut_method_call(const char *interface, const char *member)
+{
+	return ut_dispatch(dbus_message_new_method_call(NULL, "/com/example",
+							interface, member));
+}
+
+static void ut_signal(const char *path, const char *arg0, const char *arg1)
+{
+	DBusMessage *msg = dbus_message_new_signal(path, UT_IFACE_A, "changed");
+
+	ck_assert(dbus_message_append_args(msg,
+					   DBUS_TYPE_STRING, &arg0,
+					   DBUS_TYPE_STRING, &arg1,
+					   DBUS_TYPE_INVALID));
+	ut_dispatch(msg);
+}
+
+static void ut_setup(void)
+{
+	ut_calls[0] = ut_calls[1] = 0;
+}
+
+static void ut_teardown(void)
+{
+	ck_assert(dbus_handlers == NULL);
+	ck_assert(dbus_handler_lut == NULL ||
+		  g_hash_table_size(dbus_handler_lut) == 0);
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+START_TEST (ut_check_method_lookup)
+{
+	gconstpointer a, b;
+
+	a = mce_dbus_handler_add(UT_IFACE_A, "ping", NULL,
+				 DBUS_MESSAGE_TYPE_METHOD_CALL, ut_handler_a);
+	b = mce_dbus_handler_add(UT_IFACE_B, "ping", NULL,
+				 DBUS_MESSAGE_TYPE_METHOD_CALL, ut_handler_b);
+
+	ck_assert(ut_method_call(UT_IFACE_A, "ping"));
+	ck_assert_int_eq(ut_calls[0], 1);
+	ck_assert(ut_method_call(UT_IFACE_B, "ping"));
+	ck_assert_int_eq(ut_calls[1], 1);
+
+	ck_assert(!ut_method_call("com.example.c", "ping"));
+	ck_assert(!ut_method_call(UT_IFACE_A, "pong"));
+
+	/* Missing interface matches any; the newest handler wins */
+	ck_assert(ut_method_call(NULL, "ping"));
+	ck_assert_int_eq(ut_calls[1], 2);
+	ck_assert(!ut_method_call(NULL, "pong"));
+
+	mce_dbus_handler_remove(b);
+	ck_assert(ut_method_call(NULL, "ping"));
+	ck_assert_int_eq(ut_calls[0], 2);
+	ck_assert(!ut_method_call(UT_IFACE_B, "ping"));
+
+	mce_dbus_handler_remove(a);
+	ck_assert(!ut_method_call(NULL, "ping"));
+	ck_assert_int_eq(ut_calls[0], 2);
+	ck_assert_int_eq(ut_calls[1], 2);
+}
+END_TEST
+
+START_TEST (ut_check_rule_compile)
+{
+	const handler_struct *h;
+
+	h = mce_dbus_handler_add(UT_IFACE_A, "changed",
+				 "arg1='on', path='/com/example', arg0=led",
+				 DBUS_MESSAGE_TYPE_SIGNAL, ut_handler_a);
+
+	/* Rules are sorted by argument; path comes first */
+	ck_assert(!h->rule_err);
+	ck_assert_int_eq(h->rule_cnt, 3);
+	ck_assert_int_eq(h->rule_tab[0].arg, -1);
+	ck_assert_str_eq(h->rule_tab[0].value, "/com/example");
+	ck_assert_int_eq(h->rule_tab[1].arg, 0);
+	ck_assert_str_eq(h->rule_tab[1].value, "led");
+	ck_assert_int_eq(h->rule_tab[2].arg, 1);
+	ck_assert_str_eq(h->rule_tab[2].value, "on");
+
+	mce_dbus_handler_remove(h);
+
+	/* Unsupported keys never match */
+	h = mce_dbus_handler_add(UT_IFACE_A, "changed", "sender='x'",
+				 DBUS_MESSAGE_TYPE_SIGNAL, ut_handler_a);
+	ck_assert(h->rule_err);
+	mce_dbus_handler_remove(h);
+}
+END_TEST
+
+START_TEST (ut_check_signal_rules)
+{
+	gconstpointer a, b;
+
+	a = mce_dbus_handler_add(UT_IFACE_A, "changed",
+				 "path='/com/example', arg1='on'",
+				 DBUS_MESSAGE_TYPE_SIGNAL, ut_handler_a);
+	b = mce_dbus_handler_add(UT_IFACE_A, "changed", "arg0='led'",
+				 DBUS_MESSAGE_TYPE_SIGNAL, ut_handler_b);
+
+	/* Every matching signal handler gets called */
+	ut_signal("/com/example", "led", "on");
+	ck_assert_int_eq(ut_calls[0], 1);
+	ck_assert_int_eq(ut_calls[1], 1);
+
+	ut_signal("/com/example", "als", "on");
+	ck_assert_int_eq(ut_calls[0], 2);
+	ck_assert_int_eq(ut_calls[1], 1);
+
+	ut_signal("/org/example", "led", "on");
+	ck_assert_int_eq(ut_calls[0], 2);
+	ck_assert_int_eq(ut_calls[1], 2);
+
+	ut_signal("/com/example", "led", "off");
+	ck_assert_int_eq(ut_calls[0], 2);
+	ck_assert_int_eq(ut_calls[1], 3);
+
+	mce_dbus_handler_remove(a);
+	mce_dbus_handler_remove(b);
+}
+END_TEST
+
+static Suite *ut_mce_dbus_suite (void)
+{
+	Suite *s = suite_create ("ut_mce_dbus");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_checked_fixture(tc_core, ut_setup, ut_teardown);
+	tcase_add_test (tc_core, ut_check_method_lookup);
+	tcase_add_test (tc_core, ut_check_rule_compile);
+	tcase_add_test (tc_core, ut_check_signal_rules);
+	suite_add_tcase (s, tc_core);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_mce_dbus_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,173 @@
+#include <check.h>
+#include <glib.h>
+
+#include "common.h"
+
+#include "../../mce-hybris.c"
+
+/* ------------------------------------------------------------------------- *
+ * STUBS
+ * ------------------------------------------------------------------------- */
+
+/* No plugin path -> plugin functions resolve to NULL */
+EXTERN_STUB (
+gchar *, mce_conf_get_string, (const gchar *group, const gchar *key,
+			       const gchar *defaultval))
+{
+	(void)group;
+	(void)key;
+	(void)defaultval;
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+/** Samples passed to ut_ps_batch_cb() */
+static GArray *ut_ps = NULL;
+
+/** Samples passed to ut_als_batch_cb() */
+static GArray *ut_als = NULL;
+
+/** Number of ut_ps_batch_cb() calls */
+static guint ut_ps_calls = 0;
+
+/** Number of ut_als_batch_cb() calls */
+static guint ut_als_calls = 0;
+
+static void ut_ps_batch_cb(const mce_sensor_sample_t *samples, unsigned count)
+{
+	g_array_append_vals(ut_ps, samples, count);
+	ut_ps_calls++;
+}
+
+static void ut_als_batch_cb(const mce_sensor_sample_t *samples, unsigned count)
+{
+	g_array_append_vals(ut_als, samples, count);
+	ut_als_calls++;
+}
+
+static const mce_sensor_sample_t *ut_sample(GArray *array, guint i)
+{
+	return &g_array_index(array, mce_sensor_sample_t, i);
+}
+
+static void ut_setup(void)
+{
+	ut_ps = g_array_new(FALSE, FALSE, sizeof(mce_sensor_sample_t));
+	ut_als = g_array_new(FALSE, FALSE, sizeof(mce_sensor_sample_t));
+	ut_ps_calls = 0;
+	ut_als_calls = 0;
+
+	ck_assert(mce_hybris_ps_set_batch_callback(ut_ps_batch_cb));
+	ck_assert(mce_hybris_als_set_batch_callback(ut_als_batch_cb));
+}
+
+static void ut_teardown(void)
+{
+	mce_hybris_ps_set_batch_callback(0);
+	mce_hybris_als_set_batch_callback(0);
+	evepipe_quit(true);
+
+	g_array_free(ut_ps, TRUE), ut_ps = NULL;
+	g_array_free(ut_als, TRUE), ut_als = NULL;
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+/* Interleaved events are split in to one batch per sensor */
+START_TEST (ut_check_demux_batches)
+{
+	evepipe_send_als(1000000, 10.4f);
+	evepipe_send_ps(2000000, 5.0f);
+	evepipe_send_als(3000000, 20.6f);
+	evepipe_send_ps(4000000, 0.0f);
+	evepipe_send_als(5000000, -1.0f);
+
+	ck_assert(evepipe_recv_cb(NULL, G_IO_IN, NULL));
+
+	ck_assert_int_eq(ut_als_calls, 1);
+	ck_assert_int_eq(ut_als->len, 3);
+	ck_assert(ut_sample(ut_als, 0)->timestamp == 1000);
+	ck_assert_int_eq(ut_sample(ut_als, 0)->value, 10);
+	ck_assert(ut_sample(ut_als, 1)->timestamp == 3000);
+	ck_assert_int_eq(ut_sample(ut_als, 1)->value, 21);
+	ck_assert_int_eq(ut_sample(ut_als, 2)->value, 0);
+
+	/* Distance is mapped to covered state */
+	ck_assert_int_eq(ut_ps_calls, 1);
+	ck_assert_int_eq(ut_ps->len, 2);
+	ck_assert(ut_sample(ut_ps, 0)->timestamp == 2000);
+	ck_assert_int_eq(ut_sample(ut_ps, 0)->value, 0);
+	ck_assert(ut_sample(ut_ps, 1)->timestamp == 4000);
+	ck_assert_int_eq(ut_sample(ut_ps, 1)->value, 1);
+}
+END_TEST
+
+/* Sensors without events do not get empty batches */
+START_TEST (ut_check_no_empty_batch)
+{
+	evepipe_send_ps(1000, EVEPIPE_PS_COVERED_DISTANCE);
+
+	ck_assert(evepipe_recv_cb(NULL, G_IO_IN, NULL));
+
+	ck_assert_int_eq(ut_ps_calls, 1);
+	ck_assert_int_eq(ut_sample(ut_ps, 0)->value, 1);
+	ck_assert_int_eq(ut_als_calls, 0);
+}
+END_TEST
+
+/* Backlog larger than one read is delivered in read sized batches */
+START_TEST (ut_check_backlog)
+{
+	const guint count = EVEPIPE_READ_MAX + EVEPIPE_READ_MAX / 2;
+
+	for (guint i = 0; i < count; i++)
+		evepipe_send_als(1000 * (int64_t)i, (float)i);
+
+	ck_assert(evepipe_recv_cb(NULL, G_IO_IN, NULL));
+	ck_assert_int_eq(ut_als_calls, 1);
+	ck_assert_int_eq(ut_als->len, EVEPIPE_READ_MAX);
+
+	ck_assert(evepipe_recv_cb(NULL, G_IO_IN, NULL));
+	ck_assert_int_eq(ut_als_calls, 2);
+	ck_assert_int_eq(ut_als->len, count);
+
+	for (guint i = 0; i < count; i++) {
+		ck_assert_int_eq(ut_sample(ut_als, i)->value, i);
+		ck_assert(ut_sample(ut_als, i)->timestamp == i);
+	}
+}
+END_TEST
+
+static Suite *ut_mce_hybris_suite (void)
+{
+	Suite *s = suite_create ("ut_mce_hybris");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_checked_fixture(tc_core, ut_setup, ut_teardown);
+	tcase_add_test (tc_core, ut_check_demux_batches);
+	tcase_add_test (tc_core, ut_check_no_empty_batch);
+	tcase_add_test (tc_core, ut_check_backlog);
+	suite_add_tcase (s, tc_core);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_mce_hybris_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
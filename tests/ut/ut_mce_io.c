@@ -0,0 +1,640 @@
+#include <check.h>
+#include <glib.h>
+#include <fcntl.h>
+#include <linux/input.h>
+
+#include "common.h"
+
+#include "../../mce-io.c"
+
+/* ------------------------------------------------------------------------- *
+ * STUBS
+ * ------------------------------------------------------------------------- */
+
+EXTERN_DUMMY_STUB (
+void, mce_abort, (void));
+
+EXTERN_DUMMY_STUB (
+void, mce_quit_mainloop, (void));
+
+#ifdef ENABLE_WAKELOCKS
+/** Number of wakelock_lock() and wakelock_unlock() calls */
+static guint stub__wakelock_calls[2] = { 0, 0 };
+
+/** Whether the input wakelock is held */
+static gboolean stub__wakelock_held = FALSE;
+
+EXTERN_STUB (
+void, wakelock_lock, (const char *name, long long ns))
+{
+	ck_assert_str_eq(name, "mce_input_handler");
+	ck_assert(ns < 0);
+
+	stub__wakelock_calls[0]++;
+	stub__wakelock_held = TRUE;
+}
+
+EXTERN_STUB (
+void, wakelock_unlock, (const char *name))
+{
+	ck_assert_str_eq(name, "mce_input_handler");
+
+	stub__wakelock_calls[1]++;
+	stub__wakelock_held = FALSE;
+}
+#endif
+
+/** Writes made via pwrite() as "attribute=value" strings, or NULL */
+static GPtrArray *ut_pwrite_log = NULL;
+
+EXTERN_STUB (
+ssize_t, pwrite, (int fd, const void *buf, size_t n, off_t offset))
+{
+	if (ut_pwrite_log) {
+		gchar *link = g_strdup_printf("/proc/self/fd/%d", fd);
+		gchar *path = g_file_read_link(link, NULL);
+		gchar *name = g_path_get_basename(path ?: "?");
+
+		g_ptr_array_add(ut_pwrite_log,
+				g_strdup_printf("%s=%.*s", name, (int)n,
+						(const char *)buf));
+		g_free(name);
+		g_free(path);
+		g_free(link);
+	}
+
+	return pwrite64(fd, buf, n, offset);
+}
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+/** Pipe standing in for an evdev node */
+static int ut_pipe[2] = { -1, -1 };
+
+static gconstpointer ut_iomon = NULL;
+
+/** Number of input events passed to ut_input_cb() */
+static guint ut_events = 0;
+
+/** Value ut_input_cb() returns; TRUE skips rest of the data read */
+static gboolean ut_skip_rest = FALSE;
+
+/** Number of events after which ut_input_cb() unregisters ut_iomon */
+static guint ut_unregister_at = 0;
+
+static gboolean ut_input_cb(gpointer data, gsize bytes_read)
+{
+	(void)data;
+
+	ck_assert_int_eq(bytes_read, sizeof(struct input_event));
+	ut_events++;
+
+	if (ut_events == ut_unregister_at)
+		mce_unregister_io_monitor(ut_iomon), ut_iomon = NULL;
+
+	return ut_skip_rest;
+}
+
+/** Write a burst of input events to the pipe */
+static void ut_replay_events(guint count)
+{
+	struct input_event ev;
+
+	memset(&ev, 0, sizeof ev);
+	ev.type = EV_ABS;
+	ev.code = ABS_MT_POSITION_X;
+
+	for (guint i = 0; i < count; i++) {
+		ev.value = (int)i;
+		ck_assert_int_eq(write(ut_pipe[1], &ev, sizeof ev),
+				 sizeof ev);
+	}
+}
+
+#ifdef ENABLE_WAKELOCKS
+/** Main loop wakeups per burst for releasing the input wakelock */
+# define UT_WAKELOCK_WAKEUPS 1
+#else
+# define UT_WAKELOCK_WAKEUPS 0
+#endif
+
+/** Dispatch the main loop until there is nothing left to do
+ *
+ * @return number of main loop iterations that dispatched something
+ */
+static guint ut_dispatch_all(void)
+{
+	guint wakeups = 0;
+
+	while (g_main_context_iteration(NULL, FALSE))
+		wakeups++;
+
+	return wakeups;
+}
+
+static void ut_setup(void)
+{
+	ck_assert_int_eq(pipe(ut_pipe), 0);
+	ck_assert_int_eq(fcntl(ut_pipe[0], F_SETFL, O_NONBLOCK), 0);
+
+	ut_iomon = mce_register_io_monitor_chunk(ut_pipe[0], "ut_pipe",
+						 MCE_IO_ERROR_POLICY_WARN,
+						 G_IO_IN | G_IO_ERR, FALSE,
+						 ut_input_cb,
+						 sizeof(struct input_event));
+	ck_assert(ut_iomon != NULL);
+
+	ut_events = 0;
+	ut_skip_rest = FALSE;
+	ut_unregister_at = 0;
+}
+
+static void ut_teardown(void)
+{
+	mce_unregister_io_monitor(ut_iomon), ut_iomon = NULL;
+	close(ut_pipe[0]), ut_pipe[0] = -1;
+	close(ut_pipe[1]), ut_pipe[1] = -1;
+}
+
+/** Output used by the number writing tests */
+static output_state_t ut_output;
+
+/** Path to the file behind ut_output */
+static gchar *ut_output_path = NULL;
+
+static void ut_output_setup(void)
+{
+	int fd = g_file_open_tmp("ut_mce_io-XXXXXX", &ut_output_path, NULL);
+
+	ck_assert(fd != -1);
+	close(fd);
+
+	memset(&ut_output, 0, sizeof ut_output);
+	ut_output.context = "ut_output";
+	ut_output.truncate_file = TRUE;
+	ut_output.path = ut_output_path;
+
+	ut_pwrite_log = g_ptr_array_new_with_free_func(g_free);
+}
+
+static void ut_output_teardown(void)
+{
+	g_ptr_array_unref(ut_pwrite_log), ut_pwrite_log = NULL;
+	mce_close_output(&ut_output);
+	g_unlink(ut_output_path);
+	g_free(ut_output_path), ut_output_path = NULL;
+}
+
+/** Get content of the file behind ut_output */
+static gchar *ut_output_content(void)
+{
+	gchar *content = NULL;
+
+	ck_assert(g_file_get_contents(ut_output_path, &content, NULL, NULL));
+
+	return content;
+}
+
+/** Replace content of the file behind ut_output in place */
+static void ut_output_overwrite(const char *content)
+{
+	FILE *file = fopen(ut_output_path, "w");
+
+	ck_assert(file != NULL);
+	fputs(content, file);
+	fclose(file);
+}
+
+/** Write a sequence of numbers to ut_output */
+static void ut_output_write(guint count)
+{
+	for (guint i = 0; i < count; i++)
+		mce_write_number_string_to_file(&ut_output, i);
+}
+
+/** Fake sysfs directory for the attribute writer tests */
+static gchar *ut_sysfs_dir = NULL;
+
+/** Attributes of a fake two engine LED controller */
+static const char *const ut_sysfs_names[] = {
+	"engine1_mode", "engine1_leds", "engine1_load",
+	"engine2_mode", "engine2_leds", "engine2_load",
+};
+
+/** Outputs for ut_sysfs_names attributes, configured like in led.c */
+static output_state_t ut_sysfs_output[G_N_ELEMENTS(ut_sysfs_names)];
+
+static void ut_sysfs_setup(void)
+{
+	ut_sysfs_dir = g_strdup("/tmp/ut_mce_io-XXXXXX");
+	ck_assert(mkdtemp(ut_sysfs_dir) != NULL);
+
+	for (guint i = 0; i < G_N_ELEMENTS(ut_sysfs_names); i++) {
+		output_state_t *output = &ut_sysfs_output[i];
+
+		memset(output, 0, sizeof *output);
+		output->context = ut_sysfs_names[i];
+		output->truncate_file = TRUE;
+		output->use_pwrite = TRUE;
+		output->skip_unchanged = TRUE;
+		output->path = g_build_filename(ut_sysfs_dir,
+						ut_sysfs_names[i], NULL);
+		ck_assert(g_file_set_contents(output->path, "", 0, NULL));
+	}
+
+	ut_pwrite_log = g_ptr_array_new_with_free_func(g_free);
+}
+
+static void ut_sysfs_teardown(void)
+{
+	g_ptr_array_unref(ut_pwrite_log), ut_pwrite_log = NULL;
+
+	for (guint i = 0; i < G_N_ELEMENTS(ut_sysfs_names); i++) {
+		output_state_t *output = &ut_sysfs_output[i];
+
+		mce_close_output(output);
+		g_unlink(output->path);
+		g_free((void *)output->path), output->path = NULL;
+	}
+
+	g_rmdir(ut_sysfs_dir);
+	g_free(ut_sysfs_dir), ut_sysfs_dir = NULL;
+}
+
+/** Check and clear the writes made since the last check
+ *
+ * @param expect expected "attribute=value" strings, NULL terminated
+ */
+static void ut_assert_writes(const char *const *expect)
+{
+	guint i = 0;
+
+	for (; expect[i]; i++) {
+		ck_assert_int_lt(i, ut_pwrite_log->len);
+		ck_assert_str_eq(g_ptr_array_index(ut_pwrite_log, i),
+				 expect[i]);
+	}
+	ck_assert_int_eq(ut_pwrite_log->len, i);
+
+	g_ptr_array_set_size(ut_pwrite_log, 0);
+}
+
+/** Disable the LED engines, like lysti_disable_led() does */
+static void ut_sysfs_disable(void)
+{
+	mce_write_string_to_output(&ut_sysfs_output[0], "disabled");
+	mce_write_string_to_output(&ut_sysfs_output[3], "disabled");
+}
+
+/** Program the LED engines, like lysti_program_led() does
+ *
+ * @return number of attribute writes made
+ */
+static guint ut_sysfs_program(const char *leds, const char *load)
+{
+	mce_output_batch_t *batch = mce_output_batch_create();
+	guint writes = ut_pwrite_log->len;
+
+	mce_output_batch_add(batch, &ut_sysfs_output[0], "load");
+	mce_output_batch_add(batch, &ut_sysfs_output[1], leds);
+	mce_output_batch_add(batch, &ut_sysfs_output[2], load);
+	mce_output_batch_add(batch, &ut_sysfs_output[3], "load");
+	mce_output_batch_add(batch, &ut_sysfs_output[4], "000000011");
+	mce_output_batch_add(batch, &ut_sysfs_output[5], load);
+	mce_output_batch_add(batch, &ut_sysfs_output[3], "run");
+	mce_output_batch_add(batch, &ut_sysfs_output[0], "run");
+
+	if (!mce_output_batch_is_current(batch)) {
+		ut_sysfs_disable();
+		ck_assert(mce_output_batch_commit(batch));
+	}
+
+	mce_output_batch_delete(batch);
+
+	return ut_pwrite_log->len - writes;
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+START_TEST (ut_check_buffer_reuse)
+{
+	const iomon_struct *iomon = ut_iomon;
+	const gchar *buffer = iomon->chunk_buffer;
+
+	ck_assert(buffer != NULL);
+	ck_assert_int_eq(iomon->chunk_buffer_size %
+			 sizeof(struct input_event), 0);
+
+	ut_replay_events(8);
+	ut_dispatch_all();
+	ut_replay_events(8);
+	ut_dispatch_all();
+
+	ck_assert_int_eq(ut_events, 16);
+	ck_assert(iomon->chunk_buffer == buffer);
+}
+END_TEST
+
+START_TEST (ut_check_skip_rest)
+{
+	ut_skip_rest = TRUE;
+	mce_set_io_monitor_drain(ut_iomon, TRUE);
+
+	/* The rest of the data read is ignored and draining stops */
+	ut_replay_events(4);
+	ut_dispatch_all();
+	ck_assert_int_eq(ut_events, 1);
+}
+END_TEST
+
+/* A burst of input events larger than the read buffer is processed
+ * with one main loop wakeup when draining is enabled */
+START_TEST (ut_check_drain)
+{
+	const iomon_struct *iomon = ut_iomon;
+	const guint burst = 1024;
+	guint wakeups[2] = { 0, 0 };
+
+	ck_assert(burst * sizeof(struct input_event) >
+		  iomon->chunk_buffer_size);
+
+	for (int drain = 0; drain < 2; drain++) {
+		mce_set_io_monitor_drain(ut_iomon, drain);
+		ut_events = 0;
+
+		ut_replay_events(burst);
+		wakeups[drain] = ut_dispatch_all();
+
+		ck_assert_int_eq(ut_events, burst);
+	}
+
+	ck_assert_int_eq(wakeups[1], 1 + UT_WAKELOCK_WAKEUPS);
+	ck_assert_int_lt(wakeups[1], wakeups[0]);
+}
+END_TEST
+
+/* Unregistering from a callback stops processing of the data read */
+START_TEST (ut_check_unregister_from_cb)
+{
+	ut_unregister_at = 3;
+	mce_set_io_monitor_drain(ut_iomon, TRUE);
+
+	ut_replay_events(1024);
+	ut_dispatch_all();
+
+	ck_assert(ut_iomon == NULL);
+	ck_assert_int_eq(ut_events, 3);
+	ck_assert(file_monitors == NULL);
+}
+END_TEST
+
+#ifdef ENABLE_WAKELOCKS
+/* The input wakelock is held over a burst of wakeups and released
+ * only once the main loop goes idle */
+START_TEST (ut_check_wakelock_burst)
+{
+	guint wakeups;
+
+	stub__wakelock_calls[0] = stub__wakelock_calls[1] = 0;
+
+	ut_replay_events(1024);
+	wakeups = ut_dispatch_all();
+
+	ck_assert_int_eq(ut_events, 1024);
+	ck_assert_int_gt(stub__wakelock_calls[0], 1);
+	ck_assert_int_eq(stub__wakelock_calls[1], 1);
+	ck_assert(!stub__wakelock_held);
+	ck_assert_int_eq(wakeups,
+			 stub__wakelock_calls[0] + UT_WAKELOCK_WAKEUPS);
+
+	ut_replay_events(1);
+	g_main_context_iteration(NULL, FALSE);
+	ck_assert(stub__wakelock_held);
+	ut_dispatch_all();
+	ck_assert(!stub__wakelock_held);
+	ck_assert_int_eq(stub__wakelock_calls[1], 2);
+}
+END_TEST
+#endif
+
+START_TEST (ut_check_output_pwrite)
+{
+	gchar *content;
+
+	ut_output.use_pwrite = TRUE;
+
+	/* Values replace each other instead of getting appended */
+	ck_assert(mce_write_number_string_to_file(&ut_output, 100));
+	ck_assert(mce_write_number_string_to_file(&ut_output, 200));
+	ck_assert(ut_output.fd_open);
+
+	content = ut_output_content();
+	ck_assert_str_eq(content, "200");
+	g_free(content);
+
+	mce_close_output(&ut_output);
+	ck_assert(!ut_output.fd_open);
+	ck_assert(!ut_output.value_cached);
+}
+END_TEST
+
+START_TEST (ut_check_output_skip_unchanged)
+{
+	gchar *content;
+
+	ut_output.use_pwrite = TRUE;
+	ut_output.skip_unchanged = TRUE;
+
+	ck_assert(mce_write_number_string_to_file(&ut_output, 42));
+
+	/* Unchanged value is not written again ... */
+	ut_output_overwrite("x");
+	ck_assert(mce_write_number_string_to_file(&ut_output, 42));
+	content = ut_output_content();
+	ck_assert_str_eq(content, "x");
+	g_free(content);
+
+	/* ... unless the output has been closed in between */
+	mce_close_output(&ut_output);
+	ck_assert(mce_write_number_string_to_file(&ut_output, 42));
+	content = ut_output_content();
+	ck_assert_str_eq(content, "42");
+	g_free(content);
+}
+END_TEST
+
+/* In pwrite mode each value is written with one pwrite() call, and
+ * unchanged values are not written at all */
+START_TEST (ut_check_output_writes)
+{
+	gchar *name = g_path_get_basename(ut_output_path);
+	gchar *expect[] = {
+		g_strdup_printf("%s=0", name),
+		g_strdup_printf("%s=1", name),
+		g_strdup_printf("%s=2", name),
+		NULL
+	};
+
+	ut_output.use_pwrite = TRUE;
+	ut_output.skip_unchanged = TRUE;
+
+	ut_output_write(3);
+	ck_assert(mce_write_number_string_to_file(&ut_output, 2));
+	ut_assert_writes((const char *const *)expect);
+
+	for (guint i = 0; expect[i]; i++)
+		g_free(expect[i]);
+	g_free(name);
+}
+END_TEST
+
+/* Attributes are kept open and unchanged values are not rewritten */
+START_TEST (ut_check_sysfs_write)
+{
+	output_state_t *output = &ut_sysfs_output[0];
+	const char *path = output->path;
+	int fd;
+
+	ck_assert(mce_write_string_to_output(output, "disabled"));
+	fd = output->fd;
+	ck_assert(mce_write_string_to_output(output, "disabled"));
+	ck_assert(mce_write_string_to_output(output, "run"));
+	ck_assert(output->fd_open);
+	ck_assert_int_eq(output->fd, fd);
+
+	ut_assert_writes((const char *const []) {
+		"engine1_mode=disabled",
+		"engine1_mode=run",
+		NULL
+	});
+
+	/* Failed writes are not cached and are retried */
+	output->path = "/nonexistent/engine1_mode";
+	mce_close_output(output);
+	ck_assert(!mce_write_string_to_output(output, "run"));
+	ck_assert(!output->value_cached);
+	ck_assert(!mce_write_string_to_output(output, "run"));
+	ck_assert(!output->fd_open);
+	output->path = path;
+}
+END_TEST
+
+/* Engine attributes are written only when their values change */
+START_TEST (ut_check_sysfs_program)
+{
+	static const char *const load_a = "000140ff7f0040000000";
+	static const char *const load_b = "0001407f7f0040000000";
+
+	/* The first activation writes everything */
+	ck_assert_int_eq(ut_sysfs_program("000000100", load_a), 10);
+	ut_assert_writes((const char *const []) {
+		"engine1_mode=disabled",
+		"engine2_mode=disabled",
+		"engine1_mode=load",
+		"engine1_leds=000000100",
+		"engine1_load=000140ff7f0040000000",
+		"engine2_mode=load",
+		"engine2_leds=000000011",
+		"engine2_load=000140ff7f0040000000",
+		"engine2_mode=run",
+		"engine1_mode=run",
+		NULL
+	});
+
+	/* Reactivating the running pattern writes nothing */
+	ck_assert_int_eq(ut_sysfs_program("000000100", load_a), 0);
+
+	/* Switching the program rewrites only the load attributes */
+	ck_assert_int_eq(ut_sysfs_program("000000100", load_b), 8);
+	ut_assert_writes((const char *const []) {
+		"engine1_mode=disabled",
+		"engine2_mode=disabled",
+		"engine1_mode=load",
+		"engine1_load=0001407f7f0040000000",
+		"engine2_mode=load",
+		"engine2_load=0001407f7f0040000000",
+		"engine2_mode=run",
+		"engine1_mode=run",
+		NULL
+	});
+
+	/* Switching the leds rewrites only the leds attribute */
+	ck_assert_int_eq(ut_sysfs_program("000000010", load_b), 7);
+	g_ptr_array_set_size(ut_pwrite_log, 0);
+
+	/* Disabling already disabled engines writes nothing */
+	ut_sysfs_disable();
+	ut_assert_writes((const char *const []) {
+		"engine1_mode=disabled",
+		"engine2_mode=disabled",
+		NULL
+	});
+	ut_sysfs_disable();
+	ut_assert_writes((const char *const []) { NULL });
+
+	/* Reactivating a disabled pattern only steps the engine modes */
+	ck_assert_int_eq(ut_sysfs_program("000000010", load_b), 4);
+	ut_assert_writes((const char *const []) {
+		"engine1_mode=load",
+		"engine2_mode=load",
+		"engine2_mode=run",
+		"engine1_mode=run",
+		NULL
+	});
+
+	/* All attributes are kept open */
+	for (guint i = 0; i < G_N_ELEMENTS(ut_sysfs_names); i++)
+		ck_assert(ut_sysfs_output[i].fd_open);
+}
+END_TEST
+
+static Suite *ut_mce_io_suite (void)
+{
+	Suite *s = suite_create ("ut_mce_io");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_checked_fixture(tc_core, ut_setup, ut_teardown);
+	tcase_add_test (tc_core, ut_check_buffer_reuse);
+	tcase_add_test (tc_core, ut_check_skip_rest);
+	tcase_add_test (tc_core, ut_check_drain);
+	tcase_add_test (tc_core, ut_check_unregister_from_cb);
+#ifdef ENABLE_WAKELOCKS
+	tcase_add_test (tc_core, ut_check_wakelock_burst);
+#endif
+	suite_add_tcase (s, tc_core);
+
+	TCase *tc_output = tcase_create ("output");
+	tcase_add_checked_fixture(tc_output, ut_output_setup,
+				  ut_output_teardown);
+	tcase_add_test (tc_output, ut_check_output_pwrite);
+	tcase_add_test (tc_output, ut_check_output_skip_unchanged);
+	tcase_add_test (tc_output, ut_check_output_writes);
+	suite_add_tcase (s, tc_output);
+
+	TCase *tc_sysfs = tcase_create ("sysfs");
+	tcase_add_checked_fixture(tc_sysfs, ut_sysfs_setup,
+				  ut_sysfs_teardown);
+	tcase_add_test (tc_sysfs, ut_check_sysfs_write);
+	tcase_add_test (tc_sysfs, ut_check_sysfs_program);
+	suite_add_tcase (s, tc_sysfs);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_mce_io_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
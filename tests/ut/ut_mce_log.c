@@ -0,0 +1,136 @@
+#include <check.h>
+#include <glib.h>
+
+/* The real logging code is under test here */
+#define UT_REAL_MCE_LOG
+#include "common.h"
+
+#include "../../mce-log.c"
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+static void ut_trace(long i)
+{
+	mce_trace(LL_DEBUG, "i=%ld %s", i, (i & 1) ? "odd" : "even");
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+START_TEST (ut_check_recorder_disabled)
+{
+	ck_assert(!mce_log_recorder_p());
+	ck_assert(mce_log_recorder_to_string() == NULL);
+
+	/* Falls back to normal logging, which is filtered by verbosity */
+	ut_trace(0);
+	ck_assert_int_eq(recorder_head, 0);
+}
+END_TEST
+
+START_TEST (ut_check_recorder_ring)
+{
+	const long count = MCE_LOG_RECORDER_SIZE + 10;
+	gchar *text = NULL;
+	gchar **lines = NULL;
+	guint n;
+
+	mce_log_recorder_enable();
+	ck_assert(mce_log_recorder_p());
+
+	for (long i = 0; i < count; i++)
+		ut_trace(i);
+
+	/* Only the newest entries are kept, listed oldest first */
+	text = mce_log_recorder_to_string();
+	ck_assert(text != NULL);
+	lines = g_strsplit(text, "\n", 0);
+	n = g_strv_length(lines);
+
+	ck_assert_int_eq(n, MCE_LOG_RECORDER_SIZE + 1);
+	ck_assert_str_eq(lines[n - 1], "");
+	ck_assert(g_str_has_suffix(lines[0], "ut_trace(): i=10 even"));
+	ck_assert(g_str_has_suffix(lines[n - 2], "ut_trace(): i=4105 odd"));
+	ck_assert(strstr(lines[0], " D: ") != NULL);
+
+	g_strfreev(lines);
+	g_free(text);
+}
+END_TEST
+
+/* Stored arguments are formatted with their original types */
+START_TEST (ut_check_recorder_arg_types)
+{
+	int value = -1;
+	gchar *text = NULL;
+
+	mce_log_recorder_enable();
+	mce_trace(LL_DEBUG, "%d%%/%5u/%x/%s", value, 7u, value, "str");
+	mce_trace(LL_DEBUG, "%c/%-3ld/%lu/%p", 'A', -2L, 3UL, NULL);
+
+	text = mce_log_recorder_to_string();
+	ck_assert(text != NULL);
+	ck_assert(strstr(text, "(): -1%/    7/ffffffff/str\n") != NULL);
+	ck_assert(g_str_has_suffix(text, "(): A/-2 /3/(nil)\n"));
+	g_free(text);
+}
+END_TEST
+
+/* Cost of storing one entry in the flight recorder */
+START_TEST (ut_check_recorder_benchmark)
+{
+	const long rounds = 1000000;
+	gint64 t0, t1;
+	double cost;
+
+	mce_log_recorder_enable();
+
+	t0 = ut_get_nsec();
+	for (long i = 0; i < rounds; i++)
+		ut_trace(i);
+	t1 = ut_get_nsec();
+
+	cost = (double)(t1 - t0) / rounds;
+	ck_assert_msg(cost < 1000, "tracing costs %.1f ns/trace", cost);
+}
+END_TEST
+
+static Suite *ut_mce_log_suite (void)
+{
+	Suite *s = suite_create ("ut_mce_log");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_test (tc_core, ut_check_recorder_disabled);
+	tcase_add_test (tc_core, ut_check_recorder_ring);
+	tcase_add_test (tc_core, ut_check_recorder_arg_types);
+	suite_add_tcase (s, tc_core);
+
+	if (ut_benchmarks_enabled()) {
+		TCase *tc_bench = tcase_create ("benchmark");
+		tcase_set_timeout(tc_bench, 60);
+		tcase_add_test (tc_bench, ut_check_recorder_benchmark);
+		suite_add_tcase (s, tc_bench);
+	}
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	mce_log_open("ut_mce_log", LOG_USER, MCE_LOG_STDERR);
+
+	int number_failed;
+	Suite *s = ut_mce_log_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	mce_log_close();
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,175 @@
+#include <check.h>
+#include <glib.h>
+
+#include "common.h"
+
+#include "../../mce-modules.c"
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+static const gchar *const ut_provides_a[] = { "a", NULL };
+static const gchar *const ut_provides_b[] = { "b", NULL };
+static const gchar *const ut_provides_c[] = { "c", "c-alias", NULL };
+
+static const gchar *const ut_depends_b[] = { "b", "tklock", NULL };
+static const gchar *const ut_depends_c[] = { "c-alias", NULL };
+static const gchar *const ut_depends_a[] = { "a", NULL };
+
+/** Module a, depends on b and core functionality */
+static module_info_struct ut_info_a = {
+	.name = "a", .depends = ut_depends_b, .provides = ut_provides_a,
+};
+
+/** Module b, depends on c */
+static module_info_struct ut_info_b = {
+	.name = "b", .depends = ut_depends_c, .provides = ut_provides_b,
+};
+
+/** Module c, no dependencies */
+static module_info_struct ut_info_c = {
+	.name = "c", .provides = ut_provides_c,
+};
+
+/** Module c, depends on a making a cycle */
+static module_info_struct ut_info_c_cyclic = {
+	.name = "c", .depends = ut_depends_a, .provides = ut_provides_c,
+};
+
+/** Set up load_list as if modules had been prefetched
+ *
+ * @param info module information for each module, NULL terminated
+ */
+static void ut_setup_load_list(const module_info_struct **info)
+{
+	load_count = 0;
+	while( info[load_count] )
+		load_count++;
+
+	load_list = g_new0(mce_module_load_t, load_count + 1);
+
+	for( guint i = 0; i < load_count; ++i ) {
+		load_list[i].name = g_strdup(info[i]->name);
+		load_list[i].path = g_strdup(info[i]->name);
+		load_list[i].info = info[i];
+	}
+}
+
+/** Run the init ordering and return module names in init order
+ *
+ * @return order string; release with g_free()
+ */
+static gchar *ut_init_order(void)
+{
+	GString *order = g_string_new("");
+	mce_module_load_t *load;
+
+	while( (load = mce_modules_next()) ) {
+		load->done = TRUE;
+		g_string_append(order, load->name);
+	}
+
+	return g_string_free(order, FALSE);
+}
+
+static void ut_teardown(void)
+{
+	mce_modules_prefetch_quit();
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+/* Modules are initialized after the modules they depend on */
+START_TEST (ut_check_dependency_order)
+{
+	const module_info_struct *info[] = {
+		&ut_info_a, &ut_info_b, &ut_info_c, NULL
+	};
+	gchar *order;
+
+	ut_setup_load_list(info);
+	order = ut_init_order();
+	ck_assert_str_eq(order, "cba");
+	g_free(order);
+}
+END_TEST
+
+/* Configuration order is kept when there are no dependencies */
+START_TEST (ut_check_config_order)
+{
+	const module_info_struct *info[] = {
+		&ut_info_c, &ut_info_b, &ut_info_a, NULL
+	};
+	gchar *order;
+
+	ut_setup_load_list(info);
+	order = ut_init_order();
+	ck_assert_str_eq(order, "cba");
+	g_free(order);
+}
+END_TEST
+
+/* Modules without information and failed modules do not block others */
+START_TEST (ut_check_missing_info)
+{
+	const module_info_struct *info[] = {
+		&ut_info_b, &ut_info_c, NULL
+	};
+	gchar *order;
+
+	ut_setup_load_list(info);
+	load_list[1].info = NULL;
+	order = ut_init_order();
+	ck_assert_str_eq(order, "bc");
+	g_free(order);
+}
+END_TEST
+
+/* Circular dependencies do not prevent loading */
+START_TEST (ut_check_cycle)
+{
+	const module_info_struct *info[] = {
+		&ut_info_a, &ut_info_b, &ut_info_c_cyclic, NULL
+	};
+	gchar *order;
+
+	ut_setup_load_list(info);
+	order = ut_init_order();
+	ck_assert_int_eq(strlen(order), 3);
+	ck_assert(strchr(order, 'a') && strchr(order, 'b') &&
+		  strchr(order, 'c'));
+	g_free(order);
+}
+END_TEST
+
+static Suite *ut_mce_modules_suite (void)
+{
+	Suite *s = suite_create ("ut_mce_modules");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_checked_fixture(tc_core, NULL, ut_teardown);
+	tcase_add_test (tc_core, ut_check_dependency_order);
+	tcase_add_test (tc_core, ut_check_config_order);
+	tcase_add_test (tc_core, ut_check_missing_info);
+	tcase_add_test (tc_core, ut_check_cycle);
+	suite_add_tcase (s, tc_core);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_mce_modules_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
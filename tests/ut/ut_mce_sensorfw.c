@@ -0,0 +1,310 @@
+#include <check.h>
+#include <glib.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+
+#include "common.h"
+
+#include "../../mce-sensorfw.c"
+
+/* ------------------------------------------------------------------------- *
+ * STUBS
+ * ------------------------------------------------------------------------- */
+
+EXTERN_DUMMY_STUB (
+DBusConnection *, dbus_connection_get, (void));
+
+/** Number of setInterval calls made via dbus_send() */
+static guint stub__set_interval_calls = 0;
+
+/** Interval passed in the latest setInterval call */
+static dbus_int32_t stub__set_interval_value = -1;
+
+EXTERN_STUB (
+gboolean, dbus_send, (const gchar *const service, const gchar *const path,
+		      const gchar *const interface, const gchar *const name,
+		      DBusPendingCallNotifyFunction callback,
+		      int first_arg_type, ...))
+{
+	(void)service;
+	(void)path;
+	(void)interface;
+	(void)callback;
+
+	va_list va;
+
+	/* Only setInterval is expected; args: INT32 sid, INT32 interval */
+	ck_assert_str_eq(name, "setInterval");
+	ck_assert_int_eq(first_arg_type, DBUS_TYPE_INT32);
+
+	va_start(va, first_arg_type);
+	(void)va_arg(va, dbus_int32_t *);
+	ck_assert_int_eq(va_arg(va, int), DBUS_TYPE_INT32);
+	stub__set_interval_value = *va_arg(va, dbus_int32_t *);
+	va_end(va);
+
+	stub__set_interval_calls++;
+
+	return TRUE;
+}
+
+EXTERN_DUMMY_STUB (
+DBusMessage *, dbus_send_with_block, (const gchar *const service,
+				      const gchar *const path,
+				      const gchar *const interface,
+				      const gchar *const name,
+				      gint timeout, int first_arg_type, ...));
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+/** Socket pair standing in for sensord data channel; [1] is sensord end */
+static int ut_sock[2] = { -1, -1 };
+
+/** Number of ut_send_* calls made so far; used for generating samples */
+static guint ut_sent = 0;
+
+/** Samples passed to ut_batch_cb() */
+static GArray *ut_batches = NULL;
+
+/** Number of ut_batch_cb() calls */
+static guint ut_batch_calls = 0;
+
+static void ut_batch_cb(const mce_sensor_sample_t *samples, unsigned count)
+{
+	g_array_append_vals(ut_batches, samples, count);
+	ut_batch_calls++;
+}
+
+/** Build a sensord ALS data block with count samples
+ *
+ * @return block data; release with g_byte_array_unref()
+ */
+static GByteArray *ut_build_als_block(uint32_t count)
+{
+	GByteArray *block = g_byte_array_new();
+
+	g_byte_array_append(block, (const guint8 *)&count, sizeof count);
+
+	for (uint32_t i = 0; i < count; i++, ut_sent++) {
+		als_data_t data;
+
+		memset(&data, 0, sizeof data);
+		data.timestamp = 1000 * (uint64_t)ut_sent;
+		data.value = ut_sent;
+		g_byte_array_append(block, (const guint8 *)&data, sizeof data);
+	}
+
+	return block;
+}
+
+static void ut_send(const guint8 *data, size_t size)
+{
+	ck_assert_int_eq(write(ut_sock[1], data, size), size);
+}
+
+/** Check that samples [first, first + count) have been received */
+static void ut_assert_samples(guint first, guint count)
+{
+	ck_assert_int_eq(ut_batches->len, first + count);
+
+	for (guint i = first; i < first + count; i++) {
+		const mce_sensor_sample_t *sample =
+			&g_array_index(ut_batches, mce_sensor_sample_t, i);
+
+		ck_assert_int_eq(sample->value, i);
+		ck_assert(sample->timestamp == 1000 * (uint64_t)i);
+	}
+}
+
+/** Run ALS input callback once */
+static gboolean ut_als_input(void)
+{
+	GIOChannel *chn = g_io_channel_unix_new(ut_sock[0]);
+	gboolean res = als_input_cb(chn, G_IO_IN, NULL);
+
+	g_io_channel_unref(chn);
+
+	return res;
+}
+
+static void ut_setup(void)
+{
+	ck_assert_int_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, ut_sock), 0);
+
+	ut_sent = 0;
+	ut_batches = g_array_new(FALSE, FALSE, sizeof(mce_sensor_sample_t));
+	ut_batch_calls = 0;
+
+	stub__set_interval_calls = 0;
+	stub__set_interval_value = -1;
+
+	sfw_reader_reset(&als_reader);
+	mce_sensorfw_als_set_batch_notify(ut_batch_cb);
+}
+
+static void ut_teardown(void)
+{
+	mce_sensorfw_als_set_batch_notify(0);
+	sfw_reader_free(&als_reader);
+
+	g_array_free(ut_batches, TRUE), ut_batches = NULL;
+	close(ut_sock[0]), ut_sock[0] = -1;
+	close(ut_sock[1]), ut_sock[1] = -1;
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+/* Queued blocks are read and delivered as one batch */
+START_TEST (ut_check_backlog_batch)
+{
+	for (int i = 0; i < 4; i++) {
+		GByteArray *block = ut_build_als_block(10);
+		ut_send(block->data, block->len);
+		g_byte_array_unref(block);
+	}
+
+	ck_assert(ut_als_input());
+	ck_assert_int_eq(ut_batch_calls, 1);
+	ut_assert_samples(0, 40);
+}
+END_TEST
+
+/* Partial blocks are carried over to the next callback */
+START_TEST (ut_check_partial_block)
+{
+	GByteArray *block = ut_build_als_block(3);
+	const size_t cut[] = { 2, sizeof(uint32_t) + sizeof(als_data_t) / 2,
+			       block->len };
+	size_t done = 0;
+
+	for (guint i = 0; i < G_N_ELEMENTS(cut); i++) {
+		ut_send(block->data + done, cut[i] - done);
+		done = cut[i];
+
+		ck_assert(ut_als_input());
+		ck_assert_int_eq(ut_batch_calls,
+				 i + 1 < G_N_ELEMENTS(cut) ? 0 : 1);
+	}
+	g_byte_array_unref(block);
+
+	ut_assert_samples(0, 3);
+	ck_assert_int_eq(als_reader.used, 0);
+}
+END_TEST
+
+/* Buffer grows to fit a backlog larger than the initial size and
+ * is then reused */
+START_TEST (ut_check_large_backlog)
+{
+	const uint32_t count = 4 * SFW_READER_BUFFER_SIZE / sizeof(als_data_t);
+	GByteArray *block;
+	char *buffer;
+
+	block = ut_build_als_block(count);
+	ut_send(block->data, block->len);
+	g_byte_array_unref(block);
+
+	/* Partial read, buffer is then sized for the whole block */
+	ck_assert(ut_als_input());
+	ck_assert_int_eq(ut_batch_calls, 0);
+	ck_assert(ut_als_input());
+	ck_assert_int_eq(ut_batch_calls, 1);
+	ut_assert_samples(0, count);
+
+	buffer = als_reader.data;
+
+	block = ut_build_als_block(count);
+	ut_send(block->data, block->len);
+	g_byte_array_unref(block);
+
+	ck_assert(ut_als_input());
+	ck_assert_int_eq(ut_batch_calls, 2);
+	ut_assert_samples(0, 2 * count);
+	ck_assert(als_reader.data == buffer);
+}
+END_TEST
+
+/* Bogus sample count closes the data channel */
+START_TEST (ut_check_out_of_sync)
+{
+	uint32_t count = SFW_READER_SAMPLES_MAX + 1;
+
+	ut_send((const guint8 *)&count, sizeof count);
+	ck_assert(!ut_als_input());
+	ck_assert_int_eq(ut_batch_calls, 0);
+}
+END_TEST
+
+/* Interval changes are sent to running sensor only, without duplicates,
+ * and are applied when the sensor gets started */
+START_TEST (ut_check_set_interval)
+{
+	sensord_running = true;
+	als_have = false;
+	als_interval_have = 0;
+
+	mce_sensorfw_als_set_interval(1000);
+	ck_assert_int_eq(stub__set_interval_calls, 0);
+
+	/* What mce_sensorfw_als_rethink() does after starting the sensor */
+	als_have = true;
+	mce_sensorfw_als_rethink_interval();
+	ck_assert_int_eq(stub__set_interval_calls, 1);
+	ck_assert_int_eq(stub__set_interval_value, 1000);
+
+	mce_sensorfw_als_set_interval(1000);
+	ck_assert_int_eq(stub__set_interval_calls, 1);
+
+	mce_sensorfw_als_set_interval(100);
+	ck_assert_int_eq(stub__set_interval_calls, 2);
+	ck_assert_int_eq(stub__set_interval_value, 100);
+
+	/* New session starts with sensord default interval */
+	als_have = false;
+	als_interval_have = 0;
+	mce_sensorfw_als_set_interval(0);
+	ck_assert_int_eq(stub__set_interval_calls, 2);
+
+	als_have = true;
+	mce_sensorfw_als_rethink_interval();
+	ck_assert_int_eq(stub__set_interval_calls, 2);
+
+	als_have = false;
+	sensord_running = false;
+	als_interval_want = 0;
+}
+END_TEST
+
+static Suite *ut_mce_sensorfw_suite (void)
+{
+	Suite *s = suite_create ("ut_mce_sensorfw");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_checked_fixture(tc_core, ut_setup, ut_teardown);
+	tcase_add_test (tc_core, ut_check_backlog_batch);
+	tcase_add_test (tc_core, ut_check_partial_block);
+	tcase_add_test (tc_core, ut_check_large_backlog);
+	tcase_add_test (tc_core, ut_check_out_of_sync);
+	tcase_add_test (tc_core, ut_check_set_interval);
+	suite_add_tcase (s, tc_core);
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_mce_sensorfw_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
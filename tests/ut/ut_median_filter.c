@@ -0,0 +1,228 @@
+#include <check.h>
+#include <glib.h>
+
+#include "common.h"
+
+#include "../../median_filter.c"
+
+/* ------------------------------------------------------------------------- *
+ * HELPERS
+ * ------------------------------------------------------------------------- */
+
+static gint ut_compare_int(gconstpointer a, gconstpointer b)
+{
+	gint x = *(const gint *)a;
+	gint y = *(const gint *)b;
+
+	return (x > y) - (x < y);
+}
+
+/** Median of the newest window_size values, computed by sorting */
+static gint ut_reference_median(const gint *values, gsize count,
+				gsize window_size)
+{
+	gsize n = MIN(count, window_size);
+	gint *sorted = g_memdup(values + count - n, n * sizeof *values);
+	gint res;
+
+	qsort(sorted, n, sizeof *sorted, ut_compare_int);
+	res = (sorted[(n - 1) / 2] + sorted[n / 2]) / 2;
+	g_free(sorted);
+
+	return res;
+}
+
+/** Initialise filter, using heaps regardless of the window size */
+static void ut_init_heap(median_filter_struct *filter, gsize window_size)
+{
+	ck_assert(median_filter_init(filter, window_size));
+	if (filter->values == NULL)
+		median_filter_init_heap(filter, window_size);
+}
+
+/** Feed random values to filter and compare against the reference
+ *
+ * @param filter initialised filter
+ * @param range values are picked from [0, range)
+ */
+static void ut_check_against_reference(median_filter_struct *filter,
+				       gint range)
+{
+	const gsize count = 4 * filter->window_size + 10;
+	gint *values = g_new(gint, count);
+
+	for (gsize i = 0; i < count; i++) {
+		values[i] = g_random_int_range(0, range);
+		ck_assert_int_eq(median_filter_map(filter, values[i]),
+				 ut_reference_median(values, i + 1,
+						     filter->window_size));
+	}
+
+	g_free(values);
+}
+
+/** Measure average cost of filtering one sample
+ *
+ * @param filter initialised filter
+ * @param rounds number of samples to time
+ *
+ * @return nanoseconds per sample
+ */
+static double ut_bench_map(median_filter_struct *filter, guint rounds)
+{
+	gint64 t0, t1;
+	gint sink = 0;
+
+	for (gsize i = 0; i < filter->window_size; i++)
+		sink += median_filter_map(filter, g_random_int_range(0, 1000));
+
+	t0 = ut_get_nsec();
+	for (guint i = 0; i < rounds; i++)
+		sink += median_filter_map(filter, (gint)((i * 7919u) % 1000));
+	t1 = ut_get_nsec();
+
+	/* Keep the compiler from dropping the loop */
+	ck_assert(sink != G_MININT);
+
+	return (double)(t1 - t0) / rounds;
+}
+
+/* ------------------------------------------------------------------------- *
+ * TESTS
+ * ------------------------------------------------------------------------- */
+
+START_TEST (ut_check_init)
+{
+	median_filter_struct filter;
+
+	ck_assert(!median_filter_init(NULL, 5));
+	ck_assert(!median_filter_init(&filter, 0));
+
+	ck_assert(median_filter_init(&filter, MEDIAN_FILTER_MAX_WINDOW_SIZE));
+	ck_assert(filter.values == NULL);
+	median_filter_free(&filter);
+
+	ck_assert(median_filter_init(&filter,
+				     MEDIAN_FILTER_MAX_WINDOW_SIZE + 1));
+	ck_assert(filter.values != NULL);
+	median_filter_free(&filter);
+	ck_assert(filter.values == NULL);
+}
+END_TEST
+
+START_TEST (ut_check_sorted_array)
+{
+	median_filter_struct filter;
+
+	for (gsize size = 1; size <= MEDIAN_FILTER_MAX_WINDOW_SIZE; size++) {
+		ck_assert(median_filter_init(&filter, size));
+		ut_check_against_reference(&filter, 100);
+		median_filter_free(&filter);
+	}
+}
+END_TEST
+
+START_TEST (ut_check_heap)
+{
+	static const gsize sizes[] = { 1, 2, 3, 4, 5, 11, 12, 64, 257 };
+	median_filter_struct filter;
+
+	for (guint i = 0; i < G_N_ELEMENTS(sizes); i++) {
+		ut_init_heap(&filter, sizes[i]);
+		ut_check_against_reference(&filter, 1000);
+		median_filter_free(&filter);
+
+		/* Lots of duplicate values */
+		ut_init_heap(&filter, sizes[i]);
+		ut_check_against_reference(&filter, 3);
+		median_filter_free(&filter);
+	}
+}
+END_TEST
+
+/* Compare the sorted array and the heap variants for every window size
+ * the sorted array supports; as the array shifts O(n) and the heaps
+ * O(log n) values per sample, the heaps must gain on the array as the
+ * window grows. Beyond that only heaps are available, and their cost
+ * must grow roughly logarithmically. */
+START_TEST (ut_check_benchmark)
+{
+	static const gsize large[] = { 101, 1001 };
+	const guint rounds = 200000;
+	const gsize max = MEDIAN_FILTER_MAX_WINDOW_SIZE;
+	median_filter_struct filter;
+	double sorted[MEDIAN_FILTER_MAX_WINDOW_SIZE + 1];
+	double heap[MEDIAN_FILTER_MAX_WINDOW_SIZE + 1];
+	double small[2] = { 0, 0 };
+	double big[2] = { 0, 0 };
+	double cost;
+
+	for (gsize size = 1; size <= max; size++) {
+		ck_assert(median_filter_init(&filter, size));
+		sorted[size] = ut_bench_map(&filter, rounds);
+		median_filter_free(&filter);
+
+		ut_init_heap(&filter, size);
+		heap[size] = ut_bench_map(&filter, rounds);
+		median_filter_free(&filter);
+	}
+
+	/* Sum up a few sizes at both ends to even out timing noise */
+	for (gsize size = 2; size <= 4; size++) {
+		small[0] += sorted[size], small[1] += heap[size];
+		big[0] += sorted[max + 2 - size], big[1] += heap[max + 2 - size];
+	}
+
+	ck_assert_msg(big[1] / big[0] < small[1] / small[0],
+		      "heap/sorted cost: %.1f/%.1f ns at windows %u-%u, "
+		      "%.1f/%.1f ns at windows 2-4",
+		      big[1], big[0], (unsigned)max - 2, (unsigned)max,
+		      small[1], small[0]);
+
+	for (guint i = 0; i < G_N_ELEMENTS(large); i++) {
+		ut_init_heap(&filter, large[i]);
+		cost = ut_bench_map(&filter, rounds);
+		median_filter_free(&filter);
+
+		ck_assert_msg(cost < heap[max] * 8,
+			      "heap cost %.1f ns at window %u, "
+			      "%.1f ns at window %u",
+			      cost, (unsigned)large[i],
+			      heap[max], (unsigned)max);
+	}
+}
+END_TEST
+
+static Suite *ut_median_filter_suite (void)
+{
+	Suite *s = suite_create ("ut_median_filter");
+
+	TCase *tc_core = tcase_create ("core");
+	tcase_add_test (tc_core, ut_check_init);
+	tcase_add_test (tc_core, ut_check_sorted_array);
+	tcase_add_test (tc_core, ut_check_heap);
+	suite_add_tcase (s, tc_core);
+
+	if (ut_benchmarks_enabled()) {
+		TCase *tc_bench = tcase_create ("benchmark");
+		tcase_set_timeout(tc_bench, 60);
+		tcase_add_test (tc_bench, ut_check_benchmark);
+		suite_add_tcase (s, tc_bench);
+	}
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+
+	int number_failed;
+	Suite *s = ut_median_filter_suite ();
+	SRunner *sr = srunner_create (s);
+	srunner_run_all (sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
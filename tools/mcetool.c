@@ -58,6 +58,12 @@
 /** Define set config DBUS method */
 #define MCE_DBUS_SET_CONFIG_REQ                 "set_config"
 
+/** Define dump trace DBUS method */
+#define MCE_DBUS_DUMP_TRACE_REQ                 "dump_trace"
+
+/** Define get datapipe statistics DBUS method */
+#define MCE_DBUS_GET_DATAPIPE_STATS_REQ         "get_datapipe_stats"
+
 /** Default padding for left column of status reports */
 #define PAD1 "28"
 
@@ -2548,6 +2554,26 @@ static void xmce_get_version(void)
         free(str);
 }
 
+/** Get mce flight recorder contents and print them out
+ */
+static void xmce_dump_trace(void)
+{
+        char *str = 0;
+        if( xmce_ipc_string_reply(MCE_DBUS_DUMP_TRACE_REQ, &str, DBUS_TYPE_INVALID) )
+                fputs(str ?: "", stdout);
+        free(str);
+}
+
+/** Get mce datapipe execution statistics and print them out
+ */
+static void xmce_get_datapipe_stats(void)
+{
+        char *str = 0;
+        if( xmce_ipc_string_reply(MCE_DBUS_GET_DATAPIPE_STATS_REQ, &str, DBUS_TYPE_INVALID) )
+                fputs(str ?: "", stdout);
+        free(str);
+}
+
 /** Get inactivity state from mce and print it out
  */
 static void xmce_get_inactivity_state(void)
@@ -2805,6 +2831,13 @@ EXTRA"  set the display demo mode  to STATE;\n"
 EXTRA"     valid states are: 'on' and 'off'\n"
 PARAM"-N, --status\n"
 EXTRA"output MCE status\n"
+PARAM"-X, --dump-trace\n"
+EXTRA"output contents of the mce flight recorder; mce\n"
+EXTRA"  must have been started with --trace=recorder\n"
+PARAM"-W, --datapipe-stats\n"
+EXTRA"output datapipe and datapipe callback execution\n"
+EXTRA"  counts and times; mce must have been started\n"
+EXTRA"  with --trace=datapipes\n"
 PARAM"-B, --block[=<secs>]\n"
 EXTRA"block after executing commands\n"
 EXTRA"  for D-Bus\n"
@@ -2884,7 +2917,7 @@ PROG_NAME" v"G_STRINGIFY(PRG_VERSION)"\n"
 
 // Unused short options left ....
 // - - - - - - - - - - - - - - - - - - - - - - w x - z
-// - - - - - - - - - - - - - - - - - - - - - - W X - Z
+// - - - - - - - - - - - - - - - - - - - - - - - - - Z
 
 const char OPT_S[] =
 "B::" // --block,
@@ -2912,6 +2945,8 @@ const char OPT_S[] =
 "Y:"  // --deactivate-led-pattern,
 "e:"  // --powerkey-event,
 "N"   // --status,
+"X"   // --dump-trace,
+"W"   // --datapipe-stats,
 "h"   // --help,
 "H"   // --long-help,
 "V"   // --version,
@@ -2968,6 +3003,8 @@ struct option const OPT_L[] =
         { "deactivate-led-pattern",    1, 0, 'Y' }, // set_led_pattern_state()
         { "powerkey-event",            1, 0, 'e' }, // xmce_powerkey_event()
         { "status",                    0, 0, 'N' }, // xmce_get_status()
+        { "dump-trace",                0, 0, 'X' }, // xmce_dump_trace()
+        { "datapipe-stats",            0, 0, 'W' }, // xmce_get_datapipe_stats()
         { "help",                      0, 0, 'h' }, // N/A
         { "long-help",                 0, 0, 'H' }, // N/A
         { "version",                   0, 0, 'V' }, // N/A
@@ -3074,6 +3111,8 @@ int main(int argc, char **argv)
                 case 'D': xmce_set_demo_mode(optarg);             break;
 
                 case 'N': xmce_get_status();                      break;
+                case 'X': xmce_dump_trace();                      break;
+                case 'W': xmce_get_datapipe_stats();              break;
                 case 'B': mcetool_block(optarg);                  break;
 
                 case 'h':